@@ -17,6 +17,85 @@
 #    define EXR_USE_CONFIG_DEFLATE_STRUCT 1
 #endif
 
+#ifndef EXR_USE_CONFIG_DEFLATE_STRUCT
+
+/* see internal_structs.h for details on the msvc guard. */
+#    if !defined(_MSC_VER)
+#        if defined __has_include
+#            if __has_include(<stdatomic.h>)
+#                define EXR_HAS_STD_ATOMICS 1
+#            endif
+#        endif
+#    endif
+
+#    ifdef EXR_HAS_STD_ATOMICS
+#        include <stdatomic.h>
+#    elif defined(_MSC_VER)
+/* chunk.c provides these in the unity build */
+#        ifndef atomic_load
+#            include <windows.h>
+
+#            define atomic_load(object)                                        \
+                InterlockedOr64 ((int64_t volatile*) object, 0)
+
+static inline int
+atomic_compare_exchange_strong (
+    uint64_t volatile* object, uint64_t* expected, uint64_t desired)
+{
+    uint64_t prev =
+        (uint64_t) InterlockedCompareExchange64 (object, desired, *expected);
+    if (prev == *expected) return 1;
+    *expected = prev;
+    return 0;
+}
+#        endif
+#    else
+#        error OS unimplemented support for atomics
+#    endif
+
+/* Before 1.19, libdeflate takes its allocator from globals, so setting it
+ * for every buffer races when chunks are compressed on several threads.
+ * The default allocator is set once; a context with allocators of its
+ * own still sets them for each buffer. */
+static atomic_uintptr_t default_allocator_state; /* unset, setting, set */
+
+static void
+set_deflate_allocator (const struct _internal_exr_context* pctxt)
+{
+    uintptr_t expected = 0;
+    if (pctxt && (pctxt->alloc_fn != &internal_exr_alloc ||
+                  pctxt->free_fn != &internal_exr_free))
+    {
+        libdeflate_set_memory_allocator (pctxt->alloc_fn, pctxt->free_fn);
+        default_allocator_state = 0;
+        return;
+    }
+    if (atomic_load (&default_allocator_state) == 2) return;
+    if (atomic_compare_exchange_strong (&default_allocator_state, &expected, 1))
+    {
+        /* the checksum and the decompressor pick their implementation for
+         * the cpu on first use; pick them here, before any thread depends
+         * on them. The stream is an empty stored block. */
+        static const uint8_t empty[] = {
+            0x78, 0x01, 0x01, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01};
+        struct libdeflate_decompressor* decomp;
+        uint8_t                         out;
+        libdeflate_set_memory_allocator (internal_exr_alloc, internal_exr_free);
+        libdeflate_adler32 (1, empty, sizeof (empty));
+        decomp = libdeflate_alloc_decompressor ();
+        if (decomp)
+        {
+            libdeflate_zlib_decompress (decomp, empty, sizeof (empty), &out, 0, NULL);
+            libdeflate_free_decompressor (decomp);
+        }
+        default_allocator_state = 2;
+        return;
+    }
+    while (atomic_load (&default_allocator_state) == 1) {}
+}
+
+#endif
+
 /* value Aras found to be better trade off of speed vs size */
 #define EXR_DEFAULT_ZLIB_COMPRESS_LEVEL 4
 
@@ -70,9 +149,7 @@ exr_compress_buffer (
         .free_func      = pctxt ? pctxt->free_fn : internal_exr_free};
 
 #else
-    libdeflate_set_memory_allocator (
-        pctxt ? pctxt->alloc_fn : internal_exr_alloc,
-        pctxt ? pctxt->free_fn : internal_exr_free);
+    set_deflate_allocator (pctxt);
 #endif
 
     if (level < 0)
@@ -128,9 +205,7 @@ exr_uncompress_buffer (
 
     decomp = libdeflate_alloc_decompressor_ex (&opt);
 #else
-    libdeflate_set_memory_allocator (
-        pctxt ? pctxt->alloc_fn : internal_exr_alloc,
-        pctxt ? pctxt->free_fn : internal_exr_free);
+    set_deflate_allocator (pctxt);
     decomp = libdeflate_alloc_decompressor ();
 #endif
 
@@ -489,6 +489,15 @@ internal_exr_apply_piz (exr_encode_pipeline_t* encode)
     if (minNonZero <= maxNonZero)
     {
         bpl = (uint64_t) (maxNonZero - minNonZero + 1);
+        /* the bitmap of a small chunk of noisy data may not fit the
+         * compressed buffer, and the chunk is stored uncompressed */
+        if (nOut + bpl + sizeof (uint32_t) >= packedbytes)
+        {
+            memcpy (
+                encode->compressed_buffer, encode->packed_buffer, packedbytes);
+            encode->compressed_bytes = packedbytes;
+            return EXR_ERR_SUCCESS;
+        }
         memcpy (out, bitmap + minNonZero, bpl);
         out += bpl;
         nOut += bpl;
@@ -624,14 +624,18 @@ static bool strIsRed(const char* layerName, const char* str) {
         folded[i] = tolower(folded[i]);
     }
     if (strcmp(folded, "y") == 0 || strcmp(folded, "r") == 0 ||
-        strcmp(folded, "red") == 0)
+        strcmp(folded, "red") == 0) {
+        free(folded);
         return true;
+    }
     size_t l = strlen(folded);
-    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'r'))
+    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'r')) {
+        free(folded);
         return true;
-    if (l < 4)
-        return false;
-    return strcmp(folded + l - 4, ".red");
+    }
+    bool match = (l >= 4) && strcmp(folded + l - 4, ".red") == 0;
+    free(folded);
+    return match;
 }
 
 static bool strIsGreen(const char* layerName, const char* str) {
@@ -643,14 +647,18 @@ static bool strIsGreen(const char* layerName, const char* str) {
     for (int i = 0; folded[i]; ++i) {
         folded[i] = tolower(folded[i]);
     }
-    if (strcmp(folded, "g") == 0 || strcmp(folded, "green") == 0)
+    if (strcmp(folded, "g") == 0 || strcmp(folded, "green") == 0) {
+        free(folded);
         return true;
+    }
     size_t l = strlen(folded);
-    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'g'))
+    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'g')) {
+        free(folded);
         return true;
-    if (l < 6)
-        return false;
-    return strcmp(folded + l - 6, ".green");
+    }
+    bool match = (l >= 6) && strcmp(folded + l - 6, ".green") == 0;
+    free(folded);
+    return match;
 }
 
 static bool strIsBlue(const char* layerName, const char* str) {
@@ -662,14 +670,18 @@ static bool strIsBlue(const char* layerName, const char* str) {
     for (int i = 0; folded[i]; ++i) {
         folded[i] = tolower(folded[i]);
     }
-    if (strcmp(folded, "b") == 0 || strcmp(folded, "blue") == 0)
+    if (strcmp(folded, "b") == 0 || strcmp(folded, "blue") == 0) {
+        free(folded);
         return true;
+    }
     size_t l = strlen(folded);
-    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'b'))
+    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'b')) {
+        free(folded);
         return true;
-    if (l < 5)
-        return false;
-    return strcmp(folded + l - 5, ".blue");
+    }
+    bool match = (l >= 5) && strcmp(folded + l - 5, ".blue") == 0;
+    free(folded);
+    return match;
 }
 
 static bool strIsAlpha(const char* layerName, const char* str) {
@@ -681,14 +693,18 @@ static bool strIsAlpha(const char* layerName, const char* str) {
     for (int i = 0; folded[i]; ++i) {
         folded[i] = tolower(folded[i]);
     }
-    if (strcmp(folded, "a") == 0 || strcmp(folded, "alpha") == 0)
+    if (strcmp(folded, "a") == 0 || strcmp(folded, "alpha") == 0) {
+        free(folded);
         return true;
+    }
     size_t l = strlen(folded);
-    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'a'))
+    if ((l > 2) && (folded[l - 2] == '.') && (folded[l - 1] == 'a')) {
+        free(folded);
         return true;
-    if (l < 6)
-        return false;
-    return strcmp(folded + l - 6, ".alpha");
+    }
+    bool match = (l >= 6) && strcmp(folded + l - 6, ".alpha") == 0;
+    free(folded);
+    return match;
 }
 
 void nanoexr_release_image_data(nanoexr_ImageData_t* imageData)
@@ -1228,3 +1244,565 @@ exr_result_t nanoexr_read_exr(const char* filename,
     }
     return rv;
 }
+
+// Lazy reading: the header is read once, and then levels, or regions of
+// levels, are decoded a chunk at a time on request.
+
+exr_result_t nanoexr_open(nanoexr_File_t* file, const char* filename,
+                          exr_read_func_ptr_t readfn, void* callback_userData,
+                          int partIndex)
+{
+    memset(file, 0, sizeof(*file));
+    file->partIndex = partIndex;
+    file->numMipLevels = 1;
+    file->scanlinesPerChunk = 1;
+    for (int i = 0; i < 4; ++i)
+        file->rgbaIndex[i] = -1;
+
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn = tiled_exr_err_cb;
+    cinit.read_fn = readfn;
+    cinit.user_data = callback_userData;
+    exr_result_t rv = exr_start_read(&file->exr, filename, &cinit);
+    if (rv != EXR_ERR_SUCCESS) {
+        nanoexr_close(file);
+        return rv;
+    }
+
+    exr_storage_t storage;
+    exr_attr_box2i_t datawin;
+    const exr_attr_chlist_t* chlist = NULL;
+    do {
+        rv = exr_get_storage(file->exr, partIndex, &storage);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        rv = exr_get_data_window(file->exr, partIndex, &datawin);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        rv = exr_get_channels(file->exr, partIndex, &chlist);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+
+        file->dataWindowMinY = datawin.min.y;
+        file->isScanline = storage == EXR_STORAGE_SCANLINE;
+        if (storage == EXR_STORAGE_TILED) {
+            uint32_t tilew, tileh;
+            exr_tile_level_mode_t levelMode;
+            exr_tile_round_mode_t roundMode;
+            int levelsX = 1, levelsY = 1;
+            rv = exr_get_tile_descriptor(file->exr, partIndex, &tilew, &tileh,
+                                         &levelMode, &roundMode);
+            if (rv != EXR_ERR_SUCCESS)
+                break;
+            rv = exr_get_tile_levels(file->exr, partIndex, &levelsX, &levelsY);
+            if (rv != EXR_ERR_SUCCESS)
+                break;
+            file->tileWidth = (int) tilew;
+            file->tileHeight = (int) tileh;
+            // rip maps are read along the diagonal
+            file->numMipLevels = levelsX < levelsY ? levelsX : levelsY;
+        }
+        else if (storage == EXR_STORAGE_SCANLINE) {
+            rv = exr_get_scanlines_per_chunk(file->exr, partIndex, &file->scanlinesPerChunk);
+            if (rv != EXR_ERR_SUCCESS)
+                break;
+        }
+        else {
+            rv = EXR_ERR_FEATURE_NOT_IMPLEMENTED;   // deep data
+            break;
+        }
+
+        // unlayered channels are preferred, then the first of each in a layer
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int c = 0; c < chlist->num_channels; ++c) {
+                const exr_attr_chlist_entry_t* ch = &chlist->entries[c];
+                bool layered = strchr(ch->name.str, '.') != NULL;
+                if (layered != (pass == 1) || ch->x_sampling != 1 || ch->y_sampling != 1)
+                    continue;
+                int slot = -1;
+                if (strIsRed(NULL, ch->name.str)) slot = 0;
+                else if (strIsGreen(NULL, ch->name.str)) slot = 1;
+                else if (strIsBlue(NULL, ch->name.str)) slot = 2;
+                else if (strIsAlpha(NULL, ch->name.str)) slot = 3;
+                if (slot < 0 || file->rgbaIndex[slot] >= 0)
+                    continue;
+                if (file->rgbaIndex[0] < 0 && file->rgbaIndex[1] < 0 &&
+                    file->rgbaIndex[2] < 0 && file->rgbaIndex[3] < 0)
+                    file->pixelType = ch->pixel_type;
+                file->rgbaIndex[slot] = c;
+            }
+        }
+        if (file->rgbaIndex[0] < 0 && file->rgbaIndex[1] < 0 &&
+            file->rgbaIndex[2] < 0 && file->rgbaIndex[3] < 0)
+            rv = EXR_ERR_NO_ATTR_BY_NAME;
+    } while (false);
+
+    if (rv != EXR_ERR_SUCCESS) {
+        fprintf(stderr, "nanoexr open error: %s\n", exr_get_default_error_message(rv));
+        nanoexr_close(file);
+    }
+    return rv;
+}
+
+void nanoexr_close(nanoexr_File_t* file)
+{
+    if (file && file->exr)
+        exr_finish(&file->exr);
+}
+
+exr_result_t nanoexr_get_level_size(const nanoexr_File_t* file, int level,
+                                    int* width, int* height)
+{
+    if (level < 0 || level >= file->numMipLevels)
+        return EXR_ERR_ARGUMENT_OUT_OF_RANGE;
+    if (!file->isScanline)
+        return exr_get_level_sizes(file->exr, file->partIndex, level, level, width, height);
+    exr_attr_box2i_t datawin;
+    exr_result_t rv = exr_get_data_window(file->exr, file->partIndex, &datawin);
+    *width = datawin.max.x - datawin.min.x + 1;
+    *height = datawin.max.y - datawin.min.y + 1;
+    return rv;
+}
+
+exr_result_t nanoexr_region_init(const nanoexr_File_t* file, nanoexr_Region_t* region,
+                                 int level, int x, int y, int width, int height)
+{
+    int levelWidth = 0, levelHeight = 0;
+    exr_result_t rv = nanoexr_get_level_size(file, level, &levelWidth, &levelHeight);
+    if (rv != EXR_ERR_SUCCESS)
+        return rv;
+
+    int64_t x1 = (int64_t) x + width;
+    int64_t y1 = (int64_t) y + height;
+    if (x1 > levelWidth) x1 = levelWidth;
+    if (y1 > levelHeight) y1 = levelHeight;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 <= x || y1 <= y)
+        return EXR_ERR_ARGUMENT_OUT_OF_RANGE;
+
+    region->level = level;
+    region->x = x;
+    region->y = y;
+    region->width = (int) (x1 - x);
+    region->height = (int) (y1 - y);
+    if (file->isScanline) {
+        int spc = file->scanlinesPerChunk;
+        region->firstChunkX = 0;
+        region->firstChunkY = y / spc;
+        region->chunksAcross = 1;
+        region->chunkCount = (int) ((y1 + spc - 1) / spc) - region->firstChunkY;
+    }
+    else {
+        region->firstChunkX = x / file->tileWidth;
+        region->firstChunkY = y / file->tileHeight;
+        region->chunksAcross = (int) ((x1 + file->tileWidth - 1) / file->tileWidth) - region->firstChunkX;
+        region->chunkCount = region->chunksAcross *
+            ((int) ((y1 + file->tileHeight - 1) / file->tileHeight) - region->firstChunkY);
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t nanoexr_read_region_chunks(const nanoexr_File_t* file,
+                                        const nanoexr_Region_t* region,
+                                        nanoexr_ImageData_t* img,
+                                        int firstChunk, int lastChunk)
+{
+    if (img->channelCount != 4 || img->width != region->width ||
+        img->height != region->height || img->pixelType != file->pixelType)
+        return EXR_ERR_INVALID_ARGUMENT;
+
+    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    exr_result_t rv = EXR_ERR_SUCCESS;
+    const int bytesPerChannel = nanoexr_getPixelTypeSize(file->pixelType);
+    const size_t pixelStride = 4 * (size_t) bytesPerChannel;
+    const size_t imageStride = pixelStride * img->width;
+    const int x1 = region->x + region->width;
+    const int y1 = region->y + region->height;
+    uint8_t* scratch = NULL;
+    size_t scratchSize = 0;
+
+    for (int i = firstChunk; i < lastChunk && rv == EXR_ERR_SUCCESS; ++i) {
+        int chunkX = region->firstChunkX + i % region->chunksAcross;
+        int chunkY = region->firstChunkY + i / region->chunksAcross;
+        exr_chunk_info_t cinfo;
+        if (file->isScanline)
+            rv = exr_read_scanline_chunk_info(file->exr, file->partIndex,
+                                              file->dataWindowMinY + chunkY * file->scanlinesPerChunk,
+                                              &cinfo);
+        else
+            rv = exr_read_tile_chunk_info(file->exr, file->partIndex, chunkX, chunkY,
+                                          region->level, region->level, &cinfo);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        if (decoder.channels == NULL)
+            rv = exr_decoding_initialize(file->exr, file->partIndex, &cinfo, &decoder);
+        else
+            rv = exr_decoding_update(file->exr, file->partIndex, &cinfo, &decoder);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+
+        // the chunk's origin within the level
+        int cx = file->isScanline ? 0 : chunkX * file->tileWidth;
+        int cy = file->isScanline ? cinfo.start_y - file->dataWindowMinY : chunkY * file->tileHeight;
+        bool inside = cx >= region->x && cy >= region->y &&
+                      cx + cinfo.width <= x1 && cy + cinfo.height <= y1;
+
+        // chunks entirely within the region are decoded in place, the
+        // others into scratch, and the overlap copied
+        uint8_t* dst;
+        size_t lineStride;
+        if (inside) {
+            dst = img->data + (cy - region->y) * imageStride + (cx - region->x) * pixelStride;
+            lineStride = imageStride;
+        }
+        else {
+            lineStride = pixelStride * cinfo.width;
+            if (scratchSize < lineStride * cinfo.height) {
+                free(scratch);
+                scratchSize = lineStride * cinfo.height;
+                scratch = (uint8_t*) malloc(scratchSize);
+                if (!scratch) {
+                    rv = EXR_ERR_OUT_OF_MEMORY;
+                    break;
+                }
+            }
+            dst = scratch;
+        }
+        for (int c = 0; c < decoder.channel_count; ++c) {
+            decoder.channels[c].decode_to_ptr = NULL;
+            decoder.channels[c].user_pixel_stride = (int32_t) pixelStride;
+            decoder.channels[c].user_line_stride = (int32_t) lineStride;
+            decoder.channels[c].user_bytes_per_element = (int16_t) bytesPerChannel;
+            decoder.channels[c].user_data_type = (uint16_t) file->pixelType;
+            for (int slot = 0; slot < 4; ++slot) {
+                if (file->rgbaIndex[slot] == c) {
+                    decoder.channels[c].decode_to_ptr = dst + slot * bytesPerChannel;
+                    break;
+                }
+            }
+        }
+        rv = exr_decoding_choose_default_routines(file->exr, file->partIndex, &decoder);
+        if (rv == EXR_ERR_SUCCESS)
+            rv = exr_decoding_run(file->exr, file->partIndex, &decoder);
+
+        if (rv == EXR_ERR_SUCCESS && !inside) {
+            int ox0 = cx > region->x ? cx : region->x;
+            int ox1 = cx + cinfo.width < x1 ? cx + cinfo.width : x1;
+            int oy0 = cy > region->y ? cy : region->y;
+            int oy1 = cy + cinfo.height < y1 ? cy + cinfo.height : y1;
+            for (int row = oy0; row < oy1; ++row)
+                memcpy(img->data + (row - region->y) * imageStride + (ox0 - region->x) * pixelStride,
+                       scratch + (row - cy) * lineStride + (ox0 - cx) * pixelStride,
+                       (ox1 - ox0) * pixelStride);
+        }
+    }
+
+    if (rv != EXR_ERR_SUCCESS)
+        fprintf(stderr, "nanoexr error: %s\n", exr_get_default_error_message(rv));
+    free(scratch);
+    nanoexr_cleanup(file->exr, &decoder);
+    return rv;
+}
+
+void nanoexr_fill_missing_channels(const nanoexr_File_t* file, nanoexr_ImageData_t* img,
+                                   int firstRow, int lastRow)
+{
+    const int* rgba = file->rgbaIndex;
+    if (rgba[0] >= 0 && rgba[1] >= 0 && rgba[2] >= 0 && rgba[3] >= 0)
+        return;
+
+    // as nanoexr_read_exr: blue copies green, and green red, if present.
+    // Missing color is zero, and missing alpha is one, except for uint data.
+    int source[4];
+    source[0] = rgba[0] >= 0 ? 0 : -1;
+    source[1] = rgba[1] >= 0 ? 1 : source[0];
+    source[2] = rgba[2] >= 0 ? 2 : source[1];
+    source[3] = rgba[3] >= 0 ? 3 : -2;
+    const int bytesPerChannel = nanoexr_getPixelTypeSize(img->pixelType);
+    uint32_t zero = 0, one = 0;
+    if (img->pixelType == EXR_PIXEL_HALF) {
+        uint16_t h = float_to_half(1.0f);
+        memcpy(&one, &h, sizeof(h));
+    }
+    else if (img->pixelType == EXR_PIXEL_FLOAT) {
+        float f = 1.0f;
+        memcpy(&one, &f, sizeof(f));
+    }
+    for (int y = firstRow; y < lastRow; ++y) {
+        uint8_t* p = img->data + (size_t) y * img->width * 4 * bytesPerChannel;
+        for (int x = 0; x < img->width; ++x, p += 4 * bytesPerChannel) {
+            for (int c = 0; c < 4; ++c) {
+                if (source[c] == c)
+                    continue;
+                const void* from = source[c] >= 0 ? (const void*) (p + source[c] * bytesPerChannel)
+                                 : source[c] == -2 ? (const void*) &one : (const void*) &zero;
+                memcpy(p + c * bytesPerChannel, from, bytesPerChannel);
+            }
+        }
+    }
+}
+
+exr_result_t nanoexr_writer_open(nanoexr_Writer_t* writer, const char* filename,
+                                 nanoexr_attrsAdd attrsAdd, void* attrsAdd_userData,
+                                 const nanoexr_ImageData_t* levels, int levelCount,
+                                 int tileSize, exr_compression_t compression)
+{
+    if (!writer)
+        return EXR_ERR_INVALID_ARGUMENT;
+    memset(writer, 0, sizeof(*writer));
+    if (!levels || levelCount < 1 || levelCount > NANOEXR_WRITER_MAX_LEVELS ||
+        tileSize < 0 || (tileSize == 0 && levelCount != 1))
+        return EXR_ERR_INVALID_ARGUMENT;
+    for (int l = 0; l < levelCount; ++l)
+        if (!levels[l].data || levels[l].channelCount != 4 ||
+            levels[l].pixelType != levels[0].pixelType)
+            return EXR_ERR_INVALID_ARGUMENT;
+
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn = err_cb;
+    exr_result_t rv = exr_start_write(&writer->exr, filename, EXR_WRITE_FILE_DIRECTLY, &cinit);
+    if (rv != EXR_ERR_SUCCESS)
+        return rv;
+
+    writer->isScanline = tileSize == 0;
+    writer->pixelType = levels[0].pixelType;
+    writer->levels = levels;
+    writer->tileSize = tileSize;
+    exr_context_t exr = writer->exr;
+    int part = 0;
+    do {
+        rv = exr_add_part(exr, "rgba", tileSize ? EXR_STORAGE_TILED : EXR_STORAGE_SCANLINE, &part);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        writer->partIndex = part;
+        rv = exr_initialize_required_attr_simple(exr, part, levels[0].width,
+                                                 levels[0].height, compression);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        if (tileSize) {
+            rv = exr_set_tile_descriptor(exr, part, tileSize, tileSize,
+                                         levelCount > 1 ? EXR_TILE_MIPMAP_LEVELS : EXR_TILE_ONE_LEVEL,
+                                         EXR_TILE_ROUND_DOWN);
+            if (rv != EXR_ERR_SUCCESS)
+                break;
+        }
+        static const char* names[] = { "R", "G", "B", "A" };
+        for (int c = 0; c < 4 && rv == EXR_ERR_SUCCESS; ++c)
+            rv = exr_add_channel(exr, part, names[c], writer->pixelType,
+                                 EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        if (attrsAdd)
+            attrsAdd(attrsAdd_userData, exr);
+        rv = exr_write_header(exr);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+
+        if (writer->isScanline) {
+            rv = exr_get_scanlines_per_chunk(exr, part, &writer->scanlinesPerChunk);
+            if (rv != EXR_ERR_SUCCESS)
+                break;
+            writer->levelCount = 1;
+            writer->chunkCount = (levels[0].height + writer->scanlinesPerChunk - 1) /
+                                 writer->scanlinesPerChunk;
+            break;
+        }
+
+        int fileLevels = 0;
+        rv = exr_get_tile_levels(exr, part, &fileLevels, NULL);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        if (fileLevels > levelCount) {
+            // every level the file declares must be written
+            rv = EXR_ERR_INVALID_ARGUMENT;
+            break;
+        }
+        int chunk = 0;
+        for (int level = 0; level < fileLevels && rv == EXR_ERR_SUCCESS; ++level) {
+            int w = 0, h = 0;
+            rv = exr_get_level_sizes(exr, part, level, level, &w, &h);
+            if (rv == EXR_ERR_SUCCESS && (levels[level].width != w || levels[level].height != h))
+                rv = EXR_ERR_INVALID_ARGUMENT;
+            int across = (w + tileSize - 1) / tileSize;
+            int down = (h + tileSize - 1) / tileSize;
+            writer->levelFirstChunk[level] = chunk;
+            writer->levelTilesAcross[level] = across;
+            chunk += across * down;
+        }
+        writer->levelCount = fileLevels;
+        writer->chunkCount = chunk;
+    } while (false);
+
+    if (rv != EXR_ERR_SUCCESS)
+        exr_finish(&writer->exr);
+    return rv;
+}
+
+static void nanoexr_writer_locate_tile(const nanoexr_Writer_t* writer, int chunk,
+                                       int* level, int* tx, int* ty)
+{
+    int l = 0;
+    while (l + 1 < writer->levelCount && chunk >= writer->levelFirstChunk[l + 1])
+        ++l;
+    int i = chunk - writer->levelFirstChunk[l];
+    *level = l;
+    *tx = i % writer->levelTilesAcross[l];
+    *ty = i / writer->levelTilesAcross[l];
+}
+
+exr_result_t nanoexr_writer_encode_chunks(const nanoexr_Writer_t* writer,
+                                          int firstChunk, int lastChunk,
+                                          nanoexr_EncodedChunk_t* chunks)
+{
+    if (!writer || !writer->exr || !chunks || firstChunk < 0 ||
+        lastChunk > writer->chunkCount || firstChunk > lastChunk)
+        return EXR_ERR_INVALID_ARGUMENT;
+
+    static const char* names[] = { "R", "G", "B", "A" };
+    const int bytesPerChannel = nanoexr_getPixelTypeSize(writer->pixelType);
+    const size_t pixelStride = 4 * (size_t) bytesPerChannel;
+    exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    exr_result_t rv = EXR_ERR_SUCCESS;
+    for (int i = firstChunk; i < lastChunk && rv == EXR_ERR_SUCCESS; ++i) {
+        exr_chunk_info_t cinfo;
+        const nanoexr_ImageData_t* img;
+        const uint8_t* base;
+        if (writer->isScanline) {
+            img = &writer->levels[0];
+            int y = i * writer->scanlinesPerChunk;
+            rv = exr_write_scanline_chunk_info(writer->exr, writer->partIndex, y, &cinfo);
+            base = img->data + (size_t) y * pixelStride * img->width;
+        }
+        else {
+            int level, tx, ty;
+            nanoexr_writer_locate_tile(writer, i, &level, &tx, &ty);
+            img = &writer->levels[level];
+            rv = exr_write_tile_chunk_info(writer->exr, writer->partIndex,
+                                           tx, ty, level, level, &cinfo);
+            base = img->data + (size_t) ty * writer->tileSize * pixelStride * img->width +
+                   (size_t) tx * writer->tileSize * pixelStride;
+        }
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        if (encoder.channels == NULL)
+            rv = exr_encoding_initialize(writer->exr, writer->partIndex, &cinfo, &encoder);
+        else
+            rv = exr_encoding_update(writer->exr, writer->partIndex, &cinfo, &encoder);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+
+        const size_t lineStride = pixelStride * img->width;
+        for (int c = 0; c < encoder.channel_count; ++c) {
+            // the channels are sorted, so find each one's slot
+            int slot = 0;
+            while (slot < 3 && strcmp(encoder.channels[c].channel_name, names[slot]))
+                ++slot;
+            encoder.channels[c].encode_from_ptr = base + slot * bytesPerChannel;
+            encoder.channels[c].user_pixel_stride = (int32_t) pixelStride;
+            encoder.channels[c].user_line_stride = (int32_t) lineStride;
+            encoder.channels[c].user_bytes_per_element = (int16_t) bytesPerChannel;
+            encoder.channels[c].user_data_type = (uint16_t) writer->pixelType;
+        }
+        rv = exr_encoding_choose_default_routines(writer->exr, writer->partIndex, &encoder);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        // the chunk is kept rather than written, so that chunks may be
+        // compressed out of order and written in order; the default yield
+        // would insist that this chunk is the next to be written
+        encoder.yield_until_ready_fn = NULL;
+        encoder.write_fn = NULL;
+        rv = exr_encoding_run(writer->exr, writer->partIndex, &encoder);
+        if (rv != EXR_ERR_SUCCESS)
+            break;
+        nanoexr_EncodedChunk_t* out = &chunks[i - firstChunk];
+        out->data = malloc(encoder.compressed_bytes);
+        if (!out->data) {
+            rv = EXR_ERR_OUT_OF_MEMORY;
+            break;
+        }
+        memcpy(out->data, encoder.compressed_buffer, encoder.compressed_bytes);
+        out->size = encoder.compressed_bytes;
+    }
+    if (encoder.channels)
+        exr_encoding_destroy(writer->exr, &encoder);
+    return rv;
+}
+
+exr_result_t nanoexr_writer_write_chunks(nanoexr_Writer_t* writer,
+                                         int firstChunk, int lastChunk,
+                                         nanoexr_EncodedChunk_t* chunks)
+{
+    if (!writer || !writer->exr || !chunks || firstChunk < 0 ||
+        lastChunk > writer->chunkCount || firstChunk > lastChunk)
+        return EXR_ERR_INVALID_ARGUMENT;
+    exr_result_t rv = EXR_ERR_SUCCESS;
+    for (int i = firstChunk; i < lastChunk; ++i) {
+        nanoexr_EncodedChunk_t* chunk = &chunks[i - firstChunk];
+        if (rv == EXR_ERR_SUCCESS) {
+            if (!chunk->data)
+                rv = EXR_ERR_INVALID_ARGUMENT;
+            else if (writer->isScanline)
+                rv = exr_write_scanline_chunk(writer->exr, writer->partIndex,
+                                              i * writer->scanlinesPerChunk,
+                                              chunk->data, chunk->size);
+            else {
+                int level, tx, ty;
+                nanoexr_writer_locate_tile(writer, i, &level, &tx, &ty);
+                rv = exr_write_tile_chunk(writer->exr, writer->partIndex, tx, ty,
+                                          level, level, chunk->data, chunk->size);
+            }
+        }
+        free(chunk->data);
+        chunk->data = NULL;
+        chunk->size = 0;
+    }
+    return rv;
+}
+
+exr_result_t nanoexr_writer_close(nanoexr_Writer_t* writer)
+{
+    if (!writer || !writer->exr)
+        return EXR_ERR_INVALID_ARGUMENT;
+    return exr_finish(&writer->exr);
+}
+
+void nanoexr_free_encoded_chunks(nanoexr_EncodedChunk_t* chunks, int count)
+{
+    if (!chunks)
+        return;
+    for (int i = 0; i < count; ++i) {
+        free(chunks[i].data);
+        chunks[i].data = NULL;
+        chunks[i].size = 0;
+    }
+}
+
+exr_result_t nanoexr_write_tiled_exr(const char* filename,
+                                     nanoexr_attrsAdd attrsAdd, void* attrsAdd_userData,
+                                     const nanoexr_ImageData_t* levels, int levelCount,
+                                     int tileSize, exr_compression_t compression)
+{
+    if (tileSize < 1)
+        return EXR_ERR_INVALID_ARGUMENT;
+    nanoexr_Writer_t writer;
+    exr_result_t rv = nanoexr_writer_open(&writer, filename, attrsAdd, attrsAdd_userData,
+                                          levels, levelCount, tileSize, compression);
+    if (rv != EXR_ERR_SUCCESS)
+        return rv;
+
+    // a batch of chunks at a time, so that the whole file is not held
+    enum { kBatch = 256 };
+    nanoexr_EncodedChunk_t chunks[kBatch];
+    memset(chunks, 0, sizeof(chunks));
+    for (int first = 0; first < writer.chunkCount && rv == EXR_ERR_SUCCESS; first += kBatch) {
+        int last = first + kBatch < writer.chunkCount ? first + kBatch : writer.chunkCount;
+        rv = nanoexr_writer_encode_chunks(&writer, first, last, chunks);
+        if (rv == EXR_ERR_SUCCESS)
+            rv = nanoexr_writer_write_chunks(&writer, first, last, chunks);
+        else
+            nanoexr_free_encoded_chunks(chunks, last - first);
+    }
+    exr_result_t finish = nanoexr_writer_close(&writer);
+    return rv != EXR_ERR_SUCCESS ? rv : finish;
+}
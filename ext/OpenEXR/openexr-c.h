@@ -152,6 +152,114 @@ exr_result_t nanoexr_write_exr(
 
 void nanoexr_release_image_data(nanoexr_ImageData_t* imageData);
 
+// A file opened for reading levels, or regions of levels, on demand. Only
+// the header is read by nanoexr_open. The chunks of a region may be decoded
+// concurrently by calling nanoexr_read_region_chunks from several threads
+// with disjoint ranges, provided that readfn is safe to call concurrently,
+// as a pread based reader is.
+typedef struct {
+    exr_context_t exr;
+    int partIndex;
+    bool isScanline;
+    int numMipLevels;
+    exr_pixel_type_t pixelType;
+    int rgbaIndex[4];       // the channel read for each of R, G, B and A, or -1
+    int tileWidth, tileHeight;
+    int scanlinesPerChunk;
+    int dataWindowMinY;
+} nanoexr_File_t;
+
+// a region of a level, clamped to the level, and the chunks overlapping it
+typedef struct {
+    int level;
+    int x, y, width, height;
+    int firstChunkX, firstChunkY;
+    int chunksAcross;
+    int chunkCount;
+} nanoexr_Region_t;
+
+exr_result_t nanoexr_open(nanoexr_File_t* file, const char* filename,
+                          exr_read_func_ptr_t readfn, void* callback_userData,
+                          int partIndex);
+void nanoexr_close(nanoexr_File_t* file);
+
+exr_result_t nanoexr_get_level_size(const nanoexr_File_t* file, int level,
+                                    int* width, int* height);
+
+exr_result_t nanoexr_region_init(const nanoexr_File_t* file, nanoexr_Region_t* region,
+                                 int level, int x, int y, int width, int height);
+
+// decodes chunks [firstChunk, lastChunk) of region into img, which must be
+// an RGBA image of the region's size, in the file's pixel type.
+exr_result_t nanoexr_read_region_chunks(const nanoexr_File_t* file,
+                                        const nanoexr_Region_t* region,
+                                        nanoexr_ImageData_t* img,
+                                        int firstChunk, int lastChunk);
+
+// fills the channels of rows [firstRow, lastRow) of a decoded region that
+// the file does not have, as nanoexr_read_exr does.
+void nanoexr_fill_missing_channels(const nanoexr_File_t* file, nanoexr_ImageData_t* img,
+                                   int firstRow, int lastRow);
+
+// An RGBA file being written. The chunks are compressed by
+// nanoexr_writer_encode_chunks, which may be called from several threads
+// with disjoint ranges, and are then written in order by
+// nanoexr_writer_write_chunks, on one thread.
+#define NANOEXR_WRITER_MAX_LEVELS 32
+typedef struct {
+    exr_context_t exr;
+    int partIndex;
+    bool isScanline;
+    exr_pixel_type_t pixelType;
+    const nanoexr_ImageData_t* levels;
+    int levelCount;
+    int tileSize;
+    int scanlinesPerChunk;
+    int chunkCount;
+    int levelFirstChunk[NANOEXR_WRITER_MAX_LEVELS];
+    int levelTilesAcross[NANOEXR_WRITER_MAX_LEVELS];
+} nanoexr_Writer_t;
+
+typedef struct {
+    void* data;         // malloc'd, and freed when written
+    uint64_t size;
+} nanoexr_EncodedChunk_t;
+
+// writes the header of a scanline file if tileSize is zero, or else of a
+// tiled file. levels is a mip chain, full resolution first, with every
+// level the file requires; a single level has no mips. A scanline file
+// has a single level. The levels must outlive the writer.
+exr_result_t nanoexr_writer_open(nanoexr_Writer_t* writer, const char* filename,
+                                 nanoexr_attrsAdd, void* attrsAdd_userData,
+                                 const nanoexr_ImageData_t* levels, int levelCount,
+                                 int tileSize, exr_compression_t compression);
+
+// compresses chunks [firstChunk, lastChunk) into chunks[0, lastChunk - firstChunk)
+exr_result_t nanoexr_writer_encode_chunks(const nanoexr_Writer_t* writer,
+                                          int firstChunk, int lastChunk,
+                                          nanoexr_EncodedChunk_t* chunks);
+
+// writes and frees chunks [firstChunk, lastChunk), held in
+// chunks[0, lastChunk - firstChunk), which must follow the chunks already
+// written
+exr_result_t nanoexr_writer_write_chunks(nanoexr_Writer_t* writer,
+                                         int firstChunk, int lastChunk,
+                                         nanoexr_EncodedChunk_t* chunks);
+
+// finishes the file; every chunk must have been written
+exr_result_t nanoexr_writer_close(nanoexr_Writer_t* writer);
+
+// frees encoded chunks that will not be written
+void nanoexr_free_encoded_chunks(nanoexr_EncodedChunk_t* chunks, int count);
+
+// writes a tiled RGBA file. levels is a mip chain, full resolution first,
+// with every level the file requires; a single level writes a file
+// without mips.
+exr_result_t nanoexr_write_tiled_exr(const char* filename,
+                                     nanoexr_attrsAdd, void* attrsAdd_userData,
+                                     const nanoexr_ImageData_t* levels, int levelCount,
+                                     int tileSize, exr_compression_t compression);
+
 bool nanoexr_Gaussian_resample(const nanoexr_ImageData_t* src,
                                nanoexr_ImageData_t* dst);
 
@@ -95,6 +95,10 @@ public:
         add_process(Idle);
     }
 
+    ~LoadSkeletonModule() {
+        Unregister();
+    }
+
     void LoadSkeleton() {
         if (pendingFile) {
             std::cerr << "LoadSkeleton: pendingFile is not zero\n";
@@ -194,6 +198,10 @@ public:
         add_process(Idle);
     }
 
+    ~LoadAnimationModule() {
+        Unregister();
+    }
+
     void LoadAnimation(const std::string& skeletonName) {
         if (pendingFile) {
             std::cerr << "LoadAnimation: pendingFile is not zero\n";
@@ -282,6 +290,10 @@ public:
         add_process(Idle);
     }
 
+    ~LoadModelModule() {
+        Unregister();
+    }
+
     void LoadModel(const std::string& skeletonName) {
         if (pendingFile) {
             std::cerr << "LoadModel: pendingFile is not zero\n";
@@ -156,7 +156,10 @@ struct ConsoleActivity::data {
         console.System().RegisterCommand("l", "Run landru program",
                                          [this](const csys::String &landru) {
             try {
-                LandruRun(landru.m_String.c_str());
+                // the program runs a tick per frame until its machines retire
+                LandruDestroy(this->landru);
+                this->landru = nullptr;
+                this->landru = LandruCreate(landru.m_String.c_str());
             }
             catch(std::exception& e) {
                 console.System().Log(csys::ItemType::ERROR) << "Couldn't run the landru program" << csys::endl;
@@ -170,6 +173,7 @@ struct ConsoleActivity::data {
     ImVec4 clear_color = ImVec4(0.25f, 0.25f, 0.25f, 1.00f);
     std::once_flag must_init;
     bool ui_visible = true;
+    Landru* landru = nullptr;
 };
 
 ConsoleActivity::ConsoleActivity()
@@ -183,11 +187,17 @@ ConsoleActivity::ConsoleActivity()
 
 ConsoleActivity::~ConsoleActivity()
 {
+    LandruDestroy(_self->landru);
     delete _self;
 }
 
 void ConsoleActivity::RunUI(const LabViewInteraction&)
 {
+    if (_self->landru && !LandruUpdate(_self->landru, ImGui::GetIO().DeltaTime)) {
+        LandruDestroy(_self->landru);
+        _self->landru = nullptr;
+    }
+
     if (!_self->ui_visible)
         return;
     
@@ -17,7 +17,7 @@ namespace lab {
 
 struct JournalActivity::data {
     bool uiVisible = true;
-    JournalNode* selection = nullptr;
+    JournalIndex selection = kJournalNil;
 };
 
 JournalActivity::JournalActivity() : Activity(JournalActivity::sname()) {
@@ -32,12 +32,12 @@ JournalActivity::~JournalActivity() {
     delete _self;
 }
 
-ImGuiTreeNodeFlags JournalActivity::ComputeDisplayFlags(JournalNode* node)
+ImGuiTreeNodeFlags JournalActivity::ComputeDisplayFlags(Journal& journal, JournalIndex node)
 {
     ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_None;
     
     // set the flag if leaf or not
-    if (node->sibling == nullptr) {
+    if (journal.Node(node)->sibling == kJournalNil) {
         flags |= ImGuiTreeNodeFlags_Leaf;
         flags |= ImGuiTreeNodeFlags_Bullet;
     }
@@ -49,12 +49,22 @@ ImGuiTreeNodeFlags JournalActivity::ComputeDisplayFlags(JournalNode* node)
     return flags;
 }
 
-bool JournalActivity::DrawJournalNode(JournalNode* node)
+bool JournalActivity::DrawJournalNode(Journal& journal, JournalIndex node)
 {
-    const char* name = node->transaction.message.c_str();
-    ImGuiTreeNodeFlags flags = ComputeDisplayFlags(node);
-    ImGui::PushID(node);
-    bool ret = ImGui::TreeNodeEx(name, flags);
+    std::string name = journal.Message(node);
+    ImGuiTreeNodeFlags flags = ComputeDisplayFlags(journal, node);
+    ImGui::PushID((int) node);
+
+    // spilled history kept only its messages, and can't be undone
+    bool spilled = journal.Node(node)->IsSpilled();
+    if (spilled)
+        ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+    bool ret = ImGui::TreeNodeEx(name.c_str(), flags);
+    if (spilled) {
+        ImGui::PopStyleColor();
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Beyond the journal's memory budget; can't be undone");
+    }
     ImGui::PopID();
     return ret;
 }
@@ -91,9 +101,9 @@ void JournalActivity::DrawChildrendHierarchyDecoration(
 }
 
 // returns the node's rectangle
-ImRect JournalActivity::DrawJournalHierarchy(JournalNode* node)
+ImRect JournalActivity::DrawJournalHierarchy(Journal& journal, JournalIndex node)
 {
-    bool recurse = DrawJournalNode(node);
+    bool recurse = DrawJournalNode(journal, node);
     
     if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
         _self->selection = node;
@@ -105,11 +115,11 @@ ImRect JournalActivity::DrawJournalHierarchy(JournalNode* node)
     if (recurse) {
         // draw all children and store their rect position
         std::vector<ImRect> rects;
-        JournalNode* curr = node->sibling;
-        while (curr) {
-            ImRect childRect = DrawJournalHierarchy(curr);
+        JournalIndex curr = journal.Node(node)->sibling;
+        while (curr != kJournalNil) {
+            ImRect childRect = DrawJournalHierarchy(journal, curr);
             rects.push_back(childRect);
-            curr = curr->sibling;
+            curr = journal.Node(curr)->sibling;
         }
         
         if (rects.size() > 0) {
@@ -143,12 +153,16 @@ void JournalActivity::RunUI(const LabViewInteraction&) {
     if (ImGui::Button("Trim")) {
     }
 
-    ImGui::BeginChild("###Journal");
     auto& journal = orchestrator->GetJournal();
-    auto curr = &journal.root;
-    while (curr) {
-        DrawJournalHierarchy(curr);
-        curr = curr->next;
+    if (journal.MemoryBudget())
+        ImGui::TextDisabled("Undo is limited to the last %zu KB of history",
+                            journal.MemoryBudget() >> 10);
+
+    ImGui::BeginChild("###Journal");
+    auto curr = journal.Root();
+    while (curr != kJournalNil) {
+        DrawJournalHierarchy(journal, curr);
+        curr = journal.Node(curr)->next;
     }
     ImGui::EndChild();
     ImGui::End();
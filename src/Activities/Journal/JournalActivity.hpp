@@ -21,11 +21,11 @@ class JournalActivity : public Activity
 {
     struct data;
     data* _self;
-    ImRect DrawJournalHierarchy(JournalNode*);
-    bool DrawJournalNode(JournalNode*);
+    ImRect DrawJournalHierarchy(Journal&, JournalIndex);
+    bool DrawJournalNode(Journal&, JournalIndex);
     void DrawChildrendHierarchyDecoration(ImRect parentRect,
                                           std::vector<ImRect> childrenRects);
-    ImGuiTreeNodeFlags ComputeDisplayFlags(JournalNode*);
+    ImGuiTreeNodeFlags ComputeDisplayFlags(Journal&, JournalIndex);
     
     // activities
     void RunUI(const LabViewInteraction&);
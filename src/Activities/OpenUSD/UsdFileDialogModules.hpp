@@ -164,6 +164,10 @@ public:
         add_process(Idle);
     }
 
+    ~LoadLayerModule() {
+        Unregister();
+    }
+
     void LoadStage() {
         if (pendingFile) {
             std::cerr << "LoadStage: pendingFile is not zero\n";
@@ -289,6 +293,10 @@ public:
         add_process(Idle);
     }
 
+    ~ExportStageModule() {
+        Unregister();
+    }
+
     void ExportCurrentStage() {
         if (pendingFile != 0) {
             std::cerr << "ExportCurrentStage: an export is currently in progress\n";
@@ -374,6 +382,10 @@ public:
     {
     }
 
+    ~ShotTemplateModule() {
+        Unregister();
+    }
+
     void CreateShotFromTemplate() {
         emit_event(NameRequest);
     }
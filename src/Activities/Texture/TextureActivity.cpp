@@ -13,14 +13,17 @@
 #include "Lab/LabFileDialogManager.hpp"
 #include "Lab/CoreProviders/Color/ColorProvider.hpp"
 #include "Lab/CoreProviders/Color/nanocolorUtils.h"
+#include "Lab/CoreProviders/Texture/PixelConvert.hpp"
 #include "Lab/CoreProviders/Texture/TextureCache.hpp"
 
 #ifndef IMGUI_DEFINE_MATH_OPERATORS
 #define IMGUI_DEFINE_MATH_OPERATORS
 #endif
 #include "imgui.h"
+#include "implot.h"
 #include "imgui_tex_inspect/imgui_tex_inspect.h"
 
+#include <algorithm>
 #include <map>
 #include <mutex>
 #include <string>
@@ -39,11 +42,19 @@ namespace ImGuiTexInspect
 
 namespace {
     std::map<int, LabImageData_t> loadedTextureMap;
+    std::map<int, std::shared_ptr<LabImageData_t>> convertedTextureMap;
     std::map<ImTextureID, int> loadedTextureMapReverse;
     std::map<std::string, Texture> hardwareTextures;
+    // the decoded images, whose statistics the stats panel shows
+    std::map<ImTextureID, std::shared_ptr<LabImageData_t>> sourceImages;
     vector<string> texture_names;
 }
 
+std::shared_ptr<LabImageData_t> SourceImage(ImTextureID texture) {
+    auto it = sourceImages.find(texture);
+    return it == sourceImages.end() ? nullptr : it->second;
+}
+
 Texture LoadTexture(const char *path) {
     auto it = hardwareTextures.find(path);
     if (it != hardwareTextures.end()) {
@@ -57,14 +68,31 @@ Texture LoadTexture(const char *path) {
     if (!tex)
         return ret;
 
+    // into the rendering color space, if one is set, before it is encoded
+    bool premultiplied = false;
+    const char* colorSpace = lab::ColorProvider::FileColorSpace(path, &premultiplied);
+    if (auto converted = lab::ColorProvider::instance()->ConvertCachedToRenderingColorSpace(
+                path, colorSpace, premultiplied))
+        tex = converted;
+
     // fetch an encoded texture if possible.
     int i = tc->GetEncodedTexture(tex);
     if (i >= 0) {
         ret.texture = (ImTextureID) LabGetEncodedTexture(i);
         ret.size = {(float)tex->width, (float)tex->height};
 
-        loadedTextureMap[i] = *tex;
+        // the inspector reads uint8, half and float components, so uint32
+        // data is inspected through a float copy
+        if (tex->pixelType == LAB_PIXEL_UINT) {
+            auto copy = lab::ConvertImage(*tex, LAB_PIXEL_FLOAT, tex->channelCount);
+            if (copy)
+                convertedTextureMap[i] = copy;
+            loadedTextureMap[i] = copy ? *copy : *tex;
+        }
+        else
+            loadedTextureMap[i] = *tex;
         loadedTextureMapReverse[ret.texture] = i;
+        sourceImages[ret.texture] = tex;
         hardwareTextures[path] = ret;
 
         texture_names.push_back(path);
@@ -72,6 +100,31 @@ Texture LoadTexture(const char *path) {
     return ret;
 }
 
+void ReleaseTexture(const char* path) {
+    auto it = hardwareTextures.find(path);
+    if (it == hardwareTextures.end())
+        return;
+    ImTextureID texture = it->second.texture;
+    hardwareTextures.erase(it);
+
+    auto rit = loadedTextureMapReverse.find(texture);
+    if (rit != loadedTextureMapReverse.end()) {
+        loadedTextureMap.erase(rit->second);
+        convertedTextureMap.erase(rit->second);
+        loadedTextureMapReverse.erase(rit);
+    }
+
+    // drop the handle LoadTexture retained, then unpin the image
+    LabReleaseEncodedTexture((void*) (uintptr_t) texture);
+    auto sit = sourceImages.find(texture);
+    if (sit != sourceImages.end()) {
+        lab::TextureCache::instance()->ReleaseEncodedTexture(sit->second);
+        sourceImages.erase(sit);
+    }
+    texture_names.erase(std::remove(texture_names.begin(), texture_names.end(), path),
+                        texture_names.end());
+}
+
 bool BackEnd_GetData(Inspector* inspector, ImTextureID texture,
                      int x, int y, int w, int h, BufferDesc* bufferDesc) {
     if (!bufferDesc)
@@ -101,7 +154,6 @@ bool BackEnd_GetData(Inspector* inspector, ImTextureID texture,
     bufferDesc->Width = tx.width;
     bufferDesc->Height = tx.height;
 
-    // inspector has to be upgraded for f16 data
     if (tx.pixelType == LAB_PIXEL_UINT8)
         bufferDesc->Data_uint8_t = tx.data;
     else if (tx.pixelType == LAB_PIXEL_FLOAT)
@@ -122,9 +174,11 @@ bool BackEnd_GetData(Inspector* inspector, ImTextureID texture,
 namespace lab {
 
 class LoadTextureModule : public CSP_Module {
-    CSP_Process LoadRequest, Loading, Error, LoadFile, Idle;
+    CSP_Process LoadRequest, Loading, Error, LoadFile, Decoding, Idle;
     int pendingFile = 0;
     FileDialogManager::FileReq req;
+    TextureCache::ReadHandle decode;
+    static constexpr int kDecodePollMs = 4;
 public:
     LoadTextureModule(CSP_Engine& engine)
     : CSP_Module(engine, "LoadTextureModule")
@@ -164,9 +218,19 @@ public:
     , LoadFile("LoadFile",
                [this]() {
                    printf("Entering file_load_success\n");
-                   auto fdm = LabApp::instance()->fdm();
+                   // the user is waiting on this image, so it goes ahead of
+                   // any preloads
+                   decode = TextureCache::instance()->ReadAndCacheAsync(req.path.c_str(), 100);
+                   this->emit_event(Decoding);
+               })
+    , Decoding("Decoding",
+               [this]() {
+                   if (!decode.Ready()) {
+                       // poll again shortly, without holding a worker
+                       this->emit_event(Decoding, kDecodePollMs);
+                       return;
+                   }
                    auto path = req.path.c_str();
-                   auto tc = TextureCache::instance();
                    auto img = ImGuiTexInspect::LoadTexture(req.path.c_str());
                    if (img.texture >= 0) {
                        printf("Loaded texture %s\n", path);
@@ -188,9 +252,14 @@ public:
         add_process(Loading);
         add_process(Error);
         add_process(LoadFile);
+        add_process(Decoding);
         add_process(Idle);
     }
 
+    ~LoadTextureModule() {
+        Unregister();
+    }
+
     void LoadTexture() {
         emit_event(LoadRequest);
     }
@@ -249,11 +318,22 @@ void TextureActivity::RunTextureCachePanel() {
     ImGui::Begin("Loaded textures##tcp");
     ImVec2 windowSize = ImGui::GetWindowSize();
 
-    if (_self->cache_selected_texture_index >= 0 && ImGuiTexInspect::texture_names.size() > 0) {
+    if (_self->cache_selected_texture_index >= 0 &&
+        _self->cache_selected_texture_index < (int) ImGuiTexInspect::texture_names.size()) {
         if (ImGui::Button("Inspect")) {
             _self->focussedTexture =
             ImGuiTexInspect::LoadTexture(ImGuiTexInspect::texture_names[_self->cache_selected_texture_index].c_str());
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Release")) {
+            std::string name = ImGuiTexInspect::texture_names[_self->cache_selected_texture_index];
+            auto it = ImGuiTexInspect::hardwareTextures.find(name);
+            if (it != ImGuiTexInspect::hardwareTextures.end() &&
+                it->second.texture == _self->focussedTexture.texture)
+                _self->focussedTexture = {};
+            ImGuiTexInspect::ReleaseTexture(name.c_str());
+            _self->cache_selected_texture_index = 0;
+        }
     }
     else if (ImGuiTexInspect::texture_names.size()) {
         if (ImGui::Button("Select a texture")) {
@@ -266,6 +346,14 @@ void TextureActivity::RunTextureCachePanel() {
         }
     }
 
+    auto stats = TextureCache::instance()->GetStats();
+    ImGui::Text("%zu images, %.1f of %.1f MB, %.1f MB pinned",
+                stats.entries, stats.bytesResident / 1048576.0,
+                stats.budget / 1048576.0, stats.bytesPinned / 1048576.0);
+    ImGui::Text("%llu hits, %llu misses, %llu evictions",
+                (unsigned long long) stats.hits, (unsigned long long) stats.misses,
+                (unsigned long long) stats.evictions);
+
     windowSize.x = -FLT_MIN;
     windowSize.y = 0;
     if (ImGui::BeginListBox("###TextureCacheList", windowSize)) {
@@ -486,6 +574,94 @@ void TextureActivity::RunTextureInspectorPanel() {
     ImGui::End();
 }
 
+void TextureActivity::RunTextureStatsPanel() {
+    ImGui::Begin("Texture statistics##tsp");
+    auto image = ImGuiTexInspect::SourceImage(_self->focussedTexture.texture);
+    // computed on the pool the first time an image is shown, then cached
+    auto stats = image ? lab::TextureCache::instance()->GetImageStats(image) : nullptr;
+    if (!image) {
+        ImGui::TextUnformatted("No texture selected");
+        ImGui::End();
+        return;
+    }
+    if (!stats) {
+        ImGui::TextUnformatted("Computing...");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("%d x %d, %d channels, %.1f ms", image->width, image->height,
+                stats->channels, stats->ms);
+    static const char* channelNames[] = { "R", "G", "B", "A" };
+    if (ImGui::BeginTable("##channels", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        for (const char* heading : { "", "min", "max", "mean", "NaN", "Inf", "negative" })
+            ImGui::TableSetupColumn(heading);
+        ImGui::TableHeadersRow();
+        for (int c = 0; c < stats->channels; ++c) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats->channels == 1 ? "Y" : channelNames[c]);
+            ImGui::TableNextColumn();
+            if (stats->min[c] <= stats->max[c]) {
+                ImGui::Text("%g", stats->min[c]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%g", stats->max[c]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%g", stats->mean[c]);
+            }
+            else {
+                ImGui::TextUnformatted("-");
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted("-");
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted("-");
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats->nan[c]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats->inf[c]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats->negative[c]);
+        }
+        ImGui::EndTable();
+    }
+
+    // log2 luminance, eight bins per stop; the y axis is logarithmic so
+    // that sparse highlights remain visible beside the mid tones
+    static double stops[lab::ImageStats::kHistogramBins];
+    static double counts[lab::ImageStats::kHistogramBins];
+    const double binWidth = double(lab::ImageStats::kHistogramMaxLog2 - lab::ImageStats::kHistogramMinLog2) /
+                            lab::ImageStats::kHistogramBins;
+    for (int i = 0; i < lab::ImageStats::kHistogramBins; ++i) {
+        stops[i] = lab::ImageStats::kHistogramMinLog2 + (i + 0.5) * binWidth;
+        counts[i] = double(stats->histogram[i]);
+    }
+    if (ImPlot::BeginPlot("Luminance##tsp", ImVec2(-1, 220))) {
+        ImPlot::SetupAxes("log2 luminance", "pixels");
+        ImPlot::SetupAxisScale(ImAxis_Y1, ImPlotScale_Log10);
+        ImPlot::SetupAxisLimits(ImAxis_X1, lab::ImageStats::kHistogramMinLog2,
+                                lab::ImageStats::kHistogramMaxLog2);
+        ImPlot::PlotBars("##luminance", stops, counts, lab::ImageStats::kHistogramBins, binWidth);
+        ImPlot::EndPlot();
+    }
+    ImGui::Text("below 2^%d: %llu, above 2^%d: %llu",
+                int(lab::ImageStats::kHistogramMinLog2), (unsigned long long) stats->below,
+                int(lab::ImageStats::kHistogramMaxLog2), (unsigned long long) stats->above);
+
+    const bool gray = stats->channels == 1;
+    auto locations = [gray](const char* label, const std::vector<lab::ImageStats::Location>& where) {
+        if (where.empty() || !ImGui::TreeNode(label))
+            return;
+        for (auto& l : where)
+            ImGui::Text("%d, %d  %s", l.x, l.y, gray ? "Y" : channelNames[l.channel]);
+        ImGui::TreePop();
+    };
+    locations("NaN locations", stats->nanLocations);
+    locations("Inf locations", stats->infLocations);
+    locations("Negative locations", stats->negativeLocations);
+    ImGui::End();
+}
+
 void TextureActivity::RunUI(const LabViewInteraction&)
 {
     std::call_once(_self->init, [this]() {
@@ -497,6 +673,7 @@ void TextureActivity::RunUI(const LabViewInteraction&)
 
     RunTextureCachePanel();
     RunTextureInspectorPanel();
+    RunTextureStatsPanel();
 }
 
 void TextureActivity::Update()
@@ -551,8 +728,14 @@ void TextureActivity::Menu() {
             _self->loadTextureModule.LoadTexture();
         }
 
+        if (ImGui::MenuItem("Generate Mip Chains")) {
+            TextureCache::instance()->GenerateAllMips();
+        }
+
         if (ImGui::MenuItem("Export Texture Cache")) {
-            TextureCache::instance()->ExportCache("/var/tmp");
+            for (auto& f : TextureCache::instance()->ExportCache("/var/tmp"))
+                printf("%s %s, %.1f ms, %zu bytes\n", f.ok ? "Exported" : "Failed to export",
+                       f.path.c_str(), f.ms, f.bytes);
         }
         ImGui::EndMenu();
     }
@@ -18,6 +18,7 @@ class TextureActivity : public Activity
     data* _self;
     void RunTextureCachePanel();
     void RunTextureInspectorPanel();
+    void RunTextureStatsPanel();
     
     // activities
     void RunUI(const LabViewInteraction&);
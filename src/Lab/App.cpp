@@ -6,6 +6,8 @@
 #include "StudioCore.hpp"
 #include "LabFileDialogManager.hpp"
 #include "AppTheme.h"
+#include "LabDirectories.h"
+#include "LabProfiler.hpp"
 #include "CoreProviders/Color/nanocolor.h"
 #include "../Providers/Scheme/SchemeProvider.hpp"
 
@@ -197,6 +199,17 @@ void ShowWindowMenu()
         if (ImGui::MenuItem("Reset Layout"))
             ResetLayout();
 
+        bool profiling = Profiler::Enabled();
+        if (ImGui::MenuItem("Profile Activities", nullptr, profiling))
+            Profiler::SetEnabled(!profiling);
+        if (ImGui::MenuItem("Write Profile Trace", nullptr, false, profiling)) {
+            std::string path = std::string(lab_temp_directory_path()) + "/lab_trace.json";
+            if (Profiler::WriteChromeTrace(path.c_str()))
+                std::cout << "Wrote profile trace to " << path << std::endl;
+            else
+                std::cerr << "Could not write profile trace to " << path << std::endl;
+        }
+
         ImGui::Separator();
 
         // Iterate over all windows in ImGui
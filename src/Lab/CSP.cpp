@@ -1,14 +1,20 @@
 
 #include "CSP.hpp"
+#include "concurrentqueue.hpp"
 
-#include <zmq.hpp>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace lab {
 
@@ -27,6 +33,10 @@ void CSP_Module::Register() {
     engine.register_module(this);
 }
 
+void CSP_Module::Unregister() {
+    engine.unregister_module(module_name);
+}
+
 void CSP_Module::add_process(CSP_Process& proc) {
     processes.emplace_back(&proc);
 }
@@ -35,80 +45,320 @@ void CSP_Module::emit_event(const CSP_Process& proc) {
     engine.emit_event(proc, 0);
 }
 
-struct TimedProcess {
+void CSP_Module::emit_event(const CSP_Process& proc, int msDelay) {
+    engine.emit_event(proc, msDelay);
+}
+
+namespace {
+
+// Events are fixed size records, routed to the serial queue of the module
+// owning the process. If the module has been unregistered by the time the
+// event is executed, the event is dropped rather than dereferenced; the
+// generation tells events emitted before a module was unregistered from
+// those emitted after its name was registered again. A worker checks the
+// registration and runs the behavior under the queue's execution lock, and
+// unregistering takes that lock, so once unregister_module returns no
+// behavior of the module is running or will run.
+struct EventRecord {
     const CSP_Process* process;
-    std::chrono::steady_clock::time_point when;
+    CSP_ModuleQueue* queue;
+    uint64_t due;   // timing wheel tick, unused for immediate events
+    uint64_t generation;
+};
 
-    // implement < for priority queue
-    bool operator<(const TimedProcess& other) const {
-        return when > other.when;
+// A hierarchical timing wheel, four levels of 256 slots, with one tick per
+// millisecond. Events are filed in the level corresponding to the highest
+// byte in which their due tick differs from the current tick, and cascade
+// to lower levels as the current tick crosses into their range. Slot
+// storage is retained, so once warmed up, scheduling doesn't allocate.
+class TimingWheel {
+public:
+    static constexpr int kBits = 8;
+    static constexpr int kSlots = 1 << kBits;
+    static constexpr int kLevels = 4;
+    static constexpr uint64_t kRange = 1ull << (kBits * kLevels);
+
+    size_t size() const { return _size; }
+
+    void insert(EventRecord e) {
+        if (e.due < _now)
+            e.due = _now;
+        if (e.due - _now >= kRange)
+            e.due = _now + kRange - 1;
+        uint64_t x = e.due ^ _now;
+        int level = 0;
+        while (level < kLevels - 1 && (x >> (kBits * (level + 1))))
+            ++level;
+        _slots[level][(e.due >> (kBits * level)) & (kSlots - 1)].push_back(e);
+        ++_size;
+    }
+
+    // fire every event due at or before tick
+    template <typename F>
+    void advance(uint64_t tick, F&& fire) {
+        while (_now <= tick) {
+            if (!_size) {
+                _now = tick + 1;
+                return;
+            }
+            // cascade higher levels down, from highest to lowest, whenever
+            // the current tick enters a new block of a level.
+            for (int level = kLevels - 1; level > 0; --level) {
+                uint64_t mask = (1ull << (kBits * level)) - 1;
+                if ((_now & mask) == 0) {
+                    auto& slot = _slots[level][(_now >> (kBits * level)) & (kSlots - 1)];
+                    _cascade.swap(slot);
+                    _size -= _cascade.size();
+                    for (auto& e : _cascade)
+                        insert(e);
+                    _cascade.clear();
+                }
+            }
+            auto& slot = _slots[0][_now & (kSlots - 1)];
+            if (slot.size()) {
+                _fire.swap(slot);
+                _size -= _fire.size();
+                for (auto& e : _fire)
+                    fire(e);
+                _fire.clear();
+            }
+            ++_now;
+        }
     }
+
+    uint64_t now() const { return _now; }
+
+private:
+    std::vector<EventRecord> _slots[kLevels][kSlots];
+    std::vector<EventRecord> _cascade, _fire;
+    uint64_t _now = 0;
+    size_t _size = 0;
+};
+
+} // anon
+
+// Each module has a queue of events, which is scheduled onto a worker as a
+// unit. A queue is held by at most one worker at a time, which is what makes
+// the execution of a module's processes serial.
+struct CSP_ModuleQueue {
+    std::string name;
+    moodycamel::ConcurrentQueue<EventRecord> events;
+    std::atomic<bool> registered{true};
+    std::atomic<uint64_t> generation{0};  // incremented when unregistered
+    std::mutex execution;   // held while a behavior of the module runs
+    std::atomic<bool> scheduled{false};
+    std::atomic<int64_t> depth{0};
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+};
+
+namespace {
+
+// Module queues ready to run. The owning worker pushes and pops at the back,
+// other workers steal from the front.
+struct WorkerDeque {
+    std::mutex mutex;
+    std::deque<CSP_ModuleQueue*> queues;
 };
 
+thread_local const void* tlsEngine = nullptr;
+thread_local int tlsWorker = -1;
+thread_local const CSP_ModuleQueue* tlsRunning = nullptr; // the queue whose behavior is running
+
+} // anon
+
 struct CSP_Engine::Self {
-    zmq::context_t context;
-    zmq::socket_t pub_socket;
-    zmq::socket_t sub_socket;
-    std::thread worker;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerDeque>> deques;
+    // Schedule holds this shared, run() and stop() exclusively while they
+    // build or tear down deques, and change running
+    std::shared_mutex dequesMutex;
+    int workerCount = 1;
+    std::atomic<unsigned> nextDeque{0};
     std::mutex workerMutex;
-    bool running;
+    std::atomic<bool> running{false};
 
-    std::map<int, CSP_Process*> processes;
+    // module queues live as long as the engine, since events may refer to
+    // them after their module is unregistered. There is one per module name,
+    // reused when a module of that name registers again, so that the number
+    // of queues is bounded by the number of names. Guarded by workerMutex.
+    std::vector<std::unique_ptr<CSP_ModuleQueue>> moduleQueues;
     std::map<std::string, CSP_Module*> modules;
-
-    std::priority_queue<TimedProcess> timedProcessQueue;
+    std::map<std::string, CSP_ModuleQueue*> moduleQueueByName;
+    CSP_ModuleQueue unregistered; // processes never registered with a module
+    int nextProcess = 1;
+
+    // ready module queues are counted, so that idle workers know when to wake
+    std::atomic<int64_t> readyCount{0};
+    std::mutex readyMutex;
+    std::condition_variable readyCv;
+    std::atomic<int> workersSleeping{0};
+
+    // delayed events, handed to the service thread which owns the wheel
+    moodycamel::ConcurrentQueue<EventRecord> timed;
+    TimingWheel wheel;
+    std::atomic<size_t> pendingTimed{0};
     std::thread serviceThread;
     std::mutex serviceMutex;
     std::condition_variable cv;
+    bool serviceIdle = false;   // guarded by serviceMutex
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
 
-    std::atomic<int> nextProcess{1};
-    std::atomic<int> nextModule{1};
-    struct EventData {
-        int id;
-        std::string message;
-        const CSP_Process* process;
-    };
+    std::atomic<uint64_t> emitted{0};
+    std::atomic<uint64_t> executed{0};
+    std::atomic<uint64_t> dropped{0};
 
-    std::map<int, EventData> pendingProcesses;
+    Self() {
+        unregistered.name = "<unregistered>";
+    }
 
-    void AsyncSendProcess(const CSP_Process& process, zmq::socket_t& socket) {
-        int pendingMessageId = ++nextProcess;
-        pendingProcesses[pendingMessageId] = {pendingMessageId, process.name, &process};
+    uint64_t Tick(std::chrono::steady_clock::time_point t) const {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t - epoch).count();
+    }
+
+    // make a module queue available to the workers, preferring the calling
+    // worker's own deque so that a module's event chains stay warm. An event
+    // emitted from another thread may get here while stop() runs; the queue
+    // is then released, and its events wait for the next run().
+    void Schedule(CSP_ModuleQueue* q) {
+        std::shared_lock<std::shared_mutex> guard(dequesMutex);
+        if (!running || deques.empty()) {
+            q->scheduled = false;
+            return;
+        }
+        size_t n = deques.size();
+        size_t d = (tlsEngine == this && tlsWorker >= 0) ? (size_t) tlsWorker
+                                                         : nextDeque++ % n;
+        {
+            std::lock_guard<std::mutex> lock(deques[d]->mutex);
+            deques[d]->queues.push_back(q);
+        }
+        ++readyCount;
+        if (workersSleeping.load()) {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            readyCv.notify_one();
+        }
+    }
 
-        // package pendingMessageId and process.name into a message and send it on a socket
-        // structure it as name:id
-        std::string event = process.name + ":" + std::to_string(pendingMessageId);
-        printf("Sending event: %s\n", event.c_str());
+    void Ready(const EventRecord& e) {
+        CSP_ModuleQueue* q = e.queue;
+        ++q->depth;
+        q->events.enqueue(e);
+        // before run(), events wait in their queue for run() to schedule it
+        if (running && !q->scheduled.exchange(true))
+            Schedule(q);
+    }
 
-        zmq::message_t message(event.size()+1);
-        char* buff = (char*) message.data();
-        memcpy(buff, event.data(), event.size());
-        buff[event.size()] = '\0';
-        socket.send(message, zmq::send_flags::none);
+    CSP_ModuleQueue* Take(int worker) {
+        size_t n = deques.size();
+        {
+            WorkerDeque& own = *deques[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.queues.size()) {
+                CSP_ModuleQueue* q = own.queues.back();
+                own.queues.pop_back();
+                --readyCount;
+                return q;
+            }
+        }
+        for (size_t i = 1; i < n; ++i) {
+            WorkerDeque& victim = *deques[(worker + i) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.queues.size()) {
+                CSP_ModuleQueue* q = victim.queues.front();
+                victim.queues.pop_front();
+                --readyCount;
+                return q;
+            }
+        }
+        return nullptr;
     }
-    
-
-#ifdef PUSHPULL
-    Self()
-    : context(1)
-    , sub_socket(context, ZMQ_PULL), running(false)
-    , pub_socket(context, ZMQ_PUSH) {
-        pub_socket.connect("inproc://csp_engine");
-        sub_socket.bind("inproc://csp_engine");
-        //sub_socket.set(zmq::sockopt::subscribe, ""); // "" means subscribe to all messages
+
+    // run a bounded number of a module's events, so that a busy module
+    // can't starve the others sharing its worker
+    void RunModule(CSP_ModuleQueue* q) {
+        static constexpr size_t kBulk = 64;
+        EventRecord batch[kBulk];
+        size_t n = q->events.try_dequeue_bulk(batch, kBulk);
+        q->depth -= (int64_t) n;
+        for (size_t i = 0; i < n; ++i) {
+            // the process is only dereferenced while its module is registered
+            std::lock_guard<std::mutex> lock(q->execution);
+            if (!q->registered || batch[i].generation != q->generation) {
+                ++q->dropped;
+                ++dropped;
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            tlsRunning = q;
+            batch[i].process->behavior();
+            tlsRunning = nullptr;
+            uint64_t ns = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+            q->totalNs += ns;
+            if (ns > q->maxNs.load(std::memory_order_relaxed))
+                q->maxNs.store(ns, std::memory_order_relaxed);
+            ++q->executed;
+            ++executed;
+        }
+
+        // release the module, and reschedule it if events arrived meanwhile
+        q->scheduled.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (q->events.size_approx() > 0 && !q->scheduled.exchange(true))
+            Schedule(q);
     }
-#else
-    Self()
-    : context(1)
-    , sub_socket(context, ZMQ_SUB)
-    , running(false)
-    , pub_socket(context, ZMQ_PUB)
-    , nextProcess(1) {
-        pub_socket.bind("inproc://csp_engine");
-        sub_socket.connect("inproc://csp_engine");
-        sub_socket.set(zmq::sockopt::subscribe, ""); // "" means subscribe to all messages
+
+    void Work(int worker) {
+        tlsEngine = this;
+        tlsWorker = worker;
+        while (running) {
+            CSP_ModuleQueue* q = Take(worker);
+            if (q) {
+                RunModule(q);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(readyMutex);
+            ++workersSleeping;
+            // the timeout guards against a notification racing the
+            // sleeping count
+            readyCv.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+                return readyCount.load() > 0 || !running; });
+            --workersSleeping;
+        }
+        tlsWorker = -1;
+        tlsEngine = nullptr;
+    }
+
+    void Service() {
+        static constexpr size_t kBulk = 64;
+        EventRecord batch[kBulk];
+        while (running) {
+            size_t n;
+            while ((n = timed.try_dequeue_bulk(batch, kBulk)) > 0)
+                for (size_t i = 0; i < n; ++i)
+                    wheel.insert(batch[i]);
+
+            wheel.advance(Tick(std::chrono::steady_clock::now()), [this](const EventRecord& e) {
+                --pendingTimed;
+                Ready(e);
+            });
+
+            // sleep until the next tick, or indefinitely if nothing is
+            // scheduled; emit_event wakes the thread.
+            std::unique_lock<std::mutex> lock(serviceMutex);
+            if (wheel.size()) {
+                cv.wait_for(lock, std::chrono::milliseconds(1));
+            }
+            else {
+                serviceIdle = true;
+                cv.wait(lock, [this]() { return timed.size_approx() > 0 || !running; });
+                serviceIdle = false;
+            }
+        }
     }
-#endif
 };
 
 CSP_Engine::CSP_Engine() : self(new Self()) {
@@ -128,137 +378,133 @@ void CSP_Engine::register_module(CSP_Module* module) {
     }
     self->modules[module->get_name()] = module;
 
-    // add all the module's process ids to the processes map
-    // report an error if a process id is already in the map.
+    CSP_ModuleQueue*& q = self->moduleQueueByName[module->get_name()];
+    if (!q) {
+        self->moduleQueues.emplace_back(new CSP_ModuleQueue());
+        q = self->moduleQueues.back().get();
+        q->name = module->get_name();
+    }
+    q->registered = true;
+
     for (auto& proc : module->processes) {
         proc->id = self->nextProcess++;
-        self->processes[proc->id] = proc;
+        proc->queue = q;
     }
 }
 
 void CSP_Engine::unregister_module(const std::string& module_name) {
-    std::lock_guard<std::mutex> lock(self->workerMutex);
-    auto module = self->modules.find(module_name);
-    if (module == self->modules.end()) {
-        return;
-    }
-    // remove all the module's process ids from the processes map
-    for (auto& proc : module->second->processes) {
-        self->processes.erase(proc->id);
+    CSP_ModuleQueue* queue = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(self->workerMutex);
+        auto module = self->modules.find(module_name);
+        if (module == self->modules.end()) {
+            return;
+        }
+        // pending events for the module's processes will be dropped; the
+        // queue is kept for the next module registered with the name
+        auto q = self->moduleQueueByName.find(module_name);
+        if (q != self->moduleQueueByName.end()) {
+            queue = q->second;
+            queue->registered = false;
+            ++queue->generation;
+        }
+        self->modules.erase(module_name);
     }
-    self->modules.erase(module_name);
+
+    // wait for a behavior already running on a worker to return, so that the
+    // caller may destroy the processes. The wait is outside workerMutex, since
+    // the behavior may register modules. A behavior unregistering its own
+    // module can't wait for itself.
+    if (queue && tlsRunning != queue)
+        std::lock_guard<std::mutex> wait(queue->execution);
+}
+
+void CSP_Engine::set_worker_count(int workers) {
+    self->workerCount = workers;
+}
+
+int CSP_Engine::worker_count() const {
+    return self->running ? (int) self->workers.size() : self->workerCount;
 }
 
 void CSP_Engine::run() {
     if (!self->running) {
-        self->running = true;
-        self->serviceThread = std::thread([this]() {
-            // service the timed priority queue
-            while (self->running) {
-                std::unique_lock<std::mutex> lock(self->serviceMutex);
-
-                // Wait until there are messages in the queue or the thread is stopped
-                self->cv.wait(lock, [this]() { return !self->timedProcessQueue.empty() || !self->running; });
-
-                // If we're stopping and there are no messages, exit
-                if (!self->running && self->timedProcessQueue.empty()) break;
-
-                // Check the front of the priority queue
-                auto now = std::chrono::steady_clock::now();
-                auto front = self->timedProcessQueue.top();
-
-                // If the scheduled time has arrived, send the message
-                if (front.when <= now) {
-                    const CSP_Process* process = front.process;
-                    self->timedProcessQueue.pop();
-
-                    // Send the message via ZMQ
-                    /// @TODO need to have the id that was passed in
-                    self->AsyncSendProcess(*process, self->pub_socket);
-
-                    //zmq::message_t message2(5);
-                    //memcpy(message2.data(), "Alice", 5);
-                    //pub_socket.send(message2, zmq::send_flags::none);
-                }
-                else {
-                    // Otherwise, if the front message isn't due yet, wait until it is
-                    self->cv.wait_until(lock, front.when);
-                }
-            }
-        });
-
-        self->worker = std::thread([this]() {
-            std::cout << "Waiting for inproc://csp_engine events" << std::endl;
-            while (self->running) {
-                zmq::message_t event_msg;
-                std::optional<size_t> rcvd_bytes = self->sub_socket.recv(event_msg, zmq::recv_flags::none);
-                if (rcvd_bytes > 0) {
-                    std::string event(static_cast<char*>(event_msg.data()), event_msg.size());
-                    if (event == "STOP") break;
-                    if (event == "Alice" || event == "Bob") {
-                        std::cout << "Received " << event << std::endl;
-                        continue;
-                    }
-
-                    const char* msg = reinterpret_cast<const char*>(event_msg.data());
-                    if (!msg) {
-                        continue;
-                    }
-                    int id = 0;
-                    std::string message(msg);
-                    auto colon = message.find(':');
-                    if (colon != std::string::npos) {
-                        id = std::stoi(message.substr(colon + 1));
-                        message = message.substr(0, colon);
-                    }
-
-                    std::cout << "Received event [" << id
-                              << "] msg: " << message << std::endl;
-                    if (id == 0)
-                        continue; // no associated process
-
-                    auto proc = self->pendingProcesses.find(id);
-                    if (proc != self->pendingProcesses.end()) {
-                        proc->second.process->behavior();
-                    }
-                    else {
-                        std::cerr << "Error: Process id " << id << " not found in the engine." << std::endl;
-                    }
-                }
-            }
-        });
+        int n = self->workerCount > 0 ? self->workerCount
+                                      : (int) std::max(1u, std::thread::hardware_concurrency());
+        {
+            std::lock_guard<std::shared_mutex> guard(self->dequesMutex);
+            self->deques.clear();
+            for (int i = 0; i < n; ++i)
+                self->deques.emplace_back(new WorkerDeque());
+            self->running = true;
+        }
+        self->serviceThread = std::thread([this]() { self->Service(); });
+        for (int i = 0; i < n; ++i)
+            self->workers.emplace_back([this, i]() { self->Work(i); });
+
+        // events emitted before the engine ran are waiting in their queues
+        std::lock_guard<std::mutex> lock(self->workerMutex);
+        auto pending = [this](CSP_ModuleQueue* q) {
+            if (q->events.size_approx() > 0 && !q->scheduled.exchange(true))
+                self->Schedule(q);
+        };
+        pending(&self->unregistered);
+        for (auto& q : self->moduleQueues)
+            pending(q.get());
     }
 }
 
 void CSP_Engine::stop() {
     if (self->running) {
-        self->running = false;
-        self->cv.notify_all();  // Wake up the timed thread in case it is waiting
+        {
+            std::lock_guard<std::shared_mutex> guard(self->dequesMutex);
+            self->running = false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(self->serviceMutex);
+            self->cv.notify_all();  // Wake up the timed thread in case it is waiting
+        }
         self->serviceThread.join();
-
-        zmq::message_t stop_msg("STOP", 4);
-        self->pub_socket.send(stop_msg, zmq::send_flags::none); // Graceful shutdown
-        self->worker.join();
+        {
+            std::lock_guard<std::mutex> lock(self->readyMutex);
+            self->readyCv.notify_all();
+        }
+        for (auto& w : self->workers)
+            w.join();
+        self->workers.clear();
+
+        // module queues still held by a deque are released, so that they
+        // are rescheduled by the next run()
+        std::lock_guard<std::shared_mutex> guard(self->dequesMutex);
+        for (auto& d : self->deques)
+            for (auto q : d->queues)
+                q->scheduled = false;
+        self->deques.clear();
+        self->readyCount = 0;
     }
 }
 
 // Emit an event with a delay (in milliseconds)
 void CSP_Engine::emit_event(const CSP_Process& process, int msDelay) {
-    // Get current time
-    auto now = std::chrono::steady_clock::now();
-
-    // Calculate the future time when the event should be sent
-    auto sendTime = now + std::chrono::milliseconds(msDelay);
+    ++self->emitted;
+    CSP_ModuleQueue* q = process.queue ? process.queue : &self->unregistered;
+    if (msDelay <= 0) {
+        self->Ready({&process, q, 0, q->generation.load()});
+        return;
+    }
 
+    // Calculate the tick when the event should be sent
+    auto sendTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(msDelay);
+    ++self->pendingTimed;
+    self->timed.enqueue({&process, q, self->Tick(sendTime), q->generation.load()});
     {
+        // Notify the service thread if it is waiting for something to
+        // schedule, otherwise it will pick the event up on its next tick.
         std::lock_guard<std::mutex> lock(self->serviceMutex);
-        // Insert the message into the priority queue
-        self->timedProcessQueue.push({&process, sendTime});
+        if (self->serviceIdle)
+            self->cv.notify_one();
     }
 
-    // Notify the service thread that there is a new message to process
-    self->cv.notify_one();
-
     static const bool verbose = false;
     if (verbose)
         std::cout << "Event '" << process.name << "' scheduled for: "
@@ -266,26 +512,277 @@ void CSP_Engine::emit_event(const CSP_Process& process, int msDelay) {
                   << " ms\n";
 }
 
-zmq::context_t& CSP_Engine::get_context() { return self->context; }
+CSP_Engine::Stats CSP_Engine::stats() const {
+    Stats s;
+    s.emitted = self->emitted.load();
+    s.executed = self->executed.load();
+    s.dropped = self->dropped.load();
+    s.pendingTimed = self->pendingTimed.load();
+    return s;
+}
+
+std::vector<CSP_Engine::ModuleStats> CSP_Engine::module_stats() const {
+    std::vector<ModuleStats> result;
+    std::lock_guard<std::mutex> lock(self->workerMutex);
+    auto report = [&result](const CSP_ModuleQueue& q) {
+        ModuleStats m;
+        m.name = q.name;
+        m.queueDepth = (size_t) std::max<int64_t>(0, q.depth.load());
+        m.executed = q.executed.load();
+        m.dropped = q.dropped.load();
+        m.totalMs = q.totalNs.load() * 1e-6;
+        m.maxMs = q.maxNs.load() * 1e-6;
+        result.push_back(m);
+    };
+    report(self->unregistered);
+    for (auto& q : self->moduleQueues)
+        if (q->registered)
+            report(*q);
+    return result;
+}
 
 int CSP_Engine::test() {
+    using clock = std::chrono::steady_clock;
     run();
-    zmq::message_t message(5);
-    memcpy(message.data(), "Alice", 5);
-    self->pub_socket.send(message, zmq::send_flags::none);
-    zmq::message_t message2(3);
-    memcpy(message2.data(), "Bob", 3);
-    self->pub_socket.send(message2, zmq::send_flags::none);
-
-    static CSP_Process e0("Event 1.0s", [](){ std::cout << "Event 1.0s"; });
-    static CSP_Process e1("Event 0.5s", [](){ std::cout << "Event 0.5s"; });
-    static CSP_Process e2("Event 2.0s", [](){ std::cout << "Event 2.0s"; });
-
-    emit_event(e0, 1000);  // 1 second delay
-    emit_event(e1,  500);  // 0.5 second delay
-    emit_event(e2, 2000);  // 2 second delay
-
-    return 0;
+    int failures = 0;
+
+    // timed events fire in the order they fall due. The state is static, as
+    // the processes are, so that an event outliving a failed test is harmless.
+    static std::mutex orderMutex;
+    static std::string order;
+    auto fired = []() {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        return order;
+    };
+    auto mark = [](char c) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order += c;
+    };
+    static CSP_Process e0("Event 100ms", [mark]() { mark('b'); });
+    static CSP_Process e1("Event 50ms", [mark]() { mark('a'); });
+    static CSP_Process e2("Event 200ms", [mark]() { mark('c'); });
+    {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.clear();
+    }
+    emit_event(e0, 100);
+    emit_event(e1,  50);
+    emit_event(e2, 200);
+    auto deadline = clock::now() + std::chrono::seconds(2);
+    while (fired().size() < 3 && clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (fired() != "abc") {
+        printf("  CSP test failed: timed events fired as %s, expected abc\n", fired().c_str());
+        ++failures;
+    }
+
+    // modules destroyed while their behaviors run on the workers; once a
+    // destructor's Unregister returns, no behavior of the module may run
+    struct BusyModule : public CSP_Module {
+        CSP_Process Busy;
+        BusyModule(CSP_Engine& engine, int round, std::atomic<int>& destroyed,
+                   std::atomic<int>& late)
+        : CSP_Module(engine, "CSP_Engine::test::busy")
+        , Busy("Busy", [round, &destroyed, &late]() {
+            auto until = clock::now() + std::chrono::microseconds(20);
+            while (clock::now() < until) {}
+            if (destroyed.load() > round)
+                ++late;
+        }) {
+            add_process(Busy);
+        }
+        ~BusyModule() {
+            Unregister();
+        }
+    };
+    const int rounds = 50;
+    std::atomic<int> destroyed{0};
+    std::atomic<int> late{0};
+    for (int round = 0; round < rounds; ++round) {
+        auto m = std::make_unique<BusyModule>(*this, round, destroyed, late);
+        m->Register();
+        for (int i = 0; i < 100; ++i)
+            m->emit_event(m->Busy);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        m.reset();
+        ++destroyed;
+    }
+    if (late.load()) {
+        printf("  CSP test failed: %d behaviors ran after their module was destroyed\n",
+               late.load());
+        ++failures;
+    }
+
+    // events emitted from another thread while the engine stops and runs
+    // again are neither lost nor scheduled onto torn down deques
+    std::atomic<int> received{0};
+    CSP_Process receive("Receive", [&received]() { ++received; });
+    struct ReceiveModule : public CSP_Module {
+        ReceiveModule(CSP_Engine& engine, CSP_Process& p)
+        : CSP_Module(engine, "CSP_Engine::test::receive") {
+            add_process(p);
+        }
+        ~ReceiveModule() {
+            Unregister();
+        }
+    } receiver(*this, receive);
+    receiver.Register();
+    const int sent = 20000;
+    std::thread emitter([this, &receive]() {
+        for (int i = 0; i < sent; ++i)
+            emit_event(receive, 0);
+    });
+    for (int cycle = 0; cycle < 20; ++cycle) {
+        stop();
+        run();
+    }
+    emitter.join();
+    deadline = clock::now() + std::chrono::seconds(5);
+    while (received.load() < sent && clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (received.load() != sent) {
+        printf("  CSP test failed: %d of %d events emitted across stop and run were received\n",
+               received.load(), sent);
+        ++failures;
+    }
+
+    printf("CSP engine, %d workers: %s\n", worker_count(), failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int CSP_Engine::benchmark(int events) {
+    using clock = std::chrono::steady_clock;
+    run();
+
+    std::atomic<int> count{0};
+    CSP_Process counter("counter", [&count]() { ++count; });
+    std::atomic<int> timedCount{0};
+    CSP_Process timer("timer", [&timedCount]() { ++timedCount; });
+
+    class BenchModule : public CSP_Module {
+    public:
+        BenchModule(CSP_Engine& engine, CSP_Process& a, CSP_Process& b)
+        : CSP_Module(engine, "CSP_Engine::benchmark") {
+            add_process(a);
+            add_process(b);
+        }
+    } module(*this, counter, timer);
+    module.Register();
+
+    // immediate events, from several producers
+    const int producers = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    auto start = clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+        threads.emplace_back([this, &counter, events, producers]() {
+            for (int i = 0; i < events / producers; ++i)
+                emit_event(counter, 0);
+        });
+    for (auto& t : threads)
+        t.join();
+    const int expected = (events / producers) * producers;
+    while (count.load() < expected)
+        std::this_thread::yield();
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    printf("CSP immediate: %d events from %d producers in %.3f ms, %.2f M events/s\n",
+           expected, producers, seconds * 1e3, expected / seconds * 1e-6);
+
+    // timed events spread over 100ms
+    const int timedEvents = std::min(events, 100000);
+    start = clock::now();
+    for (int i = 0; i < timedEvents; ++i)
+        emit_event(timer, 1 + (i % 100));
+    while (timedCount.load() < timedEvents)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    seconds = std::chrono::duration<double>(clock::now() - start).count();
+    printf("CSP timed: %d events over 1..100 ms delays completed in %.3f ms\n",
+           timedEvents, seconds * 1e3);
+
+    // slow behaviors in several modules; each module must stay serial, while
+    // the modules run in parallel across the workers
+    struct SlowModule : public CSP_Module {
+        std::atomic<bool> inside{false};
+        std::atomic<int> overlaps{0};
+        std::atomic<int> done{0};
+        CSP_Process Slow;
+        SlowModule(CSP_Engine& engine, const std::string& name)
+        : CSP_Module(engine, name)
+        , Slow("Slow", [this]() {
+            if (inside.exchange(true))
+                ++overlaps;
+            auto until = clock::now() + std::chrono::microseconds(200);
+            while (clock::now() < until) {}
+            inside = false;
+            ++done;
+        }) {
+            add_process(Slow);
+        }
+        ~SlowModule() {
+            Unregister();
+        }
+    };
+    const int moduleCount = 8;
+    const int slowEvents = 50;
+    std::vector<std::unique_ptr<SlowModule>> slowModules;
+    for (int i = 0; i < moduleCount; ++i) {
+        slowModules.emplace_back(new SlowModule(*this, "CSP_Engine::benchmark::" + std::to_string(i)));
+        slowModules.back()->Register();
+    }
+    start = clock::now();
+    for (int e = 0; e < slowEvents; ++e)
+        for (auto& m : slowModules)
+            m->emit_event(m->Slow);
+    int overlaps = 0;
+    for (auto& m : slowModules) {
+        while (m->done.load() < slowEvents)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        overlaps += m->overlaps.load();
+    }
+    seconds = std::chrono::duration<double>(clock::now() - start).count();
+    double serial = moduleCount * slowEvents * 200e-6;
+    printf("CSP modules: %d modules x %d 200us behaviors on %d workers in %.3f ms, "
+           "%.2fx vs serial, %d serial violations\n",
+           moduleCount, slowEvents, worker_count(), seconds * 1e3,
+           serial / seconds, overlaps);
+
+    // a module registered and destroyed over and over reuses one queue, and
+    // the events it left behind are dropped rather than run
+    struct TransientModule : public CSP_Module {
+        CSP_Process Ping;
+        TransientModule(CSP_Engine& engine)
+        : CSP_Module(engine, "CSP_Engine::benchmark::transient")
+        , Ping("Ping", []() {}) {
+            add_process(Ping);
+        }
+        ~TransientModule() {
+            Unregister();
+        }
+    };
+    const int cycles = 1000;
+    uint64_t droppedBefore = self->dropped.load();
+    size_t queuesBefore;
+    {
+        std::lock_guard<std::mutex> lock(self->workerMutex);
+        queuesBefore = self->moduleQueues.size();
+    }
+    for (int i = 0; i < cycles; ++i) {
+        TransientModule m(*this);
+        m.Register();
+        m.emit_event(m.Ping, 5);
+    }
+    auto deadline = clock::now() + std::chrono::seconds(5);
+    while (self->dropped.load() - droppedBefore < (uint64_t) cycles && clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    size_t queuesAdded;
+    {
+        std::lock_guard<std::mutex> lock(self->workerMutex);
+        queuesAdded = self->moduleQueues.size() - queuesBefore;
+    }
+    uint64_t stale = self->dropped.load() - droppedBefore;
+    printf("CSP reregistration: %d cycles added %zu queues, dropped %llu of %d stale events\n",
+           cycles, queuesAdded, (unsigned long long) stale, cycles);
+    bool leaked = queuesAdded > 1 || stale != (uint64_t) cycles;
+    return overlaps || leaked ? 1 : 0;
 }
 
 } // lab
@@ -1,13 +1,14 @@
 #ifndef Lab_CSP_hpp
 #define Lab_CSP_hpp
 
-#include <zmq.hpp>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace lab {
 
@@ -15,14 +16,16 @@ namespace lab {
 
 class CSP_Module;
 class CSP_Engine;
+struct CSP_ModuleQueue;
 
 class CSP_Process {
     friend class CSP_Engine;
     int id;
+    CSP_ModuleQueue* queue; // the serial queue of the owning module
 public:
     CSP_Process() = delete;
     CSP_Process(const std::string& n, std::function<void()> b)
-    : id(-1), name(n), behavior(b) {}
+    : id(-1), queue(nullptr), name(n), behavior(b) {}
 
     std::string name;
     std::function<void()> behavior;
@@ -42,15 +45,24 @@ public:
     // must be called to register the module with the engine.
     void Register();
 
+    // removes the module from the engine. Pending events are dropped, and a
+    // behavior of the module already running on a worker is waited for.
+    // The base destructor runs after a derived module's members are gone,
+    // so modules whose processes are members must call this in their own
+    // destructors.
+    void Unregister();
+
     void emit_event(const CSP_Process& event);
 
+    // Emit an event after a delay in milliseconds, through the engine's
+    // timing wheel.
+    void emit_event(const CSP_Process& event, int msDelay);
+
 protected:
     void add_process(CSP_Process& proc);
     std::vector<CSP_Process*> processes;
 };
 
-//#define PUSHPULL
-
 class CSP_Engine {
     struct Self;
     Self* self;
@@ -58,17 +70,52 @@ class CSP_Engine {
 public:
     CSP_Engine();
     ~CSP_Engine();
-    zmq::context_t& get_context();
 
     void register_module(CSP_Module* module);
     void unregister_module(const std::string& module_name);
 
+    // The processes of a module are executed serially, in the order their
+    // events were emitted, but different modules may run concurrently when
+    // the engine has more than one worker. The worker count takes effect on
+    // the next call to run(); zero means one per hardware thread.
+    void set_worker_count(int workers);
+    int worker_count() const;
+
     void run();
     void stop();
 
-    // Emit an event with a delay (in milliseconds)
+    // Emit an event with a delay (in milliseconds). Events with no delay are
+    // queued immediately, delayed events are held in a timing wheel with
+    // millisecond resolution until they are due.
     void emit_event(const CSP_Process& event, int msDelay);
+
+    struct Stats {
+        uint64_t emitted = 0;
+        uint64_t executed = 0;
+        uint64_t dropped = 0;   // events for processes no longer registered
+        size_t   pendingTimed = 0;
+    };
+    Stats stats() const;
+
+    struct ModuleStats {
+        std::string name;
+        size_t   queueDepth = 0;
+        uint64_t executed = 0;
+        uint64_t dropped = 0;
+        double   totalMs = 0;   // time spent in the module's behaviors
+        double   maxMs = 0;
+    };
+    std::vector<ModuleStats> module_stats() const;
+
+    // checks that timed events fire in order, and that no behavior of a
+    // module runs once it has been unregistered, with modules destroyed
+    // while their behaviors run
     int test();
+
+    // measures event throughput, with producers emitting from several
+    // threads, timed event accuracy through the timing wheel, and the
+    // parallelism of slow behaviors spread over several modules.
+    int benchmark(int events);
 };
 
 
@@ -113,6 +160,10 @@ public:
         add_process(Error);
         add_process(Idle);
     }
+
+    ~DemoFileOpenModule() {
+        Unregister();
+    }
 };
 
 
@@ -1,13 +1,33 @@
 
 #include "ColorProvider.hpp"
+#include "nanocolor.h"
+#include "Lab/CoreProviders/Texture/ImageColor.hpp"
+#include "Lab/CoreProviders/Texture/TextureCache.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <vector>
+
+#ifdef HAVE_OPENEXR
+#include "openexr-c.h"
+#endif
 
 namespace lab {
 
 struct ColorProvider::data {
     std::set<std::string> colorSpaces;
     std::string renderingColorSpace;
+
+    // the image each cached name was converted to, so that an image is
+    // converted only once
+    std::mutex convertedMutex;
+    std::map<std::string, std::weak_ptr<LabImageData_t>> converted;
 };
 
 ColorProvider::ColorProvider() : Provider(ColorProvider::sname()) {
@@ -42,4 +62,178 @@ void ColorProvider::SetRenderingColorSpace(const char* colorSpace) {
     _self->colorSpaces.insert(colorSpace);
 }
 
+//static
+const char* ColorProvider::FileColorSpace(const char* path, bool* premultiplied) {
+    std::string ext = path ? path : "";
+    size_t dot = ext.find_last_of('.');
+    ext = dot == std::string::npos ? "" : ext.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return (char) std::tolower(c); });
+    if (premultiplied)
+        *premultiplied = ext == "exr";
+    if (ext == "exr" || ext == "hdr" || ext == "pfm")
+        return "lin_rec709";
+    return "srgb_texture";
+}
+
+std::shared_ptr<LabImageData_t> ColorProvider::ConvertToRenderingColorSpace(
+        const LabImageData_t& image, const char* colorSpace, bool premultiplied) const {
+    const char* rendering = RenderingColorSpace();
+    if (!rendering || !colorSpace)
+        return nullptr;
+    const NcColorSpace* src = NcGetNamedColorSpace(colorSpace);
+    const NcColorSpace* dst = NcGetNamedColorSpace(rendering);
+    if (!src || !dst || !image.data)
+        return nullptr;
+
+    // 8 bit encodings are too coarse for linear values
+    LabPixelType_t pixelType = image.pixelType;
+    if (pixelType == LAB_PIXEL_UINT8 && IsLinear(dst))
+        pixelType = LAB_PIXEL_HALF;
+
+    auto result = TextureCache::AllocateImage(image.width, image.height, image.channelCount, pixelType);
+    if (!result || !ConvertImageColorSpace(image, src, *result, dst, premultiplied))
+        return nullptr;
+    return result;
+}
+
+std::shared_ptr<LabImageData_t> ColorProvider::ConvertCachedToRenderingColorSpace(
+        const char* name, const char* colorSpace, bool premultiplied) {
+    TextureCache* tc = TextureCache::instance();
+    auto image = tc->Get(name);
+    if (!image)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_self->convertedMutex);
+        if (_self->converted[name].lock() == image)
+            return image;
+    }
+
+    // every level is converted; those not yet decoded are decoded first, as
+    // they would otherwise be decoded later in the file's color space. A
+    // level that can't be had ends the chain.
+    auto levels = tc->GetLevels(name);
+    std::vector<std::shared_ptr<LabImageData_t>> result;
+    for (size_t i = 0; i < std::max<size_t>(1, levels.size()); ++i) {
+        auto level = i == 0 ? image : levels[i];
+        if (!level)
+            level = tc->Get((std::string(name) + "_" + std::to_string(i)).c_str());
+        auto converted = level ? ConvertToRenderingColorSpace(*level, colorSpace, premultiplied) : nullptr;
+        if (!converted)
+            break;
+        result.push_back(converted);
+    }
+    if (result.empty())
+        return image;
+    tc->AddLevels(name, result);
+    std::lock_guard<std::mutex> lock(_self->convertedMutex);
+    _self->converted[name] = result[0];
+    return result[0];
+}
+
+//static
+int ColorProvider::TestConvertCachedLevels() {
+    int failures = 0;
+    auto check = [&failures](bool ok, const char* what) {
+        if (!ok) {
+            printf("  ConvertCachedLevels test failed: %s\n", what);
+            ++failures;
+        }
+    };
+    // a 64 pixel square chain of RGBA levels, each a different gray
+    auto makeChain = [](LabPixelType_t pixelType) {
+        std::vector<std::shared_ptr<LabImageData_t>> chain;
+        for (int l = 0; (64 >> l) > 0; ++l) {
+            int side = 64 >> l;
+            auto img = TextureCache::AllocateImage(side, side, 4, pixelType);
+            if (!img)
+                return std::vector<std::shared_ptr<LabImageData_t>>();
+            for (int i = 0; i < side * side; ++i) {
+                if (pixelType == LAB_PIXEL_FLOAT) {
+                    float* p = (float*) img->data + i * 4;
+                    p[0] = p[1] = p[2] = 0.05f * (l + 1);
+                    p[3] = 1.f;
+                }
+                else {
+                    uint16_t* p = (uint16_t*) img->data + i * 4;
+                    p[0] = p[1] = p[2] = (uint16_t) (0x2c00 + 0x100 * l);
+                    p[3] = 0x3c00;
+                }
+            }
+            chain.push_back(img);
+        }
+        return chain;
+    };
+    auto same = [](const std::shared_ptr<LabImageData_t>& a, const std::shared_ptr<LabImageData_t>& b) {
+        return a && b && a->dataSize == b->dataSize && !memcmp(a->data, b->data, a->dataSize);
+    };
+
+    // the singleton is the local provider for the test's duration
+    ColorProvider* saved = _instance;
+    {
+        ColorProvider color;
+        color.SetRenderingColorSpace("srgb_texture");
+        TextureCache* tc = TextureCache::instance();
+
+        // every level resident
+        const char* name = "lab_convert_cached_levels";
+        auto chain = makeChain(LAB_PIXEL_FLOAT);
+        tc->AddLevels(name, chain);
+        auto converted = color.ConvertCachedToRenderingColorSpace(name, "lin_rec709", false);
+        auto levels = tc->GetLevels(name);
+        check(converted && !same(converted, chain[0]), "resident, the image was not converted");
+        check(levels.size() == chain.size(), "resident, levels were lost");
+        for (size_t l = 0; l < std::min(levels.size(), chain.size()); ++l)
+            check(same(levels[l], color.ConvertToRenderingColorSpace(*chain[l], "lin_rec709", false)),
+                  "resident, a level does not match its conversion");
+        check(color.ConvertCachedToRenderingColorSpace(name, "lin_rec709", false) == converted,
+              "resident, the image was converted twice");
+        tc->Erase(name);
+
+#ifdef HAVE_OPENEXR
+        // the levels below the first are decoded as they are requested, so
+        // all but the first are yet to be decoded when converted
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        std::string path = (fs::temp_directory_path(ec) / "lab_convert_cached_levels.exr").string();
+        chain = makeChain(LAB_PIXEL_HALF);
+        std::vector<nanoexr_ImageData_t> exrLevels;
+        for (auto& img : chain) {
+            nanoexr_ImageData_t level = {};
+            level.data = img->data;
+            level.dataSize = img->dataSize;
+            level.pixelType = EXR_PIXEL_HALF;
+            level.channelCount = 4;
+            level.width = img->width;
+            level.height = img->height;
+            exrLevels.push_back(level);
+        }
+        bool written = nanoexr_write_tiled_exr(path.c_str(), nullptr, nullptr, exrLevels.data(),
+                                               (int) exrLevels.size(), 16, EXR_COMPRESSION_ZIP) == EXR_ERR_SUCCESS;
+        check(written, "could not write the EXR");
+        if (written && tc->ReadAndCache(path.c_str())) {
+            levels = tc->GetLevels(path.c_str());
+            check(levels.size() == chain.size() && !levels.back(), "EXR, the levels were decoded eagerly");
+            converted = color.ConvertCachedToRenderingColorSpace(path.c_str(), "lin_rec709", true);
+            levels = tc->GetLevels(path.c_str());
+            check(levels.size() == chain.size(), "EXR, levels were lost");
+            for (size_t l = 0; l < std::min(levels.size(), chain.size()); ++l)
+                check(same(levels[l], color.ConvertToRenderingColorSpace(*chain[l], "lin_rec709", true)),
+                      "EXR, a level does not match its conversion");
+            // a level found by name is the converted one, not decoded again
+            check(levels.size() > 1 && tc->Get((path + "_1").c_str()) == levels[1],
+                  "EXR, a level found by name was not the converted one");
+        }
+        else if (written)
+            check(false, "EXR, could not read the file back");
+        tc->Erase(path.c_str());
+        fs::remove(path, ec);
+#endif
+    }
+    _instance = saved;
+
+    printf("TestConvertCachedLevels: %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
 } // lab
@@ -3,6 +3,8 @@
 #define Providers_Color_ColorProvider_hpp
 
 #include "Lab/StudioCore.hpp"
+#include "Lab/CoreProviders/Texture/ImageData.h"
+#include <memory>
 
 namespace lab {
 
@@ -20,6 +22,33 @@ public:
 
     const char* RenderingColorSpace() const;
     void SetRenderingColorSpace(const char* colorSpace);
+
+    // the color space of the pixels decoded from an image file, by its
+    // extension: linear Rec. 709 for EXR, HDR and PFM, whose EXR alpha is
+    // premultiplied, and sRGB for the 8 bit formats.
+    static const char* FileColorSpace(const char* path, bool* premultiplied = nullptr);
+
+    // converts image from the named color space into the rendering color
+    // space, into a new image; 8 bit images converted to a linear space
+    // become half floats. Returns null if there is no rendering color
+    // space, either color space is unknown, or image is not a color image.
+    std::shared_ptr<LabImageData_t> ConvertToRenderingColorSpace(const LabImageData_t& image,
+                                                                 const char* colorSpace,
+                                                                 bool premultiplied) const;
+
+    // converts the cached image called name into the rendering color space,
+    // once, as it is loaded. Cached images may be read only mappings, so the
+    // conversion replaces the cached image rather than writing to it. Every
+    // level of a mip chain is converted, decoding the levels that were not
+    // yet. Returns the cached image, converted if it could be, or null if
+    // name is not cached.
+    std::shared_ptr<LabImageData_t> ConvertCachedToRenderingColorSpace(const char* name,
+                                                                       const char* colorSpace,
+                                                                       bool premultiplied);
+
+    // checks that converting a cached mip chain keeps and converts each of
+    // its levels, whether decoded or, for an EXR, not yet decoded
+    static int TestConvertCachedLevels();
 };
 
 } // lab
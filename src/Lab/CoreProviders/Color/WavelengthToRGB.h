@@ -9,6 +9,7 @@
 #ifndef WavelengthToRGB_h
 #define WavelengthToRGB_h
 
+#include "nanocolor.h"
 #include <stdio.h>
 
 #ifdef __cplusplus
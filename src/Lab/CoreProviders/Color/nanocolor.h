@@ -58,6 +58,7 @@
 #define NcColorSpaceDescriptor NCCONCAT(NCNAMESPACE, ColorSpaceDescriptor)
 #define NcColorSpaceM33Descriptor NCCONCAT(NCNAMESPACE, ColorSpaceM33Descriptor)
 #define NcColorSpace NCCONCAT(NCNAMESPACE, ColorSpace)
+#define NcTransform NCCONCAT(NCNAMESPACE, Transform)
 
 // NcChromaticity is a single coordinate in the CIE 1931 xy chromaticity diagram.
 typedef struct {
@@ -108,6 +109,7 @@ typedef struct {
 
 // Opaque struct for the public interface
 typedef struct NcColorSpace NcColorSpace;
+typedef struct NcTransform NcTransform;
 
 #ifdef __cplusplus
 extern "C" {
@@ -171,10 +173,15 @@ NCEXTERNC const char* Nc_srgb_texture;
 // directly as source without running into symbol or API conflicts.
 // Change the namespace here to make the symbols unique.
 // Recommended: Foo_nc_ to embed nanocolor in library Foo.
+#define NcApplyTransform             NCCONCAT(NCNAMESPACE, ApplyTransform)
+#define NcApplyTransformColors       NCCONCAT(NCNAMESPACE, ApplyTransformColors)
+#define NcApplyTransformColorsWithAlpha NCCONCAT(NCNAMESPACE, ApplyTransformColorsWithAlpha)
 #define NcColorSpaceEqual            NCCONCAT(NCNAMESPACE, ColorSpaceEqual)
 #define NcCreateColorSpace           NCCONCAT(NCNAMESPACE, CreateColorSpace)
 #define NcCreateColorSpaceM33        NCCONCAT(NCNAMESPACE, CreateColorSpaceM33)
+#define NcCreateTransform            NCCONCAT(NCNAMESPACE, CreateTransform)
 #define NcFreeColorSpace             NCCONCAT(NCNAMESPACE, FreeColorSpace)
+#define NcFreeTransform              NCCONCAT(NCNAMESPACE, FreeTransform)
 #define NcGetColorSpaceDescriptor    NCCONCAT(NCNAMESPACE, GetColorSpaceDescriptor)
 #define NcGetColorSpaceM33Descriptor NCCONCAT(NCNAMESPACE, GetColorSpaceM33Descriptor)
 #define NcGetDescription             NCCONCAT(NCNAMESPACE, GetDescription)
@@ -182,10 +189,13 @@ NCEXTERNC const char* Nc_srgb_texture;
 #define NcGetNamedColorSpace         NCCONCAT(NCNAMESPACE, GetNamedColorSpace)
 #define NcGetRGBToRGBMatrix          NCCONCAT(NCNAMESPACE, GetRGBToRGBMatrix)
 #define NcGetRGBToRGBMatrixBradford  NCCONCAT(NCNAMESPACE, GetRGBToRGBMatrixBradford)
+#define NcGetTransform               NCCONCAT(NCNAMESPACE, GetTransform)
+#define NcGetTransformMatrix         NCCONCAT(NCNAMESPACE, GetTransformMatrix)
 #define NcGetRGBToXYZMatrix          NCCONCAT(NCNAMESPACE, GetRGBtoXYZMatrix)
 #define NcGetXYZToRGBMatrix          NCCONCAT(NCNAMESPACE, GetXYZtoRGBMatrix)
 #define NcInitColorSpaceLibrary      NCCONCAT(NCNAMESPACE, InitColorSpaceLibrary)
 #define NcKelvinToYxy                NCCONCAT(NCNAMESPACE, KelvinToYxy)
+#define NcKelvinToYxyColors          NCCONCAT(NCNAMESPACE, KelvinToYxyColors)
 #define NcMatchLinearColorSpace      NCCONCAT(NCNAMESPACE, MatchLinearColorSpace)
 #define NcNormalizeLuminance         NCCONCAT(NCNAMESPACE, NormalizeLuminance)
 #define NcRegisteredColorSpaceNames  NCCONCAT(NCNAMESPACE, RegisteredColorSpaceNames)
@@ -193,6 +203,8 @@ NCEXTERNC const char* Nc_srgb_texture;
 #define NcTransformColor             NCCONCAT(NCNAMESPACE, TransformColor)
 #define NcTransformColors            NCCONCAT(NCNAMESPACE, TransformColors)
 #define NcTransformColorsWithAlpha   NCCONCAT(NCNAMESPACE, TransformColorsWithAlpha)
+#define NcTransformColorsLevel       NCCONCAT(NCNAMESPACE, TransformColorsLevel)
+#define NcTransformColorsForceLevel  NCCONCAT(NCNAMESPACE, TransformColorsForceLevel)
 #define NcXYZToRGB                   NCCONCAT(NCNAMESPACE, XYZToRGB)
 #define NcXYZToYxy                   NCCONCAT(NCNAMESPACE, XYZToYxy)
 #define NcYxyToRGB                   NCCONCAT(NCNAMESPACE, YxyToRGB)
@@ -202,6 +214,9 @@ NCEXTERNC const char* Nc_srgb_texture;
  *
  * Initializes the color spaces provided in the built-in color space library.
  *
+ * The names of the built-in color spaces are hashed, and the transforms
+ * between every pair of them are precomputed, for NcGetTransform.
+ *
  * This function is not thread-safe and must be called before NcGetNamedColorSpace
  * is called.
  *
@@ -350,6 +365,117 @@ NCAPI void NcTransformColors(const NcColorSpace* dst, const NcColorSpace* src,
 NCAPI void NcTransformColorsWithAlpha(const NcColorSpace* dst, const NcColorSpace* src,
                                       float* rgba, size_t count);
 
+/**
+ * @brief Returns the instruction set used by NcTransformColors.
+ *
+ * NcTransformColors and NcTransformColorsWithAlpha transform four or eight
+ * pixels at a time with the widest instruction set the processor supports.
+ * The power segments of the curves are approximated, with a relative error
+ * below 3e-7 + 8e-8 * |log2(result)| for results between 2^-126 and 2^127.
+ *
+ * @return 0 for scalar code, which matches NcTransformColor exactly, 1 for
+ *         SSE4.1, 2 for AVX2 with FMA, and 3 for NEON.
+ */
+NCAPI int NcTransformColorsLevel(void);
+
+/**
+ * @brief Caps the instruction set used by NcTransformColors, for tests and
+ *        benchmarks.
+ *
+ * @param level The highest level to use, as NcTransformColorsLevel reports
+ *              it, or -1 to remove the cap. This is not thread-safe.
+ * @return void
+ */
+NCAPI void NcTransformColorsForceLevel(int level);
+
+/**
+ * @brief Creates a transform from one color space to another.
+ *
+ * A transform holds the combined RGB to RGB matrix and the parameters of
+ * both transfer curves, so that transforming a color does not recompute
+ * them. The color spaces must outlive the transform.
+ *
+ * @param dst Pointer to the destination color space object.
+ * @param src Pointer to the source color space object.
+ * @param adapt If true, the matrix includes a Bradford adaptation between
+ *              the white points, as NcGetRGBToRGBMatrixBradford computes it.
+ * @return The transform, to be freed with NcFreeTransform, or NULL if either
+ *         color space is NULL.
+ */
+NCAPI const NcTransform* NcCreateTransform(const NcColorSpace* dst, const NcColorSpace* src,
+                                           bool adapt);
+
+/**
+ * @brief Frees a transform made by NcCreateTransform.
+ *
+ * Transforms returned by NcGetTransform belong to the library, and are
+ * ignored.
+ *
+ * @param t Pointer to the transform, or NULL.
+ * @return void
+ */
+NCAPI void NcFreeTransform(const NcTransform* t);
+
+/**
+ * @brief Returns the library's transform between two built-in color spaces.
+ *
+ * The transforms between built-in color spaces are made once, and the same
+ * pointer is returned for the same arguments. Call NcInitColorSpaceLibrary
+ * before calling this from several threads.
+ *
+ * @param dst Pointer to the destination color space object.
+ * @param src Pointer to the source color space object.
+ * @param adapt If true, the matrix includes a Bradford adaptation.
+ * @return The transform, or NULL if either color space was not returned by
+ *         NcGetNamedColorSpace.
+ */
+NCAPI const NcTransform* NcGetTransform(const NcColorSpace* dst, const NcColorSpace* src,
+                                        bool adapt);
+
+/**
+ * @brief Retrieves the RGB to RGB matrix of a transform.
+ *
+ * @param t Pointer to the transform.
+ * @return The 3x3 matrix applied to linear colors, or the identity if t is NULL.
+ */
+NCAPI NcM33f NcGetTransformMatrix(const NcTransform* t);
+
+/**
+ * @brief Transforms a color with a transform.
+ *
+ * Gives the same result as NcTransformColor, without looking up the color
+ * spaces or computing the matrix.
+ *
+ * @param t Pointer to the transform.
+ * @param rgb The RGB color to transform.
+ * @return The transformed RGB color, or rgb if t is NULL.
+ */
+NCAPI NcRGB NcApplyTransform(const NcTransform* t, NcRGB rgb);
+
+/**
+ * @brief Transforms an array of colors with a transform.
+ *
+ * Gives the same result as NcTransformColors.
+ *
+ * @param t Pointer to the transform.
+ * @param rgb Pointer to the array of RGB colors to transform.
+ * @param count Number of colors in the array.
+ * @return void
+ */
+NCAPI void NcApplyTransformColors(const NcTransform* t, NcRGB* rgb, size_t count);
+
+/**
+ * @brief Transforms an array of colors with alpha channel with a transform.
+ *
+ * Gives the same result as NcTransformColorsWithAlpha.
+ *
+ * @param t Pointer to the transform.
+ * @param rgba Pointer to the array of RGBA colors to transform.
+ * @param count Number of colors in the array.
+ * @return void
+ */
+NCAPI void NcApplyTransformColorsWithAlpha(const NcTransform* t, float* rgba, size_t count);
+
 /**
  * @brief Normalizes the luminance of a color.
  *
@@ -496,6 +622,23 @@ NCAPI const char* NcMatchLinearColorSpace(NcChromaticity redPrimary,
  */
 NCAPI NcYxy NcKelvinToYxy(float temperature, float luminosity);
 
+/**
+ * @brief Computes the Yxy coordinates of an array of blackbody temperatures.
+ *
+ * Temperatures are evaluated four or eight at a time with the instruction
+ * set NcTransformColorsLevel reports, in single precision, within 1e-6 of
+ * NcKelvinToYxy.
+ *
+ * @param temperatures Pointer to the array of temperatures in Kelvin.
+ * @param luminosity The luminosity of each coordinate.
+ * @param Yxy Pointer to the array of coordinates to fill; zero for
+ *            temperatures outside 1000 to 15000K.
+ * @param count Number of temperatures in the array.
+ * @return void
+ */
+NCAPI void NcKelvinToYxyColors(const float* temperatures, float luminosity,
+                               NcYxy* Yxy, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,926 @@
+#include "nanocolorLUT.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+/*
+ The shapers map an input to s in [0, 1], and s * (size - 1) to a lattice
+ cell and the fraction across it.
+
+ The log2 shaper is the bits of x + 2^domainMin read as an integer, which
+ is piecewise linear in each stop and exact to invert, so that shaping
+ costs an add and a conversion rather than a log. The offset makes it
+ linear below 2^domainMin, down to zero.
+
+ A 3D lattice holds four floats per point, red fastest, so that a point
+ is one load. The cube containing a color is split into six tetrahedra
+ along its diagonal; the one containing the color has vertices at the
+ near corner, one step along the axis of the largest fraction, a further
+ step along the axis of the middle fraction, and the far corner, and the
+ weights of these are the differences between the sorted fractions.
+
+ The SSE4.1 and NEON kernels shape and locate four colors at once, then
+ blend the four points of each tetrahedron as vectors. The AVX2 kernel
+ gathers the points of eight colors and blends each channel. 1D LUTs are
+ gathered by the AVX2 kernel, and interpolated by scalar code otherwise.
+ As for NcTransformColors, a tail shorter than a batch is copied through
+ a padded batch.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #if defined(__GNUC__) || defined(__clang__)
+        #define NC_SSE4_TARGET __attribute__((target("sse4.1")))
+        #define NC_AVX2_TARGET __attribute__((target("avx2,fma")))
+        #define NC_HAVE_SSE4 1
+        #define NC_HAVE_AVX2 1
+    #elif defined(__AVX2__)
+        #define NC_SSE4_TARGET
+        #define NC_AVX2_TARGET
+        #define NC_HAVE_SSE4 1
+        #define NC_HAVE_AVX2 1
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define NC_HAVE_NEON 1
+#endif
+
+// as NcTransformColorsLevel reports them
+enum {
+    _NcLevelScalar = 0,
+    _NcLevelSSE4 = 1,
+    _NcLevelAVX2 = 2,
+    _NcLevelNEON = 3
+};
+
+struct NcLUT {
+    NcLUTShaper shaper;
+    float lo, hi;       // inputs are clamped to these
+    float offset;       // the log2 shaper's 2^domainMin
+    int32_t base;       // the bits of offset
+    int32_t range;      // the bits of hi + offset, less base
+    float scale;        // to [0, 1], from the input above lo or the bits above base
+    int size;
+    bool is1D;
+    float* table;       // size^3 points of four floats, or three rows of size
+};
+
+static inline float _NcShape(const NcLUT* l, float x) {
+    x = fminf(fmaxf(x, l->lo), l->hi);      // NaN becomes lo
+    if (l->shaper == NcLUTShaperLog2) {
+        x += l->offset;
+        int32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (float) (bits - l->base) * l->scale;
+    }
+    return (x - l->lo) * l->scale;
+}
+
+static double _NcUnshape(const NcLUT* l, double s) {
+    if (l->shaper == NcLUTShaperLog2) {
+        const double bits = ((double) l->base + s * l->range) / 8388608.0;
+        const double e = floor(bits);
+        return ldexp(1.0 + (bits - e), (int) e - 127) - l->offset;
+    }
+    return l->lo + s * ((double) l->hi - l->lo);
+}
+
+static inline void _NcLattice(float s, int size, int* i, float* f) {
+    const float t = s * (float) (size - 1);
+    int k = (int) t;
+    if (k > size - 2)
+        k = size - 2;
+    *i = k;
+    *f = t - (float) k;
+}
+
+static inline void _NcLookup3D(const NcLUT* l, const float* in, float* out) {
+    const int n = l->size;
+    int ir, ig, ib;
+    float fr, fg, fb;
+    _NcLattice(_NcShape(l, in[0]), n, &ir, &fr);
+    _NcLattice(_NcShape(l, in[1]), n, &ig, &fg);
+    _NcLattice(_NcShape(l, in[2]), n, &ib, &fb);
+
+    // ties go to red for the largest and to blue for the smallest, so the
+    // two are never the same axis
+    const int sr = 1, sg = n, sb = n * n;
+    const int omax = fr >= fg && fr >= fb ? sr : fg >= fb ? sg : sb;
+    const int omin = fb <= fr && fb <= fg ? sb : fg <= fr ? sg : sr;
+    const float fmax = fmaxf(fr, fmaxf(fg, fb));
+    const float fmin = fminf(fr, fminf(fg, fb));
+    const float fmid = fmaxf(fminf(fr, fg), fminf(fmaxf(fr, fg), fb));
+
+    const float* c0 = l->table + 4 * (ir + ig * sg + ib * sb);
+    const float* c1 = c0 + 4 * omax;
+    const float* c2 = c0 + 4 * (sr + sg + sb - omin);
+    const float* c3 = c0 + 4 * (sr + sg + sb);
+    const float w0 = 1.f - fmax, w1 = fmax - fmid, w2 = fmid - fmin, w3 = fmin;
+    for (int c = 0; c < 3; c++)
+        out[c] = w0 * c0[c] + w1 * c1[c] + w2 * c2[c] + w3 * c3[c];
+}
+
+static inline void _NcLookup1D(const NcLUT* l, const float* in, float* out) {
+    const int n = l->size;
+    for (int c = 0; c < 3; c++) {
+        int i;
+        float f;
+        _NcLattice(_NcShape(l, in[c]), n, &i, &f);
+        const float* row = l->table + c * n;
+        out[c] = row[i] + f * (row[i + 1] - row[i]);
+    }
+}
+
+static void _NcScalarLUTRow(const NcLUT* l, float* px, size_t count, int stride) {
+    for (size_t i = 0; i < count; i++, px += stride) {
+        float out[3];
+        if (l->is1D)
+            _NcLookup1D(l, px, out);
+        else
+            _NcLookup3D(l, px, out);
+        memcpy(px, out, sizeof(out));
+    }
+}
+
+#ifdef NC_HAVE_SSE4
+
+NC_SSE4_TARGET static inline __m128 _NcShape4(const NcLUT* l, __m128 x) {
+    // _mm_max_ps returns its second operand for NaN
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(l->lo)), _mm_set1_ps(l->hi));
+    if (l->shaper == NcLUTShaperLog2) {
+        __m128i bits = _mm_castps_si128(_mm_add_ps(x, _mm_set1_ps(l->offset)));
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(bits, _mm_set1_epi32(l->base))),
+                          _mm_set1_ps(l->scale));
+    }
+    return _mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(l->lo)), _mm_set1_ps(l->scale));
+}
+
+NC_SSE4_TARGET static inline __m128i _NcLattice4(const NcLUT* l, __m128 s, __m128* f) {
+    const __m128 t = _mm_mul_ps(s, _mm_set1_ps((float) (l->size - 1)));
+    const __m128i k = _mm_min_epi32(_mm_cvttps_epi32(t), _mm_set1_epi32(l->size - 2));
+    *f = _mm_sub_ps(t, _mm_cvtepi32_ps(k));
+    return k;
+}
+
+NC_SSE4_TARGET static void _NcSSE4LUTRow(const NcLUT* l, float* px, size_t count, int stride) {
+    if (l->is1D) {
+        _NcScalarLUTRow(l, px, count, stride);
+        return;
+    }
+
+    const int n = l->size;
+    const __m128i sg = _mm_set1_epi32(n), sb = _mm_set1_epi32(n * n);
+    const __m128i sr = _mm_set1_epi32(1), all = _mm_set1_epi32(1 + n + n * n);
+    for (size_t i = 0; i < count; i += 4, px += 4 * stride) {
+        const float* p = px;
+        __m128 r = _mm_set_ps(p[3 * stride], p[2 * stride], p[stride], p[0]);
+        __m128 g = _mm_set_ps(p[3 * stride + 1], p[2 * stride + 1], p[stride + 1], p[1]);
+        __m128 b = _mm_set_ps(p[3 * stride + 2], p[2 * stride + 2], p[stride + 2], p[2]);
+
+        __m128 fr, fg, fb;
+        __m128i ir = _NcLattice4(l, _NcShape4(l, r), &fr);
+        __m128i ig = _NcLattice4(l, _NcShape4(l, g), &fg);
+        __m128i ib = _NcLattice4(l, _NcShape4(l, b), &fb);
+
+        __m128 rMax = _mm_and_ps(_mm_cmpge_ps(fr, fg), _mm_cmpge_ps(fr, fb));
+        __m128 gMax = _mm_cmpge_ps(fg, fb);
+        __m128i omax = _mm_castps_si128(_mm_blendv_ps(
+            _mm_blendv_ps(_mm_castsi128_ps(sb), _mm_castsi128_ps(sg), gMax),
+            _mm_castsi128_ps(sr), rMax));
+        __m128 bMin = _mm_and_ps(_mm_cmple_ps(fb, fr), _mm_cmple_ps(fb, fg));
+        __m128 gMin = _mm_cmple_ps(fg, fr);
+        __m128i omin = _mm_castps_si128(_mm_blendv_ps(
+            _mm_blendv_ps(_mm_castsi128_ps(sr), _mm_castsi128_ps(sg), gMin),
+            _mm_castsi128_ps(sb), bMin));
+
+        __m128 fmax = _mm_max_ps(fr, _mm_max_ps(fg, fb));
+        __m128 fmin = _mm_min_ps(fr, _mm_min_ps(fg, fb));
+        __m128 fmid = _mm_max_ps(_mm_min_ps(fr, fg), _mm_min_ps(_mm_max_ps(fr, fg), fb));
+
+        __m128i base = _mm_add_epi32(ir, _mm_add_epi32(_mm_mullo_epi32(ig, sg),
+                                                       _mm_mullo_epi32(ib, sb)));
+        int32_t c0[4], c1[4], c2[4];
+        float w[4][4];
+        _mm_storeu_si128((__m128i*) c0, base);
+        _mm_storeu_si128((__m128i*) c1, _mm_add_epi32(base, omax));
+        _mm_storeu_si128((__m128i*) c2, _mm_add_epi32(base, _mm_sub_epi32(all, omin)));
+        _mm_storeu_ps(w[0], _mm_sub_ps(_mm_set1_ps(1.f), fmax));
+        _mm_storeu_ps(w[1], _mm_sub_ps(fmax, fmid));
+        _mm_storeu_ps(w[2], _mm_sub_ps(fmid, fmin));
+        _mm_storeu_ps(w[3], fmin);
+
+        const int far = 1 + n + n * n;
+        for (int j = 0; j < 4; j++) {
+            const float* t = l->table;
+            __m128 v = _mm_mul_ps(_mm_set1_ps(w[0][j]), _mm_loadu_ps(t + 4 * c0[j]));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(w[1][j]), _mm_loadu_ps(t + 4 * c1[j])));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(w[2][j]), _mm_loadu_ps(t + 4 * c2[j])));
+            v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(w[3][j]), _mm_loadu_ps(t + 4 * (c0[j] + far))));
+            float out[4];
+            _mm_storeu_ps(out, v);
+            memcpy(px + j * stride, out, 3 * sizeof(float));
+        }
+    }
+}
+
+#endif // NC_HAVE_SSE4
+
+#ifdef NC_HAVE_AVX2
+
+NC_AVX2_TARGET static inline __m256 _NcShape8(const NcLUT* l, __m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(l->lo)), _mm256_set1_ps(l->hi));
+    if (l->shaper == NcLUTShaperLog2) {
+        __m256i bits = _mm256_castps_si256(_mm256_add_ps(x, _mm256_set1_ps(l->offset)));
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(bits, _mm256_set1_epi32(l->base))),
+                             _mm256_set1_ps(l->scale));
+    }
+    return _mm256_mul_ps(_mm256_sub_ps(x, _mm256_set1_ps(l->lo)), _mm256_set1_ps(l->scale));
+}
+
+NC_AVX2_TARGET static inline __m256i _NcLattice8(const NcLUT* l, __m256 s, __m256* f) {
+    const __m256 t = _mm256_mul_ps(s, _mm256_set1_ps((float) (l->size - 1)));
+    const __m256i k = _mm256_min_epi32(_mm256_cvttps_epi32(t), _mm256_set1_epi32(l->size - 2));
+    *f = _mm256_sub_ps(t, _mm256_cvtepi32_ps(k));
+    return k;
+}
+
+NC_AVX2_TARGET static void _NcAVX2LUTRow(const NcLUT* l, float* px, size_t count, int stride) {
+    const int n = l->size;
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                             _mm256_set1_epi32(stride));
+    for (size_t i = 0; i < count; i += 8, px += 8 * stride) {
+        __m256 in[3], out[3];
+        for (int c = 0; c < 3; c++)
+            in[c] = _mm256_i32gather_ps(px + c, lanes, 4);
+
+        if (l->is1D) {
+            for (int c = 0; c < 3; c++) {
+                __m256 f;
+                __m256i k = _NcLattice8(l, _NcShape8(l, in[c]), &f);
+                const float* row = l->table + c * n;
+                __m256 a = _mm256_i32gather_ps(row, k, 4);
+                __m256 b = _mm256_i32gather_ps(row + 1, k, 4);
+                out[c] = _mm256_add_ps(a, _mm256_mul_ps(f, _mm256_sub_ps(b, a)));
+            }
+        }
+        else {
+            const __m256i sr = _mm256_set1_epi32(1), sg = _mm256_set1_epi32(n);
+            const __m256i sb = _mm256_set1_epi32(n * n);
+            __m256 fr, fg, fb;
+            __m256i ir = _NcLattice8(l, _NcShape8(l, in[0]), &fr);
+            __m256i ig = _NcLattice8(l, _NcShape8(l, in[1]), &fg);
+            __m256i ib = _NcLattice8(l, _NcShape8(l, in[2]), &fb);
+
+            __m256 rMax = _mm256_and_ps(_mm256_cmp_ps(fr, fg, _CMP_GE_OQ),
+                                        _mm256_cmp_ps(fr, fb, _CMP_GE_OQ));
+            __m256 gMax = _mm256_cmp_ps(fg, fb, _CMP_GE_OQ);
+            __m256i omax = _mm256_castps_si256(_mm256_blendv_ps(
+                _mm256_blendv_ps(_mm256_castsi256_ps(sb), _mm256_castsi256_ps(sg), gMax),
+                _mm256_castsi256_ps(sr), rMax));
+            __m256 bMin = _mm256_and_ps(_mm256_cmp_ps(fb, fr, _CMP_LE_OQ),
+                                        _mm256_cmp_ps(fb, fg, _CMP_LE_OQ));
+            __m256 gMin = _mm256_cmp_ps(fg, fr, _CMP_LE_OQ);
+            __m256i omin = _mm256_castps_si256(_mm256_blendv_ps(
+                _mm256_blendv_ps(_mm256_castsi256_ps(sr), _mm256_castsi256_ps(sg), gMin),
+                _mm256_castsi256_ps(sb), bMin));
+
+            __m256 fmax = _mm256_max_ps(fr, _mm256_max_ps(fg, fb));
+            __m256 fmin = _mm256_min_ps(fr, _mm256_min_ps(fg, fb));
+            __m256 fmid = _mm256_max_ps(_mm256_min_ps(fr, fg),
+                                        _mm256_min_ps(_mm256_max_ps(fr, fg), fb));
+            __m256 w0 = _mm256_sub_ps(_mm256_set1_ps(1.f), fmax);
+            __m256 w1 = _mm256_sub_ps(fmax, fmid);
+            __m256 w2 = _mm256_sub_ps(fmid, fmin);
+
+            // the points are four floats apart
+            __m256i base = _mm256_add_epi32(ir, _mm256_add_epi32(_mm256_mullo_epi32(ig, sg),
+                                                                 _mm256_mullo_epi32(ib, sb)));
+            __m256i far = _mm256_set1_epi32(1 + n + n * n);
+            __m256i i0 = _mm256_slli_epi32(base, 2);
+            __m256i i1 = _mm256_slli_epi32(_mm256_add_epi32(base, omax), 2);
+            __m256i i2 = _mm256_slli_epi32(_mm256_add_epi32(base, _mm256_sub_epi32(far, omin)), 2);
+            __m256i i3 = _mm256_slli_epi32(_mm256_add_epi32(base, far), 2);
+            for (int c = 0; c < 3; c++) {
+                const float* t = l->table + c;
+                __m256 v = _mm256_mul_ps(w0, _mm256_i32gather_ps(t, i0, 4));
+                v = _mm256_fmadd_ps(w1, _mm256_i32gather_ps(t, i1, 4), v);
+                v = _mm256_fmadd_ps(w2, _mm256_i32gather_ps(t, i2, 4), v);
+                out[c] = _mm256_fmadd_ps(fmin, _mm256_i32gather_ps(t, i3, 4), v);
+            }
+        }
+
+        float o[3][8];
+        for (int c = 0; c < 3; c++)
+            _mm256_storeu_ps(o[c], out[c]);
+        for (int j = 0; j < 8; j++) {
+            px[j * stride + 0] = o[0][j];
+            px[j * stride + 1] = o[1][j];
+            px[j * stride + 2] = o[2][j];
+        }
+    }
+}
+
+#endif // NC_HAVE_AVX2
+
+#ifdef NC_HAVE_NEON
+
+static inline float32x4_t _NcShapeNeon(const NcLUT* l, float32x4_t x) {
+    // vmaxnmq_f32 returns the number for NaN
+    x = vminq_f32(vmaxnmq_f32(x, vdupq_n_f32(l->lo)), vdupq_n_f32(l->hi));
+    if (l->shaper == NcLUTShaperLog2) {
+        int32x4_t bits = vreinterpretq_s32_f32(vaddq_f32(x, vdupq_n_f32(l->offset)));
+        return vmulq_f32(vcvtq_f32_s32(vsubq_s32(bits, vdupq_n_s32(l->base))),
+                         vdupq_n_f32(l->scale));
+    }
+    return vmulq_f32(vsubq_f32(x, vdupq_n_f32(l->lo)), vdupq_n_f32(l->scale));
+}
+
+static inline int32x4_t _NcLatticeNeon(const NcLUT* l, float32x4_t s, float32x4_t* f) {
+    const float32x4_t t = vmulq_f32(s, vdupq_n_f32((float) (l->size - 1)));
+    const int32x4_t k = vminq_s32(vcvtq_s32_f32(t), vdupq_n_s32(l->size - 2));
+    *f = vsubq_f32(t, vcvtq_f32_s32(k));
+    return k;
+}
+
+static void _NcNeonLUTRow(const NcLUT* l, float* px, size_t count, int stride) {
+    if (l->is1D) {
+        _NcScalarLUTRow(l, px, count, stride);
+        return;
+    }
+
+    const int n = l->size;
+    const int32x4_t sr = vdupq_n_s32(1), sg = vdupq_n_s32(n), sb = vdupq_n_s32(n * n);
+    const int32x4_t all = vdupq_n_s32(1 + n + n * n);
+    for (size_t i = 0; i < count; i += 4, px += 4 * stride) {
+        float rgb[3][4];
+        for (int j = 0; j < 4; j++)
+            for (int c = 0; c < 3; c++)
+                rgb[c][j] = px[j * stride + c];
+
+        float32x4_t fr, fg, fb;
+        int32x4_t ir = _NcLatticeNeon(l, _NcShapeNeon(l, vld1q_f32(rgb[0])), &fr);
+        int32x4_t ig = _NcLatticeNeon(l, _NcShapeNeon(l, vld1q_f32(rgb[1])), &fg);
+        int32x4_t ib = _NcLatticeNeon(l, _NcShapeNeon(l, vld1q_f32(rgb[2])), &fb);
+
+        uint32x4_t rMax = vandq_u32(vcgeq_f32(fr, fg), vcgeq_f32(fr, fb));
+        uint32x4_t gMax = vcgeq_f32(fg, fb);
+        int32x4_t omax = vbslq_s32(rMax, sr, vbslq_s32(gMax, sg, sb));
+        uint32x4_t bMin = vandq_u32(vcleq_f32(fb, fr), vcleq_f32(fb, fg));
+        uint32x4_t gMin = vcleq_f32(fg, fr);
+        int32x4_t omin = vbslq_s32(bMin, sb, vbslq_s32(gMin, sg, sr));
+
+        float32x4_t fmax = vmaxq_f32(fr, vmaxq_f32(fg, fb));
+        float32x4_t fmin = vminq_f32(fr, vminq_f32(fg, fb));
+        float32x4_t fmid = vmaxq_f32(vminq_f32(fr, fg), vminq_f32(vmaxq_f32(fr, fg), fb));
+
+        int32x4_t base = vaddq_s32(ir, vaddq_s32(vmulq_s32(ig, sg), vmulq_s32(ib, sb)));
+        int32_t c0[4], c1[4], c2[4];
+        float w[4][4];
+        vst1q_s32(c0, base);
+        vst1q_s32(c1, vaddq_s32(base, omax));
+        vst1q_s32(c2, vaddq_s32(base, vsubq_s32(all, omin)));
+        vst1q_f32(w[0], vsubq_f32(vdupq_n_f32(1.f), fmax));
+        vst1q_f32(w[1], vsubq_f32(fmax, fmid));
+        vst1q_f32(w[2], vsubq_f32(fmid, fmin));
+        vst1q_f32(w[3], fmin);
+
+        const int far = 1 + n + n * n;
+        for (int j = 0; j < 4; j++) {
+            const float* t = l->table;
+            float32x4_t v = vmulq_n_f32(vld1q_f32(t + 4 * c0[j]), w[0][j]);
+            v = vfmaq_n_f32(v, vld1q_f32(t + 4 * c1[j]), w[1][j]);
+            v = vfmaq_n_f32(v, vld1q_f32(t + 4 * c2[j]), w[2][j]);
+            v = vfmaq_n_f32(v, vld1q_f32(t + 4 * (c0[j] + far)), w[3][j]);
+            float out[4];
+            vst1q_f32(out, v);
+            memcpy(px + j * stride, out, 3 * sizeof(float));
+        }
+    }
+}
+
+#endif // NC_HAVE_NEON
+
+static void _NcApplyLUT(const NcLUT* l, float* px, size_t count, int stride) {
+    void (*row)(const NcLUT*, float*, size_t, int) = NULL;
+    size_t batch = 1;
+    switch (NcTransformColorsLevel()) {
+#ifdef NC_HAVE_SSE4
+        case _NcLevelSSE4: row = _NcSSE4LUTRow; batch = 4; break;
+#endif
+#ifdef NC_HAVE_AVX2
+        case _NcLevelAVX2: row = _NcAVX2LUTRow; batch = 8; break;
+#endif
+#ifdef NC_HAVE_NEON
+        case _NcLevelNEON: row = _NcNeonLUTRow; batch = 4; break;
+#endif
+        default: break;
+    }
+    if (!row) {
+        _NcScalarLUTRow(l, px, count, stride);
+        return;
+    }
+
+    size_t whole = count - count % batch;
+    row(l, px, whole, stride);
+    if (whole < count) {
+        float tail[8 * 4] = { 0 };
+        size_t floats = (count - whole) * stride;
+        memcpy(tail, px + whole * stride, floats * sizeof(float));
+        row(l, tail, batch, stride);
+        memcpy(px + whole * stride, tail, floats * sizeof(float));
+    }
+}
+
+static bool _NcIsDiagonal(NcM33f m) {
+    return fabsf(m.m[1]) <= 1e-6f && fabsf(m.m[2]) <= 1e-6f && fabsf(m.m[3]) <= 1e-6f &&
+           fabsf(m.m[5]) <= 1e-6f && fabsf(m.m[6]) <= 1e-6f && fabsf(m.m[7]) <= 1e-6f;
+}
+
+void NcApplyTransformChain(const NcTransform* const* chain, int count,
+                           NcRGB* rgb, size_t colors) {
+    if (!chain || !rgb)
+        return;
+
+    for (int i = 0; i < count; i++)
+        NcApplyTransformColors(chain[i], rgb, colors);
+}
+
+NcLUT* NcCreateLUT(const NcTransform* const* chain, int count, const NcLUTDescriptor* desc) {
+    if (!chain || count < 1 || !desc || !(desc->domainMax > desc->domainMin))
+        return NULL;
+
+    bool separable = desc->allow1D;
+    for (int i = 0; i < count; i++) {
+        if (!chain[i])
+            return NULL;
+        separable = separable && _NcIsDiagonal(NcGetTransformMatrix(chain[i]));
+    }
+
+    const int n = separable ? desc->size1D : desc->size3D;
+    if (n < 2 || n > (separable ? 65536 : 129))
+        return NULL;
+
+    NcLUT* l = (NcLUT*) calloc(1, sizeof(*l));
+    if (!l)
+        return NULL;
+
+    l->shaper = desc->shaper;
+    l->size = n;
+    l->is1D = separable;
+    if (desc->shaper == NcLUTShaperLog2) {
+        // the span is widened downward so that each stop is a whole number
+        // of steps, when there are enough of them. The shaper is linear
+        // within a stop, so that linear chains are then reproduced exactly.
+        const int top = (int) floorf(desc->domainMax);
+        int stops = top - (int) floorf(desc->domainMin);
+        if (stops < 1)
+            stops = 1;
+        for (int s = stops; s < n; s++)
+            if ((n - 1) % s == 0) {
+                stops = s;
+                break;
+            }
+        if (top > 64 || top - stops < -64) {
+            free(l);
+            return NULL;
+        }
+        l->offset = ldexpf(1.f, top - stops);
+        l->lo = 0.f;
+        l->hi = ldexpf(1.f, top) - l->offset;
+        memcpy(&l->base, &l->offset, sizeof(l->base));
+        l->range = stops << 23;
+        l->scale = 1.f / (float) l->range;
+    }
+    else {
+        l->lo = desc->domainMin;
+        l->hi = desc->domainMax;
+        l->scale = 1.f / (l->hi - l->lo);
+    }
+
+    // the input at each step of the lattice
+    const size_t points = separable ? (size_t) n : (size_t) n * n * n;
+    float* axis = (float*) malloc(n * sizeof(float));
+    NcRGB* rgb = (NcRGB*) malloc(points * sizeof(NcRGB));
+    l->table = (float*) calloc(separable ? 3 * points : 4 * points, sizeof(float));
+    if (!axis || !rgb || !l->table) {
+        free(axis);
+        free(rgb);
+        NcFreeLUT(l);
+        return NULL;
+    }
+
+    for (int i = 0; i < n; i++)
+        axis[i] = (float) _NcUnshape(l, (double) i / (n - 1));
+    if (separable) {
+        for (int i = 0; i < n; i++)
+            rgb[i] = (NcRGB) { axis[i], axis[i], axis[i] };
+    }
+    else {
+        for (int b = 0; b < n; b++)
+            for (int g = 0; g < n; g++)
+                for (int r = 0; r < n; r++)
+                    rgb[((size_t) b * n + g) * n + r] = (NcRGB) { axis[r], axis[g], axis[b] };
+    }
+
+    NcApplyTransformChain(chain, count, rgb, points);
+
+    for (size_t i = 0; i < points; i++) {
+        if (separable) {
+            l->table[i] = rgb[i].r;
+            l->table[n + i] = rgb[i].g;
+            l->table[2 * n + i] = rgb[i].b;
+        }
+        else
+            memcpy(&l->table[i * 4], &rgb[i], sizeof(NcRGB));
+    }
+    free(axis);
+    free(rgb);
+    return l;
+}
+
+void NcFreeLUT(NcLUT* lut) {
+    if (!lut)
+        return;
+
+    free(lut->table);
+    free(lut);
+}
+
+bool NcLUTIs1D(const NcLUT* lut) {
+    return lut && lut->is1D;
+}
+
+int NcLUTSize(const NcLUT* lut) {
+    return lut ? lut->size : 0;
+}
+
+void NcApplyLUT(const NcLUT* lut, NcRGB* rgb, size_t count) {
+    if (!lut || !rgb)
+        return;
+
+    _NcApplyLUT(lut, &rgb->r, count, 3);
+}
+
+void NcApplyLUTWithAlpha(const NcLUT* lut, float* rgba, size_t count) {
+    if (!lut || !rgba)
+        return;
+
+    _NcApplyLUT(lut, rgba, count, 4);
+}
+
+static uint32_t _NcLUTRandom(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static float _NcLabF(float t) {
+    const float d = 6.f / 29.f;
+    return t > d * d * d ? cbrtf(t) : t / (3.f * d * d) + 4.f / 29.f;
+}
+
+static void _NcLab(NcXYZ xyz, NcXYZ white, float scale, float lab[3]) {
+    const float fx = _NcLabF(xyz.x * scale / white.x);
+    const float fy = _NcLabF(xyz.y * scale / white.y);
+    const float fz = _NcLabF(xyz.z * scale / white.z);
+    lab[0] = 116.f * fy - 16.f;
+    lab[1] = 500.f * (fx - fy);
+    lab[2] = 200.f * (fy - fz);
+}
+
+NcLUTError NcMeasureLUT(const NcLUT* lut, const NcTransform* const* chain, int count,
+                        const NcColorSpace* output, size_t samples) {
+    NcLUTError err = { 0, 0, { 0, 0, 0 } };
+    if (!lut || !chain || count < 1 || !output || !samples)
+        return err;
+
+    enum { kBatch = 256 };
+    NcRGB in[kBatch], ref[kBatch], out[kBatch];
+    const NcXYZ white = NcRGBToXYZ(output, (NcRGB) { 1.f, 1.f, 1.f });
+    uint32_t state = 1;
+    double sum = 0;
+    size_t measured = 0;
+    for (size_t done = 0; done < samples; done += kBatch) {
+        const size_t batch = samples - done < kBatch ? samples - done : kBatch;
+        for (size_t i = 0; i < batch; i++) {
+            float v[3];
+            for (int c = 0; c < 3; c++)
+                v[c] = (float) _NcUnshape(lut, (_NcLUTRandom(&state) & 0xffff) / 65535.0);
+            in[i] = ref[i] = out[i] = (NcRGB) { v[0], v[1], v[2] };
+        }
+        NcApplyTransformChain(chain, count, ref, batch);
+        NcApplyLUT(lut, out, batch);
+
+        for (size_t i = 0; i < batch; i++) {
+            // colors brighter than white are compared at the exposure that
+            // brings the reference to white, so that HDR errors are relative
+            const NcXYZ refXYZ = NcRGBToXYZ(output, ref[i]);
+            const float scale = refXYZ.y > white.y ? white.y / refXYZ.y : 1.f;
+            float a[3], b[3];
+            _NcLab(refXYZ, white, scale, a);
+            _NcLab(NcRGBToXYZ(output, out[i]), white, scale, b);
+            if (!isfinite(a[0]) || !isfinite(a[1]) || !isfinite(a[2]))
+                continue;
+            float de = sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+                             (a[2] - b[2]) * (a[2] - b[2]));
+            if (!isfinite(de))
+                de = INFINITY;
+            if (de > err.maxDeltaE) {
+                err.maxDeltaE = de;
+                err.worstInput = in[i];
+            }
+            sum += de;
+            ++measured;
+        }
+    }
+    err.meanDeltaE = measured ? (float) (sum / measured) : 0.f;
+    return err;
+}
+
+//----------------------------------------------------------------------------
+// Tests and benchmarks
+//----------------------------------------------------------------------------
+
+static const char* _lutLevelNames[] = { "scalar", "SSE4.1", "AVX2", "NEON" };
+
+typedef struct {
+    const char* name;
+    const char* spaces[4][2];   // src, dst of each link; NULL ends the chain
+    bool adapt[3];
+    NcLUTShaper shaper;
+    float domainMin, domainMax;
+    bool linear;                // matrices only, so reproduced exactly
+} _NcLUTPipeline;
+
+static const _NcLUTPipeline _lutPipelines[] = {
+    { "ACEScg to linear Rec. 709",
+      { { "lin_ap1", "lin_rec709" } }, { false },
+      NcLUTShaperLinear, -0.25f, 1.25f, true },
+    { "ACES2065-1 to linear Rec. 709, scene linear",
+      { { "lin_ap0", "lin_rec709" } }, { true },
+      NcLUTShaperLog2, -12.f, 8.f, true },
+    { "sRGB texture to ACEScg",
+      { { "srgb_texture", "lin_rec709" }, { "lin_rec709", "lin_ap1" } }, { false, true },
+      NcLUTShaperLog2, -12.f, 0.f, false },
+    { "ACES2065-1 to sRGB display",
+      { { "lin_ap0", "lin_rec709" }, { "lin_rec709", "sRGB" } }, { true, false },
+      NcLUTShaperLog2, -12.f, 0.f, false },
+    { "Rec. 2020 to Display P3 display",
+      { { "lin_rec2020", "lin_displayp3" }, { "lin_displayp3", "srgb_displayp3" } }, { false, false },
+      NcLUTShaperLog2, -12.f, 0.f, false },
+    { "gamma 2.2 to sRGB, separable",
+      { { "g22_rec709", "lin_rec709" }, { "lin_rec709", "sRGB" } }, { false, false },
+      NcLUTShaperLog2, -12.f, 0.f, false },
+};
+
+static int _NcLUTChain(const _NcLUTPipeline* p, const NcTransform* chain[3],
+                       const NcColorSpace** output) {
+    int count = 0;
+    for (; count < 3 && p->spaces[count][0]; count++) {
+        const NcColorSpace* src = NcGetNamedColorSpace(p->spaces[count][0]);
+        const NcColorSpace* dst = NcGetNamedColorSpace(p->spaces[count][1]);
+        chain[count] = NcGetTransform(dst, src, p->adapt[count]);
+        *output = dst;
+    }
+    return count;
+}
+
+static double _NcLUTSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int NcTestLUTs(void) {
+    int failures = 0;
+    NcInitColorSpaceLibrary();
+
+    enum { kPixels = 1000 };
+    static float in[(kPixels + 1) * 4], ref[(kPixels + 1) * 4], out[(kPixels + 1) * 4];
+    const size_t pipelines = sizeof(_lutPipelines) / sizeof(_lutPipelines[0]);
+    for (size_t pi = 0; pi < pipelines; pi++) {
+        const _NcLUTPipeline* p = &_lutPipelines[pi];
+        const NcTransform* chain[3];
+        const NcColorSpace* output = NULL;
+        const int count = _NcLUTChain(p, chain, &output);
+        const bool separable = pi == pipelines - 1;
+        printf("  %s\n", p->name);
+
+        NcLUTError coarse = { 0, 0, { 0, 0, 0 } };
+        for (int variant = 0; variant < 3; variant++) {
+            NcLUTDescriptor desc = { p->shaper, p->domainMin, p->domainMax,
+                                     variant == 0 ? 33 : 65, 4096, variant == 2 };
+            NcLUT* lut = NcCreateLUT(chain, count, &desc);
+            if (!lut || NcLUTIs1D(lut) != (variant == 2 && separable)) {
+                printf("  NcCreateLUT test failed: %s, variant %d\n", p->name, variant);
+                ++failures;
+                NcFreeLUT(lut);
+                continue;
+            }
+            if (variant == 2 && !separable) {
+                NcFreeLUT(lut);
+                continue;
+            }
+
+            // the lattice points reproduce the chain
+            if (!NcLUTIs1D(lut)) {
+                const int n = NcLUTSize(lut);
+                for (int i = 0; i < n; i += 3) {
+                    float x = (float) _NcUnshape(lut, (double) i / (n - 1));
+                    float y = (float) _NcUnshape(lut, (double) (n - 1 - i) / (n - 1));
+                    NcRGB a = { x, y, x }, b = a;
+                    NcApplyTransformChain(chain, count, &a, 1);
+                    NcTransformColorsForceLevel(0);
+                    NcApplyLUT(lut, &b, 1);
+                    NcTransformColorsForceLevel(-1);
+                    float scale = fmaxf(1.f, fmaxf(fabsf(a.r), fmaxf(fabsf(a.g), fabsf(a.b))));
+                    if (fabsf(a.r - b.r) > 1e-5f * scale || fabsf(a.g - b.g) > 1e-5f * scale ||
+                        fabsf(a.b - b.b) > 1e-5f * scale) {
+                        printf("  NcApplyLUT test failed: %s, lattice point %d gave (%g %g %g), "
+                               "expected (%g %g %g)\n", p->name, i, b.r, b.g, b.b, a.r, a.g, a.b);
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+
+            // every level against the scalar reference, with values outside
+            // the domain and NaN, for every tail
+            uint32_t state = (uint32_t) (pi * 7 + variant + 1);
+            for (int i = 0; i < kPixels * 4; i++) {
+                float s = (float) (_NcLUTRandom(&state) & 0xffff) / 65535.f * 1.2f - 0.1f;
+                if ((i & 3) == 3)
+                    in[i] = (float) i;
+                else if (s < 0.f)
+                    in[i] = lut->lo + s * 10.f;
+                else if (s > 1.f)
+                    in[i] = lut->hi * (1.f + s);
+                else
+                    in[i] = (float) _NcUnshape(lut, s);
+            }
+            in[4 * 7 + 1] = NAN;
+            in[4 * 11 + 2] = INFINITY;
+            in[4 * 13 + 0] = -INFINITY;
+            memcpy(ref, in, sizeof(in));
+            NcTransformColorsForceLevel(0);
+            NcApplyLUTWithAlpha(lut, ref, kPixels);
+            for (int level = 1; level < 4; level++) {
+                NcTransformColorsForceLevel(level);
+                if (NcTransformColorsLevel() != level)
+                    continue;
+                for (size_t c = 1; c <= 18; c++) {
+                    const size_t colors = c < 18 ? c : kPixels;
+                    memcpy(out, in, sizeof(in));
+                    out[colors * 4] = -7.f;
+                    NcApplyLUTWithAlpha(lut, out, colors);
+                    bool ok = out[colors * 4] == -7.f;
+                    for (size_t i = 0; ok && i < colors * 4; i++) {
+                        float tolerance = (i & 3) == 3 ? 0.f : 2e-6f * fmaxf(1.f, fabsf(ref[i]));
+                        ok = fabsf(out[i] - ref[i]) <= tolerance;
+                        if (!ok)
+                            printf("  NcApplyLUT test failed: %s, %s, %d of %d gave %g, "
+                                   "expected %g\n", p->name, _lutLevelNames[level], (int) i / 4,
+                                   (int) colors, out[i], ref[i]);
+                    }
+                    if (!ok) {
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+            NcTransformColorsForceLevel(-1);
+
+            NcLUTError err = NcMeasureLUT(lut, chain, count, output, 200000);
+            printf("    %-3s %5d  delta E max %.4f mean %.5f at (%g %g %g)\n",
+                   NcLUTIs1D(lut) ? "1D" : "3D", NcLUTSize(lut), err.maxDeltaE,
+                   err.meanDeltaE, err.worstInput.r, err.worstInput.g, err.worstInput.b);
+            // a just noticeable difference is about 1; the largest errors
+            // are in the deep shadows, and shrink with the lattice
+            bool ok = err.meanDeltaE < (variant == 0 ? 2.f : variant == 1 ? 0.5f : 0.01f);
+            if (p->linear)
+                ok = ok && err.maxDeltaE < 0.1f;
+            if (variant == 0)
+                coarse = err;
+            else if (variant == 1)
+                ok = ok && err.maxDeltaE <= coarse.maxDeltaE + 0.01f;
+            if (!ok) {
+                printf("  NcMeasureLUT test failed: %s, delta E max %g mean %g\n",
+                       p->name, err.maxDeltaE, err.meanDeltaE);
+                ++failures;
+            }
+            NcFreeLUT(lut);
+        }
+    }
+
+    const NcTransform* chain[3];
+    const NcColorSpace* output = NULL;
+    int count = _NcLUTChain(&_lutPipelines[0], chain, &output);
+    NcLUTDescriptor bad[] = {
+        { NcLUTShaperLinear, 1.f, 0.f, 33, 4096, false },
+        { NcLUTShaperLinear, 0.f, 1.f, 1, 4096, false },
+        { NcLUTShaperLinear, 0.f, 1.f, 130, 4096, false },
+        { NcLUTShaperLog2, -100.f, 4.f, 33, 4096, false },
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        NcLUT* lut = NcCreateLUT(chain, count, &bad[i]);
+        if (lut) {
+            printf("  NcCreateLUT test failed: invalid descriptor %d was accepted\n", (int) i);
+            ++failures;
+        }
+        NcFreeLUT(lut);
+    }
+    if (NcCreateLUT(chain, 0, &bad[0])) {
+        printf("  NcCreateLUT test failed: an empty chain was accepted\n");
+        ++failures;
+    }
+
+    printf("NcLUT: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int NcBenchmarkLUTs(size_t count) {
+    float* rgba = (float*) malloc(count * 4 * sizeof(float));
+    NcRGB* rgb = (NcRGB*) malloc(count * sizeof(NcRGB));
+    if (!rgba || !rgb) {
+        free(rgba);
+        free(rgb);
+        return 1;
+    }
+
+    NcInitColorSpaceLibrary();
+    printf("NcBenchmarkLUTs: %zu pixels, Mpixel/s, and ms to bake\n", count);
+    const size_t pipelines = sizeof(_lutPipelines) / sizeof(_lutPipelines[0]);
+    for (size_t pi = 0; pi < pipelines; pi++) {
+        const _NcLUTPipeline* p = &_lutPipelines[pi];
+        const NcTransform* chain[3];
+        const NcColorSpace* output = NULL;
+        const int links = _NcLUTChain(p, chain, &output);
+        printf("  %s\n", p->name);
+
+        // image-like values over the domain: gradients across a 1024 wide
+        // image, with a little noise. Uniformly random colors would miss
+        // the cache on every lookup, as images rarely do.
+        uint32_t state = 1;
+        const float top = p->shaper == NcLUTShaperLog2 ? ldexpf(1.f, (int) p->domainMax)
+                                                       : p->domainMax;
+        const size_t rows = count / 1024 + 1;
+        for (size_t i = 0; i < count; i++) {
+            const float x = (float) (i % 1024) / 1024.f, y = (float) (i / 1024) / rows;
+            const float v[3] = { x, y, 0.5f * (x + 1.f - y) };
+            for (int c = 0; c < 3; c++)
+                rgba[i * 4 + c] = (v[c] * v[c] * 0.98f +
+                                   (float) (_NcLUTRandom(&state) & 0xff) / 255.f * 0.02f) * top;
+            rgba[i * 4 + 3] = 1.f;
+        }
+
+        double best = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            for (size_t i = 0; i < count; i++)
+                memcpy(&rgb[i], &rgba[i * 4], sizeof(NcRGB));
+            double t0 = _NcLUTSeconds();
+            NcApplyTransformChain(chain, links, rgb, count);
+            best = fmin(best, _NcLUTSeconds() - t0);
+        }
+        printf("    analytic, %-7s           %8.1f\n",
+               _lutLevelNames[NcTransformColorsLevel()], count / best * 1e-6);
+
+        const int sizes[] = { 33, 65, 4096 };
+        for (int si = 0; si < 3; si++) {
+            NcLUTDescriptor desc = { p->shaper, p->domainMin, p->domainMax,
+                                     sizes[si], sizes[si], si == 2 };
+            double t0 = _NcLUTSeconds();
+            NcLUT* lut = NcCreateLUT(chain, links, &desc);
+            double bake = _NcLUTSeconds() - t0;
+            if (!lut || (si == 2 && !NcLUTIs1D(lut))) {
+                NcFreeLUT(lut);
+                continue;
+            }
+            for (int level = 0; level < 4; level++) {
+                NcTransformColorsForceLevel(level);
+                if (NcTransformColorsLevel() != level)
+                    continue;
+                best = 1e30;
+                for (int rep = 0; rep < 3; rep++) {
+                    for (size_t i = 0; i < count; i++)
+                        memcpy(&rgb[i], &rgba[i * 4], sizeof(NcRGB));
+                    double t1 = _NcLUTSeconds();
+                    NcApplyLUT(lut, rgb, count);
+                    best = fmin(best, _NcLUTSeconds() - t1);
+                }
+                printf("    %s %4d, %-7s %8.1f ms %8.1f\n", NcLUTIs1D(lut) ? "1D" : "3D",
+                       sizes[si], _lutLevelNames[level], bake * 1e3, count / best * 1e-6);
+            }
+            NcTransformColorsForceLevel(-1);
+            NcFreeLUT(lut);
+        }
+    }
+    free(rgba);
+    free(rgb);
+    return 0;
+}
@@ -0,0 +1,171 @@
+#ifndef PXR_BASE_GF_NC_NANOCOLOR_LUT_H
+#define PXR_BASE_GF_NC_NANOCOLOR_LUT_H
+
+#include "nanocolor.h"
+
+/*
+ Baked color pipelines. A chain of transforms, such as decoding, a gamut
+ conversion, an adaptation and a display encoding, is evaluated once at
+ the points of a lattice, and colors are then interpolated rather than
+ transformed analytically.
+
+ Inputs are first mapped to [0, 1] by a shaper, either linearly over a
+ range, for encoded values, or logarithmically over a span of stops, for
+ scene linear values, so that the lattice is as fine in the shadows as in
+ the highlights. A chain whose every matrix is diagonal is separable, and
+ may be baked into three 1D tables; otherwise it is baked into a 3D
+ lattice, interpolated tetrahedrally.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NcLUT                        NCCONCAT(NCNAMESPACE, LUT)
+#define NcLUTDescriptor              NCCONCAT(NCNAMESPACE, LUTDescriptor)
+#define NcLUTError                   NCCONCAT(NCNAMESPACE, LUTError)
+#define NcLUTShaper                  NCCONCAT(NCNAMESPACE, LUTShaper)
+
+typedef struct NcLUT NcLUT;
+
+typedef enum {
+    // linear over [domainMin, domainMax]
+    NcLUTShaperLinear = 0,
+    // zero to 2^domainMax, with even steps per stop down to 2^domainMin
+    // and linear below it. The bounds are whole stops, and domainMin is
+    // lowered if that makes each stop a whole number of steps.
+    NcLUTShaperLog2 = 1,
+} NcLUTShaper;
+
+typedef struct {
+    NcLUTShaper shaper;
+    float domainMin, domainMax;
+    int size3D;             // lattice points per edge, from 2 to 129; 33 or 65
+    int size1D;             // entries per channel of a 1D LUT, from 2 to 65536
+    bool allow1D;           // bake separable chains into a 1D LUT
+} NcLUTDescriptor;
+
+typedef struct {
+    float maxDeltaE;        // CIE 1976 delta E, in the output color space
+    float meanDeltaE;
+    NcRGB worstInput;       // the input with the largest delta E
+} NcLUTError;
+
+#define NcCreateLUT                  NCCONCAT(NCNAMESPACE, CreateLUT)
+#define NcFreeLUT                    NCCONCAT(NCNAMESPACE, FreeLUT)
+#define NcLUTIs1D                    NCCONCAT(NCNAMESPACE, LUTIs1D)
+#define NcLUTSize                    NCCONCAT(NCNAMESPACE, LUTSize)
+#define NcApplyLUT                   NCCONCAT(NCNAMESPACE, ApplyLUT)
+#define NcApplyLUTWithAlpha          NCCONCAT(NCNAMESPACE, ApplyLUTWithAlpha)
+#define NcApplyTransformChain        NCCONCAT(NCNAMESPACE, ApplyTransformChain)
+#define NcMeasureLUT                 NCCONCAT(NCNAMESPACE, MeasureLUT)
+#define NcTestLUTs                   NCCONCAT(NCNAMESPACE, TestLUTs)
+#define NcBenchmarkLUTs              NCCONCAT(NCNAMESPACE, BenchmarkLUTs)
+
+/**
+ * @brief Bakes a chain of transforms into a LUT.
+ *
+ * @param chain The transforms, applied in order. They are only used while
+ *              baking.
+ * @param count Number of transforms in the chain.
+ * @param desc The shaper, domain and sizes of the LUT.
+ * @return The LUT, to be freed with NcFreeLUT, or NULL if the chain is
+ *         empty, the descriptor is invalid, or the LUT could not be
+ *         allocated.
+ */
+NCAPI NcLUT* NcCreateLUT(const NcTransform* const* chain, int count,
+                         const NcLUTDescriptor* desc);
+
+/**
+ * @brief Frees a LUT made by NcCreateLUT.
+ *
+ * @param lut Pointer to the LUT, or NULL.
+ * @return void
+ */
+NCAPI void NcFreeLUT(NcLUT* lut);
+
+/**
+ * @brief Reports whether a LUT was baked as three 1D tables.
+ */
+NCAPI bool NcLUTIs1D(const NcLUT* lut);
+
+/**
+ * @brief Returns the points per edge of a 3D LUT, or the entries per
+ *        channel of a 1D LUT.
+ */
+NCAPI int NcLUTSize(const NcLUT* lut);
+
+/**
+ * @brief Transforms an array of colors through a LUT.
+ *
+ * Inputs outside the domain are clamped to it, and NaN is taken as the
+ * bottom of the domain. Colors are interpolated four or eight at a time
+ * with the instruction set NcTransformColorsLevel reports.
+ *
+ * @param lut Pointer to the LUT.
+ * @param rgb Pointer to the array of RGB colors to transform.
+ * @param count Number of colors in the array.
+ * @return void
+ */
+NCAPI void NcApplyLUT(const NcLUT* lut, NcRGB* rgb, size_t count);
+
+/**
+ * @brief Transforms an array of colors with alpha channel through a LUT,
+ *        leaving alpha unchanged.
+ *
+ * @param lut Pointer to the LUT.
+ * @param rgba Pointer to the array of RGBA colors to transform.
+ * @param count Number of colors in the array.
+ * @return void
+ */
+NCAPI void NcApplyLUTWithAlpha(const NcLUT* lut, float* rgba, size_t count);
+
+/**
+ * @brief Transforms an array of colors through a chain of transforms,
+ *        analytically, as the chain would be baked.
+ *
+ * @param chain The transforms, applied in order.
+ * @param count Number of transforms in the chain.
+ * @param rgb Pointer to the array of RGB colors to transform.
+ * @param colors Number of colors in the array.
+ * @return void
+ */
+NCAPI void NcApplyTransformChain(const NcTransform* const* chain, int count,
+                                 NcRGB* rgb, size_t colors);
+
+/**
+ * @brief Measures a LUT against the chain it was baked from.
+ *
+ * Inputs are drawn evenly over the shaped domain, and both results are
+ * compared in CIELAB, relative to the white of the output color space.
+ * Colors brighter than white are compared at the exposure that brings the
+ * analytic result to white.
+ *
+ * @param lut Pointer to the LUT.
+ * @param chain The transforms the LUT was baked from.
+ * @param count Number of transforms in the chain.
+ * @param output The color space the chain transforms into.
+ * @param samples Number of inputs to compare.
+ * @return The largest and mean delta E, or zeros if an argument is invalid.
+ */
+NCAPI NcLUTError NcMeasureLUT(const NcLUT* lut, const NcTransform* const* chain, int count,
+                              const NcColorSpace* output, size_t samples);
+
+/// \brief Checks the SIMD interpolation against the scalar reference, at
+///        every instruction set level the processor supports, that
+///        lattice points reproduce the chain, that separable chains bake
+///        to 1D LUTs, and reports the delta E of typical pipelines at 33
+///        and 65 points per edge.
+/// \return The number of failures.
+NCAPI int NcTestLUTs(void);
+
+/// \brief Reports the Mpixel/s of NcApplyLUTWithAlpha at each level and of
+///        the analytic chain over count pixels, and the time to bake.
+/// \return Zero, or one if the pixels could not be allocated.
+NCAPI int NcBenchmarkLUTs(size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PXR_BASE_GF_NC_NANOCOLOR_LUT_H */
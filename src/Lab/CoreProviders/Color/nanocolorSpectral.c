@@ -0,0 +1,1245 @@
+#include "nanocolorSpectral.h"
+#include "WavelengthToRGB.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+/*
+ The matching functions are kept as three rows per observer, so that the
+ weights of a sampling are three rows too, and a spectrum is integrated by
+ three dot products over its samples.
+
+ A weight is the integral of the matching function against the hat that
+ interpolates its sample. Between two neighboring samples of the spectrum
+ and two neighboring nm, both are linear, so their product is quadratic
+ and Simpson's rule integrates it exactly.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #if defined(__GNUC__) || defined(__clang__)
+        #define NC_SSE4_TARGET __attribute__((target("sse4.1")))
+        #define NC_AVX2_TARGET __attribute__((target("avx2,fma")))
+        #define NC_HAVE_SSE4 1
+        #define NC_HAVE_AVX2 1
+    #elif defined(__AVX2__)
+        #define NC_SSE4_TARGET
+        #define NC_AVX2_TARGET
+        #define NC_HAVE_SSE4 1
+        #define NC_HAVE_AVX2 1
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define NC_HAVE_NEON 1
+#endif
+
+// as NcTransformColorsLevel reports them
+enum {
+    _NcLevelScalar = 0,
+    _NcLevelSSE4 = 1,
+    _NcLevelAVX2 = 2,
+    _NcLevelNEON = 3
+};
+
+/* The standard observers, sampled at one nanometer intervals from 360 to
+   830 nm as rows of x, y and z.
+
+   The CIE 1931 2 degree observer is from the color matching functions
+   published in Commission Internationale de l’Éclairage Proceedings, 1931.
+
+   The CIE 1964 10 degree observer is from the CIE's tabulation at 5 nm from
+   380 to 780 nm, interpolated to 1 nm by Sprague's method as CIE 167
+   recommends, and extended to 360 and 830 nm by exponential extrapolation
+   of the last two samples at each end. */
+
+static float const _cmf[2][3][NC_CMF_SAMPLES] = {
+    {   // CIE 1931
+        {   // x
+            0.000130f, 0.000146f, 0.000164f, 0.000184f, 0.000207f,   // 360 nm
+            0.000232f, 0.000261f, 0.000293f, 0.000329f, 0.000370f,   // 365 nm
+            0.000415f, 0.000464f, 0.000519f, 0.000582f, 0.000655f,   // 370 nm
+            0.000742f, 0.000845f, 0.000965f, 0.001095f, 0.001231f,   // 375 nm
+            0.001368f, 0.001502f, 0.001642f, 0.001802f, 0.001996f,   // 380 nm
+            0.002236f, 0.002535f, 0.002893f, 0.003301f, 0.003753f,   // 385 nm
+            0.004243f, 0.004762f, 0.005330f, 0.005979f, 0.006741f,   // 390 nm
+            0.007650f, 0.008751f, 0.010029f, 0.011422f, 0.012869f,   // 395 nm
+            0.014310f, 0.015704f, 0.017147f, 0.018781f, 0.020748f,   // 400 nm
+            0.023190f, 0.026207f, 0.029783f, 0.033881f, 0.038468f,   // 405 nm
+            0.043510f, 0.048996f, 0.055023f, 0.061719f, 0.069212f,   // 410 nm
+            0.077630f, 0.086958f, 0.097177f, 0.108406f, 0.120767f,   // 415 nm
+            0.134380f, 0.149358f, 0.165396f, 0.181983f, 0.198611f,   // 420 nm
+            0.214770f, 0.230187f, 0.244880f, 0.258777f, 0.271808f,   // 425 nm
+            0.283900f, 0.294944f, 0.304897f, 0.313787f, 0.321645f,   // 430 nm
+            0.328500f, 0.334351f, 0.339210f, 0.343121f, 0.346130f,   // 435 nm
+            0.348280f, 0.349600f, 0.350147f, 0.350013f, 0.349287f,   // 440 nm
+            0.348060f, 0.346373f, 0.344262f, 0.341809f, 0.339094f,   // 445 nm
+            0.336200f, 0.333198f, 0.330041f, 0.326636f, 0.322887f,   // 450 nm
+            0.318700f, 0.314025f, 0.308884f, 0.303290f, 0.297258f,   // 455 nm
+            0.290800f, 0.283970f, 0.276721f, 0.268918f, 0.260423f,   // 460 nm
+            0.251100f, 0.240847f, 0.229851f, 0.218407f, 0.206812f,   // 465 nm
+            0.195360f, 0.184214f, 0.173327f, 0.162688f, 0.152283f,   // 470 nm
+            0.142100f, 0.132179f, 0.122570f, 0.113275f, 0.104298f,   // 475 nm
+            0.095640f, 0.087300f, 0.079308f, 0.071718f, 0.064581f,   // 480 nm
+            0.057950f, 0.051862f, 0.046282f, 0.041151f, 0.036413f,   // 485 nm
+            0.032010f, 0.027917f, 0.024144f, 0.020687f, 0.017540f,   // 490 nm
+            0.014700f, 0.012162f, 0.009920f, 0.007967f, 0.006296f,   // 495 nm
+            0.004900f, 0.003777f, 0.002945f, 0.002425f, 0.002236f,   // 500 nm
+            0.002400f, 0.002926f, 0.003837f, 0.005175f, 0.006982f,   // 505 nm
+            0.009300f, 0.012149f, 0.015536f, 0.019477f, 0.023993f,   // 510 nm
+            0.029100f, 0.034815f, 0.041120f, 0.047985f, 0.055379f,   // 515 nm
+            0.063270f, 0.071635f, 0.080462f, 0.089740f, 0.099456f,   // 520 nm
+            0.109600f, 0.120167f, 0.131114f, 0.142368f, 0.153854f,   // 525 nm
+            0.165500f, 0.177257f, 0.189140f, 0.201169f, 0.213366f,   // 530 nm
+            0.225750f, 0.238321f, 0.251067f, 0.263992f, 0.277102f,   // 535 nm
+            0.290400f, 0.303891f, 0.317573f, 0.331438f, 0.345483f,   // 540 nm
+            0.359700f, 0.374084f, 0.388640f, 0.403378f, 0.418312f,   // 545 nm
+            0.433450f, 0.448795f, 0.464336f, 0.480064f, 0.495971f,   // 550 nm
+            0.512050f, 0.528296f, 0.544692f, 0.561209f, 0.577821f,   // 555 nm
+            0.594500f, 0.611221f, 0.627976f, 0.644760f, 0.661570f,   // 560 nm
+            0.678400f, 0.695239f, 0.712059f, 0.728828f, 0.745519f,   // 565 nm
+            0.762100f, 0.778543f, 0.794826f, 0.810926f, 0.826825f,   // 570 nm
+            0.842500f, 0.857933f, 0.873082f, 0.887894f, 0.902318f,   // 575 nm
+            0.916300f, 0.929799f, 0.942798f, 0.955278f, 0.967218f,   // 580 nm
+            0.978600f, 0.989386f, 0.999549f, 1.009089f, 1.018006f,   // 585 nm
+            1.026300f, 1.033983f, 1.040986f, 1.047188f, 1.052467f,   // 590 nm
+            1.056700f, 1.059794f, 1.061799f, 1.062807f, 1.062910f,   // 595 nm
+            1.062200f, 1.060735f, 1.058444f, 1.055224f, 1.050977f,   // 600 nm
+            1.045600f, 1.039037f, 1.031361f, 1.022666f, 1.013048f,   // 605 nm
+            1.002600f, 0.991368f, 0.979331f, 0.966492f, 0.952848f,   // 610 nm
+            0.938400f, 0.923194f, 0.907244f, 0.890502f, 0.872920f,   // 615 nm
+            0.854450f, 0.835084f, 0.814946f, 0.794186f, 0.772954f,   // 620 nm
+            0.751400f, 0.729584f, 0.707589f, 0.685602f, 0.663810f,   // 625 nm
+            0.642400f, 0.621515f, 0.601114f, 0.581105f, 0.561398f,   // 630 nm
+            0.541900f, 0.522600f, 0.503546f, 0.484744f, 0.466194f,   // 635 nm
+            0.447900f, 0.429861f, 0.412098f, 0.394644f, 0.377533f,   // 640 nm
+            0.360800f, 0.344456f, 0.328517f, 0.313019f, 0.298001f,   // 645 nm
+            0.283500f, 0.269545f, 0.256118f, 0.243190f, 0.230727f,   // 650 nm
+            0.218700f, 0.207097f, 0.195923f, 0.185171f, 0.174832f,   // 655 nm
+            0.164900f, 0.155367f, 0.146230f, 0.137490f, 0.129147f,   // 660 nm
+            0.121200f, 0.113640f, 0.106465f, 0.099690f, 0.093331f,   // 665 nm
+            0.087400f, 0.081901f, 0.076804f, 0.072077f, 0.067687f,   // 670 nm
+            0.063600f, 0.059807f, 0.056282f, 0.052971f, 0.049819f,   // 675 nm
+            0.046770f, 0.043784f, 0.040875f, 0.038073f, 0.035405f,   // 680 nm
+            0.032900f, 0.030564f, 0.028381f, 0.026345f, 0.024453f,   // 685 nm
+            0.022700f, 0.021084f, 0.019600f, 0.018237f, 0.016987f,   // 690 nm
+            0.015840f, 0.014791f, 0.013831f, 0.012949f, 0.012129f,   // 695 nm
+            0.011359f, 0.010629f, 0.009939f, 0.009288f, 0.008679f,   // 700 nm
+            0.008111f, 0.007582f, 0.007089f, 0.006627f, 0.006195f,   // 705 nm
+            0.005790f, 0.005410f, 0.005053f, 0.004717f, 0.004403f,   // 710 nm
+            0.004109f, 0.003834f, 0.003576f, 0.003334f, 0.003109f,   // 715 nm
+            0.002899f, 0.002704f, 0.002523f, 0.002354f, 0.002197f,   // 720 nm
+            0.002049f, 0.001911f, 0.001781f, 0.001660f, 0.001547f,   // 725 nm
+            0.001440f, 0.001340f, 0.001246f, 0.001158f, 0.001076f,   // 730 nm
+            0.001000f, 0.000929f, 0.000862f, 0.000801f, 0.000743f,   // 735 nm
+            0.000690f, 0.000640f, 0.000594f, 0.000552f, 0.000512f,   // 740 nm
+            0.000476f, 0.000442f, 0.000411f, 0.000383f, 0.000357f,   // 745 nm
+            0.000332f, 0.000310f, 0.000289f, 0.000269f, 0.000252f,   // 750 nm
+            0.000235f, 0.000219f, 0.000205f, 0.000191f, 0.000178f,   // 755 nm
+            0.000166f, 0.000155f, 0.000145f, 0.000135f, 0.000126f,   // 760 nm
+            0.000117f, 0.000110f, 0.000102f, 0.000095f, 0.000089f,   // 765 nm
+            0.000083f, 0.000078f, 0.000072f, 0.000067f, 0.000063f,   // 770 nm
+            0.000059f, 0.000055f, 0.000051f, 0.000048f, 0.000044f,   // 775 nm
+            0.000042f, 0.000039f, 0.000036f, 0.000034f, 0.000031f,   // 780 nm
+            0.000029f, 0.000027f, 0.000026f, 0.000024f, 0.000022f,   // 785 nm
+            0.000021f, 0.000019f, 0.000018f, 0.000017f, 0.000016f,   // 790 nm
+            0.000015f, 0.000014f, 0.000013f, 0.000012f, 0.000011f,   // 795 nm
+            0.000010f, 0.000010f, 0.000009f, 0.000008f, 0.000008f,   // 800 nm
+            0.000007f, 0.000007f, 0.000006f, 0.000006f, 0.000005f,   // 805 nm
+            0.000005f, 0.000005f, 0.000004f, 0.000004f, 0.000004f,   // 810 nm
+            0.000004f, 0.000003f, 0.000003f, 0.000003f, 0.000003f,   // 815 nm
+            0.000003f, 0.000002f, 0.000002f, 0.000002f, 0.000002f,   // 820 nm
+            0.000002f, 0.000002f, 0.000002f, 0.000001f, 0.000001f,   // 825 nm
+            0.000001f    // 830 nm
+        },
+        {   // y
+            0.000004f, 0.000004f, 0.000005f, 0.000006f, 0.000006f,   // 360 nm
+            0.000007f, 0.000008f, 0.000009f, 0.000010f, 0.000011f,   // 365 nm
+            0.000012f, 0.000014f, 0.000016f, 0.000017f, 0.000020f,   // 370 nm
+            0.000022f, 0.000025f, 0.000028f, 0.000032f, 0.000035f,   // 375 nm
+            0.000039f, 0.000043f, 0.000047f, 0.000052f, 0.000057f,   // 380 nm
+            0.000064f, 0.000072f, 0.000082f, 0.000094f, 0.000106f,   // 385 nm
+            0.000120f, 0.000135f, 0.000152f, 0.000170f, 0.000192f,   // 390 nm
+            0.000217f, 0.000247f, 0.000281f, 0.000319f, 0.000357f,   // 395 nm
+            0.000396f, 0.000434f, 0.000473f, 0.000518f, 0.000572f,   // 400 nm
+            0.000640f, 0.000725f, 0.000825f, 0.000941f, 0.001070f,   // 405 nm
+            0.001210f, 0.001362f, 0.001531f, 0.001720f, 0.001935f,   // 410 nm
+            0.002180f, 0.002455f, 0.002764f, 0.003118f, 0.003526f,   // 415 nm
+            0.004000f, 0.004546f, 0.005159f, 0.005829f, 0.006546f,   // 420 nm
+            0.007300f, 0.008086f, 0.008909f, 0.009768f, 0.010664f,   // 425 nm
+            0.011600f, 0.012573f, 0.013583f, 0.014630f, 0.015715f,   // 430 nm
+            0.016840f, 0.018007f, 0.019214f, 0.020454f, 0.021718f,   // 435 nm
+            0.023000f, 0.024295f, 0.025610f, 0.026959f, 0.028351f,   // 440 nm
+            0.029800f, 0.031311f, 0.032884f, 0.034521f, 0.036226f,   // 445 nm
+            0.038000f, 0.039847f, 0.041768f, 0.043766f, 0.045843f,   // 450 nm
+            0.048000f, 0.050244f, 0.052573f, 0.054981f, 0.057459f,   // 455 nm
+            0.060000f, 0.062602f, 0.065278f, 0.068042f, 0.070911f,   // 460 nm
+            0.073900f, 0.077016f, 0.080266f, 0.083667f, 0.087233f,   // 465 nm
+            0.090980f, 0.094918f, 0.099046f, 0.103367f, 0.107885f,   // 470 nm
+            0.112600f, 0.117532f, 0.122674f, 0.127993f, 0.133453f,   // 475 nm
+            0.139020f, 0.144676f, 0.150469f, 0.156462f, 0.162718f,   // 480 nm
+            0.169300f, 0.176243f, 0.183558f, 0.191273f, 0.199418f,   // 485 nm
+            0.208020f, 0.217120f, 0.226735f, 0.236857f, 0.247481f,   // 490 nm
+            0.258600f, 0.270185f, 0.282294f, 0.295051f, 0.308578f,   // 495 nm
+            0.323000f, 0.338402f, 0.354686f, 0.371699f, 0.389288f,   // 500 nm
+            0.407300f, 0.425630f, 0.444310f, 0.463394f, 0.482940f,   // 505 nm
+            0.503000f, 0.523569f, 0.544512f, 0.565690f, 0.586965f,   // 510 nm
+            0.608200f, 0.629346f, 0.650307f, 0.670875f, 0.690842f,   // 515 nm
+            0.710000f, 0.728185f, 0.745464f, 0.761969f, 0.777837f,   // 520 nm
+            0.793200f, 0.808110f, 0.822496f, 0.836307f, 0.849492f,   // 525 nm
+            0.862000f, 0.873811f, 0.884962f, 0.895494f, 0.905443f,   // 530 nm
+            0.914850f, 0.923735f, 0.932092f, 0.939923f, 0.947225f,   // 535 nm
+            0.954000f, 0.960256f, 0.966007f, 0.971261f, 0.976022f,   // 540 nm
+            0.980300f, 0.984092f, 0.987418f, 0.990313f, 0.992812f,   // 545 nm
+            0.994950f, 0.996711f, 0.998098f, 0.999112f, 0.999748f,   // 550 nm
+            1.000000f, 0.999857f, 0.999305f, 0.998326f, 0.996899f,   // 555 nm
+            0.995000f, 0.992601f, 0.989743f, 0.986444f, 0.982724f,   // 560 nm
+            0.978600f, 0.974084f, 0.969171f, 0.963857f, 0.958135f,   // 565 nm
+            0.952000f, 0.945450f, 0.938499f, 0.931163f, 0.923458f,   // 570 nm
+            0.915400f, 0.907006f, 0.898277f, 0.889205f, 0.879782f,   // 575 nm
+            0.870000f, 0.859861f, 0.849392f, 0.838622f, 0.827581f,   // 580 nm
+            0.816300f, 0.804795f, 0.793082f, 0.781192f, 0.769155f,   // 585 nm
+            0.757000f, 0.744754f, 0.732422f, 0.720004f, 0.707497f,   // 590 nm
+            0.694900f, 0.682219f, 0.669472f, 0.656674f, 0.643845f,   // 595 nm
+            0.631000f, 0.618155f, 0.605314f, 0.592476f, 0.579638f,   // 600 nm
+            0.566800f, 0.553961f, 0.541137f, 0.528353f, 0.515632f,   // 605 nm
+            0.503000f, 0.490469f, 0.478030f, 0.465678f, 0.453403f,   // 610 nm
+            0.441200f, 0.429080f, 0.417036f, 0.405032f, 0.393032f,   // 615 nm
+            0.381000f, 0.368918f, 0.356827f, 0.344777f, 0.332818f,   // 620 nm
+            0.321000f, 0.309338f, 0.297850f, 0.286594f, 0.275625f,   // 625 nm
+            0.265000f, 0.254763f, 0.244890f, 0.235334f, 0.226053f,   // 630 nm
+            0.217000f, 0.208162f, 0.199549f, 0.191155f, 0.182974f,   // 635 nm
+            0.175000f, 0.167223f, 0.159646f, 0.152278f, 0.145126f,   // 640 nm
+            0.138200f, 0.131500f, 0.125025f, 0.118779f, 0.112769f,   // 645 nm
+            0.107000f, 0.101476f, 0.096189f, 0.091123f, 0.086265f,   // 650 nm
+            0.081600f, 0.077121f, 0.072825f, 0.068710f, 0.064770f,   // 655 nm
+            0.061000f, 0.057396f, 0.053955f, 0.050674f, 0.047550f,   // 660 nm
+            0.044580f, 0.041759f, 0.039085f, 0.036564f, 0.034201f,   // 665 nm
+            0.032000f, 0.029963f, 0.028077f, 0.026329f, 0.024708f,   // 670 nm
+            0.023200f, 0.021801f, 0.020501f, 0.019281f, 0.018121f,   // 675 nm
+            0.017000f, 0.015904f, 0.014837f, 0.013811f, 0.012835f,   // 680 nm
+            0.011920f, 0.011068f, 0.010273f, 0.009533f, 0.008846f,   // 685 nm
+            0.008210f, 0.007624f, 0.007085f, 0.006591f, 0.006138f,   // 690 nm
+            0.005723f, 0.005343f, 0.004996f, 0.004676f, 0.004380f,   // 695 nm
+            0.004102f, 0.003839f, 0.003589f, 0.003354f, 0.003134f,   // 700 nm
+            0.002929f, 0.002738f, 0.002560f, 0.002393f, 0.002237f,   // 705 nm
+            0.002091f, 0.001954f, 0.001825f, 0.001704f, 0.001590f,   // 710 nm
+            0.001484f, 0.001384f, 0.001291f, 0.001204f, 0.001123f,   // 715 nm
+            0.001047f, 0.000977f, 0.000911f, 0.000850f, 0.000793f,   // 720 nm
+            0.000740f, 0.000690f, 0.000643f, 0.000600f, 0.000559f,   // 725 nm
+            0.000520f, 0.000484f, 0.000450f, 0.000418f, 0.000389f,   // 730 nm
+            0.000361f, 0.000335f, 0.000311f, 0.000289f, 0.000269f,   // 735 nm
+            0.000249f, 0.000231f, 0.000215f, 0.000199f, 0.000185f,   // 740 nm
+            0.000172f, 0.000160f, 0.000149f, 0.000138f, 0.000129f,   // 745 nm
+            0.000120f, 0.000112f, 0.000104f, 0.000097f, 0.000091f,   // 750 nm
+            0.000085f, 0.000079f, 0.000074f, 0.000069f, 0.000064f,   // 755 nm
+            0.000060f, 0.000056f, 0.000052f, 0.000049f, 0.000045f,   // 760 nm
+            0.000042f, 0.000040f, 0.000037f, 0.000034f, 0.000032f,   // 765 nm
+            0.000030f, 0.000028f, 0.000026f, 0.000024f, 0.000023f,   // 770 nm
+            0.000021f, 0.000020f, 0.000018f, 0.000017f, 0.000016f,   // 775 nm
+            0.000015f, 0.000014f, 0.000013f, 0.000012f, 0.000011f,   // 780 nm
+            0.000011f, 0.000010f, 0.000009f, 0.000009f, 0.000008f,   // 785 nm
+            0.000007f, 0.000007f, 0.000006f, 0.000006f, 0.000006f,   // 790 nm
+            0.000005f, 0.000005f, 0.000005f, 0.000004f, 0.000004f,   // 795 nm
+            0.000004f, 0.000003f, 0.000003f, 0.000003f, 0.000003f,   // 800 nm
+            0.000003f, 0.000002f, 0.000002f, 0.000002f, 0.000002f,   // 805 nm
+            0.000002f, 0.000002f, 0.000002f, 0.000001f, 0.000001f,   // 810 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000001f,   // 815 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000001f,   // 820 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000000f,   // 825 nm
+            0.000000f    // 830 nm
+        },
+        {   // z
+            0.000606f, 0.000681f, 0.000765f, 0.000860f, 0.000967f,   // 360 nm
+            0.001086f, 0.001221f, 0.001373f, 0.001544f, 0.001734f,   // 365 nm
+            0.001946f, 0.002178f, 0.002436f, 0.002732f, 0.003078f,   // 370 nm
+            0.003486f, 0.003975f, 0.004541f, 0.005158f, 0.005803f,   // 375 nm
+            0.006450f, 0.007083f, 0.007746f, 0.008501f, 0.009414f,   // 380 nm
+            0.010550f, 0.011966f, 0.013656f, 0.015588f, 0.017730f,   // 385 nm
+            0.020050f, 0.022511f, 0.025203f, 0.028280f, 0.031897f,   // 390 nm
+            0.036210f, 0.041438f, 0.047504f, 0.054120f, 0.060998f,   // 395 nm
+            0.067850f, 0.074486f, 0.081362f, 0.089154f, 0.098540f,   // 400 nm
+            0.110200f, 0.124613f, 0.141702f, 0.161304f, 0.183257f,   // 405 nm
+            0.207400f, 0.233692f, 0.262611f, 0.294775f, 0.330799f,   // 410 nm
+            0.371300f, 0.416209f, 0.465464f, 0.519695f, 0.579530f,   // 415 nm
+            0.645600f, 0.718484f, 0.796713f, 0.877846f, 0.959439f,   // 420 nm
+            1.039050f, 1.115367f, 1.188497f, 1.258123f, 1.323930f,   // 425 nm
+            1.385600f, 1.442635f, 1.494804f, 1.542190f, 1.584881f,   // 430 nm
+            1.622960f, 1.656405f, 1.685296f, 1.709875f, 1.730382f,   // 435 nm
+            1.747060f, 1.760045f, 1.769623f, 1.776264f, 1.780433f,   // 440 nm
+            1.782600f, 1.782968f, 1.781700f, 1.779198f, 1.775867f,   // 445 nm
+            1.772110f, 1.768259f, 1.764039f, 1.758944f, 1.752466f,   // 450 nm
+            1.744100f, 1.733559f, 1.720858f, 1.705937f, 1.688737f,   // 455 nm
+            1.669200f, 1.647529f, 1.623413f, 1.596022f, 1.564528f,   // 460 nm
+            1.528100f, 1.486111f, 1.439522f, 1.389880f, 1.338736f,   // 465 nm
+            1.287640f, 1.237422f, 1.187824f, 1.138761f, 1.090148f,   // 470 nm
+            1.041900f, 0.994198f, 0.947347f, 0.901453f, 0.856619f,   // 475 nm
+            0.812950f, 0.770517f, 0.729445f, 0.689914f, 0.652105f,   // 480 nm
+            0.616200f, 0.582329f, 0.550416f, 0.520338f, 0.491967f,   // 485 nm
+            0.465180f, 0.439925f, 0.416184f, 0.393882f, 0.372946f,   // 490 nm
+            0.353300f, 0.334858f, 0.317552f, 0.301338f, 0.286169f,   // 495 nm
+            0.272000f, 0.258817f, 0.246484f, 0.234772f, 0.223453f,   // 500 nm
+            0.212300f, 0.201169f, 0.190120f, 0.179225f, 0.168561f,   // 505 nm
+            0.158200f, 0.148138f, 0.138376f, 0.128994f, 0.120075f,   // 510 nm
+            0.111700f, 0.103905f, 0.096667f, 0.089983f, 0.083845f,   // 515 nm
+            0.078250f, 0.073209f, 0.068678f, 0.064568f, 0.060788f,   // 520 nm
+            0.057250f, 0.053904f, 0.050747f, 0.047753f, 0.044899f,   // 525 nm
+            0.042160f, 0.039507f, 0.036936f, 0.034458f, 0.032089f,   // 530 nm
+            0.029840f, 0.027712f, 0.025694f, 0.023787f, 0.021989f,   // 535 nm
+            0.020300f, 0.018718f, 0.017240f, 0.015864f, 0.014585f,   // 540 nm
+            0.013400f, 0.012307f, 0.011302f, 0.010378f, 0.009529f,   // 545 nm
+            0.008750f, 0.008035f, 0.007382f, 0.006785f, 0.006243f,   // 550 nm
+            0.005750f, 0.005304f, 0.004900f, 0.004534f, 0.004202f,   // 555 nm
+            0.003900f, 0.003623f, 0.003371f, 0.003141f, 0.002935f,   // 560 nm
+            0.002750f, 0.002585f, 0.002439f, 0.002309f, 0.002197f,   // 565 nm
+            0.002100f, 0.002018f, 0.001948f, 0.001890f, 0.001841f,   // 570 nm
+            0.001800f, 0.001766f, 0.001738f, 0.001711f, 0.001683f,   // 575 nm
+            0.001650f, 0.001610f, 0.001564f, 0.001514f, 0.001459f,   // 580 nm
+            0.001400f, 0.001337f, 0.001270f, 0.001205f, 0.001147f,   // 585 nm
+            0.001100f, 0.001069f, 0.001049f, 0.001036f, 0.001021f,   // 590 nm
+            0.001000f, 0.000969f, 0.000930f, 0.000887f, 0.000843f,   // 595 nm
+            0.000800f, 0.000761f, 0.000724f, 0.000686f, 0.000645f,   // 600 nm
+            0.000600f, 0.000548f, 0.000492f, 0.000435f, 0.000384f,   // 605 nm
+            0.000340f, 0.000307f, 0.000283f, 0.000265f, 0.000252f,   // 610 nm
+            0.000240f, 0.000230f, 0.000221f, 0.000212f, 0.000202f,   // 615 nm
+            0.000190f, 0.000174f, 0.000156f, 0.000136f, 0.000117f,   // 620 nm
+            0.000100f, 0.000086f, 0.000075f, 0.000065f, 0.000057f,   // 625 nm
+            0.000050f, 0.000044f, 0.000039f, 0.000036f, 0.000033f,   // 630 nm
+            0.000030f, 0.000028f, 0.000026f, 0.000024f, 0.000022f,   // 635 nm
+            0.000020f, 0.000018f, 0.000016f, 0.000014f, 0.000012f,   // 640 nm
+            0.000010f, 0.000008f, 0.000005f, 0.000003f, 0.000001f,   // 645 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 650 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 655 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 660 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 665 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 670 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 675 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 680 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 685 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 690 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 695 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 700 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 705 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 710 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 715 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 720 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 725 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 730 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 735 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 740 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 745 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 750 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 755 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 760 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 765 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 770 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 775 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 780 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 785 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 790 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 795 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 800 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 805 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 810 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 815 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 820 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 825 nm
+            0.000000f    // 830 nm
+        }
+    },
+    {   // CIE 1964
+        {   // x
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000002f,   // 360 nm
+            0.000002f, 0.000003f, 0.000004f, 0.000006f, 0.000007f,   // 365 nm
+            0.000009f, 0.000012f, 0.000017f, 0.000023f, 0.000031f,   // 370 nm
+            0.000039f, 0.000050f, 0.000067f, 0.000091f, 0.000122f,   // 375 nm
+            0.000160f, 0.000212f, 0.000286f, 0.000384f, 0.000508f,   // 380 nm
+            0.000662f, 0.000861f, 0.001119f, 0.001447f, 0.001856f,   // 385 nm
+            0.002362f, 0.002988f, 0.003758f, 0.004703f, 0.005853f,   // 390 nm
+            0.007242f, 0.008902f, 0.010863f, 0.013178f, 0.015909f,   // 395 nm
+            0.019110f, 0.022805f, 0.027008f, 0.031789f, 0.037234f,   // 400 nm
+            0.043400f, 0.050285f, 0.057892f, 0.066198f, 0.075160f,   // 405 nm
+            0.084736f, 0.094902f, 0.105620f, 0.116848f, 0.128540f,   // 410 nm
+            0.140638f, 0.153087f, 0.165840f, 0.178767f, 0.191694f,   // 415 nm
+            0.204492f, 0.217122f, 0.229549f, 0.241685f, 0.253435f,   // 420 nm
+            0.264737f, 0.275548f, 0.285797f, 0.295607f, 0.305195f,   // 425 nm
+            0.314679f, 0.323997f, 0.333128f, 0.341930f, 0.350180f,   // 430 nm
+            0.357719f, 0.364545f, 0.370643f, 0.375932f, 0.380316f,   // 435 nm
+            0.383734f, 0.386179f, 0.387640f, 0.388163f, 0.387835f,   // 440 nm
+            0.386726f, 0.384838f, 0.382169f, 0.378830f, 0.374974f,   // 445 nm
+            0.370702f, 0.366031f, 0.361009f, 0.355567f, 0.349574f,   // 450 nm
+            0.342957f, 0.335753f, 0.327962f, 0.319686f, 0.311090f,   // 455 nm
+            0.302273f, 0.293233f, 0.284001f, 0.274491f, 0.264549f,   // 460 nm
+            0.254085f, 0.243161f, 0.231830f, 0.220109f, 0.208022f,   // 465 nm
+            0.195618f, 0.182942f, 0.170011f, 0.157061f, 0.144430f,   // 470 nm
+            0.132349f, 0.120842f, 0.109976f, 0.099704f, 0.089904f,   // 475 nm
+            0.080507f, 0.071570f, 0.063119f, 0.055190f, 0.047830f,   // 480 nm
+            0.041072f, 0.034909f, 0.029338f, 0.024359f, 0.019973f,   // 485 nm
+            0.016172f, 0.012955f, 0.010333f, 0.008228f, 0.006518f,   // 490 nm
+            0.005132f, 0.004073f, 0.003318f, 0.002945f, 0.003085f,   // 495 nm
+            0.003816f, 0.005120f, 0.007006f, 0.009415f, 0.012248f,   // 500 nm
+            0.015444f, 0.019020f, 0.022974f, 0.027335f, 0.032154f,   // 505 nm
+            0.037465f, 0.043256f, 0.049516f, 0.056267f, 0.063543f,   // 510 nm
+            0.071358f, 0.079704f, 0.088585f, 0.097940f, 0.107682f,   // 515 nm
+            0.117749f, 0.128135f, 0.138817f, 0.149817f, 0.161188f,   // 520 nm
+            0.172953f, 0.185087f, 0.197586f, 0.210381f, 0.223371f,   // 525 nm
+            0.236491f, 0.249736f, 0.263084f, 0.276572f, 0.290269f,   // 530 nm
+            0.304213f, 0.318385f, 0.332784f, 0.347362f, 0.362040f,   // 535 nm
+            0.376772f, 0.391570f, 0.406442f, 0.421392f, 0.436434f,   // 540 nm
+            0.451584f, 0.466840f, 0.482186f, 0.497715f, 0.513567f,   // 545 nm
+            0.529826f, 0.546474f, 0.563515f, 0.580872f, 0.598415f,   // 550 nm
+            0.616053f, 0.633784f, 0.651589f, 0.669443f, 0.687329f,   // 555 nm
+            0.705224f, 0.723089f, 0.740877f, 0.758588f, 0.776243f,   // 560 nm
+            0.793832f, 0.811323f, 0.828707f, 0.845847f, 0.862539f,   // 565 nm
+            0.878655f, 0.894203f, 0.909173f, 0.923604f, 0.937578f,   // 570 nm
+            0.951162f, 0.964327f, 0.977027f, 0.989423f, 1.001756f,   // 575 nm
+            1.014160f, 1.026583f, 1.039011f, 1.051273f, 1.063103f,   // 580 nm
+            1.074300f, 1.084849f, 1.094726f, 1.103762f, 1.111742f,   // 585 nm
+            1.118520f, 1.124065f, 1.128321f, 1.131357f, 1.133319f,   // 590 nm
+            1.134300f, 1.134265f, 1.133205f, 1.131132f, 1.128057f,   // 595 nm
+            1.123990f, 1.118946f, 1.112941f, 1.105971f, 1.098025f,   // 600 nm
+            1.089100f, 1.079219f, 1.068409f, 1.056677f, 1.044029f,   // 605 nm
+            1.030480f, 1.016067f, 1.000825f, 0.984810f, 0.968093f,   // 610 nm
+            0.950740f, 0.932785f, 0.914256f, 0.895252f, 0.875902f,   // 615 nm
+            0.856297f, 0.836463f, 0.816438f, 0.796204f, 0.775711f,   // 620 nm
+            0.754930f, 0.733911f, 0.712714f, 0.691290f, 0.669550f,   // 625 nm
+            0.647467f, 0.625098f, 0.602469f, 0.579764f, 0.557247f,   // 630 nm
+            0.535110f, 0.513373f, 0.492073f, 0.471289f, 0.451103f,   // 635 nm
+            0.431567f, 0.412714f, 0.394584f, 0.377111f, 0.360172f,   // 640 nm
+            0.343690f, 0.327683f, 0.312155f, 0.297094f, 0.282487f,   // 645 nm
+            0.268329f, 0.254610f, 0.241319f, 0.228480f, 0.216132f,   // 650 nm
+            0.204300f, 0.192974f, 0.182148f, 0.171814f, 0.161959f,   // 655 nm
+            0.152568f, 0.143636f, 0.135156f, 0.127108f, 0.119467f,   // 660 nm
+            0.112210f, 0.105328f, 0.098808f, 0.092634f, 0.086790f,   // 665 nm
+            0.081261f, 0.076034f, 0.071097f, 0.066439f, 0.062053f,   // 670 nm
+            0.057930f, 0.054059f, 0.050427f, 0.047023f, 0.043835f,   // 675 nm
+            0.040851f, 0.038061f, 0.035455f, 0.033021f, 0.030748f,   // 680 nm
+            0.028623f, 0.026638f, 0.024785f, 0.023056f, 0.021443f,   // 685 nm
+            0.019941f, 0.018542f, 0.017238f, 0.016024f, 0.014894f,   // 690 nm
+            0.013842f, 0.012863f, 0.011951f, 0.011102f, 0.010312f,   // 695 nm
+            0.009577f, 0.008893f, 0.008257f, 0.007665f, 0.007115f,   // 700 nm
+            0.006605f, 0.006131f, 0.005691f, 0.005283f, 0.004904f,   // 705 nm
+            0.004553f, 0.004227f, 0.003926f, 0.003646f, 0.003386f,   // 710 nm
+            0.003145f, 0.002921f, 0.002713f, 0.002520f, 0.002341f,   // 715 nm
+            0.002175f, 0.002021f, 0.001877f, 0.001744f, 0.001621f,   // 720 nm
+            0.001506f, 0.001400f, 0.001301f, 0.001209f, 0.001124f,   // 725 nm
+            0.001045f, 0.000972f, 0.000904f, 0.000840f, 0.000781f,   // 730 nm
+            0.000727f, 0.000676f, 0.000630f, 0.000586f, 0.000546f,   // 735 nm
+            0.000508f, 0.000473f, 0.000440f, 0.000410f, 0.000382f,   // 740 nm
+            0.000356f, 0.000332f, 0.000309f, 0.000288f, 0.000269f,   // 745 nm
+            0.000251f, 0.000234f, 0.000219f, 0.000204f, 0.000191f,   // 750 nm
+            0.000178f, 0.000166f, 0.000155f, 0.000145f, 0.000135f,   // 755 nm
+            0.000126f, 0.000118f, 0.000110f, 0.000103f, 0.000096f,   // 760 nm
+            0.000090f, 0.000084f, 0.000079f, 0.000074f, 0.000069f,   // 765 nm
+            0.000065f, 0.000061f, 0.000057f, 0.000053f, 0.000049f,   // 770 nm
+            0.000046f, 0.000043f, 0.000040f, 0.000038f, 0.000035f,   // 775 nm
+            0.000033f, 0.000031f, 0.000029f, 0.000027f, 0.000025f,   // 780 nm
+            0.000024f, 0.000022f, 0.000021f, 0.000019f, 0.000018f,   // 785 nm
+            0.000017f, 0.000016f, 0.000015f, 0.000014f, 0.000013f,   // 790 nm
+            0.000012f, 0.000011f, 0.000011f, 0.000010f, 0.000009f,   // 795 nm
+            0.000009f, 0.000008f, 0.000008f, 0.000007f, 0.000007f,   // 800 nm
+            0.000006f, 0.000006f, 0.000005f, 0.000005f, 0.000005f,   // 805 nm
+            0.000004f, 0.000004f, 0.000004f, 0.000004f, 0.000003f,   // 810 nm
+            0.000003f, 0.000003f, 0.000003f, 0.000003f, 0.000002f,   // 815 nm
+            0.000002f, 0.000002f, 0.000002f, 0.000002f, 0.000002f,   // 820 nm
+            0.000002f, 0.000002f, 0.000001f, 0.000001f, 0.000001f,   // 825 nm
+            0.000001f    // 830 nm
+        },
+        {   // y
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 360 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000001f, 0.000001f,   // 365 nm
+            0.000001f, 0.000001f, 0.000002f, 0.000002f, 0.000003f,   // 370 nm
+            0.000004f, 0.000005f, 0.000007f, 0.000010f, 0.000013f,   // 375 nm
+            0.000017f, 0.000023f, 0.000031f, 0.000042f, 0.000055f,   // 380 nm
+            0.000072f, 0.000093f, 0.000121f, 0.000156f, 0.000199f,   // 385 nm
+            0.000253f, 0.000320f, 0.000402f, 0.000502f, 0.000623f,   // 390 nm
+            0.000769f, 0.000943f, 0.001148f, 0.001389f, 0.001672f,   // 395 nm
+            0.002004f, 0.002386f, 0.002820f, 0.003313f, 0.003874f,   // 400 nm
+            0.004509f, 0.005219f, 0.006005f, 0.006862f, 0.007781f,   // 405 nm
+            0.008756f, 0.009788f, 0.010876f, 0.012018f, 0.013212f,   // 410 nm
+            0.014456f, 0.015748f, 0.017087f, 0.018474f, 0.019908f,   // 415 nm
+            0.021391f, 0.022922f, 0.024504f, 0.026131f, 0.027797f,   // 420 nm
+            0.029497f, 0.031234f, 0.033006f, 0.034826f, 0.036712f,   // 425 nm
+            0.038676f, 0.040715f, 0.042826f, 0.045010f, 0.047270f,   // 430 nm
+            0.049602f, 0.052008f, 0.054494f, 0.057029f, 0.059566f,   // 435 nm
+            0.062077f, 0.064567f, 0.067031f, 0.069506f, 0.072051f,   // 440 nm
+            0.074704f, 0.077466f, 0.080350f, 0.083334f, 0.086377f,   // 445 nm
+            0.089456f, 0.092585f, 0.095757f, 0.099036f, 0.102517f,   // 450 nm
+            0.106256f, 0.110255f, 0.114540f, 0.119035f, 0.123612f,   // 455 nm
+            0.128201f, 0.132818f, 0.137443f, 0.142194f, 0.147262f,   // 460 nm
+            0.152761f, 0.158660f, 0.164960f, 0.171573f, 0.178351f,   // 465 nm
+            0.185190f, 0.192115f, 0.199153f, 0.206213f, 0.213163f,   // 470 nm
+            0.219940f, 0.226541f, 0.232905f, 0.239290f, 0.246103f,   // 475 nm
+            0.253589f, 0.261721f, 0.270588f, 0.279859f, 0.288991f,   // 480 nm
+            0.297665f, 0.305963f, 0.313846f, 0.321658f, 0.329968f,   // 485 nm
+            0.339133f, 0.349088f, 0.359855f, 0.371307f, 0.383202f,   // 490 nm
+            0.395379f, 0.407880f, 0.420715f, 0.433838f, 0.447204f,   // 495 nm
+            0.460777f, 0.474536f, 0.488454f, 0.502545f, 0.516842f,   // 500 nm
+            0.531360f, 0.546073f, 0.560954f, 0.576013f, 0.591275f,   // 505 nm
+            0.606741f, 0.622371f, 0.638124f, 0.653957f, 0.669822f,   // 510 nm
+            0.685660f, 0.701438f, 0.717148f, 0.732601f, 0.747528f,   // 515 nm
+            0.761757f, 0.775293f, 0.788109f, 0.800289f, 0.811992f,   // 520 nm
+            0.823330f, 0.834275f, 0.844801f, 0.855029f, 0.865132f,   // 525 nm
+            0.875211f, 0.885248f, 0.895246f, 0.905107f, 0.914669f,   // 530 nm
+            0.923810f, 0.932539f, 0.940867f, 0.948661f, 0.955738f,   // 535 nm
+            0.961988f, 0.967426f, 0.972042f, 0.975938f, 0.979282f,   // 540 nm
+            0.982200f, 0.984684f, 0.986723f, 0.988463f, 0.990101f,   // 545 nm
+            0.991761f, 0.993437f, 0.995155f, 0.996796f, 0.998160f,   // 550 nm
+            0.999110f, 0.999661f, 0.999808f, 0.999503f, 0.998692f,   // 555 nm
+            0.997340f, 0.995425f, 0.992918f, 0.989862f, 0.986334f,   // 560 nm
+            0.982380f, 0.977994f, 0.973199f, 0.967926f, 0.962063f,   // 565 nm
+            0.955552f, 0.948436f, 0.940740f, 0.932551f, 0.923995f,   // 570 nm
+            0.915175f, 0.906102f, 0.896773f, 0.887341f, 0.878018f,   // 575 nm
+            0.868934f, 0.860082f, 0.851489f, 0.843021f, 0.834450f,   // 580 nm
+            0.825623f, 0.816560f, 0.807263f, 0.797676f, 0.787736f,   // 585 nm
+            0.777405f, 0.766675f, 0.755529f, 0.744029f, 0.732279f,   // 590 nm
+            0.720353f, 0.708247f, 0.695971f, 0.683548f, 0.670998f,   // 595 nm
+            0.658341f, 0.645594f, 0.632774f, 0.619885f, 0.606919f,   // 600 nm
+            0.593878f, 0.580777f, 0.567631f, 0.554445f, 0.541220f,   // 605 nm
+            0.527963f, 0.514690f, 0.501415f, 0.488163f, 0.474960f,   // 610 nm
+            0.461834f, 0.448792f, 0.435836f, 0.423019f, 0.410411f,   // 615 nm
+            0.398057f, 0.385953f, 0.374108f, 0.362475f, 0.350975f,   // 620 nm
+            0.339554f, 0.328226f, 0.317006f, 0.305847f, 0.294687f,   // 625 nm
+            0.283493f, 0.272279f, 0.261041f, 0.249871f, 0.238910f,   // 630 nm
+            0.228254f, 0.217903f, 0.207867f, 0.198167f, 0.188818f,   // 635 nm
+            0.179828f, 0.171210f, 0.162976f, 0.155096f, 0.147520f,   // 640 nm
+            0.140211f, 0.133173f, 0.126401f, 0.119889f, 0.113634f,   // 645 nm
+            0.107633f, 0.101876f, 0.096355f, 0.091067f, 0.086012f,   // 650 nm
+            0.081187f, 0.076586f, 0.072202f, 0.068029f, 0.064058f,   // 655 nm
+            0.060281f, 0.056693f, 0.053287f, 0.050057f, 0.046996f,   // 660 nm
+            0.044096f, 0.041352f, 0.038757f, 0.036305f, 0.033989f,   // 665 nm
+            0.031800f, 0.029734f, 0.027785f, 0.025949f, 0.024223f,   // 670 nm
+            0.022602f, 0.021081f, 0.019656f, 0.018322f, 0.017073f,   // 675 nm
+            0.015905f, 0.014814f, 0.013796f, 0.012846f, 0.011958f,   // 680 nm
+            0.011130f, 0.010357f, 0.009635f, 0.008961f, 0.008334f,   // 685 nm
+            0.007749f, 0.007204f, 0.006697f, 0.006224f, 0.005784f,   // 690 nm
+            0.005375f, 0.004994f, 0.004640f, 0.004310f, 0.004003f,   // 695 nm
+            0.003718f, 0.003453f, 0.003206f, 0.002976f, 0.002763f,   // 700 nm
+            0.002565f, 0.002381f, 0.002210f, 0.002051f, 0.001904f,   // 705 nm
+            0.001768f, 0.001642f, 0.001525f, 0.001416f, 0.001315f,   // 710 nm
+            0.001222f, 0.001135f, 0.001055f, 0.000980f, 0.000910f,   // 715 nm
+            0.000846f, 0.000786f, 0.000730f, 0.000679f, 0.000631f,   // 720 nm
+            0.000586f, 0.000545f, 0.000506f, 0.000471f, 0.000438f,   // 725 nm
+            0.000407f, 0.000379f, 0.000352f, 0.000328f, 0.000305f,   // 730 nm
+            0.000284f, 0.000264f, 0.000246f, 0.000229f, 0.000214f,   // 735 nm
+            0.000199f, 0.000185f, 0.000173f, 0.000161f, 0.000150f,   // 740 nm
+            0.000140f, 0.000130f, 0.000121f, 0.000113f, 0.000105f,   // 745 nm
+            0.000098f, 0.000091f, 0.000085f, 0.000080f, 0.000075f,   // 750 nm
+            0.000070f, 0.000065f, 0.000061f, 0.000057f, 0.000053f,   // 755 nm
+            0.000050f, 0.000047f, 0.000044f, 0.000041f, 0.000039f,   // 760 nm
+            0.000036f, 0.000034f, 0.000031f, 0.000029f, 0.000027f,   // 765 nm
+            0.000025f, 0.000023f, 0.000022f, 0.000020f, 0.000019f,   // 770 nm
+            0.000018f, 0.000017f, 0.000016f, 0.000015f, 0.000014f,   // 775 nm
+            0.000013f, 0.000012f, 0.000011f, 0.000011f, 0.000010f,   // 780 nm
+            0.000009f, 0.000009f, 0.000008f, 0.000008f, 0.000007f,   // 785 nm
+            0.000007f, 0.000006f, 0.000006f, 0.000006f, 0.000005f,   // 790 nm
+            0.000005f, 0.000005f, 0.000004f, 0.000004f, 0.000004f,   // 795 nm
+            0.000004f, 0.000003f, 0.000003f, 0.000003f, 0.000003f,   // 800 nm
+            0.000003f, 0.000002f, 0.000002f, 0.000002f, 0.000002f,   // 805 nm
+            0.000002f, 0.000002f, 0.000002f, 0.000002f, 0.000001f,   // 810 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000001f,   // 815 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000001f,   // 820 nm
+            0.000001f, 0.000001f, 0.000001f, 0.000001f, 0.000001f,   // 825 nm
+            0.000001f    // 830 nm
+        },
+        {   // z
+            0.000002f, 0.000003f, 0.000004f, 0.000006f, 0.000008f,   // 360 nm
+            0.000010f, 0.000013f, 0.000018f, 0.000025f, 0.000032f,   // 365 nm
+            0.000041f, 0.000054f, 0.000075f, 0.000103f, 0.000134f,   // 370 nm
+            0.000170f, 0.000220f, 0.000296f, 0.000402f, 0.000536f,   // 375 nm
+            0.000705f, 0.000937f, 0.001264f, 0.001699f, 0.002246f,   // 380 nm
+            0.002928f, 0.003807f, 0.004952f, 0.006412f, 0.008231f,   // 385 nm
+            0.010482f, 0.013272f, 0.016718f, 0.020948f, 0.026105f,   // 390 nm
+            0.032344f, 0.039814f, 0.048660f, 0.059124f, 0.071491f,   // 395 nm
+            0.086011f, 0.102807f, 0.121969f, 0.143824f, 0.168782f,   // 400 nm
+            0.197120f, 0.228857f, 0.264024f, 0.302578f, 0.344400f,   // 405 nm
+            0.389366f, 0.437379f, 0.488286f, 0.541936f, 0.598169f,   // 410 nm
+            0.656760f, 0.717462f, 0.780075f, 0.843976f, 0.908342f,   // 415 nm
+            0.972542f, 1.036404f, 1.099753f, 1.162171f, 1.223190f,   // 420 nm
+            1.282500f, 1.339887f, 1.394999f, 1.448390f, 1.501041f,   // 425 nm
+            1.553480f, 1.605388f, 1.656649f, 1.706574f, 1.754112f,   // 430 nm
+            1.798500f, 1.839701f, 1.877628f, 1.911842f, 1.941837f,   // 435 nm
+            1.967280f, 1.988113f, 2.004249f, 2.015905f, 2.023483f,   // 440 nm
+            2.027300f, 2.027351f, 2.023638f, 2.016601f, 2.006850f,   // 445 nm
+            1.994800f, 1.980546f, 1.964297f, 1.945834f, 1.924711f,   // 450 nm
+            1.900700f, 1.873966f, 1.844522f, 1.812841f, 1.779639f,   // 455 nm
+            1.745370f, 1.709992f, 1.673580f, 1.635877f, 1.596418f,   // 460 nm
+            1.554900f, 1.511524f, 1.466548f, 1.419578f, 1.369998f,   // 465 nm
+            1.317560f, 1.262523f, 1.204944f, 1.145973f, 1.087326f,   // 470 nm
+            1.030200f, 0.974657f, 0.920918f, 0.869199f, 0.819576f,   // 475 nm
+            0.772125f, 0.727063f, 0.684584f, 0.644490f, 0.606399f,   // 480 nm
+            0.570060f, 0.535521f, 0.502755f, 0.471767f, 0.442601f,   // 485 nm
+            0.415254f, 0.389651f, 0.365745f, 0.343371f, 0.322296f,   // 490 nm
+            0.302356f, 0.283499f, 0.265634f, 0.248793f, 0.233072f,   // 495 nm
+            0.218502f, 0.205010f, 0.192578f, 0.180995f, 0.169950f,   // 500 nm
+            0.159249f, 0.148879f, 0.138763f, 0.129071f, 0.120107f,   // 505 nm
+            0.112044f, 0.104807f, 0.098378f, 0.092616f, 0.087292f,   // 510 nm
+            0.082248f, 0.077490f, 0.073000f, 0.068732f, 0.064645f,   // 515 nm
+            0.060709f, 0.056895f, 0.053166f, 0.049566f, 0.046179f,   // 520 nm
+            0.043050f, 0.040159f, 0.037503f, 0.035041f, 0.032705f,   // 525 nm
+            0.030451f, 0.028281f, 0.026184f, 0.024180f, 0.022306f,   // 530 nm
+            0.020584f, 0.019001f, 0.017558f, 0.016219f, 0.014936f,   // 535 nm
+            0.013676f, 0.012440f, 0.011221f, 0.010038f, 0.008930f,   // 540 nm
+            0.007918f, 0.006995f, 0.006162f, 0.005402f, 0.004684f,   // 545 nm
+            0.003988f, 0.003319f, 0.002673f, 0.002067f, 0.001534f,   // 550 nm
+            0.001091f, 0.000732f, 0.000453f, 0.000248f, 0.000101f,   // 555 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 560 nm
+            0.000000f, 0.000014f, 0.000016f, 0.000009f, 0.000002f,   // 565 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 570 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 575 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 580 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 585 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 590 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 595 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 600 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 605 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 610 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 615 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 620 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 625 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 630 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 635 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 640 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 645 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 650 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 655 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 660 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 665 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 670 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 675 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 680 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 685 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 690 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 695 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 700 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 705 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 710 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 715 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 720 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 725 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 730 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 735 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 740 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 745 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 750 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 755 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 760 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 765 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 770 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 775 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 780 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 785 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 790 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 795 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 800 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 805 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 810 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 815 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 820 nm
+            0.000000f, 0.000000f, 0.000000f, 0.000000f, 0.000000f,   // 825 nm
+            0.000000f    // 830 nm
+        }
+    }
+};
+
+bool NcGetColorMatchingFunctions(NcObserver observer,
+                                 const float** x, const float** y, const float** z) {
+    if (observer != NcObserverCIE1931 && observer != NcObserverCIE1964)
+        return false;
+
+    if (x)
+        *x = _cmf[observer][0];
+    if (y)
+        *y = _cmf[observer][1];
+    if (z)
+        *z = _cmf[observer][2];
+    return true;
+}
+
+void NcWavelengthsToXYZ(NcObserver observer, const float* wavelengths, NcXYZ* xyz, size_t count) {
+    const float *x, *y, *z;
+    if (!wavelengths || !xyz || !NcGetColorMatchingFunctions(observer, &x, &y, &z))
+        return;
+
+    for (size_t i = 0; i < count; i++) {
+        float lambda = wavelengths[i];
+        if (!(lambda >= NC_CMF_FIRST_WAVELENGTH && lambda <= NC_CMF_LAST_WAVELENGTH)) {
+            xyz[i] = (NcXYZ) { 0, 0, 0 };
+            continue;
+        }
+        lambda -= NC_CMF_FIRST_WAVELENGTH;
+        int i1 = (int) lambda;
+        if (i1 == NC_CMF_SAMPLES - 1) {
+            xyz[i] = (NcXYZ) { x[i1], y[i1], z[i1] };
+            continue;
+        }
+        float a = lambda - floorf(lambda);
+        xyz[i] = (NcXYZ) {
+            x[i1] * (1.f - a) + x[i1 + 1] * a,
+            y[i1] * (1.f - a) + y[i1 + 1] * a,
+            z[i1] * (1.f - a) + z[i1 + 1] * a
+        };
+    }
+}
+
+//----------------------------------------------------------------------------
+// Weights
+//----------------------------------------------------------------------------
+
+struct NcSpectralWeights {
+    int samples;
+    float* w[3];        // x, y and z weights of each sample
+};
+
+// a matching function at a wavelength, zero outside the table
+static double _NcCMFAt(const float* f, double lambda) {
+    double t = lambda - NC_CMF_FIRST_WAVELENGTH;
+    if (!(t >= 0.0 && t <= NC_CMF_SAMPLES - 1))
+        return 0.0;
+    int i = (int) t;
+    if (i == NC_CMF_SAMPLES - 1)
+        return f[i];
+    double a = t - i;
+    return f[i] * (1.0 - a) + f[i + 1] * a;
+}
+
+const NcSpectralWeights* NcCreateSpectralWeights(NcObserver observer, float firstWavelength,
+                                                 float spacing, int samples) {
+    const float* cmf[3];
+    if (samples < 2 || !(spacing > 0.f) || !isfinite(firstWavelength) || !isfinite(spacing) ||
+        !NcGetColorMatchingFunctions(observer, &cmf[0], &cmf[1], &cmf[2]))
+        return NULL;
+
+    NcSpectralWeights* w = (NcSpectralWeights*) calloc(1, sizeof(*w) + 3 * samples * sizeof(float));
+    if (!w)
+        return NULL;
+    w->samples = samples;
+    for (int c = 0; c < 3; c++)
+        w->w[c] = (float*) (w + 1) + c * samples;
+
+    // accumulate in double; the weights may sum hundreds of nm
+    double* acc = (double*) calloc(3 * (size_t) samples, sizeof(double));
+    if (!acc) {
+        free(w);
+        return NULL;
+    }
+    for (int j = 0; j + 1 < samples; j++) {
+        const double l0 = firstWavelength + (double) spacing * j;
+        const double l1 = firstWavelength + (double) spacing * (j + 1);
+        double a = fmax(l0, NC_CMF_FIRST_WAVELENGTH);
+        const double hi = fmin(l1, NC_CMF_LAST_WAVELENGTH);
+        while (a < hi) {
+            // to the next whole nm, where the matching functions bend
+            const double b = fmin(hi, floor(a) + 1.0);
+            const double at[3] = { a, 0.5 * (a + b), b };
+            const double simpson[3] = { (b - a) / 6.0, 4.0 * (b - a) / 6.0, (b - a) / 6.0 };
+            for (int k = 0; k < 3; k++) {
+                const double t = (at[k] - l0) / (l1 - l0);     // the hat of sample j + 1
+                for (int c = 0; c < 3; c++) {
+                    const double f = simpson[k] * _NcCMFAt(cmf[c], at[k]);
+                    acc[c * samples + j] += (1.0 - t) * f;
+                    acc[c * samples + j + 1] += t * f;
+                }
+            }
+            a = b;
+        }
+    }
+    for (int i = 0; i < 3 * samples; i++)
+        w->w[0][i] = (float) acc[i];
+    free(acc);
+    return w;
+}
+
+void NcFreeSpectralWeights(const NcSpectralWeights* w) {
+    free((void*) w);
+}
+
+//----------------------------------------------------------------------------
+// Dot products
+//----------------------------------------------------------------------------
+
+static NcXYZ _NcScalarDot(const NcSpectralWeights* w, const float* s) {
+    float x = 0.f, y = 0.f, z = 0.f;
+    for (int i = 0; i < w->samples; i++) {
+        x += s[i] * w->w[0][i];
+        y += s[i] * w->w[1][i];
+        z += s[i] * w->w[2][i];
+    }
+    return (NcXYZ) { x, y, z };
+}
+
+#ifdef NC_HAVE_SSE4
+NC_SSE4_TARGET static inline float _NcSum4(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+NC_SSE4_TARGET static NcXYZ _NcSSE4Dot(const NcSpectralWeights* w, const float* s) {
+    __m128 x = _mm_setzero_ps(), y = _mm_setzero_ps(), z = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= w->samples; i += 4) {
+        __m128 v = _mm_loadu_ps(s + i);
+        x = _mm_add_ps(x, _mm_mul_ps(v, _mm_loadu_ps(w->w[0] + i)));
+        y = _mm_add_ps(y, _mm_mul_ps(v, _mm_loadu_ps(w->w[1] + i)));
+        z = _mm_add_ps(z, _mm_mul_ps(v, _mm_loadu_ps(w->w[2] + i)));
+    }
+    NcXYZ r = { _NcSum4(x), _NcSum4(y), _NcSum4(z) };
+    for (; i < w->samples; i++) {
+        r.x += s[i] * w->w[0][i];
+        r.y += s[i] * w->w[1][i];
+        r.z += s[i] * w->w[2][i];
+    }
+    return r;
+}
+#endif
+
+#ifdef NC_HAVE_AVX2
+NC_AVX2_TARGET static inline float _NcSum8(__m256 v) {
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+    return _mm_cvtss_f32(h);
+}
+
+NC_AVX2_TARGET static NcXYZ _NcAVX2Dot(const NcSpectralWeights* w, const float* s) {
+    __m256 x = _mm256_setzero_ps(), y = _mm256_setzero_ps(), z = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= w->samples; i += 8) {
+        __m256 v = _mm256_loadu_ps(s + i);
+        x = _mm256_fmadd_ps(v, _mm256_loadu_ps(w->w[0] + i), x);
+        y = _mm256_fmadd_ps(v, _mm256_loadu_ps(w->w[1] + i), y);
+        z = _mm256_fmadd_ps(v, _mm256_loadu_ps(w->w[2] + i), z);
+    }
+    NcXYZ r = { _NcSum8(x), _NcSum8(y), _NcSum8(z) };
+    for (; i < w->samples; i++) {
+        r.x += s[i] * w->w[0][i];
+        r.y += s[i] * w->w[1][i];
+        r.z += s[i] * w->w[2][i];
+    }
+    return r;
+}
+#endif
+
+#ifdef NC_HAVE_NEON
+static NcXYZ _NcNeonDot(const NcSpectralWeights* w, const float* s) {
+    float32x4_t x = vdupq_n_f32(0.f), y = vdupq_n_f32(0.f), z = vdupq_n_f32(0.f);
+    int i = 0;
+    for (; i + 4 <= w->samples; i += 4) {
+        float32x4_t v = vld1q_f32(s + i);
+        x = vfmaq_f32(x, v, vld1q_f32(w->w[0] + i));
+        y = vfmaq_f32(y, v, vld1q_f32(w->w[1] + i));
+        z = vfmaq_f32(z, v, vld1q_f32(w->w[2] + i));
+    }
+    NcXYZ r = { vaddvq_f32(x), vaddvq_f32(y), vaddvq_f32(z) };
+    for (; i < w->samples; i++) {
+        r.x += s[i] * w->w[0][i];
+        r.y += s[i] * w->w[1][i];
+        r.z += s[i] * w->w[2][i];
+    }
+    return r;
+}
+#endif
+
+void NcSpectraToXYZ(const NcSpectralWeights* w, const float* spectra, size_t stride,
+                    NcXYZ* xyz, size_t count) {
+    if (!w || !spectra || !xyz)
+        return;
+
+    NcXYZ (*dot)(const NcSpectralWeights*, const float*) = _NcScalarDot;
+    switch (NcTransformColorsLevel()) {
+#ifdef NC_HAVE_SSE4
+        case _NcLevelSSE4: dot = _NcSSE4Dot; break;
+#endif
+#ifdef NC_HAVE_AVX2
+        case _NcLevelAVX2: dot = _NcAVX2Dot; break;
+#endif
+#ifdef NC_HAVE_NEON
+        case _NcLevelNEON: dot = _NcNeonDot; break;
+#endif
+        default: break;
+    }
+    for (size_t i = 0; i < count; i++)
+        xyz[i] = dot(w, spectra + i * stride);
+}
+
+NcXYZ NcSpectrumToXYZ(const NcSpectralWeights* w, const float* spectrum) {
+    NcXYZ xyz = { 0, 0, 0 };
+    NcSpectraToXYZ(w, spectrum, 0, &xyz, 1);
+    return xyz;
+}
+
+void NcBlackbodySpectrum(float temperature, float firstWavelength, float spacing,
+                         int samples, float* spectrum) {
+    if (!spectrum)
+        return;
+
+    // Planck's law, with the second radiation constant in nm K, relative
+    // to 560 nm as CIE illuminant A is. Temperatures too low for the
+    // emission at 560 nm to be a double give zero.
+    const double c2 = 1.4388e7;
+    const double T = temperature;
+    const double at560 = 1.0 / (pow(560.0, 5.0) * expm1(c2 / (560.0 * T)));
+    for (int i = 0; i < samples; i++) {
+        const double lambda = firstWavelength + (double) spacing * i;
+        spectrum[i] = at560 > 0.0 && lambda > 0.0
+            ? (float) (1.0 / (pow(lambda, 5.0) * expm1(c2 / (lambda * T))) / at560)
+            : 0.f;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Tests and benchmarks
+//----------------------------------------------------------------------------
+
+static const char* _spectralLevelNames[] = { "scalar", "SSE4.1", "AVX2", "NEON" };
+
+static double _NcSpectralSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static NcChromaticity _NcChromaticityOf(NcXYZ c) {
+    const float sum = c.x + c.y + c.z;
+    return (NcChromaticity) { c.x / sum, c.y / sum };
+}
+
+static bool _NcChromaticityNear(NcChromaticity a, NcChromaticity b, float tolerance) {
+    return fabsf(a.x - b.x) <= tolerance && fabsf(a.y - b.y) <= tolerance;
+}
+
+static bool _NcXYZNear(NcXYZ a, NcXYZ b, float tolerance) {
+    return fabsf(a.x - b.x) <= tolerance * fmaxf(1.f, fabsf(b.x)) &&
+           fabsf(a.y - b.y) <= tolerance * fmaxf(1.f, fabsf(b.y)) &&
+           fabsf(a.z - b.z) <= tolerance * fmaxf(1.f, fabsf(b.z));
+}
+
+/* The CIE 1964 10 degree observer by the multi-lobe fit of Wyman, Sloan
+   and Shirley, "Simple Analytic Approximations to the CIE XYZ Color
+   Matching Functions", Journal of Computer Graphics Techniques, 2013. */
+static double _NcSq(double x) {
+    return x * x;
+}
+
+static void _NcFit1964(double wave, double xyz[3]) {
+    xyz[0] = 0.398 * exp(-1250.0 * _NcSq(log((wave + 570.1) / 1014.0))) +
+             1.132 * exp(-234.0 * _NcSq(log((1338.0 - wave) / 743.5)));
+    xyz[1] = 1.011 * exp(-0.5 * _NcSq((wave - 556.1) / 46.14));
+    xyz[2] = 2.060 * exp(-32.0 * _NcSq(log((wave - 265.8) / 180.4)));
+}
+
+static uint32_t _NcSpectralRandom(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+int NcTestSpectral(void) {
+    int failures = 0;
+    NcInitColorSpaceLibrary();
+    const char* failed = NULL;
+
+    // the matching functions at any wavelength, against the 1931 lookup,
+    // and against analytic fits of both observers, which are good to a few
+    // percent of the peaks; the 1931 fit's chromaticity only holds from 420
+    // to 650 nm
+    uint32_t state = 25;
+    for (int i = 0; i < 10000 && !failed; i++) {
+        const float lambda = NC_CMF_FIRST_WAVELENGTH +
+                             (float) (_NcSpectralRandom(&state) % 470000) / 1000.f;
+        NcXYZ c[2];
+        NcWavelengthsToXYZ(NcObserverCIE1931, &lambda, &c[0], 1);
+        NcWavelengthsToXYZ(NcObserverCIE1964, &lambda, &c[1], 1);
+        const NcChromaticity lookup = _NcChromaticityOf(c[0]);
+        const NcXYZ table = NcCIE1931ColorFromWavelength(lambda, false);
+        const NcXYZ fit = NcCIE1931ColorFromWavelength(lambda, true);
+        double fit1964[3];
+        _NcFit1964(lambda, fit1964);
+        if (lookup.x != table.x || lookup.y != table.y)
+            failed = "the 1931 table differs from NcCIE1931ColorFromWavelength";
+        else if (lambda >= 420.f && lambda <= 650.f &&
+                 !_NcChromaticityNear(lookup, (NcChromaticity) { fit.x, fit.y }, 0.02f))
+            failed = "the 1931 table is far from its analytic fit";
+        else if (!_NcXYZNear(c[1], (NcXYZ) { (float) fit1964[0], (float) fit1964[1], (float) fit1964[2] }, 0.07f))
+            failed = "the 1964 table is far from its analytic fit";
+    }
+    const float outside[] = { 359.9f, 830.1f, NAN, -1.f };
+    NcXYZ none[4];
+    NcWavelengthsToXYZ(NcObserverCIE1931, outside, none, 4);
+    for (int i = 0; i < 4; i++)
+        if (none[i].x != 0.f || none[i].y != 0.f || none[i].z != 0.f)
+            failed = "a wavelength outside the table was not zero";
+    if (failed) {
+        printf("  spectral test failed: %s\n", failed);
+        failures++;
+    }
+
+    // known chromaticities of the equal energy spectrum and of CIE
+    // illuminant A, a blackbody at 2856K
+    static float spectrum[NC_CMF_SAMPLES];
+    struct {
+        NcObserver observer;
+        float temperature;          // or zero for equal energy
+        NcChromaticity expected;
+        float tolerance;
+        const char* name;
+    } known[] = {
+        { NcObserverCIE1931, 0.f, { 0.33333f, 0.33333f }, 1e-4f, "1931 equal energy" },
+        { NcObserverCIE1931, 2856.f, { 0.44757f, 0.40745f }, 1e-4f, "1931 illuminant A" },
+        { NcObserverCIE1964, 0.f, { 0.33333f, 0.33333f }, 1e-4f, "1964 equal energy" },
+        { NcObserverCIE1964, 2856.f, { 0.45117f, 0.40594f }, 1e-4f, "1964 illuminant A" },
+    };
+    for (size_t k = 0; k < sizeof(known) / sizeof(known[0]); k++) {
+        const NcSpectralWeights* w = NcCreateSpectralWeights(known[k].observer, NC_CMF_FIRST_WAVELENGTH,
+                                                             1.f, NC_CMF_SAMPLES);
+        if (known[k].temperature > 0.f)
+            NcBlackbodySpectrum(known[k].temperature, NC_CMF_FIRST_WAVELENGTH, 1.f, NC_CMF_SAMPLES, spectrum);
+        else
+            for (int i = 0; i < NC_CMF_SAMPLES; i++)
+                spectrum[i] = 1.f;
+        const NcChromaticity c = _NcChromaticityOf(NcSpectrumToXYZ(w, spectrum));
+        printf("  %-18s x %.5f y %.5f, expected %.5f %.5f\n", known[k].name, c.x, c.y,
+               known[k].expected.x, known[k].expected.y);
+        if (!_NcChromaticityNear(c, known[k].expected, known[k].tolerance)) {
+            printf("  spectral test failed: %s\n", known[k].name);
+            failures++;
+        }
+        NcFreeSpectralWeights(w);
+    }
+
+    // blackbodies against Krystek's fit of the Planckian locus, which
+    // NcKelvinToYxy evaluates
+    const NcSpectralWeights* w1nm = NcCreateSpectralWeights(NcObserverCIE1931, NC_CMF_FIRST_WAVELENGTH,
+                                                            1.f, NC_CMF_SAMPLES);
+    float worst = 0.f;
+    for (float T = 1000.f; T <= 15000.f; T += 250.f) {
+        NcBlackbodySpectrum(T, NC_CMF_FIRST_WAVELENGTH, 1.f, NC_CMF_SAMPLES, spectrum);
+        const NcChromaticity c = _NcChromaticityOf(NcSpectrumToXYZ(w1nm, spectrum));
+        const NcYxy k = NcKelvinToYxy(T, 1.f);
+        worst = fmaxf(worst, fmaxf(fabsf(c.x - k.x), fabsf(c.y - k.y)));
+    }
+    printf("  blackbodies from 1000 to 15000K are within %.5f of NcKelvinToYxy\n", worst);
+    if (worst > 5e-4f) {
+        printf("  spectral test failed: blackbodies are far from NcKelvinToYxy\n");
+        failures++;
+    }
+
+    // a sampling over the whole table, at any spacing and offset, gives
+    // the same integral for a spectrum that is linear, which interpolation
+    // reproduces exactly, and nearly the same for a blackbody
+    const float spacings[] = { 0.37f, 1.f, 5.f, 7.f, 10.f };
+    for (size_t si = 0; si < sizeof(spacings) / sizeof(spacings[0]); si++) {
+        const float first = 349.5f, spacing = spacings[si];
+        const int n = (int) ceilf((841.f - first) / spacing) + 1;
+        float* s = (float*) malloc(2 * n * sizeof(float));
+        const NcSpectralWeights* w = NcCreateSpectralWeights(NcObserverCIE1931, first, spacing, n);
+        if (!s || !w) {
+            free(s);
+            NcFreeSpectralWeights(w);
+            failures++;
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+            s[i] = 0.25f + (first + spacing * i) / 500.f;
+        NcBlackbodySpectrum(5000.f, first, spacing, n, s + n);
+        NcXYZ xyz[2];
+        NcSpectraToXYZ(w, s, n, xyz, 2);
+        for (int i = 0; i < NC_CMF_SAMPLES; i++)
+            spectrum[i] = 0.25f + (NC_CMF_FIRST_WAVELENGTH + i) / 500.f;
+        const NcXYZ linear = NcSpectrumToXYZ(w1nm, spectrum);
+        NcBlackbodySpectrum(5000.f, NC_CMF_FIRST_WAVELENGTH, 1.f, NC_CMF_SAMPLES, spectrum);
+        const NcXYZ planck = NcSpectrumToXYZ(w1nm, spectrum);
+        if (!_NcXYZNear(xyz[0], linear, 2e-5f) ||
+            !_NcChromaticityNear(_NcChromaticityOf(xyz[1]), _NcChromaticityOf(planck), 1e-4f)) {
+            printf("  spectral test failed: sampling at %.2f nm changes the integral\n", spacing);
+            failures++;
+        }
+        free(s);
+        NcFreeSpectralWeights(w);
+    }
+
+    // each level against scalar code, with tails and a stride
+    enum { kSpectra = 37, kStride = NC_CMF_SAMPLES + 3 };
+    static float spectra[kSpectra * kStride];
+    for (int i = 0; i < kSpectra * kStride; i++)
+        spectra[i] = (float) (_NcSpectralRandom(&state) & 0xffff) / 65535.f * 4.f - 1.f;
+    const int lengths[] = { 2, 3, 5, 8, 13, 81, NC_CMF_SAMPLES };
+    for (size_t li = 0; li < sizeof(lengths) / sizeof(lengths[0]); li++) {
+        const NcSpectralWeights* w = NcCreateSpectralWeights(NcObserverCIE1964, 400.f,
+                                                             300.f / (lengths[li] - 1), lengths[li]);
+        NcXYZ ref[kSpectra], out[kSpectra];
+        NcTransformColorsForceLevel(0);
+        NcSpectraToXYZ(w, spectra, kStride, ref, kSpectra);
+        for (int level = 1; level < 4; level++) {
+            NcTransformColorsForceLevel(level);
+            if (NcTransformColorsLevel() != level)
+                continue;
+            NcSpectraToXYZ(w, spectra, kStride, out, kSpectra);
+            for (int i = 0; i < kSpectra; i++)
+                if (!_NcXYZNear(out[i], ref[i], 1e-5f)) {
+                    printf("  spectral test failed: %s, %d samples, spectrum %d\n",
+                           _spectralLevelNames[level], lengths[li], i);
+                    failures++;
+                    break;
+                }
+        }
+        NcTransformColorsForceLevel(-1);
+        NcFreeSpectralWeights(w);
+    }
+
+    // batches of temperatures, at each level, against NcKelvinToYxy
+    enum { kTemperatures = 1000 };
+    static float temperatures[kTemperatures + 1];
+    static NcYxy Yxy[kTemperatures + 1];
+    for (int i = 0; i < kTemperatures; i++)
+        temperatures[i] = 500.f + 15000.f * i / kTemperatures;
+    temperatures[7] = NAN;
+    temperatures[8] = INFINITY;
+    temperatures[9] = 15000.f;
+    temperatures[10] = 1000.f;
+    for (int level = 0; level < 4; level++) {
+        NcTransformColorsForceLevel(level);
+        if (NcTransformColorsLevel() != level)
+            continue;
+        const int counts[] = { 1, 3, 4, 5, 7, 8, 9, 17, kTemperatures };
+        for (size_t ci = 0; ci < sizeof(counts) / sizeof(counts[0]); ci++) {
+            const int count = counts[ci];
+            Yxy[count] = (NcYxy) { -1.f, -1.f, -1.f };
+            NcKelvinToYxyColors(temperatures, 2.f, Yxy, count);
+            bool ok = Yxy[count].Y == -1.f;     // the guard past the end
+            for (int i = 0; i < count && ok; i++) {
+                const float t = temperatures[i];
+                const NcYxy k = t >= 1000.f && t <= 15000.f ? NcKelvinToYxy(t, 2.f) : (NcYxy) { 0, 0, 0 };
+                ok = Yxy[i].Y == k.Y && fabsf(Yxy[i].x - k.x) <= 1e-6f && fabsf(Yxy[i].y - k.y) <= 1e-6f;
+            }
+            if (!ok) {
+                printf("  spectral test failed: NcKelvinToYxyColors, %s, %d temperatures\n",
+                       _spectralLevelNames[level], count);
+                failures++;
+                break;
+            }
+        }
+    }
+    NcTransformColorsForceLevel(-1);
+
+    // invalid arguments
+    const NcSpectralWeights* invalid[] = {
+        NcCreateSpectralWeights(NcObserverCIE1931, 360.f, 1.f, 1),
+        NcCreateSpectralWeights(NcObserverCIE1931, 360.f, 0.f, 10),
+        NcCreateSpectralWeights(NcObserverCIE1931, 360.f, NAN, 10),
+        NcCreateSpectralWeights(NcObserverCIE1931, INFINITY, 1.f, 10),
+        NcCreateSpectralWeights((NcObserver) 2, 360.f, 1.f, 10),
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        if (invalid[i]) {
+            printf("  spectral test failed: invalid weights %zu were made\n", i);
+            NcFreeSpectralWeights(invalid[i]);
+            failures++;
+        }
+    NcFreeSpectralWeights(w1nm);
+
+    printf("NcTestSpectral: %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
+int NcBenchmarkSpectral(size_t count) {
+    // a bank of blackbody spectra at 1 nm, integrated over and over
+    enum { kBank = 1024 };
+    float* spectra = (float*) malloc((size_t) kBank * NC_CMF_SAMPLES * sizeof(float));
+    float* values = (float*) malloc(count * sizeof(float));
+    NcXYZ* xyz = (NcXYZ*) malloc((count > kBank ? count : kBank) * sizeof(NcXYZ));
+    NcYxy* Yxy = (NcYxy*) malloc(count * sizeof(NcYxy));
+    if (!spectra || !values || !xyz || !Yxy) {
+        free(spectra);
+        free(values);
+        free(xyz);
+        free(Yxy);
+        return 1;
+    }
+    NcInitColorSpaceLibrary();
+    for (int i = 0; i < kBank; i++)
+        NcBlackbodySpectrum(1000.f + 14000.f * i / kBank, NC_CMF_FIRST_WAVELENGTH, 1.f,
+                            NC_CMF_SAMPLES, spectra + (size_t) i * NC_CMF_SAMPLES);
+    const NcSpectralWeights* w = NcCreateSpectralWeights(NcObserverCIE1931, NC_CMF_FIRST_WAVELENGTH,
+                                                         1.f, NC_CMF_SAMPLES);
+    double t0 = _NcSpectralSeconds();
+    const NcSpectralWeights* w5 = NcCreateSpectralWeights(NcObserverCIE1931, 380.f, 5.f, 81);
+    const double make = _NcSpectralSeconds() - t0;
+    NcFreeSpectralWeights(w5);
+
+    printf("NcBenchmarkSpectral: %zu values, M/s\n", count);
+    printf("  weights for 81 samples at 5 nm made in %.3f ms\n", make * 1e3);
+
+    // the spectral locus
+    for (size_t i = 0; i < count; i++)
+        values[i] = 360.f + 470.f * (float) (i % 4096) / 4096.f;
+    double best[2] = { 1e30, 1e30 };
+    for (int rep = 0; rep < 3; rep++) {
+        t0 = _NcSpectralSeconds();
+        for (size_t i = 0; i < count; i++)
+            xyz[i] = NcCIE1931ColorFromWavelength(values[i], true);
+        best[0] = fmin(best[0], _NcSpectralSeconds() - t0);
+        t0 = _NcSpectralSeconds();
+        NcWavelengthsToXYZ(NcObserverCIE1931, values, xyz, count);
+        best[1] = fmin(best[1], _NcSpectralSeconds() - t0);
+    }
+    printf("  wavelengths: analytic fit %8.1f, table %8.1f\n",
+           count / best[0] * 1e-6, count / best[1] * 1e-6);
+
+    // spectra at 1 nm to XYZ
+    const size_t spectraCount = count / 100 + 1;
+    for (int level = 0; level < 4; level++) {
+        NcTransformColorsForceLevel(level);
+        if (NcTransformColorsLevel() != level)
+            continue;
+        double b = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            t0 = _NcSpectralSeconds();
+            for (size_t done = 0; done < spectraCount; done += kBank) {
+                const size_t n = spectraCount - done < kBank ? spectraCount - done : kBank;
+                NcSpectraToXYZ(w, spectra, NC_CMF_SAMPLES, xyz, n);
+            }
+            b = fmin(b, _NcSpectralSeconds() - t0);
+        }
+        printf("  %d nm spectra, %-7s %8.2f\n", NC_CMF_SAMPLES, _spectralLevelNames[level],
+               spectraCount / b * 1e-6);
+    }
+
+    // the Planckian locus
+    for (size_t i = 0; i < count; i++)
+        values[i] = 1000.f + 14000.f * (float) (i % 4096) / 4096.f;
+    best[0] = 1e30;
+    for (int rep = 0; rep < 3; rep++) {
+        t0 = _NcSpectralSeconds();
+        for (size_t i = 0; i < count; i++)
+            Yxy[i] = NcKelvinToYxy(values[i], 1.f);
+        best[0] = fmin(best[0], _NcSpectralSeconds() - t0);
+    }
+    printf("  temperatures, NcKelvinToYxy %8.1f\n", count / best[0] * 1e-6);
+    for (int level = 0; level < 4; level++) {
+        NcTransformColorsForceLevel(level);
+        if (NcTransformColorsLevel() != level)
+            continue;
+        double b = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            t0 = _NcSpectralSeconds();
+            NcKelvinToYxyColors(values, 1.f, Yxy, count);
+            b = fmin(b, _NcSpectralSeconds() - t0);
+        }
+        printf("  temperatures, %-14s %8.1f\n", _spectralLevelNames[level], count / b * 1e-6);
+    }
+    NcTransformColorsForceLevel(-1);
+
+    NcFreeSpectralWeights(w);
+    free(spectra);
+    free(values);
+    free(xyz);
+    free(Yxy);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef PXR_BASE_GF_NC_NANOCOLOR_SPECTRAL_H
+#define PXR_BASE_GF_NC_NANOCOLOR_SPECTRAL_H
+
+#include "nanocolor.h"
+
+/*
+ Color matching functions and spectra. The CIE 1931 2 degree and 1964 10
+ degree standard observers are tabulated at 1 nm from 360 to 830 nm.
+
+ A spectrum sampled at even spacing is integrated against an observer
+ through weights made once for its sampling, so that converting a
+ spectrum to XYZ is three dot products. The weights integrate the product
+ of the spectrum and the matching functions, both linearly interpolated
+ between their samples, exactly; the spectrum is zero outside its first
+ and last samples.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NcObserver                   NCCONCAT(NCNAMESPACE, Observer)
+#define NcSpectralWeights            NCCONCAT(NCNAMESPACE, SpectralWeights)
+
+typedef enum {
+    NcObserverCIE1931 = 0,      // 2 degree
+    NcObserverCIE1964 = 1,      // 10 degree
+} NcObserver;
+
+#define NC_CMF_FIRST_WAVELENGTH 360
+#define NC_CMF_LAST_WAVELENGTH  830
+#define NC_CMF_SAMPLES          471
+
+typedef struct NcSpectralWeights NcSpectralWeights;
+
+#define NcGetColorMatchingFunctions  NCCONCAT(NCNAMESPACE, GetColorMatchingFunctions)
+#define NcWavelengthsToXYZ           NCCONCAT(NCNAMESPACE, WavelengthsToXYZ)
+#define NcCreateSpectralWeights      NCCONCAT(NCNAMESPACE, CreateSpectralWeights)
+#define NcFreeSpectralWeights        NCCONCAT(NCNAMESPACE, FreeSpectralWeights)
+#define NcSpectrumToXYZ              NCCONCAT(NCNAMESPACE, SpectrumToXYZ)
+#define NcSpectraToXYZ               NCCONCAT(NCNAMESPACE, SpectraToXYZ)
+#define NcBlackbodySpectrum          NCCONCAT(NCNAMESPACE, BlackbodySpectrum)
+#define NcTestSpectral               NCCONCAT(NCNAMESPACE, TestSpectral)
+#define NcBenchmarkSpectral          NCCONCAT(NCNAMESPACE, BenchmarkSpectral)
+
+/**
+ * @brief Retrieves the color matching functions of an observer.
+ *
+ * The 1931 observer is the CIE's 1 nm tabulation. The 1964 observer is
+ * the CIE's 5 nm tabulation, interpolated to 1 nm by Sprague's method.
+ *
+ * @param observer The standard observer.
+ * @param x, y, z Set to arrays of NC_CMF_SAMPLES values, at 1 nm from
+ *                NC_CMF_FIRST_WAVELENGTH, owned by the library.
+ * @return false if the observer is unknown.
+ */
+NCAPI bool NcGetColorMatchingFunctions(NcObserver observer,
+                                       const float** x, const float** y, const float** z);
+
+/**
+ * @brief Computes the color matching functions at an array of wavelengths.
+ *
+ * @param observer The standard observer.
+ * @param wavelengths Pointer to the array of wavelengths in nm.
+ * @param xyz Pointer to the array to fill with the interpolated matching
+ *            functions; zero outside 360 to 830 nm.
+ * @param count Number of wavelengths in the array.
+ * @return void
+ */
+NCAPI void NcWavelengthsToXYZ(NcObserver observer, const float* wavelengths,
+                              NcXYZ* xyz, size_t count);
+
+/**
+ * @brief Makes the weights that integrate spectra with a sampling against
+ *        an observer.
+ *
+ * @param observer The standard observer.
+ * @param firstWavelength The wavelength of the first sample, in nm.
+ * @param spacing The nm between samples.
+ * @param samples Number of samples in each spectrum, at least two.
+ * @return The weights, to be freed with NcFreeSpectralWeights, or NULL if
+ *         an argument is invalid.
+ */
+NCAPI const NcSpectralWeights* NcCreateSpectralWeights(NcObserver observer, float firstWavelength,
+                                                       float spacing, int samples);
+
+/**
+ * @brief Frees weights made by NcCreateSpectralWeights.
+ *
+ * @param w Pointer to the weights, or NULL.
+ * @return void
+ */
+NCAPI void NcFreeSpectralWeights(const NcSpectralWeights* w);
+
+/**
+ * @brief Integrates a spectrum to XYZ.
+ *
+ * The result is not normalized; a spectrum of ones over the range of the
+ * matching functions gives a Y of about 106.9 for the 1931 observer.
+ *
+ * @param w Pointer to the weights of the spectrum's sampling.
+ * @param spectrum Pointer to the samples of the spectrum.
+ * @return The XYZ of the spectrum, or zero if an argument is NULL.
+ */
+NCAPI NcXYZ NcSpectrumToXYZ(const NcSpectralWeights* w, const float* spectrum);
+
+/**
+ * @brief Integrates an array of spectra to XYZ.
+ *
+ * The dot products run eight samples at a time with AVX2 and four with
+ * SSE4.1 or NEON, at the level NcTransformColorsLevel reports.
+ *
+ * @param w Pointer to the weights of the spectra's sampling.
+ * @param spectra Pointer to the first sample of the first spectrum.
+ * @param stride Number of floats from one spectrum to the next.
+ * @param xyz Pointer to the array to fill with the XYZ of each spectrum.
+ * @param count Number of spectra.
+ * @return void
+ */
+NCAPI void NcSpectraToXYZ(const NcSpectralWeights* w, const float* spectra, size_t stride,
+                          NcXYZ* xyz, size_t count);
+
+/**
+ * @brief Samples the emission of a blackbody by Planck's law.
+ *
+ * @param temperature The temperature in Kelvin.
+ * @param firstWavelength The wavelength of the first sample, in nm.
+ * @param spacing The nm between samples.
+ * @param samples Number of samples to fill.
+ * @param spectrum Pointer to the samples, relative to the emission at 560 nm.
+ * @return void
+ */
+NCAPI void NcBlackbodySpectrum(float temperature, float firstWavelength, float spacing,
+                               int samples, float* spectrum);
+
+/// \brief Checks the tables and batch functions against the analytic
+///        functions and each instruction set level against scalar code,
+///        and blackbodies and the equal energy spectrum against their
+///        known chromaticities.
+/// \return The number of failures.
+NCAPI int NcTestSpectral(void);
+
+/// \brief Reports the rate of the batch functions at each level against
+///        the analytic functions, over count spectra and temperatures.
+/// \return Zero, or one if the spectra could not be allocated.
+NCAPI int NcBenchmarkSpectral(size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PXR_BASE_GF_NC_NANOCOLOR_SPECTRAL_H */
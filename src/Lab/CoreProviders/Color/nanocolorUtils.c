@@ -24,6 +24,11 @@
 
 #include "nanocolorUtils.h"
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 // ISO 17321-1:2012 Table D.1
 // ap0 is the aces name for 2065-1
@@ -166,3 +171,344 @@ void checkInvertAndMultiply() {
     NcM33f sd = NcM33fMultiply(s, di);
 }
 #endif
+
+//----------------------------------------------------------------------------
+// tests
+//----------------------------------------------------------------------------
+
+// a deterministic generator, so that failures reproduce
+static uint32_t _NcTestRandom(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static float _NcTestValue(uint32_t* state) {
+    // edges of the linear segments, and values either side of them, with
+    // negatives, denormals and HDR values
+    static const float special[] = {
+        0.f, 1e-40f, 1e-30f, 1e-6f, 0.001f, 0.0031308f, 0.003131f, 0.018f,
+        0.04045f, 0.0405f, 0.081f, 0.1f, 0.18f, 0.5f, 0.9f, 1.f, 1.5f, 4.f,
+        16.f, 100.f, 1000.f, -1e-6f, -0.01f, -0.5f, -2.f
+    };
+    uint32_t r = _NcTestRandom(state);
+    switch (r % 4) {
+        case 0: return special[(r >> 2) % (sizeof(special) / sizeof(special[0]))];
+        case 1: return (float)((r >> 2) & 0xffff) / 65535.f;
+        case 2: return (float)((r >> 2) & 0xffff) / 65535.f * 2.2f - 0.1f;
+        default: return ldexpf((float)((r >> 2) & 0xfff) / 4096.f + 1.f, (int)((r >> 14) % 33) - 16);
+    }
+}
+
+// the largest error of a against the reference b, relative to the largest
+// component of b, or -1 if they differ in being NaN or infinite
+static double _NcTestError(NcRGB a, NcRGB b) {
+    const float av[3] = { a.r, a.g, a.b };
+    const float bv[3] = { b.r, b.g, b.b };
+    double scale = 0, err = 0;
+    for (int c = 0; c < 3; c++) {
+        if (isnan(bv[c]) != isnan(av[c]) || isinf(bv[c]) != isinf(av[c]))
+            return -1;
+        if (isinf(bv[c]) && av[c] != bv[c])
+            return -1;
+        if (isfinite(bv[c]))
+            scale = fmax(scale, fabs(bv[c]));
+    }
+    for (int c = 0; c < 3; c++)
+        if (isfinite(bv[c]))
+            err = fmax(err, fabs((double) av[c] - bv[c]));
+    return scale > 0 ? err / scale : err;
+}
+
+int NcTestTransformColors(void) {
+    // the sum of the power's error bound at 2^±20, the matrix's rounding,
+    // and the amplification of an input error by the steepest curve
+    const double tolerance = 2e-5;
+    static const char* levelNames[] = { "scalar", "SSE4.1", "AVX2", "NEON" };
+    enum { kPixels = 515 };
+    static NcRGB in[kPixels + 1], ref[kPixels], out[kPixels + 1];
+    static float rgba[(kPixels + 1) * 4];
+    int failures = 0;
+
+    NcInitColorSpaceLibrary();
+    const char** names = NcRegisteredColorSpaceNames();
+    for (int level = 0; level < 4; level++) {
+        NcTransformColorsForceLevel(level);
+        if (NcTransformColorsLevel() != level)
+            continue;
+        double worst = 0;
+        const char* worstSrc = "";
+        const char* worstDst = "";
+        int pairs = 0;
+        for (int s = 0; names[s]; s++)
+            for (int d = 0; names[d]; d++) {
+                const NcColorSpace* src = NcGetNamedColorSpace(names[s]);
+                const NcColorSpace* dst = NcGetNamedColorSpace(names[d]);
+                uint32_t state = (uint32_t)(s * 131 + d * 7 + 1);
+                for (int i = 0; i < kPixels; i++) {
+                    in[i] = (NcRGB) { _NcTestValue(&state), _NcTestValue(&state), _NcTestValue(&state) };
+                    ref[i] = NcTransformColor(dst, src, in[i]);
+                }
+                in[7].g = NAN;
+                in[11].b = INFINITY;
+                ref[7] = NcTransformColor(dst, src, in[7]);
+                ref[11] = NcTransformColor(dst, src, in[11]);
+                ++pairs;
+
+                // every count to three batches, for the tails, then all
+                for (size_t n = 1; n <= 25; n++) {
+                    const size_t count = n < 25 ? n : kPixels;
+                    memcpy(out, in, sizeof(in));
+                    out[count] = (NcRGB) { -7.f, -7.f, -7.f };
+                    for (size_t i = 0; i < count; i++) {
+                        rgba[i * 4 + 0] = in[i].r;
+                        rgba[i * 4 + 1] = in[i].g;
+                        rgba[i * 4 + 2] = in[i].b;
+                        rgba[i * 4 + 3] = (float) i - 3.5f;
+                    }
+                    rgba[count * 4] = -7.f;
+                    NcTransformColors(dst, src, out, count);
+                    NcTransformColorsWithAlpha(dst, src, rgba, count);
+
+                    bool ok = out[count].r == -7.f && rgba[count * 4] == -7.f;
+                    for (size_t i = 0; ok && i < count; i++) {
+                        NcRGB a = { rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2] };
+                        double e1 = _NcTestError(out[i], ref[i]);
+                        double e2 = _NcTestError(a, ref[i]);
+                        if (level == 0)
+                            ok = !memcmp(&out[i], &ref[i], sizeof(NcRGB)) || e1 == 0;
+                        ok = ok && e1 >= 0 && e2 >= 0 && e1 <= tolerance && e2 <= tolerance &&
+                             rgba[i * 4 + 3] == (float) i - 3.5f;
+                        if (e1 > worst) {
+                            worst = e1;
+                            worstSrc = names[s];
+                            worstDst = names[d];
+                        }
+                        if (!ok)
+                            printf("  NcTransformColors test failed: %s, %s to %s, %d of %d, "
+                                   "(%g %g %g) gave (%g %g %g), expected (%g %g %g)\n",
+                                   levelNames[level], names[s], names[d], (int) i, (int) count,
+                                   in[i].r, in[i].g, in[i].b, out[i].r, out[i].g, out[i].b,
+                                   ref[i].r, ref[i].g, ref[i].b);
+                    }
+                    if (!ok) {
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+        printf("  %-7s %d pairs, largest relative error %.2g, %s to %s\n",
+               levelNames[level], pairs, worst, worstSrc, worstDst);
+    }
+    NcTransformColorsForceLevel(-1);
+    printf("NcTransformColors: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+static double _NcTestSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int NcBenchmarkTransformColors(size_t count) {
+    static const char* levelNames[] = { "scalar", "SSE4.1", "AVX2", "NEON" };
+    static const char* pairs[][2] = {
+        { "sRGB", "lin_ap1" },          // decoding only
+        { "lin_rec709", "g22_ap1" },    // encoding only
+        { "srgb_displayp3", "sRGB" },   // both curves
+        { "lin_ap0", "lin_rec2020" },   // the matrix alone
+    };
+    float* rgba = (float*) malloc(count * 4 * sizeof(float));
+    NcRGB* rgb = (NcRGB*) malloc(count * sizeof(NcRGB));
+    if (!rgba || !rgb) {
+        free(rgba);
+        free(rgb);
+        return 1;
+    }
+
+    NcInitColorSpaceLibrary();
+    printf("NcBenchmarkTransformColors: %zu pixels, Mpixel/s, rgb and rgba\n", count);
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+        const NcColorSpace* src = NcGetNamedColorSpace(pairs[p][0]);
+        const NcColorSpace* dst = NcGetNamedColorSpace(pairs[p][1]);
+        printf("  %s to %s\n", pairs[p][0], pairs[p][1]);
+        for (int level = 0; level < 4; level++) {
+            NcTransformColorsForceLevel(level);
+            if (NcTransformColorsLevel() != level)
+                continue;
+            double best[2] = { 1e30, 1e30 };
+            for (int rep = 0; rep < 3; rep++) {
+                // image-like values; the test values include denormals,
+                // which are slow on some processors whatever the code
+                uint32_t state = 1;
+                for (size_t i = 0; i < count; i++) {
+                    rgb[i] = (NcRGB) { (float) (_NcTestRandom(&state) & 0xffff) / 52000.f,
+                                       (float) (_NcTestRandom(&state) & 0xffff) / 52000.f,
+                                       (float) (_NcTestRandom(&state) & 0xffff) / 52000.f };
+                    memcpy(&rgba[i * 4], &rgb[i], sizeof(NcRGB));
+                    rgba[i * 4 + 3] = 1.f;
+                }
+                double t0 = _NcTestSeconds();
+                NcTransformColors(dst, src, rgb, count);
+                double t1 = _NcTestSeconds();
+                NcTransformColorsWithAlpha(dst, src, rgba, count);
+                double t2 = _NcTestSeconds();
+                best[0] = fmin(best[0], t1 - t0);
+                best[1] = fmin(best[1], t2 - t1);
+            }
+            printf("    %-7s %8.1f %8.1f\n", levelNames[level],
+                   count / best[0] * 1e-6, count / best[1] * 1e-6);
+        }
+    }
+    NcTransformColorsForceLevel(-1);
+    free(rgba);
+    free(rgb);
+    return 0;
+}
+
+static bool _NcTestNear(NcRGB a, NcRGB b, float tolerance) {
+    return fabsf(a.r - b.r) <= tolerance && fabsf(a.g - b.g) <= tolerance &&
+           fabsf(a.b - b.b) <= tolerance;
+}
+
+static bool _NcTestSameMatrix(NcM33f a, NcM33f b) {
+    for (int i = 0; i < 9; i++)
+        if (fabsf(a.m[i] - b.m[i]) > 1e-6f)
+            return false;
+    return true;
+}
+
+int NcTestTransforms(void) {
+    int failures = 0;
+#define NC_CHECK(cond, ...) \
+    if (!(cond)) { printf("  NcTransform test failed: " __VA_ARGS__); printf("\n"); ++failures; }
+
+    NcInitColorSpaceLibrary();
+    const char** names = NcRegisteredColorSpaceNames();
+    for (int i = 0; names[i]; i++) {
+        const NcColorSpace* cs = NcGetNamedColorSpace(names[i]);
+        NcColorSpaceDescriptor found;
+        NC_CHECK(cs && NcGetColorSpaceDescriptor(cs, &found) && !strcmp(found.name, names[i]),
+                 "lookup of %s", names[i]);
+        NC_CHECK(cs == NcGetNamedColorSpace(names[i]), "lookup of %s is not stable", names[i]);
+    }
+    NC_CHECK(!NcGetNamedColorSpace("no_such_space"), "lookup of a missing name");
+    NC_CHECK(!NcGetNamedColorSpace(""), "lookup of an empty name");
+    NC_CHECK(!NcGetNamedColorSpace(NULL), "lookup of NULL");
+
+    for (int s = 0; names[s]; s++)
+        for (int d = 0; names[d]; d++) {
+            const NcColorSpace* src = NcGetNamedColorSpace(names[s]);
+            const NcColorSpace* dst = NcGetNamedColorSpace(names[d]);
+            const NcTransform* t = NcGetTransform(dst, src, false);
+            const NcTransform* ta = NcGetTransform(dst, src, true);
+            NC_CHECK(t && t == NcGetTransform(dst, src, false) && ta && ta != t,
+                     "memoized transforms %s to %s", names[s], names[d]);
+            if (!t || !ta)
+                continue;
+            NC_CHECK(_NcTestSameMatrix(NcGetTransformMatrix(t), NcGetRGBToRGBMatrix(src, dst)),
+                     "matrix %s to %s", names[s], names[d]);
+            NC_CHECK(_NcTestSameMatrix(NcGetTransformMatrix(ta),
+                                       NcGetRGBToRGBMatrixBradford(src, dst)),
+                     "adapted matrix %s to %s", names[s], names[d]);
+
+            uint32_t state = (uint32_t)(s * 17 + d + 1);
+            for (int i = 0; i < 64; i++) {
+                NcRGB in = { _NcTestValue(&state), _NcTestValue(&state), _NcTestValue(&state) };
+                NcRGB a = NcApplyTransform(t, in);
+                NcRGB b = NcTransformColor(dst, src, in);
+                NC_CHECK(!memcmp(&a, &b, sizeof(NcRGB)), "NcApplyTransform %s to %s",
+                         names[s], names[d]);
+            }
+        }
+
+    // transforms of spaces made by the caller are not memoized, and match
+    const NcColorSpace* rec709 = NcGetNamedColorSpace(Nc_lin_rec709);
+    const NcColorSpace* rec2020 = NcGetNamedColorSpace(Nc_lin_rec2020);
+    NcColorSpaceDescriptor desc;
+    NcGetColorSpaceDescriptor(rec709, &desc);
+    desc.name = "user_rec709";
+    const NcColorSpace* user = NcCreateColorSpace(&desc);
+    NC_CHECK(!NcGetTransform(rec2020, user, false), "a caller's space was memoized");
+    const NcTransform* created = NcCreateTransform(rec2020, user, false);
+    NcRGB red = { 1.f, 0.f, 0.f };
+    NcRGB fromUser = NcApplyTransform(created, red);
+    NcRGB fromLibrary = NcApplyTransform(NcGetTransform(rec2020, rec709, false), red);
+    NC_CHECK(created && !memcmp(&fromUser, &fromLibrary, sizeof(NcRGB)),
+             "a caller's space differs from the library's");
+    NcFreeTransform(created);
+    NcFreeTransform(NcGetTransform(rec2020, rec709, false));    // ignored
+    NcFreeColorSpace(user);
+
+    // Rec. 709 red in Rec. 2020, from the matrix of BT.2087
+    NcRGB red2020 = NcTransformColor(rec2020, rec709, red);
+    NC_CHECK(_NcTestNear(red2020, (NcRGB) { 0.6274f, 0.0691f, 0.0164f }, 2e-4f),
+             "Rec. 709 red is (%g %g %g) in Rec. 2020", red2020.r, red2020.g, red2020.b);
+
+    // adaptation maps white to white
+    const NcColorSpace* ap1 = NcGetNamedColorSpace(Nc_lin_ap1);
+    NcRGB white = NcApplyTransform(NcGetTransform(rec709, ap1, true), (NcRGB) { 1.f, 1.f, 1.f });
+    NC_CHECK(_NcTestNear(white, (NcRGB) { 1.f, 1.f, 1.f }, 1e-3f),
+             "AP1 white is (%g %g %g) in Rec. 709", white.r, white.g, white.b);
+
+    NC_CHECK(!NcCreateTransform(NULL, rec709, false), "a transform from NULL");
+    NcRGB same = NcApplyTransform(NULL, red);
+    NC_CHECK(!memcmp(&same, &red, sizeof(NcRGB)), "NULL transform changed the color");
+#undef NC_CHECK
+
+    printf("NcTransform: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int NcBenchmarkTransforms(size_t count) {
+    NcRGB* rgb = (NcRGB*) malloc(count * sizeof(NcRGB));
+    if (!rgb)
+        return 1;
+
+    uint32_t state = 1;
+    for (size_t i = 0; i < count; i++)
+        rgb[i] = (NcRGB) { (float) (_NcTestRandom(&state) & 0xffff) / 52000.f,
+                           (float) (_NcTestRandom(&state) & 0xffff) / 52000.f,
+                           (float) (_NcTestRandom(&state) & 0xffff) / 52000.f };
+
+    NcInitColorSpaceLibrary();
+    const char** names = NcRegisteredColorSpaceNames();
+    int nameCount = 0;
+    while (names[nameCount])
+        ++nameCount;
+
+    const NcColorSpace* src = NcGetNamedColorSpace(Nc_srgb_displayp3);
+    const NcColorSpace* dst = NcGetNamedColorSpace(Nc_sRGB);
+    double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+    volatile float sink = 0;
+    for (int rep = 0; rep < 3; rep++) {
+        double t0 = _NcTestSeconds();
+        for (size_t i = 0; i < count; i++)
+            sink += NcGetNamedColorSpace(names[i % nameCount]) != NULL;
+        double t1 = _NcTestSeconds();
+        for (size_t i = 0; i < count; i++)
+            sink += NcTransformColor(dst, src, rgb[i]).r;
+        double t2 = _NcTestSeconds();
+        for (size_t i = 0; i < count; i++) {
+            const NcTransform* t = NcCreateTransform(dst, src, false);
+            sink += NcApplyTransform(t, rgb[i]).r;
+            NcFreeTransform(t);
+        }
+        double t3 = _NcTestSeconds();
+        const NcTransform* t = NcGetTransform(dst, src, false);
+        for (size_t i = 0; i < count; i++)
+            sink += NcApplyTransform(t, rgb[i]).r;
+        double t4 = _NcTestSeconds();
+        best[0] = fmin(best[0], t1 - t0);
+        best[1] = fmin(best[1], t2 - t1);
+        best[2] = fmin(best[2], t3 - t2);
+        best[3] = fmin(best[3], t4 - t3);
+    }
+    printf("NcBenchmarkTransforms: %zu calls, ns per call\n", count);
+    printf("  NcGetNamedColorSpace            %8.1f\n", best[0] / count * 1e9);
+    printf("  NcTransformColor                %8.1f\n", best[1] / count * 1e9);
+    printf("  NcCreateTransform per color     %8.1f\n", best[2] / count * 1e9);
+    printf("  NcApplyTransform                %8.1f\n", best[3] / count * 1e9);
+    free(rgb);
+    return 0;
+}
@@ -12,6 +12,10 @@ extern "C" {
 #define NcISO17321ColorChipsNames    NCCONCAT(NCNAMESPACE, ISO17321ColorChipsNames)
 #define NcCheckerColorChipsSRGB      NCCONCAT(NCNAMESPACE, CheckerColorChipsSRGB)
 #define NcMcCamy1976ColorChipsYxy    NCCONCAT(NCNAMESPACE, McCamy1976ColorChipsYxy)
+#define NcTestTransformColors        NCCONCAT(NCNAMESPACE, TestTransformColors)
+#define NcBenchmarkTransformColors   NCCONCAT(NCNAMESPACE, BenchmarkTransformColors)
+#define NcTestTransforms             NCCONCAT(NCNAMESPACE, TestTransforms)
+#define NcBenchmarkTransforms        NCCONCAT(NCNAMESPACE, BenchmarkTransforms)
 
 /// \brief Returns the names of the 24 color chips in the ISO 17321 color charts.
 /// \return An array of const char pointers containing the names. A nullptr
@@ -33,6 +37,31 @@ NCAPI NcRGB* NcCheckerColorChipsSRGB(void);
 /// \return An array of NcXYZ containing the color values.
 NCAPI NcYxy* NcMcCamy1976ColorChipsYxy(void);
 
+/// \brief Checks NcTransformColors and NcTransformColorsWithAlpha against
+///        NcTransformColor for every pair of registered color spaces, at
+///        every instruction set level the processor supports, for every
+///        tail length, and that alpha and the pixels after the array are
+///        untouched.
+/// \return The number of failures.
+NCAPI int NcTestTransformColors(void);
+
+/// \brief Reports the Mpixel/s of NcTransformColors and
+///        NcTransformColorsWithAlpha over count pixels at each level.
+/// \return Zero, or one if the pixels could not be allocated.
+NCAPI int NcBenchmarkTransformColors(size_t count);
+
+/// \brief Checks name lookups, that the library's transforms are stable and
+///        match NcTransformColor, NcGetRGBToRGBMatrix and
+///        NcGetRGBToRGBMatrixBradford, and transforms of a caller's spaces.
+/// \return The number of failures.
+NCAPI int NcTestTransforms(void);
+
+/// \brief Reports the time per call of NcGetNamedColorSpace and
+///        NcTransformColor, and of transforming a color with a transform
+///        created for it and with one held, over count colors.
+/// \return Zero, or one if the colors could not be allocated.
+NCAPI int NcBenchmarkTransforms(size_t count);
+
 #ifdef __cplusplus
 }
 #endif
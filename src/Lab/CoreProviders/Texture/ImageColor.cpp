@@ -0,0 +1,552 @@
+
+// Each band of rows shares a float row; rows of float images are
+// transformed where they are. The transforms are per pixel, so the result
+// does not depend on the band size or thread count.
+
+#include "ImageColor.hpp"
+#include "PixelConvert.hpp"
+#include "TextureCache.hpp"
+#include "Lab/LabThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+// the divide and multiply by alpha use the baseline instruction sets
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define LAB_IC_HAVE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define LAB_IC_HAVE_NEON 1
+#endif
+
+namespace lab {
+
+namespace {
+
+using RowFn = std::function<void(float* row, int width, int channels)>;
+
+bool IsColorImage(const LabImageData_t& image) {
+    return image.data && image.width > 0 && image.height > 0 &&
+           (image.channelCount == 3 || image.channelCount == 4) &&
+           (image.pixelType == LAB_PIXEL_HALF || image.pixelType == LAB_PIXEL_FLOAT ||
+            image.pixelType == LAB_PIXEL_UINT8);
+}
+
+// color images of the same size; an image may only be converted in place
+// to its own pixel type
+bool Compatible(const LabImageData_t& src, const LabImageData_t& dst) {
+    return IsColorImage(src) && IsColorImage(dst) && src.width == dst.width &&
+           src.height == dst.height && src.channelCount == dst.channelCount &&
+           (src.data != dst.data || src.pixelType == dst.pixelType);
+}
+
+// calls fn on each row of src as float, and writes the rows to dst, in
+// bands on the pool if pooled. src and dst may be the same image.
+bool TransformRows(const LabImageData_t& src, LabImageData_t& dst, bool pooled, const RowFn& fn) {
+    if (!Compatible(src, dst))
+        return false;
+
+    const int width = src.width;
+    const int channels = src.channelCount;
+    const bool isFloat = dst.pixelType == LAB_PIXEL_FLOAT;
+    const size_t srcRowBytes = PixelComponentSize(src.pixelType) * channels * width;
+    const size_t dstRowBytes = PixelComponentSize(dst.pixelType) * channels * width;
+    const PixelConversion toFloat(src.pixelType, channels, LAB_PIXEL_FLOAT, channels);
+    const PixelConversion fromFloat(LAB_PIXEL_FLOAT, channels, dst.pixelType, channels);
+
+    // about 256KB of float rows per band
+    const size_t bandRows = std::max<size_t>(1, (size_t(1) << 18) / (size_t(width) * channels * sizeof(float)));
+    const size_t bands = (size_t(src.height) + bandRows - 1) / bandRows;
+    auto transform = [&](size_t b, size_t e) {
+        std::vector<float> converted(isFloat ? 0 : size_t(width) * channels);
+        for (size_t y = b * bandRows; y < std::min(size_t(src.height), e * bandRows); ++y) {
+            const uint8_t* in = src.data + y * srcRowBytes;
+            uint8_t* out = dst.data + y * dstRowBytes;
+            float* row = isFloat ? (float*) out : converted.data();
+            if (in != (const uint8_t*) row)
+                ConvertPixels(toFloat, in, 0, row, 0, width, 1);
+            fn(row, width, channels);
+            if (!isFloat)
+                ConvertPixels(fromFloat, row, 0, out, 0, width, 1);
+        }
+    };
+    if (pooled)
+        ThreadPool::Shared().ParallelFor(0, bands, 1, transform);
+    else
+        transform(0, bands);
+    return true;
+}
+
+bool TransformRows(LabImageData_t& image, bool pooled, const RowFn& fn) {
+    return TransformRows(image, image, pooled, fn);
+}
+
+RowFn LUTRows(const NcLUT* lut) {
+    return [lut](float* row, int width, int channels) {
+        if (channels == 4)
+            NcApplyLUTWithAlpha(lut, row, size_t(width));
+        else
+            NcApplyLUT(lut, (NcRGB*) row, size_t(width));
+    };
+}
+
+// the chain applied analytically, link by link, for comparison
+RowFn ChainRows(const NcTransform* const* chain, int count) {
+    return [chain, count](float* row, int width, int channels) {
+        for (int i = 0; i < count; ++i) {
+            if (channels == 4)
+                NcApplyTransformColorsWithAlpha(chain[i], row, size_t(width));
+            else
+                NcApplyTransformColors(chain[i], (NcRGB*) row, size_t(width));
+        }
+    };
+}
+
+// divides the colors of RGBA pixels by alpha, or multiplies them, one
+// pixel to a vector; colors with no alpha are left as they are
+template <bool divide>
+void ScaleByAlpha(float* begin, float* end) {
+#if defined(LAB_IC_HAVE_SSE2)
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 rgb = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    for (float* p = begin; p < end; p += 4) {
+        const __m128 v = _mm_loadu_ps(p);
+        const __m128 a = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 use = _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), rgb);
+        const __m128 s = _mm_or_ps(_mm_and_ps(use, a), _mm_andnot_ps(use, one));
+        _mm_storeu_ps(p, divide ? _mm_div_ps(v, s) : _mm_mul_ps(v, s));
+    }
+#elif defined(LAB_IC_HAVE_NEON)
+    const uint32x4_t rgb = { ~0u, ~0u, ~0u, 0u };
+    for (float* p = begin; p < end; p += 4) {
+        const float32x4_t v = vld1q_f32(p);
+        const float32x4_t a = vdupq_laneq_f32(v, 3);
+        const uint32x4_t use = vandq_u32(vcgtq_f32(a, vdupq_n_f32(0.f)), rgb);
+        const float32x4_t s = vbslq_f32(use, a, vdupq_n_f32(1.f));
+        vst1q_f32(p, divide ? vdivq_f32(v, s) : vmulq_f32(v, s));
+    }
+#else
+    for (float* p = begin; p < end; p += 4) {
+        const float s = p[3] > 0.f ? p[3] : 1.f;
+        for (int c = 0; c < 3; ++c)
+            p[c] = divide ? p[c] / s : p[c] * s;
+    }
+#endif
+}
+
+// t applied to each row. Premultiplied colors are divided by alpha around
+// a transfer curve, which is not linear in alpha.
+RowFn ConvertRows(const NcTransform* t, bool unpremultiply) {
+    return [t, unpremultiply](float* row, int width, int channels) {
+        if (channels == 3) {
+            NcApplyTransformColors(t, (NcRGB*) row, size_t(width));
+            return;
+        }
+        if (!unpremultiply) {
+            NcApplyTransformColorsWithAlpha(t, row, size_t(width));
+            return;
+        }
+        // a few KB at a time, so that the colors stay in cache between the
+        // divide, the transform and the multiply
+        const size_t chunk = 256;
+        for (size_t x = 0; x < size_t(width); x += chunk) {
+            float* begin = row + x * 4;
+            float* end = row + std::min(size_t(width), x + chunk) * 4;
+            ScaleByAlpha<true>(begin, end);
+            NcApplyTransformColorsWithAlpha(t, begin, size_t(end - begin) / 4);
+            ScaleByAlpha<false>(begin, end);
+        }
+    };
+}
+
+// the library's transform between built in color spaces, or one made for
+// the conversion otherwise
+struct ScopedTransform {
+    const NcTransform* t;
+    ScopedTransform(const NcColorSpace* dst, const NcColorSpace* src, bool adapt)
+        : t(NcGetTransform(dst, src, adapt)) {
+        if (!t)
+            t = NcCreateTransform(dst, src, adapt);
+    }
+    ~ScopedTransform() { NcFreeTransform(t); }
+};
+
+// an sRGB texture decoded, converted to ACEScg, and shown on a Display P3
+// display; three passes when applied analytically
+struct DisplayChain {
+    const NcTransform* links[3];
+    DisplayChain() {
+        NcInitColorSpaceLibrary();
+        const NcColorSpace* texture = NcGetNamedColorSpace(Nc_srgb_texture);
+        const NcColorSpace* ap1 = NcGetNamedColorSpace(Nc_lin_ap1);
+        const NcColorSpace* p3 = NcGetNamedColorSpace(Nc_lin_displayp3);
+        const NcColorSpace* display = NcGetNamedColorSpace(Nc_srgb_displayp3);
+        links[0] = NcGetTransform(ap1, texture, true);
+        links[1] = NcGetTransform(p3, ap1, true);
+        links[2] = NcGetTransform(display, p3, false);
+    }
+    NcLUT* Bake(int size) const {
+        NcLUTDescriptor desc = { NcLUTShaperLog2, -12.f, 0.f, size, 4096, false };
+        return NcCreateLUT(links, 3, &desc);
+    }
+};
+
+} // anon
+
+bool IsLinear(const NcColorSpace* cs) {
+    NcColorSpaceDescriptor desc;
+    if (NcGetColorSpaceDescriptor(cs, &desc))
+        return desc.gamma == 1.f;
+    NcColorSpaceM33Descriptor m33;
+    return NcGetColorSpaceM33Descriptor(cs, &m33) && m33.gamma == 1.f;
+}
+
+bool ApplyColorLUT(const NcLUT* lut, LabImageData_t& image) {
+    if (!lut)
+        return false;
+    return TransformRows(image, true, LUTRows(lut));
+}
+
+bool ConvertImageColorSpace(const LabImageData_t& src, const NcColorSpace* srcSpace,
+                            LabImageData_t& dst, const NcColorSpace* dstSpace,
+                            bool premultiplied, bool adapt) {
+    if (!srcSpace || !dstSpace)
+        return false;
+    if (NcColorSpaceEqual(srcSpace, dstSpace)) {
+        // nothing to transform; the pixels are only copied to dst's type
+        if (src.data == dst.data)
+            return Compatible(src, dst);
+        return TransformRows(src, dst, true, [](float*, int, int) {});
+    }
+    const bool unpremultiply = premultiplied && !(IsLinear(srcSpace) && IsLinear(dstSpace));
+    const ScopedTransform transform(dstSpace, srcSpace, adapt);
+    return transform.t && TransformRows(src, dst, true, ConvertRows(transform.t, unpremultiply));
+}
+
+bool ConvertImageColorSpace(LabImageData_t& image, const NcColorSpace* srcSpace,
+                            const NcColorSpace* dstSpace, bool premultiplied, bool adapt) {
+    return ConvertImageColorSpace(image, srcSpace, image, dstSpace, premultiplied, adapt);
+}
+
+//-----------------------------------------------------------------------------
+// tests
+//-----------------------------------------------------------------------------
+
+int TestImageColor() {
+    int failures = 0;
+    auto check = [&failures](bool ok, const char* what, const char* detail) {
+        if (!ok) {
+            printf("  ImageColor test failed: %s, %s\n", what, detail);
+            ++failures;
+        }
+    };
+    static const char* typeNames[] = { "uint", "half", "float", "uint8" };
+    const DisplayChain chain;
+    NcLUT* lut = chain.Bake(33);
+    if (!lut) {
+        printf("  ImageColor test failed: could not bake the LUT\n");
+        return 1;
+    }
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    for (int channels = 1; channels <= 4; ++channels)
+        for (int t = 0; t < Lab_PIXEL_LAST_TYPE; ++t) {
+            const LabPixelType_t type = (LabPixelType_t) t;
+            // enough rows for several bands, and an odd width for the tails
+            const int width = 1001, height = 301;
+            auto img = TextureCache::AllocateImage(width, height, channels, type);
+            for (size_t i = 0; i < img->dataSize; ++i)
+                img->data[i] = uint8_t(rng());
+            if (type == LAB_PIXEL_HALF || type == LAB_PIXEL_FLOAT) {
+                std::vector<float> px(size_t(width) * height * channels);
+                for (auto& v : px)
+                    v = unit(rng);
+                ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, channels, type, channels),
+                              px.data(), 0, img->data, 0, width, height);
+            }
+            std::vector<uint8_t> before(img->data, img->data + img->dataSize);
+
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%s, %d channels", typeNames[t], channels);
+            const bool color = ApplyColorLUT(lut, *img);
+            if (channels < 3 || type == LAB_PIXEL_UINT) {
+                check(!color && !memcmp(before.data(), img->data, img->dataSize),
+                      "a data or gray image was changed", detail);
+                continue;
+            }
+            check(color, "a color image was refused", detail);
+
+            // the whole image as one row
+            std::vector<float> ref(size_t(width) * height * channels);
+            ConvertPixels(PixelConversion(type, channels, LAB_PIXEL_FLOAT, channels),
+                          before.data(), 0, ref.data(), 0, width, height);
+            std::vector<float> alpha;
+            for (size_t i = 3; channels == 4 && i < ref.size(); i += 4)
+                alpha.push_back(ref[i]);
+            LUTRows(lut)(ref.data(), width * height, channels);
+            std::vector<uint8_t> expected(img->dataSize);
+            ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, channels, type, channels),
+                          ref.data(), 0, expected.data(), 0, width, height);
+            check(!memcmp(expected.data(), img->data, img->dataSize),
+                  "the bands differ from the whole image", detail);
+
+            if (channels == 4) {
+                std::vector<float> after(ref.size());
+                ConvertPixels(PixelConversion(type, channels, LAB_PIXEL_FLOAT, channels),
+                              img->data, 0, after.data(), 0, width, height);
+                bool kept = true;
+                for (size_t i = 3, j = 0; i < after.size(); i += 4, ++j)
+                    kept = kept && after[i] == alpha[j];
+                check(kept, "alpha was changed", detail);
+            }
+        }
+
+    LabImageData_t empty = {};
+    check(!ApplyColorLUT(lut, empty), "an empty image was accepted", "");
+    NcFreeLUT(lut);
+
+    // conversions, against each pixel transformed on its own, and encoded
+    // to the destination's type
+    struct Pair {
+        const char* src;
+        const char* dst;
+        bool adapt;
+    } pairs[] = {
+        { Nc_srgb_texture, Nc_lin_ap1, true },
+        { Nc_lin_ap0, Nc_lin_rec709, false },
+        { Nc_g22_rec709, Nc_srgb_displayp3, false },
+    };
+    struct Types {
+        LabPixelType_t src, dst;
+    } types[] = {
+        { LAB_PIXEL_HALF, LAB_PIXEL_HALF },
+        { LAB_PIXEL_FLOAT, LAB_PIXEL_FLOAT },
+        { LAB_PIXEL_UINT8, LAB_PIXEL_UINT8 },
+        { LAB_PIXEL_UINT8, LAB_PIXEL_HALF },
+        { LAB_PIXEL_HALF, LAB_PIXEL_FLOAT },
+        { LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8 },
+    };
+    const int width = 257, height = 67;
+    std::uniform_real_distribution<float> hdr(0.f, 1.5f);
+    auto randomImage = [&](int channels, LabPixelType_t type) {
+        auto img = TextureCache::AllocateImage(width, height, channels, type);
+        std::vector<float> px(size_t(width) * height * channels);
+        for (size_t i = 0; i < px.size(); ++i) {
+            const bool alpha = channels == 4 && i % 4 == 3;
+            // some pixels with no alpha
+            px[i] = alpha ? (i / 4 % 17 ? unit(rng) : 0.f) : hdr(rng);
+        }
+        ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, channels, type, channels),
+                      px.data(), 0, img->data, 0, width, height);
+        return img;
+    };
+    auto decode = [](const LabImageData_t& img) {
+        std::vector<float> px(size_t(img.width) * img.height * img.channelCount);
+        ConvertPixels(PixelConversion(img.pixelType, img.channelCount, LAB_PIXEL_FLOAT, img.channelCount),
+                      img.data, 0, px.data(), 0, img.width, img.height);
+        return px;
+    };
+
+    for (const Pair& pair : pairs)
+        for (int channels = 3; channels <= 4; ++channels)
+            for (int premultiplied = 0; premultiplied <= (channels == 4); ++premultiplied)
+                for (const Types& type : types) {
+                    const NcColorSpace* srcSpace = NcGetNamedColorSpace(pair.src);
+                    const NcColorSpace* dstSpace = NcGetNamedColorSpace(pair.dst);
+                    auto src = randomImage(channels, type.src);
+                    const bool inPlace = type.src == type.dst;
+                    auto dst = inPlace ? src : TextureCache::AllocateImage(width, height, channels, type.dst);
+                    std::vector<float> ref = decode(*src);
+
+                    char detail[128];
+                    snprintf(detail, sizeof(detail), "%s to %s, %s to %s, %d channels%s",
+                             pair.src, pair.dst, typeNames[type.src], typeNames[type.dst],
+                             channels, premultiplied ? ", premultiplied" : "");
+                    check(ConvertImageColorSpace(*src, srcSpace, *dst, dstSpace, premultiplied != 0, pair.adapt),
+                          "a conversion was refused", detail);
+
+                    const NcTransform* t = NcGetTransform(dstSpace, srcSpace, pair.adapt);
+                    for (float* p = ref.data(); p < ref.data() + ref.size(); p += channels) {
+                        const float a = channels == 4 ? p[3] : 1.f;
+                        const float s = premultiplied && a > 0.f ? a : 1.f;
+                        NcRGB c = NcApplyTransform(t, { p[0] / s, p[1] / s, p[2] / s });
+                        p[0] = c.r * s;
+                        p[1] = c.g * s;
+                        p[2] = c.b * s;
+                    }
+                    std::vector<uint8_t> encoded(dst->dataSize);
+                    ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, channels, type.dst, channels),
+                                  ref.data(), 0, encoded.data(), 0, width, height);
+                    LabImageData_t expected = *dst;
+                    expected.data = encoded.data();
+                    ref = decode(expected);
+
+                    // a rounding apart in the destination's type, or equal, as
+                    // when a color over a small alpha overflows a half
+                    const std::vector<float> result = decode(*dst);
+                    const float tolerance = type.dst == LAB_PIXEL_FLOAT ? 1e-5f :
+                                            type.dst == LAB_PIXEL_HALF ? 2e-3f : 1.01f / 255.f;
+                    bool close = true, kept = true;
+                    for (size_t i = 0; i < ref.size(); ++i) {
+                        if (channels == 4 && i % 4 == 3)
+                            kept = kept && result[i] == ref[i];
+                        else
+                            close = close && (result[i] == ref[i] ||
+                                              fabsf(result[i] - ref[i]) <= tolerance * std::max(1.f, fabsf(ref[i])));
+                    }
+                    check(close, "a converted image differs from its pixels converted alone", detail);
+                    check(kept, "alpha was changed by a conversion", detail);
+                }
+
+    const NcColorSpace* texture = NcGetNamedColorSpace(Nc_srgb_texture);
+    const NcColorSpace* linear = NcGetNamedColorSpace(Nc_lin_rec709);
+
+    // known values of the sRGB curve, on its power and linear segments,
+    // decoded and encoded again
+    const float known[][2] = { { 0.5f, 0.214041f }, { 0.02f, 0.02f / 12.92f }, { 1.f, 1.f } };
+    auto grays = TextureCache::AllocateImage(3, 1, 3, LAB_PIXEL_FLOAT);
+    float* gray3 = reinterpret_cast<float*>(grays->data);
+    for (int i = 0; i < 9; ++i)
+        gray3[i] = known[i / 3][0];
+    bool decoded = ConvertImageColorSpace(*grays, texture, linear, false);
+    for (int i = 0; i < 9; ++i)
+        decoded = decoded && fabsf(gray3[i] - known[i / 3][1]) <= 1e-5f;
+    check(decoded, "sRGB did not decode to its known linear values", "");
+    bool encoded = ConvertImageColorSpace(*grays, linear, texture, false);
+    for (int i = 0; i < 9; ++i)
+        encoded = encoded && fabsf(gray3[i] - known[i / 3][0]) <= 1e-5f;
+    check(encoded, "linear values did not encode to their known sRGB values", "");
+
+    // what may not be converted is left alone
+    auto rgba = randomImage(4, LAB_PIXEL_HALF);
+    const std::vector<uint8_t> before(rgba->data, rgba->data + rgba->dataSize);
+    auto unchanged = [&]() { return !memcmp(before.data(), rgba->data, rgba->dataSize); };
+    check(!ConvertImageColorSpace(*rgba, nullptr, linear, false) && unchanged(),
+          "a null color space was accepted", "");
+    LabImageData_t retyped = *rgba;
+    retyped.pixelType = LAB_PIXEL_FLOAT;
+    check(!ConvertImageColorSpace(*rgba, texture, retyped, linear, false) && unchanged(),
+          "an image was converted in place to another type", "");
+    auto small = TextureCache::AllocateImage(width - 1, height, 4, LAB_PIXEL_HALF);
+    check(!ConvertImageColorSpace(*rgba, texture, *small, linear, false),
+          "images of different sizes were accepted", "");
+    auto gray = TextureCache::AllocateImage(width, height, 1, LAB_PIXEL_HALF);
+    check(!ConvertImageColorSpace(*gray, texture, linear, false), "a gray image was converted", "");
+    auto ids = TextureCache::AllocateImage(width, height, 4, LAB_PIXEL_UINT);
+    check(!ConvertImageColorSpace(*ids, texture, linear, false), "a uint image was converted", "");
+    check(ConvertImageColorSpace(*rgba, texture, texture, true) && unchanged(),
+          "a conversion to the same color space changed the image", "");
+    auto copy = TextureCache::AllocateImage(width, height, 4, LAB_PIXEL_FLOAT);
+    check(ConvertImageColorSpace(*rgba, texture, *copy, texture, true) && decode(*copy) == decode(*rgba),
+          "a conversion to the same color space was not a copy", "");
+    printf("TestImageColor: %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
+int BenchmarkImageColor(int width, int height) {
+    using clock = std::chrono::steady_clock;
+    const DisplayChain chain;
+    NcLUT* luts[2] = { chain.Bake(33), chain.Bake(65) };
+    auto img = TextureCache::AllocateImage(width, height, 4, LAB_PIXEL_FLOAT);
+    if (!img || !luts[0] || !luts[1]) {
+        printf("Could not allocate a %dx%d float RGBA image and its LUTs\n", width, height);
+        NcFreeLUT(luts[0]);
+        NcFreeLUT(luts[1]);
+        return 1;
+    }
+    // gradients with a little noise; uniformly random colors would miss
+    // the cache on every lookup, as plates rarely do
+    std::mt19937 rng(24);
+    std::uniform_real_distribution<float> noise(0.f, 0.02f);
+    std::vector<float> px(size_t(width) * height * 4);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            float* p = &px[(size_t(y) * width + x) * 4];
+            const float u = float(x) / width, v = float(y) / height;
+            p[0] = u * u * 0.98f + noise(rng);
+            p[1] = v * v * 0.98f + noise(rng);
+            p[2] = 0.25f * (u + 1.f - v) * (u + 1.f - v) * 0.98f + noise(rng);
+            p[3] = 1.f;
+        }
+
+    printf("BenchmarkImageColor: %dx%d RGBA, sRGB texture to Display P3 display, %d pool threads, ms\n",
+           width, height, ThreadPool::Shared().Size());
+    for (LabPixelType_t type : { LAB_PIXEL_FLOAT, LAB_PIXEL_HALF }) {
+        auto image = type == LAB_PIXEL_FLOAT ? img : TextureCache::AllocateImage(width, height, 4, type);
+        printf("  %s\n", type == LAB_PIXEL_FLOAT ? "float" : "half");
+        struct Run {
+            const char* name;
+            RowFn fn;
+        } runs[] = {
+            { "analytic", ChainRows(chain.links, 3) },
+            { "LUT 33", LUTRows(luts[0]) },
+            { "LUT 65", LUTRows(luts[1]) },
+        };
+        for (const Run& run : runs) {
+            double best[2] = { 1e30, 1e30 };
+            for (int pooled = 0; pooled < 2; ++pooled)
+                for (int rep = 0; rep < 3; ++rep) {
+                    ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, 4, type, 4),
+                                  px.data(), 0, image->data, 0, width, height);
+                    auto t0 = clock::now();
+                    TransformRows(*image, pooled != 0, run.fn);
+                    best[pooled] = std::min(best[pooled],
+                        std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+                }
+            printf("    %-9s %8.1f single %8.1f pool\n", run.name, best[0], best[1]);
+        }
+    }
+
+    // a conversion at each instruction set level
+    const NcColorSpace* texture = NcGetNamedColorSpace(Nc_srgb_texture);
+    const NcTransform* toACEScg = NcGetTransform(NcGetNamedColorSpace(Nc_lin_ap1), texture, true);
+    static const char* levelNames[] = { "scalar", "SSE4.1", "AVX2", "NEON" };
+    std::vector<int> levels = { 0 };
+    for (int level = NcTransformColorsLevel() == 3 ? 3 : 1; level <= NcTransformColorsLevel(); ++level)
+        levels.push_back(level);
+    struct Conversion {
+        const char* name;
+        LabPixelType_t src, dst;
+        bool premultiplied;
+    } conversions[] = {
+        { "float", LAB_PIXEL_FLOAT, LAB_PIXEL_FLOAT, false },
+        { "float premult", LAB_PIXEL_FLOAT, LAB_PIXEL_FLOAT, true },
+        { "half", LAB_PIXEL_HALF, LAB_PIXEL_HALF, false },
+        { "uint8", LAB_PIXEL_UINT8, LAB_PIXEL_UINT8, false },
+        { "uint8 to half", LAB_PIXEL_UINT8, LAB_PIXEL_HALF, false },
+    };
+    printf("  sRGB texture to ACEScg\n");
+    for (const Conversion& conversion : conversions) {
+        auto src = conversion.src == LAB_PIXEL_FLOAT ? img : TextureCache::AllocateImage(width, height, 4, conversion.src);
+        auto dst = conversion.src == conversion.dst ? src : TextureCache::AllocateImage(width, height, 4, conversion.dst);
+        const RowFn fn = ConvertRows(toACEScg, conversion.premultiplied);
+        for (int level : levels) {
+            NcTransformColorsForceLevel(level);
+            double best[2] = { 1e30, 1e30 };
+            for (int pooled = 0; pooled < 2; ++pooled)
+                for (int rep = 0; rep < 3; ++rep) {
+                    ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, 4, conversion.src, 4),
+                                  px.data(), 0, src->data, 0, width, height);
+                    auto t0 = clock::now();
+                    TransformRows(*src, *dst, pooled != 0, fn);
+                    best[pooled] = std::min(best[pooled],
+                        std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+                }
+            printf("    %-14s %-7s %8.1f single %8.1f pool\n", conversion.name, levelNames[level], best[0], best[1]);
+        }
+        NcTransformColorsForceLevel(-1);
+    }
+    NcFreeLUT(luts[0]);
+    NcFreeLUT(luts[1]);
+    return 0;
+}
+
+} // lab
@@ -0,0 +1,56 @@
+#ifndef Providers_Texture_ImageColor_hpp
+#define Providers_Texture_ImageColor_hpp
+
+#include "ImageData.h"
+#include "Lab/CoreProviders/Color/nanocolorLUT.h"
+
+/*
+ Color operations on whole images. The color channels of RGB and RGBA
+ images, in half, float and uint8, are converted to float a row at a time,
+ transformed with nanocolor's batch calls, and converted back, in bands of
+ rows on the shared thread pool. Float rows are transformed in place.
+ Alpha is never changed. Gray images, and uint images, which hold data
+ such as ids, are not color and are left alone.
+ */
+
+namespace lab {
+
+// applies lut to image in place. Returns false, leaving image unchanged,
+// if image is empty or is not a color image.
+bool ApplyColorLUT(const NcLUT* lut, LabImageData_t& image);
+
+// true if cs has no transfer curve, so that its values are linear
+bool IsLinear(const NcColorSpace* cs);
+
+// converts the colors of src from srcSpace to dstSpace, into dst, which
+// must have the same size and channel count, and may have another pixel
+// type, so that an 8 bit texture may be decoded into half floats. dst may
+// be src if the pixel types match. Premultiplied RGBA colors are divided by
+// alpha around the transfer curves; adapt adds a Bradford adaptation
+// between the white points. Returns false, leaving dst unchanged, if a
+// color space is null or the images are not compatible color images.
+bool ConvertImageColorSpace(const LabImageData_t& src, const NcColorSpace* srcSpace,
+                            LabImageData_t& dst, const NcColorSpace* dstSpace,
+                            bool premultiplied, bool adapt = false);
+
+// converts image in place from srcSpace to dstSpace
+bool ConvertImageColorSpace(LabImageData_t& image, const NcColorSpace* srcSpace,
+                            const NcColorSpace* dstSpace, bool premultiplied,
+                            bool adapt = false);
+
+// checks that each pixel type and channel count gives the result of
+// applying the LUT to the whole image at once, and conversions the result
+// of transforming each pixel, with straight and premultiplied alpha and
+// between pixel types, that alpha is kept, and that other images are left
+// alone.
+int TestImageColor();
+
+// reports the time to apply a chain analytically and through 33 and 65
+// point LUTs to a float and a half RGBA image, and to convert images of
+// each pixel type between color spaces at each SIMD level, single
+// threaded and on the pool
+int BenchmarkImageColor(int width, int height);
+
+} // lab
+
+#endif // Providers_Texture_ImageColor_hpp
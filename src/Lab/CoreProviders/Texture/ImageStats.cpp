@@ -0,0 +1,490 @@
+
+// Each band of rows is converted to float a row at a time and scanned into
+// its own partial result; the partials are merged in band order, so that
+// the first locations found are the first in scan order.
+
+#include "ImageStats.hpp"
+#include "PixelConvert.hpp"
+#include "TextureCache.hpp"
+#include "Lab/LabThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define LAB_STATS_HAVE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define LAB_STATS_HAVE_NEON 1
+#endif
+
+namespace lab {
+
+namespace {
+
+std::atomic<bool> forceScalar{false};
+
+constexpr float kInf = std::numeric_limits<float>::infinity();
+constexpr int kBinsPerStop = ImageStats::kHistogramBins /
+                             int(ImageStats::kHistogramMaxLog2 - ImageStats::kHistogramMinLog2);
+
+// the bin within a stop of the top mantissa bits, so that a bin is the
+// exponent and a lookup rather than a log
+struct StopBins {
+    uint8_t bin[1024];
+    StopBins() {
+        for (int i = 0; i < 1024; ++i)
+            bin[i] = (uint8_t) std::min(kBinsPerStop - 1,
+                                        int(kBinsPerStop * std::log2(1.0 + (i + 0.5) / 1024.0)));
+    }
+};
+const StopBins stopBins;
+
+struct Partial {
+    float min[4], max[4];
+    double sum[4] = {};
+    uint64_t nan[4] = {}, inf[4] = {}, negative[4] = {};
+    std::vector<ImageStats::Location> nanLocations, infLocations, negativeLocations;
+    uint64_t histogram[ImageStats::kHistogramBins] = {};
+    uint64_t below = 0, above = 0;
+
+    Partial() {
+        std::fill(min, min + 4, kInf);
+        std::fill(max, max + 4, -kInf);
+    }
+
+    void Record(std::vector<ImageStats::Location>& where, int x, int y, int c) {
+        if (where.size() < ImageStats::kMaxLocations)
+            where.push_back({ x, y, c });
+    }
+
+    // classifies one component the slow way
+    void Special(float v, int x, int y, int c) {
+        if (std::isnan(v)) {
+            ++nan[c];
+            Record(nanLocations, x, y, c);
+        }
+        else if (std::isinf(v)) {
+            ++inf[c];
+            Record(infLocations, x, y, c);
+        }
+        else {
+            if (v < 0) {
+                ++negative[c];
+                Record(negativeLocations, x, y, c);
+            }
+            min[c] = std::min(min[c], v);
+            max[c] = std::max(max[c], v);
+            sum[c] += v;
+        }
+    }
+};
+
+void ScanScalar(Partial& p, const float* row, int width, int channels, int y) {
+    float rowSum[4] = {};
+    for (int x = 0; x < width; ++x)
+        for (int c = 0; c < channels; ++c) {
+            float v = row[x * channels + c];
+            if (std::isfinite(v) && v >= 0) {
+                p.min[c] = std::min(p.min[c], v);
+                p.max[c] = std::max(p.max[c], v);
+                rowSum[c] += v;
+            }
+            else
+                p.Special(v, x, y, c);
+        }
+    for (int c = 0; c < channels; ++c)
+        p.sum[c] += rowSum[c];
+}
+
+#if defined(LAB_STATS_HAVE_SSE2) || defined(LAB_STATS_HAVE_NEON)
+// lane i of a vector holds channel i % channels, for one, two or four
+// channels. Components that are not finite, or are negative, take the
+// slow path, and are left out of the vector range and sum.
+void ScanSIMD(Partial& p, const float* row, int width, int channels, int y) {
+    const size_t n = size_t(width) * channels;
+    size_t i = 0;
+#if defined(LAB_STATS_HAVE_SSE2)
+    const __m128 inf = _mm_set1_ps(kInf);
+    const __m128 ninf = _mm_set1_ps(-kInf);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 vmin = inf, vmax = ninf, vsum = zero;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(row + i);
+        // false for NaN, infinities and negatives
+        __m128 ok = _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, inf));
+        int bad = _mm_movemask_ps(ok) ^ 0xf;
+        vmin = _mm_min_ps(vmin, _mm_or_ps(_mm_and_ps(ok, v), _mm_andnot_ps(ok, inf)));
+        vmax = _mm_max_ps(vmax, _mm_or_ps(_mm_and_ps(ok, v), _mm_andnot_ps(ok, ninf)));
+        vsum = _mm_add_ps(vsum, _mm_and_ps(ok, v));
+        while (bad) {
+            int lane = std::countr_zero(unsigned(bad));
+            bad &= bad - 1;
+            size_t at = i + lane;
+            p.Special(row[at], int(at / channels), y, int(at % channels));
+        }
+    }
+    float mins[4], maxs[4], sums[4];
+    _mm_storeu_ps(mins, vmin);
+    _mm_storeu_ps(maxs, vmax);
+    _mm_storeu_ps(sums, vsum);
+#else
+    const float32x4_t inf = vdupq_n_f32(kInf);
+    const float32x4_t ninf = vdupq_n_f32(-kInf);
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    float32x4_t vmin = inf, vmax = ninf, vsum = zero;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(row + i);
+        uint32x4_t ok = vandq_u32(vcgeq_f32(v, zero), vcltq_f32(v, inf));
+        vmin = vminq_f32(vmin, vbslq_f32(ok, v, inf));
+        vmax = vmaxq_f32(vmax, vbslq_f32(ok, v, ninf));
+        vsum = vaddq_f32(vsum, vreinterpretq_f32_u32(vandq_u32(ok, vreinterpretq_u32_f32(v))));
+        if (vminvq_u32(ok) == 0) {
+            uint32_t lanes[4];
+            vst1q_u32(lanes, ok);
+            for (int lane = 0; lane < 4; ++lane)
+                if (!lanes[lane]) {
+                    size_t at = i + lane;
+                    p.Special(row[at], int(at / channels), y, int(at % channels));
+                }
+        }
+    }
+    float mins[4], maxs[4], sums[4];
+    vst1q_f32(mins, vmin);
+    vst1q_f32(maxs, vmax);
+    vst1q_f32(sums, vsum);
+#endif
+    for (int lane = 0; lane < 4; ++lane) {
+        int c = lane % channels;
+        p.min[c] = std::min(p.min[c], mins[lane]);
+        p.max[c] = std::max(p.max[c], maxs[lane]);
+        p.sum[c] += sums[lane];
+    }
+    // the tail of the row
+    for (; i < n; ++i) {
+        float v = row[i];
+        int c = int(i % channels);
+        if (std::isfinite(v) && v >= 0) {
+            p.min[c] = std::min(p.min[c], v);
+            p.max[c] = std::max(p.max[c], v);
+            p.sum[c] += v;
+        }
+        else
+            p.Special(v, int(i / channels), y, c);
+    }
+}
+#endif
+
+void Histogram(Partial& p, const float* row, int width, int channels) {
+    constexpr uint32_t kLowBits = uint32_t(127 + ImageStats::kHistogramMinLog2) << 23;
+    constexpr uint32_t kHighBits = uint32_t(127 + ImageStats::kHistogramMaxLog2) << 23;
+    for (int x = 0; x < width; ++x) {
+        const float* px = row + x * channels;
+        float lum = channels >= 3 ? 0.2126f * px[0] + 0.7152f * px[1] + 0.0722f * px[2] : px[0];
+        if (!std::isfinite(lum))
+            continue;
+        uint32_t bits = std::bit_cast<uint32_t>(lum);
+        if (lum <= 0 || bits < kLowBits)
+            ++p.below;
+        else if (bits >= kHighBits)
+            ++p.above;
+        else
+            ++p.histogram[((bits - kLowBits) >> 23) * kBinsPerStop + stopBins.bin[(bits >> 13) & 1023]];
+    }
+}
+
+bool Scan(const LabImageData_t& image, ImageStats& stats, bool pooled) {
+    if (!image.data || image.width < 1 || image.height < 1 ||
+        image.channelCount < 1 || image.channelCount > 4 ||
+        image.pixelType < LAB_PIXEL_UINT || image.pixelType >= Lab_PIXEL_LAST_TYPE)
+        return false;
+    auto start = std::chrono::steady_clock::now();
+    const int width = image.width;
+    const int channels = image.channelCount;
+    const bool isFloat = image.pixelType == LAB_PIXEL_FLOAT;
+    const size_t rowBytes = PixelComponentSize(image.pixelType) * channels * width;
+    const PixelConversion toFloat(image.pixelType, channels, LAB_PIXEL_FLOAT, channels);
+#if defined(LAB_STATS_HAVE_SSE2) || defined(LAB_STATS_HAVE_NEON)
+    const bool simd = channels != 3 && !forceScalar.load(std::memory_order_relaxed);
+#endif
+
+    // about 256KB of float rows per band
+    const size_t bandRows = std::max<size_t>(1, (size_t(1) << 18) / (size_t(width) * channels * sizeof(float)));
+    const size_t bands = (size_t(image.height) + bandRows - 1) / bandRows;
+    std::vector<Partial> partials(bands);
+    auto scan = [&](size_t b, size_t e) {
+        std::vector<float> converted(isFloat ? 0 : size_t(width) * channels);
+        for (size_t band = b; band < e; ++band) {
+            Partial& p = partials[band];
+            size_t y1 = std::min(size_t(image.height), (band + 1) * bandRows);
+            for (size_t y = band * bandRows; y < y1; ++y) {
+                const uint8_t* src = image.data + y * rowBytes;
+                const float* row = (const float*) src;
+                if (!isFloat) {
+                    ConvertPixels(toFloat, src, 0, converted.data(), 0, width, 1);
+                    row = converted.data();
+                }
+#if defined(LAB_STATS_HAVE_SSE2) || defined(LAB_STATS_HAVE_NEON)
+                if (simd)
+                    ScanSIMD(p, row, width, channels, int(y));
+                else
+#endif
+                    ScanScalar(p, row, width, channels, int(y));
+                Histogram(p, row, width, channels);
+            }
+        }
+    };
+    if (pooled)
+        ThreadPool::Shared().ParallelFor(0, bands, 1, scan);
+    else
+        scan(0, bands);
+
+    stats = ImageStats();
+    stats.channels = channels;
+    stats.pixels = uint64_t(width) * image.height;
+    Partial total;
+    auto append = [](std::vector<ImageStats::Location>& to, const std::vector<ImageStats::Location>& from) {
+        for (size_t i = 0; i < from.size() && to.size() < ImageStats::kMaxLocations; ++i)
+            to.push_back(from[i]);
+    };
+    for (const Partial& p : partials) {
+        for (int c = 0; c < channels; ++c) {
+            total.min[c] = std::min(total.min[c], p.min[c]);
+            total.max[c] = std::max(total.max[c], p.max[c]);
+            total.sum[c] += p.sum[c];
+            stats.nan[c] += p.nan[c];
+            stats.inf[c] += p.inf[c];
+            stats.negative[c] += p.negative[c];
+        }
+        append(stats.nanLocations, p.nanLocations);
+        append(stats.infLocations, p.infLocations);
+        append(stats.negativeLocations, p.negativeLocations);
+        for (int i = 0; i < ImageStats::kHistogramBins; ++i)
+            stats.histogram[i] += p.histogram[i];
+        stats.below += p.below;
+        stats.above += p.above;
+    }
+    for (int c = 0; c < channels; ++c) {
+        uint64_t finite = stats.pixels - stats.nan[c] - stats.inf[c];
+        stats.min[c] = total.min[c];
+        stats.max[c] = total.max[c];
+        stats.mean[c] = finite ? total.sum[c] / double(finite) : 0.0;
+    }
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+} // anon
+
+bool ComputeImageStats(const LabImageData_t& image, ImageStats& stats) {
+    return Scan(image, stats, true);
+}
+
+void ImageStatsForceScalar(bool scalar) {
+    forceScalar = scalar;
+}
+
+//-----------------------------------------------------------------------------
+// tests
+//-----------------------------------------------------------------------------
+
+int TestImageStats() {
+    int failures = 0;
+    auto check = [&failures](bool ok, const char* what, const char* detail) {
+        if (!ok) {
+            printf("  ImageStats test failed: %s, %s\n", what, detail);
+            ++failures;
+        }
+    };
+    static const char* typeNames[] = { "uint", "half", "float", "uint8" };
+    std::mt19937 rng(20);
+
+    for (int channels = 1; channels <= 4; ++channels)
+        for (int t = 0; t < Lab_PIXEL_LAST_TYPE; ++t) {
+            const LabPixelType_t type = (LabPixelType_t) t;
+            const bool hasSpecials = type == LAB_PIXEL_HALF || type == LAB_PIXEL_FLOAT;
+            // odd widths leave a tail after the vectors
+            const int width = 67, height = 41;
+            std::vector<float> px(size_t(width) * height * channels);
+            std::uniform_int_distribution<int> value(1, 200);
+            for (auto& v : px)
+                v = type == LAB_PIXEL_UINT8 ? value(rng) / 255.f : value(rng) / 8.f;
+            px[0] = type == LAB_PIXEL_UINT8 ? 0.f : 0.125f;
+
+            // specials, at known places, in the types that hold them
+            struct Seeded { int x, y, c; float v; };
+            std::vector<Seeded> seeded;
+            if (hasSpecials) {
+                seeded = { { 5, 0, 0, NAN }, { 66, 3, channels - 1, NAN },
+                           { 2, 7, 0, INFINITY }, { 9, 7, channels - 1, -INFINITY },
+                           { 1, 1, 0, -2.f }, { 30, 40, channels - 1, -0.5f } };
+                for (auto& s : seeded)
+                    px[(size_t(s.y) * width + s.x) * channels + s.c] = s.v;
+            }
+            auto img = TextureCache::AllocateImage(width, height, channels, type);
+            if (type == LAB_PIXEL_UINT)
+                for (size_t i = 0; i < px.size(); ++i)
+                    ((uint32_t*) img->data)[i] = uint32_t(px[i]);
+            else
+                ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, channels, type, channels),
+                              px.data(), 0, img->data, 0, width, height);
+            // the reference reads the components back, as the scan does
+            std::vector<float> read(px.size());
+            if (type == LAB_PIXEL_UINT)
+                for (size_t i = 0; i < px.size(); ++i)
+                    read[i] = float(((uint32_t*) img->data)[i]);
+            else
+                ConvertPixels(PixelConversion(type, channels, LAB_PIXEL_FLOAT, channels),
+                              img->data, 0, read.data(), 0, width, height);
+
+            ImageStats scalar, simd;
+            ImageStatsForceScalar(true);
+            ComputeImageStats(*img, scalar);
+            ImageStatsForceScalar(false);
+            ComputeImageStats(*img, simd);
+
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%s, %d channels", typeNames[t], channels);
+            for (const ImageStats* s : { &scalar, &simd }) {
+                bool ok = s->channels == channels && s->pixels == uint64_t(width) * height;
+                for (int c = 0; ok && c < channels; ++c) {
+                    float mn = kInf, mx = -kInf;
+                    double sum = 0;
+                    uint64_t nan = 0, inf = 0, neg = 0;
+                    for (size_t i = c; i < read.size(); i += channels) {
+                        float v = read[i];
+                        if (std::isnan(v))
+                            ++nan;
+                        else if (std::isinf(v))
+                            ++inf;
+                        else {
+                            neg += v < 0;
+                            mn = std::min(mn, v);
+                            mx = std::max(mx, v);
+                            sum += v;
+                        }
+                    }
+                    double mean = sum / double(s->pixels - nan - inf);
+                    ok = s->min[c] == mn && s->max[c] == mx && s->nan[c] == nan &&
+                         s->inf[c] == inf && s->negative[c] == neg &&
+                         fabs(s->mean[c] - mean) <= 1e-5 * std::max(1.0, fabs(mean));
+                }
+                check(ok, "channel statistics", detail);
+                if (hasSpecials) {
+                    auto at = [](const std::vector<ImageStats::Location>& v, size_t i, int x, int y, int c) {
+                        return i < v.size() && v[i].x == x && v[i].y == y && v[i].channel == c;
+                    };
+                    check(s->nanLocations.size() == 2 && at(s->nanLocations, 0, 5, 0, 0) &&
+                          at(s->nanLocations, 1, 66, 3, channels - 1) &&
+                          s->infLocations.size() == 2 && at(s->infLocations, 0, 2, 7, 0) &&
+                          at(s->infLocations, 1, 9, 7, channels - 1) &&
+                          s->negativeLocations.size() == 2 && at(s->negativeLocations, 0, 1, 1, 0) &&
+                          at(s->negativeLocations, 1, 30, 40, channels - 1),
+                          "locations in scan order", detail);
+                }
+
+                // luminance bins against log2
+                uint64_t bins[ImageStats::kHistogramBins] = {};
+                uint64_t below = 0, above = 0;
+                for (int i = 0; i < width * height; ++i) {
+                    const float* p = &read[size_t(i) * channels];
+                    float lum = channels >= 3 ? 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2] : p[0];
+                    if (!std::isfinite(lum))
+                        continue;
+                    double l2 = lum > 0 ? std::log2(double(lum)) : -1e30;
+                    if (l2 < ImageStats::kHistogramMinLog2)
+                        ++below;
+                    else if (l2 >= ImageStats::kHistogramMaxLog2)
+                        ++above;
+                    else
+                        ++bins[int((l2 - ImageStats::kHistogramMinLog2) * kBinsPerStop)];
+                }
+                // a value within the mantissa lookup's resolution of a bin
+                // edge may land in the neighbouring bin
+                uint64_t moved = 0;
+                for (int i = 0; i < ImageStats::kHistogramBins; ++i)
+                    moved += bins[i] > s->histogram[i] ? bins[i] - s->histogram[i] : 0;
+                check(s->below == below && s->above == above && moved <= uint64_t(width * height) / 200,
+                      "luminance histogram", detail);
+            }
+            check(!memcmp(scalar.histogram, simd.histogram, sizeof(scalar.histogram)),
+                  "SIMD and scalar histograms", detail);
+        }
+
+    // a single band and many bands give the same result
+    {
+        auto img = TextureCache::AllocateImage(1000, 300, 4, LAB_PIXEL_FLOAT);
+        std::uniform_real_distribution<float> unit(-0.1f, 4.f);
+        for (size_t i = 0; i < img->dataSize / sizeof(float); ++i)
+            ((float*) img->data)[i] = unit(rng);
+        ImageStats pooled, single;
+        ComputeImageStats(*img, pooled);
+        Scan(*img, single, false);
+        bool ok = !memcmp(pooled.min, single.min, sizeof(pooled.min)) &&
+                  !memcmp(pooled.max, single.max, sizeof(pooled.max)) &&
+                  !memcmp(pooled.negative, single.negative, sizeof(pooled.negative)) &&
+                  !memcmp(pooled.histogram, single.histogram, sizeof(pooled.histogram)) &&
+                  pooled.negativeLocations.size() == ImageStats::kMaxLocations &&
+                  pooled.negativeLocations.back().x == single.negativeLocations.back().x &&
+                  pooled.negativeLocations.back().y == single.negativeLocations.back().y;
+        check(ok, "pooled and single threaded scans", "float RGBA");
+    }
+
+    printf("ImageStats: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int BenchmarkImageStats(int width, int height) {
+    using clock = std::chrono::steady_clock;
+    auto img = TextureCache::AllocateImage(width, height, 4, LAB_PIXEL_FLOAT);
+    if (!img) {
+        printf("Could not allocate a %dx%d float RGBA image\n", width, height);
+        return 1;
+    }
+    std::mt19937 rng(8);
+    std::uniform_real_distribution<float> unit(0.f, 8.f);
+    float* px = (float*) img->data;
+    for (size_t i = 0; i < img->dataSize / sizeof(float); ++i)
+        px[i] = unit(rng);
+    // a plate with a few bad pixels
+    for (int i = 0; i < 100; ++i)
+        px[size_t(rng()) % (img->dataSize / sizeof(float))] = (i & 1) ? NAN : -1.f;
+
+    printf("BenchmarkImageStats: %dx%d float RGBA, %.0f MB, %d pool threads\n",
+           width, height, img->dataSize / 1e6, ThreadPool::Shared().Size());
+    const char* names[] = { "scalar", "SIMD", "SIMD pool" };
+    int failures = 0;
+    ImageStats first;
+    for (int run = 0; run < 3; ++run) {
+        ImageStatsForceScalar(run == 0);
+        ImageStats s;
+        double best = 1e30;
+        for (int rep = 0; rep < 3; ++rep) {
+            auto t0 = clock::now();
+            Scan(*img, s, run == 2);
+            best = std::min(best, std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+        }
+        if (run == 0)
+            first = s;
+        else if (memcmp(first.histogram, s.histogram, sizeof(s.histogram)) ||
+                 memcmp(first.nan, s.nan, sizeof(s.nan)) || memcmp(first.negative, s.negative, sizeof(s.negative)))
+            ++failures;
+        printf("  %-10s %9.1f ms, %6.2f GB/s\n", names[run], best, img->dataSize / (best * 1e6));
+    }
+    ImageStatsForceScalar(false);
+    if (failures)
+        printf("  FAILED: the scans differ\n");
+    return failures;
+}
+
+} // lab
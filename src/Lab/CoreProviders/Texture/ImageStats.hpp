@@ -0,0 +1,76 @@
+#ifndef Providers_Texture_ImageStats_hpp
+#define Providers_Texture_ImageStats_hpp
+
+#include "ImageData.h"
+#include <cstdint>
+#include <vector>
+
+/*
+ Whole image statistics, for checking HDR plates: the range and mean of
+ each channel, the NaN, infinite and negative values with the first of
+ their locations, and a histogram of log2 luminance.
+
+ Components are read as PixelConvert reads them, so uint8 is normalized
+ and uint is by value. Rows are scanned in bands on the shared pool; the
+ range, mean and classification of each band use SSE2 or NEON for one,
+ two and four channel images. Results do not depend on the band size or
+ thread count, except for the rounding of the means.
+ */
+
+namespace lab {
+
+struct ImageStats {
+    // eight bins per stop, from 2^-16 to 2^16
+    static constexpr int   kHistogramBins = 256;
+    static constexpr float kHistogramMinLog2 = -16.f;
+    static constexpr float kHistogramMaxLog2 = 16.f;
+    static constexpr size_t kMaxLocations = 64;
+
+    struct Location {
+        int x, y, channel;
+    };
+
+    int channels = 0;
+    uint64_t pixels = 0;
+
+    // over the finite values of each channel; min > max if there are none
+    float min[4] = {};
+    float max[4] = {};
+    double mean[4] = {};
+    uint64_t nan[4] = {};
+    uint64_t inf[4] = {};
+    uint64_t negative[4] = {};     // finite and below zero
+
+    // the first of each, in scan order
+    std::vector<Location> nanLocations;
+    std::vector<Location> infLocations;
+    std::vector<Location> negativeLocations;
+
+    // Rec. 709 luminance of RGB, or the first channel of gray. Luminance
+    // below the histogram, including zero and negative luminance, is
+    // counted in below, and above it in above. Pixels whose luminance is
+    // not finite are not counted.
+    uint64_t histogram[kHistogramBins] = {};
+    uint64_t below = 0;
+    uint64_t above = 0;
+
+    double ms = 0;      // the time taken to compute these
+};
+
+// scans every pixel of image. Returns false if the image is empty.
+bool ComputeImageStats(const LabImageData_t& image, ImageStats& stats);
+
+// scans with scalar code only, for tests and benchmarks
+void ImageStatsForceScalar(bool scalar);
+
+// checks counts, ranges, means, locations and bins on images seeded with
+// special values, in every pixel type, with SIMD and scalar scans.
+int TestImageStats();
+
+// reports the time to scan a float RGBA image, scalar and SIMD, single
+// threaded and on the pool
+int BenchmarkImageStats(int width, int height);
+
+} // lab
+
+#endif // Providers_Texture_ImageStats_hpp
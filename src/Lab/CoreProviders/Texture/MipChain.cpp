@@ -0,0 +1,537 @@
+
+// Separable resampling. Each output pixel of a pass is a weighted sum of a
+// run of adjacent input pixels, whose weights are normalized, with the
+// edges clamped. A band of output rows filters the input rows it needs
+// horizontally into scratch, and then combines them vertically, so that a
+// level is never held filtered in one direction only.
+
+#include "MipChain.hpp"
+#include "PixelConvert.hpp"
+#include "TextureCache.hpp"
+#include "Lab/LabThreadPool.hpp"
+
+#ifdef HAVE_OPENEXR
+#include "openexr-c.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define LAB_MIP_HAVE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define LAB_MIP_HAVE_NEON 1
+#endif
+
+namespace lab {
+
+namespace {
+
+std::atomic<bool> forceScalar{false};
+
+constexpr double kPi = 3.14159265358979323846;
+
+// in output pixels; a little under half, so that a 2x reduction keeps
+// detail near its new Nyquist limit while suppressing what lies above it
+constexpr double kGaussianSigma = 0.45;
+constexpr double kLanczosLobes = 3;
+
+// the taps of one pass; output i reads count[i] inputs from first[i]
+struct Taps {
+    int width = 0;                  // the most taps of any output
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<float> weights;     // width per output
+};
+
+double Sinc(double x) {
+    if (fabs(x) < 1e-9)
+        return 1;
+    x *= kPi;
+    return sin(x) / x;
+}
+
+// the filter's radius in output pixels
+double FilterRadius(MipFilter filter) {
+    switch (filter) {
+        case MipFilter::Box:      return 0.5;
+        case MipFilter::Gaussian: return 3 * kGaussianSigma;
+        case MipFilter::Lanczos:  return kLanczosLobes;
+    }
+    return 0.5;
+}
+
+// input pixel j covers [j, j+1), and output pixel i is centered on
+// (i + 0.5) * scale. When enlarging, the filter keeps its width in input
+// pixels, so that it interpolates rather than blurs.
+Taps MakeTaps(int srcSize, int dstSize, MipFilter filter) {
+    const double scale = double(srcSize) / dstSize;
+    const double stretch = std::max(scale, 1.0);
+    const double radius = FilterRadius(filter) * stretch;
+
+    Taps t;
+    t.width = std::min(srcSize, int(ceil(2 * radius)) + 2);
+    t.first.resize(dstSize);
+    t.count.resize(dstSize);
+    t.weights.assign(size_t(dstSize) * t.width, 0.f);
+    std::vector<double> w(t.width);
+    for (int i = 0; i < dstSize; ++i) {
+        double center = (i + 0.5) * scale;
+        int lo = int(floor(center - radius));
+        int hi = int(ceil(center + radius));
+        int first = std::clamp(lo, 0, srcSize - 1);
+        int last = std::clamp(hi - 1, 0, srcSize - 1);
+        std::fill(w.begin(), w.end(), 0.0);
+        for (int j = lo; j < hi; ++j) {
+            double weight;
+            if (filter == MipFilter::Box)
+                weight = std::max(0.0, std::min(j + 1.0, center + radius) -
+                                       std::max(double(j), center - radius));
+            else {
+                double x = (j + 0.5 - center) / stretch;
+                if (filter == MipFilter::Gaussian)
+                    weight = exp(-x * x / (2 * kGaussianSigma * kGaussianSigma));
+                else
+                    weight = fabs(x) < kLanczosLobes ? Sinc(x) * Sinc(x / kLanczosLobes) : 0;
+            }
+            // the edges are clamped, so taps beyond them land on the edge
+            w[std::clamp(j, 0, srcSize - 1) - first] += weight;
+        }
+
+        // trim the taps that contribute nothing
+        int a = 0, b = last - first;
+        while (a < b && w[a] == 0)
+            ++a;
+        while (b > a && w[b] == 0)
+            --b;
+        double sum = 0;
+        for (int k = a; k <= b; ++k)
+            sum += w[k];
+        t.first[i] = first + a;
+        t.count[i] = b - a + 1;
+        for (int k = a; k <= b; ++k)
+            t.weights[size_t(i) * t.width + k - a] = float(sum != 0 ? w[k] / sum : 1.0 / t.count[i]);
+    }
+    return t;
+}
+
+// filters one row of float pixels horizontally
+void FilterRow(const Taps& t, const float* in, float* out, int width, int channels, bool simd) {
+#if defined(LAB_MIP_HAVE_SSE2) || defined(LAB_MIP_HAVE_NEON)
+    if (simd && channels == 4) {
+        for (int i = 0; i < width; ++i) {
+            const float* w = &t.weights[size_t(i) * t.width];
+            const float* s = in + size_t(t.first[i]) * 4;
+#if defined(LAB_MIP_HAVE_SSE2)
+            __m128 acc = _mm_mul_ps(_mm_set1_ps(w[0]), _mm_loadu_ps(s));
+            for (int k = 1; k < t.count[i]; ++k)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + 4 * k)));
+            _mm_storeu_ps(out + 4 * size_t(i), acc);
+#else
+            float32x4_t acc = vmulq_n_f32(vld1q_f32(s), w[0]);
+            for (int k = 1; k < t.count[i]; ++k)
+                acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(s + 4 * k), w[k]));
+            vst1q_f32(out + 4 * size_t(i), acc);
+#endif
+        }
+        return;
+    }
+#endif
+    for (int i = 0; i < width; ++i) {
+        const float* w = &t.weights[size_t(i) * t.width];
+        const float* s = in + size_t(t.first[i]) * channels;
+        for (int c = 0; c < channels; ++c) {
+            float acc = w[0] * s[c];
+            for (int k = 1; k < t.count[i]; ++k)
+                acc += w[k] * s[k * channels + c];
+            out[size_t(i) * channels + c] = acc;
+        }
+    }
+}
+
+// the weighted sum of count rows of n floats
+void CombineRows(const float* const* rows, const float* w, int count,
+                 float* out, size_t n, bool simd) {
+    size_t x = 0;
+#if defined(LAB_MIP_HAVE_SSE2)
+    if (simd)
+        for (; x + 4 <= n; x += 4) {
+            __m128 acc = _mm_mul_ps(_mm_set1_ps(w[0]), _mm_loadu_ps(rows[0] + x));
+            for (int k = 1; k < count; ++k)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(rows[k] + x)));
+            _mm_storeu_ps(out + x, acc);
+        }
+#elif defined(LAB_MIP_HAVE_NEON)
+    if (simd)
+        for (; x + 4 <= n; x += 4) {
+            float32x4_t acc = vmulq_n_f32(vld1q_f32(rows[0] + x), w[0]);
+            for (int k = 1; k < count; ++k)
+                acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(rows[k] + x), w[k]));
+            vst1q_f32(out + x, acc);
+        }
+#endif
+    for (; x < n; ++x) {
+        float acc = w[0] * rows[0][x];
+        for (int k = 1; k < count; ++k)
+            acc += w[k] * rows[k][x];
+        out[x] = acc;
+    }
+}
+
+bool Compatible(const LabImageData_t& src, const LabImageData_t& dst) {
+    return src.data && dst.data && src.pixelType == dst.pixelType &&
+           src.pixelType >= LAB_PIXEL_UINT && src.pixelType < Lab_PIXEL_LAST_TYPE &&
+           src.channelCount == dst.channelCount && src.channelCount >= 1 && src.channelCount <= 4 &&
+           src.width > 0 && src.height > 0 && dst.width > 0 && dst.height > 0;
+}
+
+// rows per band; the input rows at either side of a band are filtered
+// once for each band that reads them, so bands are not too thin
+size_t BandRows(int height) {
+    size_t rows = size_t(height) / (4 * size_t(ThreadPool::Shared().Size() + 1));
+    return std::clamp<size_t>(rows, 16, 64);
+}
+
+void ForBands(int height, bool pooled, const std::function<void(size_t, size_t)>& fn) {
+    size_t rows = BandRows(height);
+    if (pooled)
+        ThreadPool::Shared().ParallelFor(0, size_t(height), rows, fn);
+    else
+        for (size_t y = 0; y < size_t(height); y += rows)
+            fn(y, std::min(size_t(height), y + rows));
+}
+
+// ids and other data are not filtered, but taken from the nearest pixel
+void PointSample(const LabImageData_t& src, LabImageData_t& dst, bool pooled) {
+    const size_t pixel = PixelComponentSize(src.pixelType) * src.channelCount;
+    ForBands(dst.height, pooled, [&](size_t y0, size_t y1) {
+        for (size_t y = y0; y < y1; ++y) {
+            size_t sy = std::min<size_t>(src.height - 1, size_t((y + 0.5) * src.height / dst.height));
+            const uint8_t* s = src.data + sy * src.width * pixel;
+            uint8_t* d = dst.data + y * dst.width * pixel;
+            for (int x = 0; x < dst.width; ++x) {
+                size_t sx = std::min<size_t>(src.width - 1, size_t((x + 0.5) * src.width / dst.width));
+                memcpy(d + x * pixel, s + sx * pixel, pixel);
+            }
+        }
+    });
+}
+
+bool Resample(const LabImageData_t& src, LabImageData_t& dst, MipFilter filter, bool pooled) {
+    if (!Compatible(src, dst))
+        return false;
+    if (src.pixelType == LAB_PIXEL_UINT) {
+        PointSample(src, dst, pooled);
+        return true;
+    }
+
+    const Taps h = MakeTaps(src.width, dst.width, filter);
+    const Taps v = MakeTaps(src.height, dst.height, filter);
+    const int channels = src.channelCount;
+    const LabPixelType_t type = src.pixelType;
+    const bool isFloat = type == LAB_PIXEL_FLOAT;
+    const size_t srcRowBytes = PixelComponentSize(type) * channels * src.width;
+    const size_t dstRowBytes = PixelComponentSize(type) * channels * dst.width;
+    const size_t dstRowFloats = size_t(dst.width) * channels;
+    const PixelConversion toFloat(type, channels, LAB_PIXEL_FLOAT, channels);
+    const PixelConversion fromFloat(LAB_PIXEL_FLOAT, channels, type, channels);
+    const bool simd = !forceScalar.load(std::memory_order_relaxed);
+
+    ForBands(dst.height, pooled, [&](size_t y0, size_t y1) {
+        // the input rows of the band; the first tap never moves up
+        int lo = v.first[y0], hi = lo;
+        for (size_t y = y0; y < y1; ++y)
+            hi = std::max(hi, v.first[y] + v.count[y]);
+        std::vector<float> filtered(size_t(hi - lo) * dstRowFloats);
+        std::vector<float> in(isFloat ? 0 : size_t(src.width) * channels);
+        std::vector<float> out(isFloat ? 0 : dstRowFloats);
+        for (int r = lo; r < hi; ++r) {
+            const uint8_t* row = src.data + size_t(r) * srcRowBytes;
+            const float* pixels = (const float*) row;
+            if (!isFloat) {
+                ConvertPixels(toFloat, row, 0, in.data(), 0, src.width, 1);
+                pixels = in.data();
+            }
+            FilterRow(h, pixels, &filtered[size_t(r - lo) * dstRowFloats], dst.width, channels, simd);
+        }
+
+        std::vector<const float*> rows(v.width);
+        for (size_t y = y0; y < y1; ++y) {
+            for (int k = 0; k < v.count[y]; ++k)
+                rows[k] = &filtered[size_t(v.first[y] + k - lo) * dstRowFloats];
+            uint8_t* row = dst.data + y * dstRowBytes;
+            float* pixels = isFloat ? (float*) row : out.data();
+            CombineRows(rows.data(), &v.weights[y * v.width], v.count[y], pixels, dstRowFloats, simd);
+            if (!isFloat)
+                ConvertPixels(fromFloat, out.data(), 0, row, 0, dst.width, 1);
+        }
+    });
+    return true;
+}
+
+std::vector<std::shared_ptr<LabImageData_t>> MipLevels(const LabImageData_t& image,
+                                                       MipFilter filter, bool pooled) {
+    std::vector<std::shared_ptr<LabImageData_t>> levels;
+    if (!image.data || image.width < 1 || image.height < 1)
+        return levels;
+    const LabImageData_t* above = &image;
+    int w = image.width, h = image.height;
+    while (w > 1 || h > 1) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        auto level = TextureCache::AllocateImage(w, h, image.channelCount, image.pixelType);
+        if (!level || !Resample(*above, *level, filter, pooled))
+            return {};
+        levels.push_back(level);
+        above = level.get();
+    }
+    return levels;
+}
+
+} // anon
+
+bool ResampleImage(const LabImageData_t& src, LabImageData_t& dst, MipFilter filter) {
+    return Resample(src, dst, filter, true);
+}
+
+std::vector<std::shared_ptr<LabImageData_t>> GenerateMipLevels(const LabImageData_t& image,
+                                                               MipFilter filter) {
+    return MipLevels(image, filter, true);
+}
+
+void MipChainForceScalar(bool scalar) {
+    forceScalar = scalar;
+}
+
+//-----------------------------------------------------------------------------
+// tests
+//-----------------------------------------------------------------------------
+
+namespace {
+
+const char* kFilterNames[] = { "box", "Gaussian", "Lanczos" };
+const MipFilter kFilters[] = { MipFilter::Box, MipFilter::Gaussian, MipFilter::Lanczos };
+
+float ComponentAt(const LabImageData_t& img, size_t i) {
+    switch (img.pixelType) {
+        case LAB_PIXEL_FLOAT: return ((const float*) img.data)[i];
+        case LAB_PIXEL_UINT:  return float(((const uint32_t*) img.data)[i]);
+        case LAB_PIXEL_UINT8: return img.data[i] / 255.f;
+        default: {
+            float f;
+            PixelConversion c(LAB_PIXEL_HALF, 1, LAB_PIXEL_FLOAT, 1);
+            ConvertPixels(c, img.data + 2 * i, 0, &f, 0, 1, 1);
+            return f;
+        }
+    }
+}
+
+std::shared_ptr<LabImageData_t> RandomImage(int width, int height, int channels,
+                                            LabPixelType_t type, std::mt19937& rng) {
+    auto img = TextureCache::AllocateImage(width, height, channels, type);
+    size_t count = size_t(width) * height * channels;
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<float> f(count);
+    for (auto& v : f)
+        v = type == LAB_PIXEL_UINT ? float(rng() & 0xffff) : unit(rng);
+    PixelConversion c(LAB_PIXEL_FLOAT, channels, type, channels);
+    if (type == LAB_PIXEL_UINT)
+        for (size_t i = 0; i < count; ++i)
+            ((uint32_t*) img->data)[i] = uint32_t(f[i]);
+    else
+        ConvertPixels(c, f.data(), 0, img->data, 0, width, height);
+    return img;
+}
+
+} // anon
+
+int TestMipChain() {
+    int failures = 0;
+    auto check = [&failures](bool ok, const char* what, const char* filter) {
+        if (!ok) {
+            printf("  MipChain test failed: %s, %s\n", what, filter);
+            ++failures;
+        }
+    };
+    std::mt19937 rng(19);
+
+    for (int f = 0; f < 3; ++f) {
+        const char* name = kFilterNames[f];
+        MipFilter filter = kFilters[f];
+
+        // odd sizes round down, to 1x1
+        {
+            auto img = TextureCache::AllocateImage(37, 5, 3, LAB_PIXEL_HALF);
+            memset(img->data, 0, img->dataSize);
+            auto levels = GenerateMipLevels(*img, filter);
+            static const int sizes[][2] = { {18, 2}, {9, 1}, {4, 1}, {2, 1}, {1, 1} };
+            bool ok = levels.size() == 5;
+            for (size_t l = 0; ok && l < levels.size(); ++l)
+                ok = levels[l]->width == sizes[l][0] && levels[l]->height == sizes[l][1] &&
+                     levels[l]->channelCount == 3 && levels[l]->pixelType == LAB_PIXEL_HALF;
+            check(ok, "level sizes", name);
+        }
+
+        // constant images stay constant in every type
+        for (LabPixelType_t type : { LAB_PIXEL_HALF, LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8 }) {
+            auto img = TextureCache::AllocateImage(123, 77, 4, type);
+            std::vector<float> px(size_t(123) * 77 * 4);
+            for (size_t i = 0; i < px.size(); ++i)
+                px[i] = (i % 4 + 1) * 0.2f;
+            ConvertPixels(PixelConversion(LAB_PIXEL_FLOAT, 4, type, 4), px.data(), 0, img->data, 0, 123, 77);
+            float expect[4];
+            for (int c = 0; c < 4; ++c)
+                expect[c] = ComponentAt(*img, c);
+            bool ok = true;
+            for (auto& level : GenerateMipLevels(*img, filter)) {
+                size_t n = size_t(level->width) * level->height * 4;
+                for (size_t i = 0; ok && i < n; ++i)
+                    ok = fabsf(ComponentAt(*level, i) - expect[i % 4]) <= 1e-3f;
+            }
+            check(ok, "constant image", name);
+        }
+
+        // a horizontal ramp is preserved away from the edges, as every
+        // filter is symmetric and normalized
+        {
+            const int w = 256, h = 8;
+            auto img = TextureCache::AllocateImage(w, h, 1, LAB_PIXEL_FLOAT);
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                    ((float*) img->data)[y * w + x] = float(x);
+            auto half = TextureCache::AllocateImage(w / 2, h / 2, 1, LAB_PIXEL_FLOAT);
+            ResampleImage(*img, *half, filter);
+            bool ok = true;
+            for (int y = 0; y < h / 2; ++y)
+                for (int x = 8; x < w / 2 - 8; ++x)
+                    ok = ok && fabsf(((float*) half->data)[y * (w / 2) + x] - (2 * x + 0.5f)) < 1e-3f;
+            check(ok, "linear ramp", name);
+        }
+
+        // scalar and SIMD taps agree
+        for (int channels : { 1, 3, 4 }) {
+            auto img = RandomImage(301, 199, channels, LAB_PIXEL_FLOAT, rng);
+            MipChainForceScalar(true);
+            auto scalar = GenerateMipLevels(*img, filter);
+            MipChainForceScalar(false);
+            auto simd = GenerateMipLevels(*img, filter);
+            bool ok = scalar.size() == simd.size();
+            for (size_t l = 0; ok && l < simd.size(); ++l) {
+                size_t n = simd[l]->dataSize / sizeof(float);
+                for (size_t i = 0; ok && i < n; ++i)
+                    ok = fabsf(ComponentAt(*simd[l], i) - ComponentAt(*scalar[l], i)) <= 1e-5f;
+            }
+            check(ok, "SIMD against scalar", name);
+        }
+    }
+
+    // the box filter of an even level is the 2x2 average
+    {
+        auto img = RandomImage(64, 48, 4, LAB_PIXEL_FLOAT, rng);
+        auto levels = GenerateMipLevels(*img, MipFilter::Box);
+        const float* s = (const float*) img->data;
+        const float* d = (const float*) levels[0]->data;
+        bool ok = true;
+        for (int y = 0; y < 24; ++y)
+            for (int x = 0; x < 32; ++x)
+                for (int c = 0; c < 4; ++c) {
+                    auto at = [&](int sx, int sy) { return s[(sy * 64 + sx) * 4 + c]; };
+                    float avg = (at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) +
+                                 at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1)) / 4;
+                    ok = ok && fabsf(d[(y * 32 + x) * 4 + c] - avg) <= 1e-6f;
+                }
+        check(ok, "2x2 average", "box");
+    }
+
+    // uint pixels are copied, never blended
+    {
+        auto img = RandomImage(45, 31, 2, LAB_PIXEL_UINT, rng);
+        auto levels = GenerateMipLevels(*img, MipFilter::Lanczos);
+        bool ok = !levels.empty();
+        const uint32_t* s = (const uint32_t*) img->data;
+        for (auto& level : levels) {
+            const uint32_t* d = (const uint32_t*) level->data;
+            size_t n = size_t(level->width) * level->height;
+            for (size_t i = 0; ok && i < n; ++i) {
+                bool found = false;
+                for (size_t j = 0; !found && j < size_t(45) * 31; ++j)
+                    found = s[2 * j] == d[2 * i] && s[2 * j + 1] == d[2 * i + 1];
+                ok = found;
+            }
+        }
+        check(ok, "uint point sampling", "Lanczos");
+    }
+
+    printf("MipChain: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int BenchmarkMipChain(int width, int height) {
+    using clock = std::chrono::steady_clock;
+    auto msSince = [](clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(clock::now() - t).count();
+    };
+    std::mt19937 rng(8);
+    auto img = RandomImage(width, height, 4, LAB_PIXEL_FLOAT, rng);
+    if (!img) {
+        printf("Could not allocate a %dx%d float RGBA image\n", width, height);
+        return 1;
+    }
+    printf("BenchmarkMipChain: %dx%d float RGBA, %.0f MB, %d pool threads, ms for every level\n",
+           width, height, img->dataSize / 1e6, ThreadPool::Shared().Size());
+    printf("  %-10s %12s %12s %12s\n", "filter", "scalar", "SIMD", "SIMD pool");
+    int failures = 0;
+    for (int f = 0; f < 3; ++f) {
+        double ms[3];
+        for (int run = 0; run < 3; ++run) {
+            MipChainForceScalar(run == 0);
+            auto start = clock::now();
+            auto levels = MipLevels(*img, kFilters[f], run == 2);
+            ms[run] = msSince(start);
+            if (levels.empty())
+                ++failures;
+        }
+        MipChainForceScalar(false);
+        printf("  %-10s %12.1f %12.1f %12.1f\n", kFilterNames[f], ms[0], ms[1], ms[2]);
+        fflush(stdout);
+    }
+
+#ifdef HAVE_OPENEXR
+    // the resampler in nanoexr, for one level
+    {
+        nanoexr_ImageData_t src = {}, dst = {};
+        src.data = img->data;
+        src.dataSize = img->dataSize;
+        src.pixelType = EXR_PIXEL_FLOAT;
+        src.channelCount = 4;
+        src.width = width;
+        src.height = height;
+        dst = src;
+        dst.width = std::max(1, width / 2);
+        dst.height = std::max(1, height / 2);
+        std::vector<float> out(size_t(dst.width) * dst.height * 4);
+        dst.data = (uint8_t*) out.data();
+        dst.dataSize = out.size() * sizeof(float);
+        auto start = clock::now();
+        bool ok = nanoexr_Gaussian_resample(&src, &dst);
+        double nanoexrMs = msSince(start);
+        auto level = TextureCache::AllocateImage(dst.width, dst.height, 4, LAB_PIXEL_FLOAT);
+        start = clock::now();
+        ResampleImage(*img, *level, MipFilter::Gaussian);
+        printf("  first level only: nanoexr_Gaussian_resample %.1f ms%s, Gaussian %.1f ms\n",
+               nanoexrMs, ok ? "" : " (failed)", msSince(start));
+    }
+#endif
+    return failures;
+}
+
+} // lab
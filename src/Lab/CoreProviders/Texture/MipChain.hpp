@@ -0,0 +1,53 @@
+#ifndef Providers_Texture_MipChain_hpp
+#define Providers_Texture_MipChain_hpp
+
+#include "ImageData.h"
+#include <memory>
+#include <vector>
+
+/*
+ Resampling and mip chain generation for LabImageData_t, so that images
+ decoded without mips, such as PNGs and PFMs, may be shown zoomed out
+ without aliasing, and uploaded at the size they are shown.
+
+ The filters are separable, and are evaluated in float whatever the pixel
+ type; pixels are converted a row at a time as they are read and written.
+ A level is resampled in bands of rows on the shared thread pool, and the
+ taps of four channel pixels are applied with SSE2 or NEON. uint images
+ hold data such as ids, which are not filtered but point sampled.
+ */
+
+namespace lab {
+
+enum class MipFilter {
+    Box,        // the area average; a 2x2 average for even sizes
+    Gaussian,   // softer, with no ringing
+    Lanczos,    // three lobes; sharpest, and may ring at hard edges
+};
+
+// resamples src to the size of dst, which must have src's type and channel
+// count. Returns false if they differ, or either is empty.
+bool ResampleImage(const LabImageData_t& src, LabImageData_t& dst, MipFilter filter);
+
+// the levels below image, each half the size of the one above rounded
+// down, to 1x1, as EXR mips are. Each level is resampled from the one
+// above it. Returns an empty vector if image is 1x1 or a level could not
+// be allocated.
+std::vector<std::shared_ptr<LabImageData_t>> GenerateMipLevels(const LabImageData_t& image,
+                                                               MipFilter filter);
+
+// applies the taps with scalar code only, for tests and benchmarks
+void MipChainForceScalar(bool scalar);
+
+// checks level sizes, that constant images stay constant, that linear
+// ramps are preserved away from the edges, the box filter against 2x2
+// averages, point sampling of uint images, and SIMD against scalar taps.
+int TestMipChain();
+
+// reports the time to generate every level of a float RGBA image with
+// each filter, with scalar and SIMD taps, single threaded and on the pool
+int BenchmarkMipChain(int width, int height);
+
+} // lab
+
+#endif // Providers_Texture_MipChain_hpp
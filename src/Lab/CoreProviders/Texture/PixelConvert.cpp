@@ -0,0 +1,1067 @@
+
+// Pixel layout conversions. A conversion is a type kernel over runs of
+// components when the channels line up, and otherwise a pass to float, a
+// swizzle and transfer on the floats, and a pass from float, a row at a time.
+
+#include "PixelConvert.hpp"
+#include "TextureCache.hpp"
+#include "Lab/LabThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #include <immintrin.h>
+    #if defined(__GNUC__) || defined(__clang__)
+        #define LAB_PC_SSE4_TARGET __attribute__((target("sse4.1")))
+        #define LAB_PC_AVX2_TARGET __attribute__((target("avx2,f16c")))
+        #define LAB_PC_HAVE_SSE4 1
+        #define LAB_PC_HAVE_AVX2 1
+    #elif defined(__AVX2__)
+        #define LAB_PC_SSE4_TARGET
+        #define LAB_PC_AVX2_TARGET
+        #define LAB_PC_HAVE_SSE4 1
+        #define LAB_PC_HAVE_AVX2 1
+    #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define LAB_PC_HAVE_NEON 1
+#endif
+
+namespace lab {
+
+namespace {
+
+enum { kScalar = 0, kSSE4 = 1, kAVX2 = 2, kNEON = 3, kLevels };
+
+//-----------------------------------------------------------------------------
+// scalar reference
+//-----------------------------------------------------------------------------
+
+constexpr float kInv255 = 1.f / 255.f;
+
+float HalfToFloat(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if (exp == 0x1f)
+        bits = sign | 0x7f800000 | (mant << 13);
+    else if (exp)
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    else if (!mant)
+        bits = sign;
+    else {
+        // subnormal; normalize the mantissa
+        uint32_t e = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            --e;
+        }
+        bits = sign | (e << 23) | ((mant & 0x3ff) << 13);
+    }
+    return std::bit_cast<float>(bits);
+}
+
+// round to nearest even, as F16C and NEON do
+uint16_t FloatToHalf(float f) {
+    uint32_t x = std::bit_cast<uint32_t>(f);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t ax = x & 0x7fffffff;
+    if (ax >= 0x7f800000)
+        return uint16_t(sign | 0x7c00 | (ax > 0x7f800000 ? 0x200 | ((ax >> 13) & 0x3ff) : 0));
+    if (ax >= 0x477ff000) // 65520 and above round to infinity
+        return uint16_t(sign | 0x7c00);
+    if (ax < 0x38800000) {
+        // below the smallest normal half; 2^-25 and below round to zero
+        if (ax <= 0x33000000)
+            return uint16_t(sign);
+        uint32_t e = ax >> 23;
+        uint32_t m = (ax & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - e;
+        uint32_t r = m >> shift;
+        uint32_t rem = m & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (r & 1)))
+            ++r;
+        return uint16_t(sign | r);
+    }
+    uint32_t r = ax - 0x38000000; // rebias the exponent from 127 to 15
+    uint32_t h = r >> 13;
+    uint32_t rem = r & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        ++h;
+    return uint16_t(sign | h);
+}
+
+uint8_t FloatToUint8(float v) {
+    v = v > 0.f ? v : 0.f; // and NaN to zero
+    v = v < 1.f ? v : 1.f;
+    return (uint8_t) std::lrintf(v * 255.f);
+}
+
+uint32_t FloatToUint32(float v) {
+    if (!(v > 0.f))
+        return 0;
+    return v < 4294967296.f ? (uint32_t) v : UINT32_MAX;
+}
+
+template <LabPixelType_t T> struct Component;
+template <> struct Component<LAB_PIXEL_UINT> {
+    using type = uint32_t;
+    static float ToFloat(uint32_t v) { return (float) v; }
+    static uint32_t FromFloat(float v) { return FloatToUint32(v); }
+};
+template <> struct Component<LAB_PIXEL_HALF> {
+    using type = uint16_t;
+    static float ToFloat(uint16_t v) { return HalfToFloat(v); }
+    static uint16_t FromFloat(float v) { return FloatToHalf(v); }
+};
+template <> struct Component<LAB_PIXEL_FLOAT> {
+    using type = float;
+    static float ToFloat(float v) { return v; }
+    static float FromFloat(float v) { return v; }
+};
+template <> struct Component<LAB_PIXEL_UINT8> {
+    using type = uint8_t;
+    static float ToFloat(uint8_t v) { return v * kInv255; }
+    static uint8_t FromFloat(float v) { return FloatToUint8(v); }
+};
+
+// converts n components
+using ConvertFn = void (*)(const void* src, void* dst, size_t n);
+
+template <LabPixelType_t S, LabPixelType_t D>
+void ConvertScalar(const void* src, void* dst, size_t n) {
+    using ST = typename Component<S>::type;
+    using DT = typename Component<D>::type;
+    if constexpr (S == D) {
+        memcpy(dst, src, n * sizeof(ST));
+    }
+    else {
+        auto s = (const ST*) src;
+        auto d = (DT*) dst;
+        for (size_t i = 0; i < n; ++i)
+            d[i] = Component<D>::FromFloat(Component<S>::ToFloat(s[i]));
+    }
+}
+
+float SRGBToLinear(float v) {
+    return v <= 0.04045f ? v * (1.f / 12.92f)
+                         : std::pow((v + 0.055f) * (1.f / 1.055f), 2.4f);
+}
+
+float LinearToSRGB(float v) {
+    return v <= 0.0031308f ? v * 12.92f
+                           : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+}
+
+bool IsColorChannel(int channel, int channels) {
+    return channels == 2 ? channel == 0 : channel < 3;
+}
+
+//-----------------------------------------------------------------------------
+// SSE4.1
+//-----------------------------------------------------------------------------
+
+#ifdef LAB_PC_HAVE_SSE4
+LAB_PC_SSE4_TARGET
+void Uint8ToFloatSSE4(const void* src, void* dst, size_t n) {
+    auto s = (const uint8_t*) src;
+    auto d = (float*) dst;
+    const __m128 scale = _mm_set1_ps(kInv255);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*) (s + i));
+        for (int q = 0; q < 4; ++q) {
+            __m128i w = _mm_cvtepu8_epi32(b);
+            _mm_storeu_ps(d + i + 4 * q, _mm_mul_ps(_mm_cvtepi32_ps(w), scale));
+            b = _mm_srli_si128(b, 4);
+        }
+    }
+    ConvertScalar<LAB_PIXEL_UINT8, LAB_PIXEL_FLOAT>(s + i, d + i, n - i);
+}
+
+LAB_PC_SSE4_TARGET
+void FloatToUint8SSE4(const void* src, void* dst, size_t n) {
+    auto s = (const float*) src;
+    auto d = (uint8_t*) dst;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scale = _mm_set1_ps(255.f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; ++k) {
+            // maxps returns its second operand for NaN
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(s + i + 4 * k), zero), one);
+            q[k] = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+        }
+        __m128i lo = _mm_packus_epi32(q[0], q[1]);
+        __m128i hi = _mm_packus_epi32(q[2], q[3]);
+        _mm_storeu_si128((__m128i*) (d + i), _mm_packus_epi16(lo, hi));
+    }
+    ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8>(s + i, d + i, n - i);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// AVX2 and F16C
+//-----------------------------------------------------------------------------
+
+#ifdef LAB_PC_HAVE_AVX2
+LAB_PC_AVX2_TARGET inline __m256 LoadUint8x8(const uint8_t* s) {
+    __m256i w = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) s));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(w), _mm256_set1_ps(kInv255));
+}
+
+LAB_PC_AVX2_TARGET inline void StoreUint8x8(uint8_t* d, __m256 v) {
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps(255.f)));
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+    _mm_storel_epi64((__m128i*) d, _mm_packus_epi16(w, w));
+}
+
+LAB_PC_AVX2_TARGET
+void HalfToFloatAVX2(const void* src, void* dst, size_t n) {
+    auto s = (const uint16_t*) src;
+    auto d = (float*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(d + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (s + i))));
+    ConvertScalar<LAB_PIXEL_HALF, LAB_PIXEL_FLOAT>(s + i, d + i, n - i);
+}
+
+LAB_PC_AVX2_TARGET
+void FloatToHalfAVX2(const void* src, void* dst, size_t n) {
+    auto s = (const float*) src;
+    auto d = (uint16_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i*) (d + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(s + i), _MM_FROUND_TO_NEAREST_INT));
+    ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_HALF>(s + i, d + i, n - i);
+}
+
+LAB_PC_AVX2_TARGET
+void Uint8ToFloatAVX2(const void* src, void* dst, size_t n) {
+    auto s = (const uint8_t*) src;
+    auto d = (float*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(d + i, LoadUint8x8(s + i));
+    ConvertScalar<LAB_PIXEL_UINT8, LAB_PIXEL_FLOAT>(s + i, d + i, n - i);
+}
+
+LAB_PC_AVX2_TARGET
+void FloatToUint8AVX2(const void* src, void* dst, size_t n) {
+    auto s = (const float*) src;
+    auto d = (uint8_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        StoreUint8x8(d + i, _mm256_loadu_ps(s + i));
+    ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8>(s + i, d + i, n - i);
+}
+
+LAB_PC_AVX2_TARGET
+void Uint8ToHalfAVX2(const void* src, void* dst, size_t n) {
+    auto s = (const uint8_t*) src;
+    auto d = (uint16_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i*) (d + i),
+                         _mm256_cvtps_ph(LoadUint8x8(s + i), _MM_FROUND_TO_NEAREST_INT));
+    ConvertScalar<LAB_PIXEL_UINT8, LAB_PIXEL_HALF>(s + i, d + i, n - i);
+}
+
+LAB_PC_AVX2_TARGET
+void HalfToUint8AVX2(const void* src, void* dst, size_t n) {
+    auto s = (const uint16_t*) src;
+    auto d = (uint8_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        StoreUint8x8(d + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (s + i))));
+    ConvertScalar<LAB_PIXEL_HALF, LAB_PIXEL_UINT8>(s + i, d + i, n - i);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// NEON
+//-----------------------------------------------------------------------------
+
+#ifdef LAB_PC_HAVE_NEON
+inline void LoadUint8x8(const uint8_t* s, float32x4_t& lo, float32x4_t& hi) {
+    uint16x8_t w = vmovl_u8(vld1_u8(s));
+    lo = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(w))), kInv255);
+    hi = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(w))), kInv255);
+}
+
+inline uint16x4_t QuantizeUint8(float32x4_t v) {
+    // maxnm returns the number when the other operand is NaN
+    v = vminq_f32(vmaxnmq_f32(v, vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+    return vqmovn_u32(vcvtnq_u32_f32(vmulq_n_f32(v, 255.f)));
+}
+
+void HalfToFloatNEON(const void* src, void* dst, size_t n) {
+    auto s = (const uint16_t*) src;
+    auto d = (float*) dst;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(d + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(s + i))));
+    ConvertScalar<LAB_PIXEL_HALF, LAB_PIXEL_FLOAT>(s + i, d + i, n - i);
+}
+
+void FloatToHalfNEON(const void* src, void* dst, size_t n) {
+    auto s = (const float*) src;
+    auto d = (uint16_t*) dst;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        vst1_u16(d + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(s + i))));
+    ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_HALF>(s + i, d + i, n - i);
+}
+
+void Uint8ToFloatNEON(const void* src, void* dst, size_t n) {
+    auto s = (const uint8_t*) src;
+    auto d = (float*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t lo, hi;
+        LoadUint8x8(s + i, lo, hi);
+        vst1q_f32(d + i, lo);
+        vst1q_f32(d + i + 4, hi);
+    }
+    ConvertScalar<LAB_PIXEL_UINT8, LAB_PIXEL_FLOAT>(s + i, d + i, n - i);
+}
+
+void FloatToUint8NEON(const void* src, void* dst, size_t n) {
+    auto s = (const float*) src;
+    auto d = (uint8_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t w = vcombine_u16(QuantizeUint8(vld1q_f32(s + i)),
+                                    QuantizeUint8(vld1q_f32(s + i + 4)));
+        vst1_u8(d + i, vqmovn_u16(w));
+    }
+    ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8>(s + i, d + i, n - i);
+}
+
+void Uint8ToHalfNEON(const void* src, void* dst, size_t n) {
+    auto s = (const uint8_t*) src;
+    auto d = (uint16_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t lo, hi;
+        LoadUint8x8(s + i, lo, hi);
+        vst1_u16(d + i, vreinterpret_u16_f16(vcvt_f16_f32(lo)));
+        vst1_u16(d + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(hi)));
+    }
+    ConvertScalar<LAB_PIXEL_UINT8, LAB_PIXEL_HALF>(s + i, d + i, n - i);
+}
+
+void HalfToUint8NEON(const void* src, void* dst, size_t n) {
+    auto s = (const uint16_t*) src;
+    auto d = (uint8_t*) dst;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t lo = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(s + i)));
+        float32x4_t hi = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(s + i + 4)));
+        vst1_u8(d + i, vqmovn_u16(vcombine_u16(QuantizeUint8(lo), QuantizeUint8(hi))));
+    }
+    ConvertScalar<LAB_PIXEL_HALF, LAB_PIXEL_UINT8>(s + i, d + i, n - i);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// dispatch
+//-----------------------------------------------------------------------------
+
+struct Kernels {
+    ConvertFn fn[4][4];
+};
+
+template <LabPixelType_t S>
+void FillScalarRow(Kernels& k) {
+    k.fn[S][LAB_PIXEL_UINT]  = ConvertScalar<S, LAB_PIXEL_UINT>;
+    k.fn[S][LAB_PIXEL_HALF]  = ConvertScalar<S, LAB_PIXEL_HALF>;
+    k.fn[S][LAB_PIXEL_FLOAT] = ConvertScalar<S, LAB_PIXEL_FLOAT>;
+    k.fn[S][LAB_PIXEL_UINT8] = ConvertScalar<S, LAB_PIXEL_UINT8>;
+}
+
+// each level starts from the scalar kernels, and replaces those it has
+struct KernelTable {
+    Kernels level[kLevels];
+
+    KernelTable() {
+        Kernels scalar;
+        FillScalarRow<LAB_PIXEL_UINT>(scalar);
+        FillScalarRow<LAB_PIXEL_HALF>(scalar);
+        FillScalarRow<LAB_PIXEL_FLOAT>(scalar);
+        FillScalarRow<LAB_PIXEL_UINT8>(scalar);
+        for (auto& l : level)
+            l = scalar;
+#ifdef LAB_PC_HAVE_SSE4
+        level[kSSE4].fn[LAB_PIXEL_UINT8][LAB_PIXEL_FLOAT] = Uint8ToFloatSSE4;
+        level[kSSE4].fn[LAB_PIXEL_FLOAT][LAB_PIXEL_UINT8] = FloatToUint8SSE4;
+#endif
+#ifdef LAB_PC_HAVE_AVX2
+        level[kAVX2].fn[LAB_PIXEL_HALF][LAB_PIXEL_FLOAT] = HalfToFloatAVX2;
+        level[kAVX2].fn[LAB_PIXEL_FLOAT][LAB_PIXEL_HALF] = FloatToHalfAVX2;
+        level[kAVX2].fn[LAB_PIXEL_UINT8][LAB_PIXEL_FLOAT] = Uint8ToFloatAVX2;
+        level[kAVX2].fn[LAB_PIXEL_FLOAT][LAB_PIXEL_UINT8] = FloatToUint8AVX2;
+        level[kAVX2].fn[LAB_PIXEL_UINT8][LAB_PIXEL_HALF] = Uint8ToHalfAVX2;
+        level[kAVX2].fn[LAB_PIXEL_HALF][LAB_PIXEL_UINT8] = HalfToUint8AVX2;
+#endif
+#ifdef LAB_PC_HAVE_NEON
+        level[kNEON].fn[LAB_PIXEL_HALF][LAB_PIXEL_FLOAT] = HalfToFloatNEON;
+        level[kNEON].fn[LAB_PIXEL_FLOAT][LAB_PIXEL_HALF] = FloatToHalfNEON;
+        level[kNEON].fn[LAB_PIXEL_UINT8][LAB_PIXEL_FLOAT] = Uint8ToFloatNEON;
+        level[kNEON].fn[LAB_PIXEL_FLOAT][LAB_PIXEL_UINT8] = FloatToUint8NEON;
+        level[kNEON].fn[LAB_PIXEL_UINT8][LAB_PIXEL_HALF] = Uint8ToHalfNEON;
+        level[kNEON].fn[LAB_PIXEL_HALF][LAB_PIXEL_UINT8] = HalfToUint8NEON;
+#endif
+    }
+
+    static const KernelTable& Get() {
+        static KernelTable table;
+        return table;
+    }
+};
+
+std::atomic<int> gForcedLevel{-1};
+
+int SupportedLevel() {
+    static const int level = []() {
+#if defined(LAB_PC_HAVE_NEON)
+        return (int) kNEON;
+#elif defined(LAB_PC_HAVE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+            return (int) kAVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return (int) kSSE4;
+        return (int) kScalar;
+#elif defined(LAB_PC_HAVE_AVX2)
+        return (int) kAVX2;
+#else
+        return (int) kScalar;
+#endif
+    }();
+    return level;
+}
+
+const Kernels& KernelsFor(int level) {
+    return KernelTable::Get().level[level];
+}
+
+//-----------------------------------------------------------------------------
+// rows
+//-----------------------------------------------------------------------------
+
+struct Plan {
+    const PixelConversion* c;
+    const Kernels* k;
+    size_t srcPixel, dstPixel;
+    bool direct; // same channels in the same order, and no transfer
+    bool copy;   // same type, reordered channels, and no transfer
+    const float* decodeLUT; // sRGB to linear for uint8 sources
+};
+
+const float* SRGBDecodeLUT() {
+    static const std::vector<float> lut = []() {
+        std::vector<float> t(256);
+        for (int i = 0; i < 256; ++i)
+            t[i] = SRGBToLinear(i * kInv255);
+        return t;
+    }();
+    return lut.data();
+}
+
+void ComponentOne(LabPixelType_t type, uint8_t one[4]) {
+    float f = 1.f;
+    ConvertFn fn[] = { ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_UINT>,
+                       ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_HALF>,
+                       ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_FLOAT>,
+                       ConvertScalar<LAB_PIXEL_FLOAT, LAB_PIXEL_UINT8> };
+    fn[type](&f, one, 1);
+}
+
+void ConvertRows(const Plan& p, const uint8_t* src, size_t srcStride,
+                 uint8_t* dst, size_t dstStride, int width, size_t rows) {
+    const PixelConversion& c = *p.c;
+    if (p.direct) {
+        ConvertFn fn = p.k->fn[c.srcType][c.dstType];
+        for (size_t y = 0; y < rows; ++y)
+            fn(src + y * srcStride, dst + y * dstStride, size_t(width) * c.srcChannels);
+        return;
+    }
+
+    if (p.copy) {
+        // components are copied, so that uint32 data is not rounded through float
+        size_t size = PixelComponentSize(c.srcType);
+        uint8_t one[4];
+        ComponentOne(c.srcType, one);
+        for (size_t y = 0; y < rows; ++y) {
+            const uint8_t* s = src + y * srcStride;
+            uint8_t* d = dst + y * dstStride;
+            for (int x = 0; x < width; ++x, s += p.srcPixel, d += p.dstPixel) {
+                for (int ch = 0; ch < c.dstChannels; ++ch) {
+                    int8_t from = c.swizzle.channel[ch];
+                    if (from >= 0)
+                        memcpy(d + ch * size, s + from * size, size);
+                    else if (from == PixelSwizzle::One)
+                        memcpy(d + ch * size, one, size);
+                    else
+                        memset(d + ch * size, 0, size);
+                }
+            }
+        }
+        return;
+    }
+
+    ConvertFn toFloat = p.k->fn[c.srcType][LAB_PIXEL_FLOAT];
+    ConvertFn fromFloat = p.k->fn[LAB_PIXEL_FLOAT][c.dstType];
+    // the row of floats is followed by a zero and a one, so that each
+    // destination channel is a gather with a fixed step and offset
+    size_t n = size_t(width) * c.srcChannels;
+    std::vector<float> in(n + 2);
+    std::vector<float> out(size_t(width) * c.dstChannels);
+    in[n] = 0.f;
+    in[n + 1] = 1.f;
+    size_t step[4], offset[4];
+    for (int ch = 0; ch < c.dstChannels; ++ch) {
+        int8_t from = c.swizzle.channel[ch];
+        step[ch] = from >= 0 ? c.srcChannels : 0;
+        offset[ch] = from >= 0 ? size_t(from) : n + (from == PixelSwizzle::One);
+    }
+    bool transfer = c.transfer != ColorTransfer::None;
+    int colors = c.dstChannels == 2 ? 1 : std::min(c.dstChannels, 3);
+
+    for (size_t y = 0; y < rows; ++y) {
+        toFloat(src + y * srcStride, in.data(), n);
+        float* d = out.data();
+        for (int ch = 0; ch < c.dstChannels; ++ch) {
+            const float* s = in.data() + offset[ch];
+            const size_t st = step[ch];
+            for (int x = 0; x < width; ++x)
+                d[x * c.dstChannels + ch] = s[x * st];
+        }
+        if (transfer) {
+            for (int x = 0; x < width; ++x, d += c.dstChannels) {
+                for (int ch = 0; ch < colors; ++ch) {
+                    if (c.transfer == ColorTransfer::LinearToSRGB)
+                        d[ch] = LinearToSRGB(d[ch]);
+                    else if (p.decodeLUT)
+                        d[ch] = p.decodeLUT[std::lrintf(d[ch] * 255.f)];
+                    else
+                        d[ch] = SRGBToLinear(d[ch]);
+                }
+            }
+        }
+        fromFloat(out.data(), dst + y * dstStride, out.size());
+    }
+}
+
+bool Valid(const PixelConversion& c) {
+    if (c.srcType < LAB_PIXEL_UINT || c.srcType >= Lab_PIXEL_LAST_TYPE ||
+        c.dstType < LAB_PIXEL_UINT || c.dstType >= Lab_PIXEL_LAST_TYPE)
+        return false;
+    if (c.srcChannels < 1 || c.srcChannels > 4 || c.dstChannels < 1 || c.dstChannels > 4)
+        return false;
+    for (int ch = 0; ch < c.dstChannels; ++ch) {
+        int8_t from = c.swizzle.channel[ch];
+        if (from >= c.srcChannels || (from < 0 && from != PixelSwizzle::Zero &&
+                                      from != PixelSwizzle::One))
+            return false;
+    }
+    return true;
+}
+
+} // anon
+
+//static
+PixelSwizzle PixelSwizzle::Expand(int srcChannels, int dstChannels) {
+    int srcAlpha = (srcChannels == 2 || srcChannels == 4) ? srcChannels - 1 : -1;
+    int srcColors = srcAlpha >= 0 ? srcChannels - 1 : srcChannels;
+    PixelSwizzle s = { { Zero, Zero, Zero, One } };
+    for (int ch = 0; ch < dstChannels && ch < 4; ++ch) {
+        if (!IsColorChannel(ch, dstChannels))
+            s.channel[ch] = srcAlpha >= 0 ? int8_t(srcAlpha) : One;
+        else if (ch < srcColors)
+            s.channel[ch] = int8_t(ch);
+        else
+            s.channel[ch] = srcColors == 1 ? 0 : Zero;
+    }
+    return s;
+}
+
+size_t PixelComponentSize(LabPixelType_t type) {
+    static const size_t componentSize[] = { 4, 2, 4, 1 };
+    return componentSize[type];
+}
+
+int PixelConvertLevel() {
+    int level = SupportedLevel();
+    int forced = gForcedLevel.load(std::memory_order_relaxed);
+    if (forced >= 0 && forced < level)
+        level = level == kNEON ? (int) kScalar : forced; // NEON has no level below it
+    return level;
+}
+
+void PixelConvertForceLevel(int level) {
+    gForcedLevel = level;
+}
+
+bool ConvertPixels(const PixelConversion& c, const void* src, size_t srcStride,
+                   void* dst, size_t dstStride, int width, int height) {
+    if (!Valid(c) || !src || !dst || width < 0 || height < 0)
+        return false;
+    if (!width || !height)
+        return true;
+
+    Plan p;
+    p.c = &c;
+    p.k = &KernelsFor(PixelConvertLevel());
+    p.srcPixel = PixelComponentSize(c.srcType) * c.srcChannels;
+    p.dstPixel = PixelComponentSize(c.dstType) * c.dstChannels;
+    p.direct = c.srcChannels == c.dstChannels && c.transfer == ColorTransfer::None;
+    for (int ch = 0; p.direct && ch < c.dstChannels; ++ch)
+        p.direct = c.swizzle.channel[ch] == ch;
+    p.copy = !p.direct && c.srcType == c.dstType && c.transfer == ColorTransfer::None;
+    p.decodeLUT = c.srcType == LAB_PIXEL_UINT8 && c.transfer == ColorTransfer::SRGBToLinear
+                ? SRGBDecodeLUT() : nullptr;
+
+    size_t srcRow = p.srcPixel * width;
+    size_t dstRow = p.dstPixel * width;
+    if (!srcStride)
+        srcStride = srcRow;
+    if (!dstStride)
+        dstStride = dstRow;
+    auto s = (const uint8_t*) src;
+    auto d = (uint8_t*) dst;
+
+    // packed rows of a direct conversion are one run of components
+    if (p.direct && srcStride == srcRow && dstStride == dstRow) {
+        width *= height;
+        height = 1;
+    }
+
+    // chunks of about 256KB of output; small images stay on this thread
+    constexpr size_t kChunkBytes = size_t(1) << 18;
+    size_t total = dstRow * height;
+    auto& pool = ThreadPool::Shared();
+    if (total < 4 * kChunkBytes || pool.Size() < 2) {
+        ConvertRows(p, s, srcStride, d, dstStride, width, height);
+        return true;
+    }
+
+    if (height == 1) {
+        // one long run, split on whole pixels
+        size_t pixels = std::max<size_t>(1, kChunkBytes / p.dstPixel);
+        ConvertFn fn = p.k->fn[c.srcType][c.dstType];
+        pool.ParallelFor(0, size_t(width), pixels, [&](size_t b, size_t e) {
+            fn(s + b * p.srcPixel, d + b * p.dstPixel, (e - b) * c.srcChannels);
+        });
+        return true;
+    }
+
+    size_t rows = std::max<size_t>(1, kChunkBytes / dstRow);
+    pool.ParallelFor(0, size_t(height), rows, [&](size_t b, size_t e) {
+        ConvertRows(p, s + b * srcStride, srcStride, d + b * dstStride, dstStride, width, e - b);
+    });
+    return true;
+}
+
+std::shared_ptr<LabImageData_t> ConvertImage(const LabImageData_t& image,
+                                             LabPixelType_t type, int channels,
+                                             ColorTransfer transfer) {
+    PixelConversion c(image.pixelType, image.channelCount, type, channels, transfer);
+    if (!Valid(c) || !image.data)
+        return nullptr;
+    auto result = TextureCache::AllocateImage(image.width, image.height, channels, type);
+    if (!result)
+        return nullptr;
+    result->dataWindowMinY = image.dataWindowMinY;
+    result->dataWindowMaxY = image.dataWindowMaxY;
+    if (!ConvertPixels(c, image.data, 0, result->data, 0, image.width, image.height))
+        return nullptr;
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// tests
+//-----------------------------------------------------------------------------
+
+namespace {
+
+const char* kLevelNames[kLevels] = { "scalar", "SSE4.1", "AVX2+F16C", "NEON" };
+const char* kTypeNames[4] = { "uint", "half", "float", "uint8" };
+
+// levels this machine can run, scalar first
+std::vector<int> RunnableLevels() {
+    std::vector<int> levels = { kScalar };
+    int best = SupportedLevel();
+    if (best == kNEON)
+        levels.push_back(kNEON);
+    else
+        for (int l = kSSE4; l <= best; ++l)
+            levels.push_back(l);
+    return levels;
+}
+
+bool SameFloat(float a, float b) {
+    if (std::isnan(a) || std::isnan(b))
+        return std::isnan(a) && std::isnan(b);
+    return std::bit_cast<uint32_t>(a) == std::bit_cast<uint32_t>(b);
+}
+
+bool SameHalf(uint16_t a, uint16_t b) {
+    bool nanA = (a & 0x7c00) == 0x7c00 && (a & 0x3ff);
+    bool nanB = (b & 0x7c00) == 0x7c00 && (b & 0x3ff);
+    return nanA || nanB ? nanA && nanB : a == b;
+}
+
+bool SameComponents(LabPixelType_t type, const uint8_t* a, const uint8_t* b, size_t n) {
+    switch (type) {
+        case LAB_PIXEL_HALF:
+            for (size_t i = 0; i < n; ++i)
+                if (!SameHalf(((const uint16_t*) a)[i], ((const uint16_t*) b)[i]))
+                    return false;
+            return true;
+        case LAB_PIXEL_FLOAT:
+            for (size_t i = 0; i < n; ++i)
+                if (!SameFloat(((const float*) a)[i], ((const float*) b)[i]))
+                    return false;
+            return true;
+        default:
+            return !memcmp(a, b, n * PixelComponentSize(type));
+    }
+}
+
+float ReferenceLoad(LabPixelType_t type, const uint8_t* p, int i) {
+    switch (type) {
+        case LAB_PIXEL_UINT:  return Component<LAB_PIXEL_UINT>::ToFloat(((const uint32_t*) p)[i]);
+        case LAB_PIXEL_HALF:  return Component<LAB_PIXEL_HALF>::ToFloat(((const uint16_t*) p)[i]);
+        case LAB_PIXEL_FLOAT: return ((const float*) p)[i];
+        default:              return Component<LAB_PIXEL_UINT8>::ToFloat(p[i]);
+    }
+}
+
+void ReferenceStore(LabPixelType_t type, uint8_t* p, int i, float v) {
+    switch (type) {
+        case LAB_PIXEL_UINT:  ((uint32_t*) p)[i] = FloatToUint32(v); break;
+        case LAB_PIXEL_HALF:  ((uint16_t*) p)[i] = FloatToHalf(v); break;
+        case LAB_PIXEL_FLOAT: ((float*) p)[i] = v; break;
+        default:              p[i] = FloatToUint8(v); break;
+    }
+}
+
+// the definition, a component at a time. Same type copies are exact.
+void ReferenceConvert(const PixelConversion& c, const uint8_t* src, uint8_t* dst, int pixels) {
+    size_t srcPixel = PixelComponentSize(c.srcType) * c.srcChannels;
+    size_t dstPixel = PixelComponentSize(c.dstType) * c.dstChannels;
+    for (int x = 0; x < pixels; ++x) {
+        const uint8_t* s = src + x * srcPixel;
+        uint8_t* d = dst + x * dstPixel;
+        for (int ch = 0; ch < c.dstChannels; ++ch) {
+            int8_t from = c.swizzle.channel[ch];
+            bool transfer = c.transfer != ColorTransfer::None && IsColorChannel(ch, c.dstChannels);
+            if (from >= 0 && c.srcType == c.dstType && c.transfer == ColorTransfer::None) {
+                size_t size = PixelComponentSize(c.srcType);
+                memcpy(d + ch * size, s + from * size, size);
+                continue;
+            }
+            float v = from >= 0 ? ReferenceLoad(c.srcType, s, from)
+                                : (from == PixelSwizzle::One ? 1.f : 0.f);
+            if (transfer)
+                v = c.transfer == ColorTransfer::LinearToSRGB ? LinearToSRGB(v) : SRGBToLinear(v);
+            ReferenceStore(c.dstType, d, ch, v);
+        }
+    }
+}
+
+// components that exercise rounding, clamping and the special values
+void FillRandom(LabPixelType_t type, uint8_t* p, size_t n, std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> bits;
+    std::uniform_real_distribution<float> unit(-0.25f, 1.25f);
+    static const float specials[] = { 0.f, -0.f, 1.f, 0.5f / 255.f, 1.5f / 255.f, 65504.f,
+                                      65520.f, 1e-8f, NAN, INFINITY, -INFINITY, 4294967296.f };
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t r = bits(rng);
+        switch (type) {
+            case LAB_PIXEL_UINT:  ((uint32_t*) p)[i] = r % 3 ? r & 0xffff : r; break;
+            case LAB_PIXEL_HALF:  ((uint16_t*) p)[i] = uint16_t(r); break;
+            case LAB_PIXEL_UINT8: p[i] = uint8_t(r); break;
+            default: {
+                float v;
+                if (r % 16 == 0)
+                    v = specials[(r >> 4) % (sizeof(specials) / sizeof(specials[0]))];
+                else if (r % 16 == 1)
+                    v = std::bit_cast<float>(bits(rng));
+                else
+                    v = unit(rng);
+                ((float*) p)[i] = v;
+                break;
+            }
+        }
+    }
+}
+
+} // anon
+
+int TestPixelConvert() {
+    int failures = 0;
+    const KernelTable& table = KernelTable::Get();
+    std::vector<int> levels = RunnableLevels();
+
+    auto check = [&failures](bool ok, const char* what) {
+        if (!ok) {
+            printf("  FAILED: %s\n", what);
+            ++failures;
+        }
+    };
+
+    // every half, through every level's half kernels, including the
+    // tails of the SIMD loops
+    std::vector<uint16_t> halves(65536);
+    for (uint32_t i = 0; i < 65536; ++i)
+        halves[i] = uint16_t(i);
+    std::vector<float> floats(65536), floatsRef(65536);
+    std::vector<uint16_t> back(65536);
+    std::vector<uint8_t> bytes(65536), bytesRef(65536);
+    for (uint32_t i = 0; i < 65536; ++i) {
+        floatsRef[i] = HalfToFloat(uint16_t(i));
+        bytesRef[i] = FloatToUint8(floatsRef[i]);
+    }
+    for (int l : levels) {
+        const Kernels& k = table.level[l];
+        char what[128];
+        k.fn[LAB_PIXEL_HALF][LAB_PIXEL_FLOAT](halves.data(), floats.data(), 65535);
+        k.fn[LAB_PIXEL_HALF][LAB_PIXEL_FLOAT](halves.data() + 65535, floats.data() + 65535, 1);
+        size_t bad = 0;
+        for (uint32_t i = 0; i < 65536; ++i)
+            bad += !SameFloat(floats[i], floatsRef[i]);
+        snprintf(what, sizeof(what), "%s: %zu halves convert to the wrong float", kLevelNames[l], bad);
+        check(!bad, what);
+
+        k.fn[LAB_PIXEL_FLOAT][LAB_PIXEL_HALF](floatsRef.data(), back.data(), 65536);
+        bad = 0;
+        for (uint32_t i = 0; i < 65536; ++i)
+            bad += !SameHalf(back[i], uint16_t(i));
+        snprintf(what, sizeof(what), "%s: %zu halves do not round trip through float", kLevelNames[l], bad);
+        check(!bad, what);
+
+        k.fn[LAB_PIXEL_HALF][LAB_PIXEL_UINT8](halves.data(), bytes.data(), 65536);
+        snprintf(what, sizeof(what), "%s: half to uint8 differs from the reference", kLevelNames[l]);
+        check(!memcmp(bytes.data(), bytesRef.data(), 65536), what);
+    }
+
+    // every uint8, both ways
+    uint8_t all[256];
+    float allRef[256];
+    for (int i = 0; i < 256; ++i) {
+        all[i] = uint8_t(i);
+        allRef[i] = i * kInv255;
+    }
+    for (int l : levels) {
+        const Kernels& k = table.level[l];
+        char what[128];
+        float f[256];
+        uint8_t u[256];
+        uint16_t h[256];
+        k.fn[LAB_PIXEL_UINT8][LAB_PIXEL_FLOAT](all, f, 256);
+        k.fn[LAB_PIXEL_FLOAT][LAB_PIXEL_UINT8](f, u, 256);
+        snprintf(what, sizeof(what), "%s: uint8 to float differs from the reference", kLevelNames[l]);
+        check(!memcmp(f, allRef, sizeof(f)), what);
+        snprintf(what, sizeof(what), "%s: uint8 does not round trip through float", kLevelNames[l]);
+        check(!memcmp(u, all, sizeof(u)), what);
+        k.fn[LAB_PIXEL_UINT8][LAB_PIXEL_HALF](all, h, 256);
+        k.fn[LAB_PIXEL_HALF][LAB_PIXEL_UINT8](h, u, 256);
+        snprintf(what, sizeof(what), "%s: uint8 does not round trip through half", kLevelNames[l]);
+        check(!memcmp(u, all, sizeof(u)), what);
+    }
+
+    // a sweep of float bit patterns, with a stride prime to the SIMD widths
+    // so that every lane sees every kind of value
+    {
+        const uint32_t step = 4093;
+        std::vector<float> sweep;
+        sweep.reserve((1ull << 32) / step + 1);
+        for (uint64_t b = 0; b < (1ull << 32); b += step)
+            sweep.push_back(std::bit_cast<float>(uint32_t(b)));
+        // the rounding boundaries of half and uint8
+        for (uint32_t i = 0; i < 65536; ++i) {
+            float f = HalfToFloat(uint16_t(i));
+            sweep.push_back(std::nextafter(f, INFINITY));
+            sweep.push_back(std::nextafter(f, -INFINITY));
+        }
+        for (int i = 0; i < 256; ++i) {
+            float mid = (i + 0.5f) / 255.f;
+            sweep.push_back(mid);
+            sweep.push_back(std::nextafter(mid, 0.f));
+            sweep.push_back(std::nextafter(mid, 2.f));
+        }
+        size_t n = sweep.size();
+        std::vector<uint16_t> hRef(n), h(n);
+        std::vector<uint8_t> uRef(n), u(n);
+        for (size_t i = 0; i < n; ++i) {
+            hRef[i] = FloatToHalf(sweep[i]);
+            uRef[i] = FloatToUint8(sweep[i]);
+        }
+        for (int l : levels) {
+            const Kernels& k = table.level[l];
+            char what[128];
+            k.fn[LAB_PIXEL_FLOAT][LAB_PIXEL_HALF](sweep.data(), h.data(), n);
+            k.fn[LAB_PIXEL_FLOAT][LAB_PIXEL_UINT8](sweep.data(), u.data(), n);
+            size_t badH = 0, badU = 0;
+            for (size_t i = 0; i < n; ++i) {
+                badH += !SameHalf(h[i], hRef[i]);
+                badU += u[i] != uRef[i];
+            }
+            snprintf(what, sizeof(what), "%s: %zu of %zu floats round to the wrong half",
+                     kLevelNames[l], badH, n);
+            check(!badH, what);
+            snprintf(what, sizeof(what), "%s: %zu of %zu floats quantize to the wrong uint8",
+                     kLevelNames[l], badU, n);
+            check(!badU, what);
+        }
+    }
+
+    // every pairing of types and channel counts, with and without a
+    // transfer, against the component at a time reference. The widths
+    // exercise the SIMD tails, and the last image is large enough to be
+    // split across the pool.
+    {
+        std::mt19937 rng(16);
+        const int widths[] = { 1, 7, 33, 1027 };
+        const ColorTransfer transfers[] = { ColorTransfer::None, ColorTransfer::SRGBToLinear,
+                                            ColorTransfer::LinearToSRGB };
+        int cases = 0;
+        for (int l : levels) {
+            PixelConvertForceLevel(l);
+            for (int st = 0; st < 4; ++st)
+            for (int dt = 0; dt < 4; ++dt)
+            for (int sc = 1; sc <= 4; ++sc)
+            for (int dc = 1; dc <= 4; ++dc)
+            for (ColorTransfer tr : transfers)
+            for (int w : widths) {
+                int h = w == 1027 && tr == ColorTransfer::None ? 300 : 3;
+                PixelConversion c((LabPixelType_t) st, sc, (LabPixelType_t) dt, dc, tr);
+                if (tr == ColorTransfer::None && w == 1027 && sc == dc && (st + dt + sc) % 2)
+                    c.swizzle = { { int8_t(sc - 1), 0, PixelSwizzle::One, PixelSwizzle::Zero } };
+                size_t srcPixel = PixelComponentSize(c.srcType) * sc;
+                size_t dstPixel = PixelComponentSize(c.dstType) * dc;
+                // a padded source stride, and a packed destination
+                size_t srcStride = srcPixel * w + 16;
+                std::vector<uint8_t> src(srcStride * h);
+                FillRandom(c.srcType, src.data(), src.size() / PixelComponentSize(c.srcType), rng);
+                std::vector<uint8_t> dst(dstPixel * w * h, 0xcd), ref(dst.size());
+                for (int y = 0; y < h; ++y)
+                    ReferenceConvert(c, src.data() + y * srcStride, ref.data() + y * dstPixel * w, w);
+                bool ok = ConvertPixels(c, src.data(), srcStride, dst.data(), 0, w, h) &&
+                          SameComponents(c.dstType, dst.data(), ref.data(), dst.size() / PixelComponentSize(c.dstType));
+                if (!ok) {
+                    char what[160];
+                    snprintf(what, sizeof(what), "%s: %s%d to %s%d, transfer %d, %dx%d",
+                             kLevelNames[l], kTypeNames[st], sc, kTypeNames[dt], dc, (int) tr, w, h);
+                    check(false, what);
+                }
+                ++cases;
+            }
+        }
+        PixelConvertForceLevel(-1);
+        printf("  %d conversions compared with the reference at %zu levels\n", cases, levels.size());
+    }
+
+    // invalid conversions are refused
+    {
+        uint8_t px[16] = {};
+        PixelConversion c(LAB_PIXEL_UINT8, 2, LAB_PIXEL_UINT8, 4);
+        c.swizzle.channel[0] = 3;
+        check(!ConvertPixels(c, px, 0, px, 0, 1, 1), "a swizzle from a missing channel is refused");
+        PixelConversion d(LAB_PIXEL_UINT8, 5, LAB_PIXEL_UINT8, 4);
+        check(!ConvertPixels(d, px, 0, px, 0, 1, 1), "five channels are refused");
+    }
+
+    printf("TestPixelConvert: %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
+int BenchmarkPixelConvert(int width, int height) {
+    struct Case {
+        const char* name;
+        LabPixelType_t srcType;
+        int srcChannels;
+        LabPixelType_t dstType;
+        int dstChannels;
+        ColorTransfer transfer;
+    };
+    const Case cases[] = {
+        { "half RGBA to float RGBA",  LAB_PIXEL_HALF,  4, LAB_PIXEL_FLOAT, 4, ColorTransfer::None },
+        { "float RGBA to half RGBA",  LAB_PIXEL_FLOAT, 4, LAB_PIXEL_HALF,  4, ColorTransfer::None },
+        { "uint8 RGBA to half RGBA",  LAB_PIXEL_UINT8, 4, LAB_PIXEL_HALF,  4, ColorTransfer::None },
+        { "float RGBA to uint8 RGBA", LAB_PIXEL_FLOAT, 4, LAB_PIXEL_UINT8, 4, ColorTransfer::None },
+        { "float RGB to half RGBA",   LAB_PIXEL_FLOAT, 3, LAB_PIXEL_HALF,  4, ColorTransfer::None },
+        { "uint8 gray to half RGBA",  LAB_PIXEL_UINT8, 1, LAB_PIXEL_HALF,  4, ColorTransfer::None },
+        { "sRGB uint8 to linear half", LAB_PIXEL_UINT8, 4, LAB_PIXEL_HALF, 4, ColorTransfer::SRGBToLinear },
+    };
+    std::vector<int> levels = RunnableLevels();
+    std::mt19937 rng(16);
+    int failures = 0;
+
+    printf("BenchmarkPixelConvert: %dx%d, GB/s of output, %d pool threads\n",
+           width, height, ThreadPool::Shared().Size());
+    printf("  %-26s", "conversion");
+    for (int l : levels)
+        printf(" %10s", kLevelNames[l]);
+    printf(" %10s\n", "pool");
+
+    for (const Case& bc : cases) {
+        PixelConversion c(bc.srcType, bc.srcChannels, bc.dstType, bc.dstChannels, bc.transfer);
+        size_t srcSize = PixelComponentSize(c.srcType) * c.srcChannels * size_t(width) * height;
+        size_t dstSize = PixelComponentSize(c.dstType) * c.dstChannels * size_t(width) * height;
+        std::vector<uint8_t> src(srcSize), dst(dstSize), first(dstSize);
+        FillRandom(c.srcType, src.data(), srcSize / PixelComponentSize(c.srcType), rng);
+
+        // rows one at a time keep the conversion on this thread
+        auto time = [&](bool pooled) {
+            using clock = std::chrono::steady_clock;
+            double best = 1e30;
+            for (int rep = 0; rep < 3; ++rep) {
+                auto t0 = clock::now();
+                if (pooled)
+                    ConvertPixels(c, src.data(), 0, dst.data(), 0, width, height);
+                else {
+                    size_t srcRow = srcSize / height, dstRow = dstSize / height;
+                    for (int y = 0; y < height; ++y)
+                        ConvertPixels(c, src.data() + y * srcRow, 0, dst.data() + y * dstRow, 0, width, 1);
+                }
+                best = std::min(best, std::chrono::duration<double>(clock::now() - t0).count());
+            }
+            return dstSize / best * 1e-9;
+        };
+
+        printf("  %-26s", bc.name);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            PixelConvertForceLevel(levels[i]);
+            printf(" %10.2f", time(false));
+            if (i == 0)
+                first = dst;
+            else if (!SameComponents(c.dstType, dst.data(), first.data(), dstSize / PixelComponentSize(c.dstType)))
+                ++failures;
+        }
+        PixelConvertForceLevel(-1);
+        printf(" %10.2f\n", time(true));
+        fflush(stdout);
+    }
+    if (failures)
+        printf("  FAILED: %d conversions differ between levels\n", failures);
+    return failures;
+}
+
+} // lab
@@ -0,0 +1,90 @@
+#ifndef Providers_Texture_PixelConvert_hpp
+#define Providers_Texture_PixelConvert_hpp
+
+#include "ImageData.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ Conversions between the pixel layouts of LabImageData_t, for texture
+ uploads and the inspector. Every conversion is defined as though through
+ float: uint8 components are normalized, so 255 is 1.0, and uint32
+ components are data, such as ids, and convert by value. Floats are
+ clamped when converted to an integer type, and NaN becomes zero.
+ Float to half rounds to nearest even.
+
+ The type conversions have SSE4.1, AVX2 with F16C, and NEON kernels,
+ chosen when first used, and a scalar reference. Every level produces the
+ same bits as the reference. Large images are converted in parallel on
+ the shared thread pool.
+ */
+
+namespace lab {
+
+enum class ColorTransfer {
+    None,
+    SRGBToLinear,
+    LinearToSRGB,
+};
+
+// the source channel of each destination channel, or Zero or One
+struct PixelSwizzle {
+    static constexpr int8_t Zero = -1;
+    static constexpr int8_t One = -2;
+    int8_t channel[4];
+
+    // gray expands to RGB, alpha is kept where both sides have it, and
+    // missing alpha is opaque. Two channels are gray and alpha.
+    static PixelSwizzle Expand(int srcChannels, int dstChannels);
+};
+
+struct PixelConversion {
+    LabPixelType_t srcType;
+    int srcChannels;
+    LabPixelType_t dstType;
+    int dstChannels;
+    PixelSwizzle swizzle;
+    // applied to the destination's color channels, never to alpha
+    ColorTransfer transfer = ColorTransfer::None;
+
+    PixelConversion(LabPixelType_t srcType, int srcChannels,
+                    LabPixelType_t dstType, int dstChannels,
+                    ColorTransfer transfer = ColorTransfer::None)
+    : srcType(srcType), srcChannels(srcChannels)
+    , dstType(dstType), dstChannels(dstChannels)
+    , swizzle(PixelSwizzle::Expand(srcChannels, dstChannels))
+    , transfer(transfer) {}
+};
+
+size_t PixelComponentSize(LabPixelType_t type);
+
+// converts width by height pixels. The strides are in bytes, and zero
+// means the rows are packed. Returns false if the conversion is invalid.
+bool ConvertPixels(const PixelConversion& conversion,
+                   const void* src, size_t srcStride,
+                   void* dst, size_t dstStride,
+                   int width, int height);
+
+// a converted copy of image, or null if the conversion is invalid
+std::shared_ptr<LabImageData_t> ConvertImage(const LabImageData_t& image,
+                                             LabPixelType_t type, int channels,
+                                             ColorTransfer transfer = ColorTransfer::None);
+
+// 0 scalar, 1 SSE4.1, 2 AVX2 and F16C, 3 NEON. Forcing a level caps the
+// level used, for tests and benchmarks; -1 removes the cap.
+int PixelConvertLevel();
+void PixelConvertForceLevel(int level);
+
+// converts every half, every uint8, and a sweep of float bit patterns,
+// then every pairing of types and channel counts at each level, against
+// the scalar reference.
+int TestPixelConvert();
+
+// reports GB/s of output for the common upload conversions at each level,
+// single threaded and on the shared pool
+int BenchmarkPixelConvert(int width, int height);
+
+} // lab
+
+#endif // Providers_Texture_PixelConvert_hpp
@@ -1,30 +1,425 @@
 
 #include "TextureCache.hpp"
+#include "TextureCacheEXR.hpp"
+#include "TextureDiskCache.hpp"
+#include "PixelConvert.hpp"
+#include "Lab/LabDirectories.h"
+#include "Lab/LabThreadPool.hpp"
 
 #ifdef HAVE_OPENEXR
 #include "openexr-c.h"
 #endif
 
 #include "stb_image.h"
+#include "parallel_hashmap/phmap.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <list>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace lab {
 
+namespace {
+    // enough for a handful of 8K float plates with their mips
+    constexpr size_t kDefaultMemoryBudget = size_t(4) << 30;
+
+    // every level of a cached image, the full resolution level first
+    typedef std::vector<std::shared_ptr<LabImageData_t>> ImageLevels;
+
+    size_t LevelBytes(const ImageLevels& levels) {
+        size_t bytes = 0;
+        for (auto& l : levels)
+            if (l)
+                bytes += l->dataSize;
+        return bytes;
+    }
+
+    // levels after the first may be named name_1, name_2, and so on; for
+    // compatibility name_0 also names the first level.
+    bool SplitLevelName(const std::string& name, std::string& base, size_t& level) {
+        auto underscore = name.rfind('_');
+        if (underscore == std::string::npos || underscore + 1 == name.size())
+            return false;
+        level = 0;
+        for (size_t i = underscore + 1; i < name.size(); ++i) {
+            if (name[i] < '0' || name[i] > '9')
+                return false;
+            level = level * 10 + (name[i] - '0');
+        }
+        base = name.substr(0, underscore);
+        return true;
+    }
+
+    ImageLevels Decode(const char* path);
+    std::shared_ptr<LabImageData_t> DecodeLevel(const char* path, int level,
+                                                int x, int y, int width, int height);
+}
+
+// a recency stamp that may be bumped while a shard is only read locked
+struct UseStamp {
+    mutable std::atomic<uint64_t> value;
+    UseStamp(uint64_t v = 0) : value(v) {}
+    UseStamp(const UseStamp& s) : value(s.value.load(std::memory_order_relaxed)) {}
+    UseStamp& operator=(const UseStamp& s) {
+        value.store(s.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+    void Touch(uint64_t v) const { value.store(v, std::memory_order_relaxed); }
+    uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// All the levels of an image are one entry, so that they are inserted and
+// evicted together, and a reader never sees some levels of one version of an
+// image and some of another.
 struct CacheEntry {
     std::string path;
-    std::shared_ptr<LabImageData_t> image;
+    ImageLevels levels;
+    size_t bytes = 0;
+    UseStamp lastUse;
 };
 
+// A read that has been requested but not yet cached. While queued it may be
+// cancelled, reprioritized, or stolen by a synchronous read of the same path.
+struct PendingRead {
+    std::string path;
+    std::promise<std::shared_ptr<LabImageData_t>> promise;
+    std::shared_future<std::shared_ptr<LabImageData_t>> future;
+    std::pair<int, uint64_t> order;     // the queue key, while queued
+    bool queued = false;
+};
+
+// The statistics of one image. Whoever claims it first, the pool or a
+// waiter, computes them; the image is held weakly so that a pending
+// computation does not keep an evicted image alive.
+struct StatsJob {
+    std::weak_ptr<LabImageData_t> image;
+    std::atomic<bool> claimed{false};
+    std::promise<std::shared_ptr<const ImageStats>> promise;
+    std::shared_future<std::shared_ptr<const ImageStats>> result = promise.get_future().share();
+
+    void Run() {
+        if (claimed.exchange(true))
+            return;
+        std::shared_ptr<ImageStats> stats;
+        if (auto img = image.lock()) {
+            stats = std::make_shared<ImageStats>();
+            if (!ComputeImageStats(*img, *stats))
+                stats.reset();
+        }
+        promise.set_value(stats);
+    }
+};
+
+// 2^4 shards, each with its own reader/writer lock
+typedef phmap::parallel_flat_hash_map<std::string, CacheEntry,
+            phmap::priv::hash_default_hash<std::string>,
+            phmap::priv::hash_default_eq<std::string>,
+            std::allocator<std::pair<const std::string, CacheEntry>>,
+            4, std::shared_mutex> CacheMap;
+
 struct TextureCache::data {
-    std::map<std::string, CacheEntry> cache;
+    CacheMap cache;
+    std::atomic<size_t> budget{kDefaultMemoryBudget};
+    std::atomic<size_t> resident{0};
+    std::atomic<uint64_t> clock{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    // pins are only taken when textures are bound, so one lock suffices.
+    // A shard lock may be held while taking pinMutex, never the reverse.
+    std::mutex pinMutex;
+    std::map<const LabImageData_t*, int> pins;
+
+    // serializes evictions, so that concurrent inserts do not each evict
+    // on behalf of the others
+    std::mutex evictMutex;
+
+    // guards the read queue. It may be held while taking a shard lock.
+    std::mutex readMutex;
+    std::map<std::string, std::shared_ptr<PendingRead>> inflight;
+    // ordered by descending priority, then by request order
+    std::map<std::pair<int, uint64_t>, std::shared_ptr<PendingRead>> queue;
+    uint64_t requests = 0;
+    int decodeThreads = 0;
+    std::unique_ptr<ThreadPool> decodePool;
+
+    // held by reads in progress, so that it may be replaced or disabled
+    // while they complete
+    std::mutex diskMutex;
+    std::shared_ptr<TextureDiskCache> disk;
+
+    // by image; an entry whose image has expired is stale, as its address
+    // may have been reused
+    std::mutex statsMutex;
+    std::map<const LabImageData_t*, std::shared_ptr<StatsJob>> stats;
+
+    void Insert(const std::string& name, const std::string& path, ImageLevels levels) {
+        size_t bytes = LevelBytes(levels);
+        uint64_t stamp = ++clock;
+        ImageLevels replaced;
+        // resident is adjusted under the shard lock, so that a concurrent
+        // removal of the same entry cannot subtract before this adds.
+        cache.lazy_emplace_l(name,
+            [&](CacheMap::value_type& v) {
+                replaced.swap(v.second.levels);
+                resident += bytes;
+                resident -= v.second.bytes;
+                v.second.path = path;
+                v.second.levels = std::move(levels);
+                v.second.bytes = bytes;
+                v.second.lastUse.Touch(stamp);
+            },
+            [&](auto&& ctor) {
+                resident += bytes;
+                ctor(name, CacheEntry{path, std::move(levels), bytes, UseStamp(stamp)});
+            });
+        Evict(name);
+        // the replaced pixels, if any, are freed here, outside of the lock
+    }
+
+    // adds levels below the entry of key, if its only level is still base,
+    // so that levels made from an image that has since been replaced are
+    // dropped rather than stored with its replacement
+    bool Extend(const std::string& key, const std::shared_ptr<LabImageData_t>& base,
+                const ImageLevels& levels) {
+        size_t bytes = LevelBytes(levels);
+        bool extended = false;
+        cache.modify_if(key, [&](CacheMap::value_type& v) {
+            if (v.second.levels.size() != 1 || v.second.levels[0] != base)
+                return;
+            v.second.levels.insert(v.second.levels.end(), levels.begin(), levels.end());
+            v.second.bytes += bytes;
+            resident += bytes;
+            extended = true;
+        });
+        if (extended)
+            Evict(key);
+        return extended;
+    }
+
+    // returns the levels of name, the level index name refers to, and the
+    // key and path of its entry. The level may not have been decoded yet.
+    bool Find(const std::string& name, ImageLevels& levels, size_t& level,
+              std::string* key = nullptr, std::string* path = nullptr) {
+        uint64_t stamp = ++clock;
+        auto copy = [&](const CacheMap::value_type& v) {
+            v.second.lastUse.Touch(stamp);
+            levels = v.second.levels;
+            if (key)
+                *key = v.first;
+            if (path)
+                *path = v.second.path;
+        };
+        level = 0;
+        if (!cache.if_contains(name, copy)) {
+            std::string base;
+            if (!SplitLevelName(name, base, level) || !cache.if_contains(base, copy)) {
+                ++misses;
+                return false;
+            }
+        }
+        if (level >= levels.size() || !levels[level]) {
+            ++misses;
+            return level < levels.size();
+        }
+        ++hits;
+        return true;
+    }
+
+    std::shared_ptr<LabImageData_t> Find(const std::string& name) {
+        ImageLevels levels;
+        size_t level;
+        std::string key, path;
+        if (!Find(name, levels, level, &key, &path))
+            return nullptr;
+        return levels[level] ? levels[level] : DecodeMissingLevel(key, path, level);
+    }
+
+    // after a miss, finds a read of path that completed before readMutex
+    // was taken. Reads insert their image before leaving inflight, so a
+    // path that is neither cached nor in flight here is not being read.
+    std::shared_ptr<LabImageData_t> FindCompleted(const std::string& path) {
+        if (!cache.contains(path))
+            return nullptr;
+        auto img = Find(path);
+        return img && img->channelCount != 0 ? img : nullptr;
+    }
+
+    // decodes a level that was not decoded when its image was read, and adds
+    // it to the entry. Two threads may decode the same level; the first to
+    // finish is kept.
+    std::shared_ptr<LabImageData_t> DecodeMissingLevel(const std::string& key,
+                                                       const std::string& path, size_t level) {
+        auto image = DecodeLevel(path.c_str(), (int) level, 0, 0, INT_MAX, INT_MAX);
+        if (!image)
+            return nullptr;
+        std::shared_ptr<LabImageData_t> result;
+        bool added = false;
+        cache.modify_if(key, [&](CacheMap::value_type& v) {
+            auto& levels = v.second.levels;
+            if (v.second.path != path || level >= levels.size())
+                return;     // replaced while decoding
+            if (!levels[level]) {
+                levels[level] = image;
+                v.second.bytes += image->dataSize;
+                resident += image->dataSize;
+                added = true;
+            }
+            result = levels[level];
+        });
+        if (added)
+            Evict(key);
+        return result ? result : image;
+    }
+
+    bool Remove(const std::string& name) {
+        ImageLevels removed;
+        bool erased = cache.erase_if(name, [&](CacheMap::value_type& v) {
+            removed.swap(v.second.levels);
+            resident -= v.second.bytes;
+            return true;
+        });
+        return erased;
+    }
+
+    // called with a shard lock held
+    bool IsPinned(const ImageLevels& levels) {
+        std::lock_guard<std::mutex> lock(pinMutex);
+        for (auto& l : levels)
+            if (pins.count(l.get()))
+                return true;
+        return false;
+    }
+
+    // evict the least recently used entries until the budget is met,
+    // sparing pinned images and keep.
+    void Evict(const std::string& keep) {
+        size_t limit = budget.load();
+        if (!limit || resident.load() <= limit)
+            return;
+        std::lock_guard<std::mutex> lock(evictMutex);
+        if (resident.load() <= limit)
+            return;
+
+        struct Candidate {
+            uint64_t lastUse;
+            std::string name;
+        };
+        std::vector<Candidate> candidates;
+        cache.for_each([&](const CacheMap::value_type& v) {
+            if (v.first != keep)
+                candidates.push_back({ v.second.lastUse.Get(), v.first });
+        });
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) { return a.lastUse < b.lastUse; });
+
+        for (auto& c : candidates) {
+            if (resident.load() <= limit)
+                break;
+            ImageLevels evicted;
+            cache.erase_if(c.name, [&](CacheMap::value_type& v) {
+                // skip entries used since the candidates were gathered
+                if (v.second.lastUse.Get() != c.lastUse || IsPinned(v.second.levels))
+                    return false;
+                evicted.swap(v.second.levels);
+                resident -= v.second.bytes;
+                ++evictions;
+                return true;
+            });
+        }
+    }
+
+    std::shared_ptr<TextureDiskCache> DiskCache() {
+        std::lock_guard<std::mutex> lock(diskMutex);
+        return disk;
+    }
+
+    // maps path from the disk cache, or decodes it. A decoded image's
+    // levels that were left for later are decoded before it is written to
+    // the disk cache, so that a later session has every level.
+    ImageLevels ReadLevels(const std::string& path) {
+        auto dc = DiskCache();
+        if (dc) {
+            ImageLevels levels = dc->Load(path.c_str());
+            if (!levels.empty())
+                return levels;
+        }
+        ImageLevels levels = Decode(path.c_str());
+        if (dc && !levels.empty()) {
+            bool complete = true;
+            for (size_t l = 1; l < levels.size(); ++l) {
+                if (!levels[l])
+                    levels[l] = DecodeLevel(path.c_str(), (int) l, 0, 0, INT_MAX, INT_MAX);
+                complete = complete && levels[l];
+            }
+            if (complete)
+                dc->Store(path.c_str(), levels);
+        }
+        return levels;
+    }
+
+    // decode a read that has been taken off the queue, cache it, and
+    // fulfil its promise. Called without readMutex held.
+    void Complete(std::shared_ptr<PendingRead> read) {
+        ImageLevels levels = ReadLevels(read->path);
+        std::shared_ptr<LabImageData_t> image = levels.empty() ? nullptr : levels[0];
+        if (image)
+            Insert(read->path, read->path, std::move(levels));
+        {
+            std::lock_guard<std::mutex> lock(readMutex);
+            inflight.erase(read->path);
+        }
+        read->promise.set_value(image);
+    }
+
+    // a decode pool job; each job decodes whichever queued read has the
+    // highest priority when it runs. There is one job per queued read, so a
+    // job finds the queue empty if its read was cancelled or stolen.
+    void DecodeNext() {
+        std::shared_ptr<PendingRead> read;
+        {
+            std::lock_guard<std::mutex> lock(readMutex);
+            if (queue.empty())
+                return;
+            read = queue.begin()->second;
+            queue.erase(queue.begin());
+            read->queued = false;
+        }
+        Complete(read);
+    }
+
+    // created on demand; called with readMutex held, which SetDecodeThreads
+    // takes to replace the pool
+    ThreadPool& DecodePool() {
+        if (!decodePool)
+            decodePool.reset(new ThreadPool(decodeThreads));
+        return *decodePool;
+    }
 };
 
 TextureCache* TextureCache::_instance = nullptr;
 
 TextureCache::TextureCache() {
     _self = new TextureCache::data();
-    _instance = this;
+    if (!_instance)
+        _instance = this;
 }
 
 TextureCache* TextureCache::instance() {
@@ -34,121 +429,357 @@ TextureCache* TextureCache::instance() {
 }
 
 TextureCache::~TextureCache() {
+    if (_instance == this)
+        _instance = nullptr;
+    CancelAll();
+    _self->decodePool.reset();  // waits for decodes in progress
     delete _self;
 }
 
+//static
+std::shared_ptr<LabImageData_t> TextureCache::AdoptImage(const LabImageData_t& image) {
+    return std::shared_ptr<LabImageData_t>(new LabImageData_t(image),
+                                           [](LabImageData_t* img) {
+                                               free(img->data);
+                                               delete img;
+                                           });
+}
+
+//static
+std::shared_ptr<LabImageData_t> TextureCache::AllocateImage(int width, int height, int channelCount,
+                                                            LabPixelType_t pixelType) {
+    static const size_t componentSize[] = { 4, 2, 4, 1 };
+    LabImageData_t img = {};
+    img.dataSize = componentSize[pixelType] * channelCount * size_t(width) * height;
+    img.data = (uint8_t*) malloc(img.dataSize);
+    if (!img.data)
+        return nullptr;
+    img.pixelType = pixelType;
+    img.channelCount = channelCount;
+    img.width = width;
+    img.height = height;
+    img.dataWindowMinY = 0;
+    img.dataWindowMaxY = height - 1;
+    return AdoptImage(img);
+}
+
 void TextureCache::Add(const char* name, std::shared_ptr<LabImageData_t> image) {
-    auto i = _self->cache.find(name);
-    if (i != _self->cache.end()) {
-        i->second = CacheEntry{std::string(name), image};
-    }
-    else {
-        _self->cache[name] = CacheEntry{std::string(name), image};;
-    }
+    _self->Insert(name, name, { image });
+}
+
+void TextureCache::AddLevels(const char* name, std::vector<std::shared_ptr<LabImageData_t>> levels) {
+    if (!levels.empty())
+        _self->Insert(name, name, std::move(levels));
 }
 
 void TextureCache::Erase(const char* name) {
-    auto i = _self->cache.find(name);
-    if (i != _self->cache.end()) {
-        _self->cache.erase(i);
+    if (!_self->Remove(name)) {
+        std::string base;
+        size_t level;
+        if (SplitLevelName(name, base, level))
+            _self->Remove(base);
     }
 }
 
 std::shared_ptr<LabImageData_t> TextureCache::Get(const char* name) {
-    auto i = _self->cache.find(name);
-    if (i != _self->cache.end()) {
-        return i->second.image;
+    return _self->Find(name);
+}
+
+std::vector<std::shared_ptr<LabImageData_t>> TextureCache::GetLevels(const char* name) {
+    ImageLevels levels;
+    size_t level;
+    _self->Find(name, levels, level);
+    return levels;
+}
+
+bool TextureCache::GenerateMips(const char* name, MipFilter filter) {
+    ImageLevels levels;
+    size_t level;
+    std::string key;
+    if (!_self->Find(name, levels, level, &key) || levels.empty() || !levels[0])
+        return false;
+    if (levels.size() > 1)
+        return true;
+    auto mips = GenerateMipLevels(*levels[0], filter);
+    if (mips.empty())
+        return levels[0]->width == 1 && levels[0]->height == 1;
+    return _self->Extend(key, levels[0], mips);
+}
+
+bool TextureCache::AddMipLevels(const char* name, std::shared_ptr<LabImageData_t> base,
+                                ImageLevels levels) {
+    return base && _self->Extend(name, base, levels);
+}
+
+void TextureCache::GenerateAllMips(MipFilter filter) {
+    std::vector<std::string> names;
+    _self->cache.for_each([&](const CacheMap::value_type& v) {
+        if (v.second.levels.size() == 1)
+            names.push_back(v.first);
+    });
+    // the levels of each image are resampled in bands on the same pool
+    ThreadPool::Shared().ParallelFor(0, names.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            GenerateMips(names[i].c_str(), filter);
+    });
+}
+
+std::shared_ptr<const ImageStats> TextureCache::GetImageStats(std::shared_ptr<LabImageData_t> image,
+                                                             bool wait) {
+    if (!image)
+        return nullptr;
+    std::shared_ptr<StatsJob> job;
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(_self->statsMutex);
+        auto& slot = _self->stats[image.get()];
+        if (!slot || slot->image.lock() != image) {
+            for (auto i = _self->stats.begin(); i != _self->stats.end();) {
+                if (i->second && i->second->image.expired())
+                    i = _self->stats.erase(i);
+                else
+                    ++i;
+            }
+            slot = std::make_shared<StatsJob>();
+            slot->image = image;
+            start = true;
+        }
+        job = slot;
     }
-    return nullptr;
+    if (start && !wait)
+        ThreadPool::Shared().Enqueue([job]() { job->Run(); });
+    if (wait) {
+        job->Run();
+        return job->result.get();
+    }
+    if (job->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return nullptr;
+    return job->result.get();
 }
 
-#ifdef HAVE_OPENEXR
-namespace {
-    int64_t exr_AssetRead_Func(
-            exr_const_context_t ctxt,
-            void*    userdata,
-            void*    buffer,
-            uint64_t sz,
-            uint64_t offset,
-            exr_stream_error_func_ptr_t error_cb)
+void TextureCache::SetMemoryBudget(size_t bytes) {
+    _self->budget = bytes;
+    _self->Evict(std::string());
+}
+
+size_t TextureCache::MemoryBudget() const {
+    return _self->budget;
+}
+
+void TextureCache::Pin(std::shared_ptr<LabImageData_t> image) {
+    std::lock_guard<std::mutex> lock(_self->pinMutex);
+    if (image)
+        ++_self->pins[image.get()];
+}
+
+void TextureCache::Unpin(std::shared_ptr<LabImageData_t> image) {
     {
-        FILE* f = (FILE*) userdata;
-        if (!f)
+        std::lock_guard<std::mutex> lock(_self->pinMutex);
+        auto i = _self->pins.find(image.get());
+        if (i == _self->pins.end() || --i->second > 0)
+            return;
+        _self->pins.erase(i);
+    }
+    _self->Evict(std::string());
+}
+
+bool TextureCache::EnableDiskCache(const char* directory, size_t maxBytes) {
+    namespace fs = std::filesystem;
+    std::string dir = directory ? directory : "";
+    if (dir.empty()) {
+        const char* temp = lab_temp_directory_path();
+        std::error_code ec;
+        dir = ((temp ? fs::path(temp) : fs::temp_directory_path(ec)) / "LabTextureCache").string();
+    }
+    auto dc = std::make_shared<TextureDiskCache>(dir, maxBytes);
+    std::error_code ec;
+    if (!fs::is_directory(dc->Directory(), ec))
+        return false;
+    std::lock_guard<std::mutex> lock(_self->diskMutex);
+    _self->disk = dc;
+    return true;
+}
+
+void TextureCache::DisableDiskCache() {
+    std::lock_guard<std::mutex> lock(_self->diskMutex);
+    _self->disk.reset();
+}
+
+void TextureCache::ClearDiskCache() {
+    if (auto dc = _self->DiskCache())
+        dc->Clear();
+}
+
+TextureCache::Stats TextureCache::GetStats() const {
+    Stats s;
+    s.bytesResident = _self->resident;
+    s.budget = _self->budget;
+    s.entries = _self->cache.size();
+    s.hits = _self->hits;
+    s.misses = _self->misses;
+    s.evictions = _self->evictions;
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        s.pendingReads = _self->inflight.size();
+    }
+    if (auto dc = _self->DiskCache()) {
+        auto ds = dc->GetStats();
+        s.diskHits = ds.hits;
+        s.diskMisses = ds.misses;
+        s.diskBytes = ds.bytes;
+    }
+    _self->cache.for_each([&](const CacheMap::value_type& v) {
+        if (_self->IsPinned(v.second.levels))
+            s.bytesPinned += v.second.bytes;
+    });
+    return s;
+}
+
+size_t TextureCache::CountResidentBytes() const {
+    size_t bytes = 0;
+    _self->cache.for_each([&](const CacheMap::value_type& v) {
+        bytes += LevelBytes(v.second.levels);
+    });
+    return bytes;
+}
+
+#ifdef HAVE_OPENEXR
+bool ExrSource::Open(const char* path) {
+#ifdef _WIN32
+    f = fopen(path, "rb");
+    return f != nullptr;
+#else
+    fd = open(path, O_RDONLY);
+    return fd >= 0;
+#endif
+}
+
+ExrSource::~ExrSource() {
+#ifdef _WIN32
+    if (f)
+        fclose(f);
+#else
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+int64_t ExrSource::Read(void* buffer, uint64_t size, uint64_t offset) {
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(mutex);
+    if (_fseeki64(f, (int64_t) offset, SEEK_SET) != 0)
+        return -1;
+    int64_t total = (int64_t) fread(buffer, 1, size, f);
+#else
+    int64_t total = 0;
+    while ((uint64_t) total < size) {
+        ssize_t n = pread(fd, (uint8_t*) buffer + total, size - total,
+                          (off_t) (offset + total));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
             return -1;
-        
-        fseek(f, offset, SEEK_SET);
-        return fread(buffer, 1, sz, f);
+        if (n == 0)
+            break;  // end of file
+        total += n;
     }
+#endif
+    bytesRead += total;
+    return total;
+}
+
+//static
+int64_t ExrSource::ReadFunc(exr_const_context_t, void* userdata, void* buffer,
+                            uint64_t size, uint64_t offset, exr_stream_error_func_ptr_t) {
+    return ((ExrSource*) userdata)->Read(buffer, size, offset);
+}
+
+ExrFile::~ExrFile() {
+    nanoexr_close(&_file);
+}
+
+bool ExrFile::Open(const char* path) {
+    return _source.Open(path) &&
+           nanoexr_open(&_file, path, &ExrSource::ReadFunc, &_source, 0) == EXR_ERR_SUCCESS;
 }
 
-std::shared_ptr<LabImageData_t> TextureCache::ReadAndCacheEXR(const char* path) {
-    std::shared_ptr<LabImageData_t> imgData = Get(path);
-    if (imgData && imgData->channelCount != 0)
-        return imgData;
+std::shared_ptr<LabImageData_t> ExrFile::Decode(int level, int x, int y, int width, int height) {
+    nanoexr_Region_t region;
+    if (!_file.exr ||
+        nanoexr_region_init(&_file, &region, level, x, y, width, height) != EXR_ERR_SUCCESS)
+        return nullptr;
+    auto image = TextureCache::AllocateImage(region.width, region.height, 4,
+                                             (LabPixelType_t) _file.pixelType);
+    if (!image)
+        return nullptr;
+    nanoexr_ImageData_t img = {};
+    img.data = image->data;
+    img.dataSize = image->dataSize;
+    img.pixelType = _file.pixelType;
+    img.channelCount = 4;
+    img.width = region.width;
+    img.height = region.height;
 
-    FILE* f = fopen(path, "rb");
-    if (!f)
+    // each range of chunks has its own decode pipeline, so ranges are a
+    // few times the pool size rather than single chunks
+    auto& pool = ThreadPool::Shared();
+    size_t grain = std::max<size_t>(1, region.chunkCount / (4 * size_t(pool.Size() + 1)));
+    std::atomic<bool> failed{false};
+    pool.ParallelFor(0, region.chunkCount, grain, [&](size_t b, size_t e) {
+        if (!failed && nanoexr_read_region_chunks(&_file, &region, &img, (int) b, (int) e)
+                            != EXR_ERR_SUCCESS)
+            failed = true;
+    });
+    if (failed)
         return nullptr;
+    pool.ParallelFor(0, img.height, 64, [&](size_t b, size_t e) {
+        nanoexr_fill_missing_channels(&_file, &img, (int) b, (int) e);
+    });
+    return image;
+}
+#endif
 
-    nanoexr_Reader_t exrReader;
-    nanoexr_set_defaults(path, &exrReader);
-    const int partIndex = 0;
-    const int channelsToRead = 4;
-    
-    exr_result_t rv = nanoexr_read_header(&exrReader, exr_AssetRead_Func,
-                                          nullptr, f,
-                                          partIndex);
-    
-    printf("Mips found: %d\n", exrReader.numMipLevels);
-
-    std::shared_ptr<LabImageData_t> img0 = nullptr;
-    for (int mip = 0; mip < exrReader.numMipLevels; ++mip) {
-        nanoexr_ImageData_t nimg;
-        rv = nanoexr_read_exr(path,
-                              exr_AssetRead_Func, f,
-                              &nimg, nullptr,
-                              channelsToRead,
-                              partIndex, mip);
-        if (rv != EXR_ERR_SUCCESS) {
-            printf("Load EXR failed %s, mip %d\n", path, mip);
-        }
-        else {
-            std::string name = std::string(path) + "_" + std::to_string(mip);
-            std::shared_ptr<LabImageData_t> img(new LabImageData_t());
-            if (!img0)
-                img0 = img;
-                        
-            img->data = nimg.data;
-            img->dataSize = nimg.dataSize;
-            img->pixelType = (LabPixelType_t) nimg.pixelType;
-            img->channelCount = nimg.channelCount;
-            img->width = nimg.width;
-            img->height = nimg.height;
-            img->dataWindowMinY = nimg.dataWindowMinY;
-            img->dataWindowMaxY = nimg.dataWindowMaxY;
-
-            printf("nimg width, height %d %d\n", nimg.width, nimg.height);
-            printf("img width, height %d %d\n", img->width, img->height);
-            _self->cache[name] = CacheEntry{std::string(path), img};
-            printf("nimg width, height %d %d\n", nimg.width, nimg.height);
-            printf("img width, height %d %d\n", img->width, img->height);
-
-            printf("Loaded EXR %s, mip %d\n", path, mip);
-            printf("mip info: \n");
-            printf("  width: %d\n", img->width);
-            printf("  height: %d\n", img->height);
-            printf("  data size: %zu\n", img->dataSize);
-        }
+namespace {
+
+#ifdef HAVE_OPENEXR
+// reads the header, and decodes the full resolution level. The remaining
+// levels are left null, and decoded when they are first requested.
+ImageLevels DecodeEXR(const char* path) {
+    ExrFile exr;
+    if (!exr.Open(path)) {
+        printf("Load EXR failed %s\n", path);
+        return {};
     }
-    return img0;
+    ImageLevels levels(exr.Levels());
+    levels[0] = exr.Decode(0, 0, 0, INT_MAX, INT_MAX);
+    if (!levels[0]) {
+        printf("Load EXR failed %s\n", path);
+        return {};
+    }
+    return levels;
 }
 #endif
 
-std::shared_ptr<LabImageData_t> TextureCache::ReadAndCacheSTB(const char* path) {
-    std::shared_ptr<LabImageData_t> imgData = Get(path);
-    if (imgData && imgData->channelCount != 0)
-        return imgData;
+bool IsEXR(const char* path) {
+    return strstr(path, ".exr") || strstr(path, ".EXR");
+}
 
+std::shared_ptr<LabImageData_t> DecodeLevel([[maybe_unused]] const char* path,
+                                            [[maybe_unused]] int level,
+                                            [[maybe_unused]] int x, [[maybe_unused]] int y,
+                                            [[maybe_unused]] int width,
+                                            [[maybe_unused]] int height) {
+#ifdef HAVE_OPENEXR
+    if (IsEXR(path)) {
+        ExrFile exr;
+        if (exr.Open(path))
+            return exr.Decode(level, x, y, width, height);
+    }
+#endif
+    return nullptr;
+}
+
+ImageLevels DecodeSTB(const char* path) {
     const int channels = 4; // force RGBA
     int imageFileChannelCount;
     int w, h;
@@ -156,76 +787,41 @@ std::shared_ptr<LabImageData_t> TextureCache::ReadAndCacheSTB(const char* path)
                                      &w, &h, &imageFileChannelCount, channels);
     
     if (!data)
-        return nullptr;
+        return {};
 
-    std::shared_ptr<LabImageData_t> img(new LabImageData_t());
-    img->data = (uint8_t*) data;
-    img->dataSize = 4 * w * h;
-    img->pixelType = LAB_PIXEL_UINT8;
-    img->channelCount = channels;
-    img->width = w;
-    img->height = h;
-    img->dataWindowMinY = 0;
-    img->dataWindowMaxY = h - 1;
-    _self->cache[std::string(path)] = CacheEntry{std::string(path), img};
-    return img;
+    LabImageData_t lid;
+    lid.data = (uint8_t*) data;
+    lid.dataSize = 4 * size_t(w) * h;
+    lid.pixelType = LAB_PIXEL_UINT8;
+    lid.channelCount = channels;
+    lid.width = w;
+    lid.height = h;
+    lid.dataWindowMinY = 0;
+    lid.dataWindowMaxY = h - 1;
+    return { TextureCache::AdoptImage(lid) };
 }
 
-std::shared_ptr<LabImageData_t> TextureCache::ReadAndCachePFM(const char* path) {
-    std::shared_ptr<LabImageData_t> imgData = Get(path);
-    if (imgData && imgData->channelCount != 0)
-        return imgData;
-
-    FILE* f = fopen(path, "rb");
-    if (!f)
-        return nullptr;
+ImageLevels DecodePFM(const char* path) {
+    auto image = TextureCache::ReadPFM(path);
+    if (!image)
+        return {};
+    return { image };
+}
 
-    char magic[3];
-    fscanf(f, "%2s\n", magic);
-    
-    if (magic[0] != 'P')
-        return nullptr;
-    
-    int channels = 1;
-    if (magic[1] == 'F')
-        channels = 3;
-    else if (magic[1] != 'f')
-        return nullptr;
-    
-    uint32_t w, h;
-    fscanf(f, "%d %d\n", &w, &h);
-    
-    // scale is meant to be a multiplier to convert to units
-    // such as watts per square meter, but it's ill defined.
-    // a negative value means little endian, else big.
-    // We are meant to use the absolute value of the scale.
-    float scale;
-    fscanf(f, "%f\n", &scale);
-    if (scale >= 0)
-        return nullptr; // bail, not swizzling big to little today
-    
-    size_t sz = sizeof(float) * w * h * channels;
-    float* data = (float*) malloc(sz);
-    fread((void*) data, 1, sz, f);
-    
-    /// @TODO swizzle the buffer if endianness doesn't match the CPU.
-    
-    fclose(f);
-
-    std::shared_ptr<LabImageData_t> img(new LabImageData_t());
-    img->data = (uint8_t*) data;
-    img->dataSize = sz;
-    img->pixelType = LAB_PIXEL_FLOAT;
-    img->channelCount = channels;
-    img->width = w;
-    img->height = h;
-    img->dataWindowMinY = 0;
-    img->dataWindowMaxY = h-1;
-
-    _self->cache[std::string(path)] = CacheEntry{std::string(path), img};
-    return img;
+ImageLevels Decode(const char* path) {
+    //if (strstr(path, ".avif") || strstr(path, ".AVIF"))
+    //    return DecodeAVIF(path);
+#ifdef HAVE_OPENEXR
+    if (IsEXR(path))
+        return DecodeEXR(path);
+#endif
+    if (strstr(path, ".pfm") || strstr(path, ".PFM"))
+        return DecodePFM(path);
+    return DecodeSTB(path);       // fallback to whatever STB provides
 }
 
+} // anon
+
 #if 0
 nanoexr_ImageData_t TextureActivity::ReadAndCacheAVIF(const char* path) {
     nanoexr_ImageData_t img = Cached(path);
@@ -285,44 +881,285 @@ nanoexr_ImageData_t TextureActivity::ReadAndCacheAVIF(const char* path) {
 #endif
 
 std::shared_ptr<LabImageData_t> TextureCache::ReadAndCache(const char* path) {
-    //if (strstr(path, ".avif") || strstr(path, ".AVIF"))
-    //    return ReadAndCacheAVIF(path);
-    if (strstr(path, ".exr") || strstr(path, ".EXR"))
-        return ReadAndCacheEXR(path);
-    if (strstr(path, ".pfm") || strstr(path, ".PFM"))
-        return ReadAndCachePFM(path);
-    return ReadAndCacheSTB(path);       // fallback to whatever STB provides
+    // hits only take the shard lock of their entry
+    auto img = _self->Find(path);
+    if (img && img->channelCount != 0)
+        return img;
+
+    std::shared_ptr<PendingRead> read;
+    std::shared_future<std::shared_ptr<LabImageData_t>> inProgress;
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        if ((img = _self->FindCompleted(path)))
+            return img;
+
+        auto i = _self->inflight.find(path);
+        if (i == _self->inflight.end()) {
+            read = std::make_shared<PendingRead>();
+            read->path = path;
+            read->future = read->promise.get_future().share();
+            _self->inflight[path] = read;
+        }
+        else if (i->second->queued) {
+            // the caller is waiting, so decode here rather than wait for a
+            // decode thread to take it from the queue.
+            read = i->second;
+            _self->queue.erase(read->order);
+            read->queued = false;
+        }
+        else
+            inProgress = i->second->future;
+    }
+    if (read) {
+        _self->Complete(read);
+        return read->future.get();
+    }
+    return inProgress.get();
 }
 
-void TextureCache::ExportCache(const char* path) {
-    for (const auto& i : _self->cache) {
-        exr_result_t rv;
-        std::string path = i.first;
-        auto slash = path.rfind('/');
-        if (slash == std::string::npos)
-            continue;
-        path = path + path.substr(slash + 1) + ".exr";
+TextureCache::ReadHandle TextureCache::ReadAndCacheAsync(const char* path, int priority) {
+    ReadHandle handle;
+    handle.path = path;
+    auto ready = [&handle](std::shared_ptr<LabImageData_t> img) {
+        std::promise<std::shared_ptr<LabImageData_t>> done;
+        done.set_value(std::move(img));
+        handle.image = done.get_future().share();
+        return handle;
+    };
 
-        LabPixelType_t typ = i.second.image->pixelType;
-        if (typ != LAB_PIXEL_HALF && typ != LAB_PIXEL_FLOAT)
-            continue;
+    // hits only take the shard lock of their entry
+    auto img = _self->Find(path);
+    if (img && img->channelCount != 0)
+        return ready(img);
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        if ((img = _self->FindCompleted(path)))
+            return ready(img);
+
+        auto i = _self->inflight.find(path);
+        if (i != _self->inflight.end()) {
+            auto& read = i->second;
+            if (read->queued && priority > -read->order.first) {
+                _self->queue.erase(read->order);
+                read->order.first = -priority;
+                _self->queue[read->order] = read;
+            }
+            handle.image = read->future;
+            return handle;
+        }
+
+        auto read = std::make_shared<PendingRead>();
+        read->path = path;
+        read->future = read->promise.get_future().share();
+        read->order = { -priority, _self->requests++ };
+        read->queued = true;
+        _self->inflight[path] = read;
+        _self->queue[read->order] = read;
+        handle.image = read->future;
+        _self->DecodePool().Enqueue([this]() { _self->DecodeNext(); });
+    }
+    return handle;
+}
+
+bool TextureCache::Prioritize(const char* path, int priority) {
+    std::lock_guard<std::mutex> lock(_self->readMutex);
+    auto i = _self->inflight.find(path);
+    if (i == _self->inflight.end() || !i->second->queued)
+        return false;
+    auto read = i->second;
+    _self->queue.erase(read->order);
+    read->order.first = -priority;
+    _self->queue[read->order] = read;
+    return true;
+}
+
+bool TextureCache::Cancel(const char* path) {
+    std::shared_ptr<PendingRead> read;
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        auto i = _self->inflight.find(path);
+        if (i == _self->inflight.end() || !i->second->queued)
+            return false;
+        read = i->second;
+        _self->queue.erase(read->order);
+        _self->inflight.erase(i);
+    }
+    read->promise.set_value(nullptr);
+    return true;
+}
+
+void TextureCache::CancelAll() {
+    std::vector<std::shared_ptr<PendingRead>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        for (auto& i : _self->queue) {
+            cancelled.push_back(i.second);
+            _self->inflight.erase(i.second->path);
+        }
+        _self->queue.clear();
+    }
+    for (auto& read : cancelled)
+        read->promise.set_value(nullptr);
+}
+
+void TextureCache::SetDecodeThreads(int threads) {
+    // queued reads remain queued; the new pool is created on demand, and
+    // the old one finishes its jobs before it is destroyed.
+    std::unique_ptr<ThreadPool> old;
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(_self->readMutex);
+        _self->decodeThreads = threads;
+        old = std::move(_self->decodePool);
+        queued = _self->queue.size();
+    }
+    old.reset();
+    std::lock_guard<std::mutex> lock(_self->readMutex);
+    for (size_t i = 0; i < queued; ++i)
+        _self->DecodePool().Enqueue([this]() { _self->DecodeNext(); });
+}
 
-        int componentSize = 2;
-        if (i.second.image->pixelType == LAB_PIXEL_FLOAT)
-            componentSize = sizeof(float);
-        int pixelStride = 4 * componentSize;
-        int lineStride = pixelStride * i.second.image->width;
-
-        rv = nanoexr_write_exr(
-            path.c_str(),
-            nullptr, nullptr,
-            i.second.image->width, i.second.image->height, false,
-            (exr_pixel_type_t) i.second.image->pixelType,
-            i.second.image->data,                     pixelStride, lineStride,
-            i.second.image->data + componentSize,     pixelStride, lineStride,
-            i.second.image->data + componentSize * 2, pixelStride, lineStride,
-            i.second.image->data + componentSize * 3, pixelStride, lineStride);
+bool TextureCache::ReadHandle::Ready() const {
+    return image.valid() &&
+           image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::shared_ptr<LabImageData_t> TextureCache::ReadHandle::Wait() const {
+    return image.valid() ? image.get() : nullptr;
+}
+
+//static
+std::shared_ptr<LabImageData_t> TextureCache::ReadRegion(const char* path, int level,
+                                                         int x, int y, int width, int height) {
+    return DecodeLevel(path, level, x, y, width, height);
+}
+
+#if !defined(__APPLE__)
+// hardware textures are only provided by the Metal provider at present
+int TextureCache::GetEncodedTexture(std::shared_ptr<LabImageData_t>) {
+    return -1;
+}
+
+void TextureCache::ReleaseEncodedTexture(std::shared_ptr<LabImageData_t>) {
+}
+#endif
+
+namespace {
+    LabPixelType_t ExportType(const LabImageData_t& image, LabPixelType_t requested) {
+        if (requested == LAB_PIXEL_HALF || requested == LAB_PIXEL_FLOAT)
+            return requested;
+        if (image.pixelType == LAB_PIXEL_HALF || image.pixelType == LAB_PIXEL_UINT8)
+            return LAB_PIXEL_HALF;
+        return LAB_PIXEL_FLOAT;
     }
+
+#ifdef HAVE_OPENEXR
+    exr_compression_t ExrCompression(ExportCompression compression) {
+        switch (compression) {
+            case ExportCompression::None: return EXR_COMPRESSION_NONE;
+            case ExportCompression::RLE:  return EXR_COMPRESSION_RLE;
+            case ExportCompression::ZIPS: return EXR_COMPRESSION_ZIPS;
+            case ExportCompression::ZIP:  return EXR_COMPRESSION_ZIP;
+            case ExportCompression::PIZ:  return EXR_COMPRESSION_PIZ;
+        }
+        return EXR_COMPRESSION_ZIPS;
+    }
+
+    // writes an RGBA image as a scanline file. The chunks are compressed in
+    // parallel a batch at a time, and each batch is written in order, so
+    // that the compressed file is never held whole.
+    bool WriteEXR(const char* path, const LabImageData_t& image, exr_compression_t compression) {
+        nanoexr_ImageData_t level = {};
+        level.data = image.data;
+        level.dataSize = image.dataSize;
+        level.pixelType = (exr_pixel_type_t) image.pixelType;
+        level.channelCount = image.channelCount;
+        level.width = image.width;
+        level.height = image.height;
+        nanoexr_Writer_t writer;
+        if (nanoexr_writer_open(&writer, path, nullptr, nullptr, &level, 1, 0, compression)
+                != EXR_ERR_SUCCESS)
+            return false;
+
+        const int batch = 256;
+        std::vector<nanoexr_EncodedChunk_t> chunks(batch);
+        auto& pool = ThreadPool::Shared();
+        size_t grain = std::max<size_t>(1, batch / (4 * size_t(pool.Size() + 1)));
+        exr_result_t rv = EXR_ERR_SUCCESS;
+        for (int first = 0; first < writer.chunkCount && rv == EXR_ERR_SUCCESS; first += batch) {
+            int last = std::min(first + batch, writer.chunkCount);
+            std::atomic<bool> failed{false};
+            pool.ParallelFor(first, last, grain, [&](size_t b, size_t e) {
+                if (nanoexr_writer_encode_chunks(&writer, (int) b, (int) e, &chunks[b - first])
+                        != EXR_ERR_SUCCESS)
+                    failed = true;
+            });
+            if (failed) {
+                nanoexr_free_encoded_chunks(chunks.data(), last - first);
+                rv = EXR_ERR_UNKNOWN;
+            }
+            else
+                rv = nanoexr_writer_write_chunks(&writer, first, last, chunks.data());
+        }
+        exr_result_t finish = nanoexr_writer_close(&writer);
+        return rv == EXR_ERR_SUCCESS && finish == EXR_ERR_SUCCESS;
+    }
+#endif
+}
+
+std::vector<ExportedFile> TextureCache::ExportCache(const char* directory,
+                                                    const ExportOptions& options) {
+    namespace fs = std::filesystem;
+    using clock = std::chrono::steady_clock;
+    std::vector<std::pair<std::string, std::shared_ptr<LabImageData_t>>> entries;
+    _self->cache.for_each([&](const CacheMap::value_type& v) {
+        for (size_t l = 0; l < v.second.levels.size(); ++l)
+            if (v.second.levels[l])
+                entries.push_back({ l ? v.first + "_" + std::to_string(l) : v.first,
+                                    v.second.levels[l] });
+    });
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // entries from different directories may share a file name, so the
+    // names are made unique before any are written
+    std::vector<ExportedFile> files(entries.size());
+    std::vector<std::string> used;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        std::string base = entries[i].first;
+        auto slash = base.find_last_of("/\\");
+        if (slash != std::string::npos)
+            base = base.substr(slash + 1);
+        if (base.empty())
+            base = "image";
+        std::string name = base;
+        for (int n = 2; std::find(used.begin(), used.end(), name) != used.end(); ++n)
+            name = base + "-" + std::to_string(n);
+        used.push_back(name);
+        files[i].name = entries[i].first;
+        files[i].path = (fs::path(directory) / (name + ".exr")).string();
+    }
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    ThreadPool::Shared().ParallelFor(0, entries.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) {
+            auto start = clock::now();
+            const LabImageData_t& image = *entries[i].second;
+            LabPixelType_t type = ExportType(image, options.pixelType);
+            std::shared_ptr<LabImageData_t> rgba = entries[i].second;
+            if (image.pixelType != type || image.channelCount != 4)
+                rgba = ConvertImage(image, type, 4);
+#ifdef HAVE_OPENEXR
+            files[i].ok = rgba && WriteEXR(files[i].path.c_str(), *rgba,
+                                           ExrCompression(options.compression));
+#endif
+            std::error_code fec;
+            files[i].bytes = files[i].ok ? (size_t) fs::file_size(files[i].path, fec) : 0;
+            files[i].ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+    });
+    return files;
 }
 
 } // lab
@@ -3,19 +3,44 @@
 #define Providers_Texture_hpp
 
 #include "ImageData.h"
+#include "ImageStats.hpp"
+#include "MipChain.hpp"
+#include <cstdint>
+#include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace lab {
 
+// the lossless codecs of OpenEXRCore
+enum class ExportCompression {
+    None, RLE, ZIPS, ZIP, PIZ,
+};
+
+struct ExportOptions {
+    ExportCompression compression = ExportCompression::ZIPS;
+    // LAB_PIXEL_HALF or LAB_PIXEL_FLOAT; the default keeps half and
+    // float images as they are, writes uint8 images as half, and uint
+    // images as float.
+    LabPixelType_t pixelType = Lab_PIXEL_LAST_TYPE;
+};
+
+struct ExportedFile {
+    std::string name;   // the cache entry, with _N for level N
+    std::string path;
+    double ms = 0;
+    size_t bytes = 0;
+    bool ok = false;
+};
+
+// The cache may be used from any thread. Entries are held in a sharded hash
+// map, so that lookups only contend with writers to the same shard.
 class TextureCache {
     struct data;
     data* _self;
     static TextureCache* _instance;
 
-    std::shared_ptr<LabImageData_t> ReadAndCacheEXR(const char* path); // caller does not own the returned pointer
-    std::shared_ptr<LabImageData_t> ReadAndCachePFM(const char* path); // caller does not own the returned pointer
-    std::shared_ptr<LabImageData_t> ReadAndCacheSTB(const char* path); // caller does not own the returned pointer
-
 public:
     TextureCache();
     ~TextureCache();
@@ -23,12 +48,134 @@ public:
     void Add(const char* name, std::shared_ptr<LabImageData_t> image);
     void Erase(const char* name);
     std::shared_ptr<LabImageData_t> Get(const char* name); // caller does not own the returned pointer
-    void ExportCache(const char* path);
 
+    // the levels of a mip chain are added atomically, and are cached and
+    // evicted as one entry. Get(name) returns the full resolution level, and
+    // Get("name_N") returns level N. ReadAndCache caches EXR mips this way,
+    // but decodes only the full resolution level; the others are null in
+    // GetLevels until Get first requests them, and they are decoded.
+    void AddLevels(const char* name, std::vector<std::shared_ptr<LabImageData_t>> levels);
+    std::vector<std::shared_ptr<LabImageData_t>> GetLevels(const char* name);
+
+    // resamples the levels of an entry that has only its full resolution
+    // level, such as a PNG or a PFM, and stores them with it. Entries that
+    // already have levels keep them. Returns false if name is not cached,
+    // or the levels could not be made.
+    bool GenerateMips(const char* name, MipFilter filter = MipFilter::Box);
+    // GenerateMips for every entry, several entries at a time
+    void GenerateAllMips(MipFilter filter = MipFilter::Box);
+    // stores levels made from base below the entry of name, if base is
+    // still its only level, so that levels made from an image that has since
+    // been replaced are dropped. Returns false if they were dropped.
+    bool AddMipLevels(const char* name, std::shared_ptr<LabImageData_t> base,
+                      std::vector<std::shared_ptr<LabImageData_t>> levels);
+
+    // the statistics of image, computed once per image on the shared pool.
+    // A decoded or replaced image is a new image, so the statistics follow
+    // the pixels shown rather than the name. Without wait, returns null
+    // until they are ready; with it, computes them on the calling thread if
+    // they have not been started.
+    std::shared_ptr<const ImageStats> GetImageStats(std::shared_ptr<LabImageData_t> image,
+                                                    bool wait = false);
+
+    // writes every decoded level in the cache to directory as an RGBA
+    // scanline EXR named for the last component of its entry's name. Files
+    // are written in parallel on the shared pool, and the chunks of a large
+    // image are compressed in parallel and written in order.
+    std::vector<ExportedFile> ExportCache(const char* directory,
+                                          const ExportOptions& options = ExportOptions());
+
+    // reads and caches the image at path, blocking until it is decoded. If
+    // the path is already queued for an asynchronous read, the read is
+    // taken from the queue and decoded on the calling thread.
     std::shared_ptr<LabImageData_t> ReadAndCache(const char* path); // caller does not own the returned pointer
 
+    // a pending or completed asynchronous read; the image is null if the
+    // file could not be decoded, or the read was cancelled.
+    struct ReadHandle {
+        std::string path;
+        std::shared_future<std::shared_ptr<LabImageData_t>> image;
+        bool Ready() const;
+        std::shared_ptr<LabImageData_t> Wait() const;
+    };
+
+    // queues path to be decoded and cached by the decode pool. Requests for
+    // a path already in flight share the one read, and raise its priority if
+    // theirs is higher. Higher priorities are decoded first.
+    ReadHandle ReadAndCacheAsync(const char* path, int priority = 0);
+
+    // change the priority of a queued read, for example when the UI starts
+    // waiting on it. Returns false if the read is not queued.
+    bool Prioritize(const char* path, int priority);
+
+    // cancels a queued read, for every requester of the path. A read that
+    // is already decoding completes. Returns false if the read is not queued.
+    bool Cancel(const char* path);
+    void CancelAll();
+
+    // zero, the default, means one decode thread per hardware thread
+    void SetDecodeThreads(int threads);
+
+    // Decoded images may also be kept on disk, so that a later session maps
+    // them instead of decoding their sources again. Entries hold every level,
+    // are keyed by a hash of the source's path, size and modification time,
+    // and are removed least recently used first when the directory exceeds
+    // maxBytes. A null directory is LabTextureCache in the temp directory.
+    // Images loaded from the disk cache are read only.
+    bool EnableDiskCache(const char* directory = nullptr, size_t maxBytes = size_t(8) << 30);
+    void DisableDiskCache();
+    void ClearDiskCache();
+
+    // decodes a region of one level of the EXR at path, reading only the
+    // tiles or scanlines that overlap it. The result is RGBA, and is not
+    // cached. Returns null for other formats.
+    static std::shared_ptr<LabImageData_t> ReadRegion(const char* path, int level,
+                                                      int x, int y, int width, int height);
+
     // on Mac and ios, the returned int can be provided to the MetalProvider to get a texture handle.
+    // The image is pinned in the cache until ReleaseEncodedTexture is called.
     int GetEncodedTexture(std::shared_ptr<LabImageData_t> image);
+    void ReleaseEncodedTexture(std::shared_ptr<LabImageData_t> image);
+
+    // When the decoded images exceed the memory budget, the least recently
+    // used are evicted. Pinned images, and the most recently added image,
+    // are never evicted. Pins are counted. A budget of zero means unlimited.
+    void SetMemoryBudget(size_t bytes);
+    size_t MemoryBudget() const;
+    void Pin(std::shared_ptr<LabImageData_t> image);
+    void Unpin(std::shared_ptr<LabImageData_t> image);
+
+    struct Stats {
+        size_t   bytesResident = 0;
+        size_t   bytesPinned = 0;
+        size_t   budget = 0;
+        size_t   entries = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t   pendingReads = 0;
+        uint64_t diskHits = 0;
+        uint64_t diskMisses = 0;
+        size_t   diskBytes = 0;
+    };
+    Stats GetStats() const;
+    // the bytes of every entry's levels, counted entry by entry, which is
+    // bytesResident when the accounting is consistent
+    size_t CountResidentBytes() const;
+
+    // an image whose malloc'd pixels are freed with the last reference
+    static std::shared_ptr<LabImageData_t> AllocateImage(int width, int height, int channelCount,
+                                                         LabPixelType_t pixelType);
+    // takes ownership of image.data, which must have been malloc'd
+    static std::shared_ptr<LabImageData_t> AdoptImage(const LabImageData_t& image);
+
+    // maps the PFM at path, and copies its rows out of the mapping in
+    // parallel, flipping them to top down, and byte swapping them if the
+    // file's byte order is not the machine's. If bottomUp is true and no
+    // swap is needed, the image is the mapping itself, which is read only.
+    static std::shared_ptr<LabImageData_t> ReadPFM(const char* path, bool bottomUp = false);
+    // writes a 1 or 3 channel float image, in either byte order
+    static bool WritePFM(const char* path, const LabImageData_t& image, bool bigEndian = false);
 
     static TextureCache* instance();
 };
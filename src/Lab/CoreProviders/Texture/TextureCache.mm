@@ -1,12 +1,23 @@
 
 #include "TextureCache.hpp"
+#include "PixelConvert.hpp"
 #include "Lab/CoreProviders/Metal/MetalProvider.hpp"
 
 #include <map>
 
 namespace lab {
 
-static std::map<std::shared_ptr<LabImageData_t>, int> g_textureMap;
+// a texture, and the converted copy of the image it was created from, if
+// the image's layout could not be uploaded directly
+struct EncodedTexture {
+    int texture;
+    std::shared_ptr<LabImageData_t> upload;
+};
+
+static std::map<std::shared_ptr<LabImageData_t>, EncodedTexture> g_textureMap;
+
+static int CreateTexture(LabMetalProvider* provider, std::shared_ptr<LabImageData_t> image);
+static std::shared_ptr<LabImageData_t> UploadableImage(std::shared_ptr<LabImageData_t> image);
 
 int TextureCache::GetEncodedTexture(std::shared_ptr<LabImageData_t> image) {
     if (image == nullptr) {
@@ -15,7 +26,7 @@ int TextureCache::GetEncodedTexture(std::shared_ptr<LabImageData_t> image) {
 
     auto it = g_textureMap.find(image);
     if (it != g_textureMap.end()) {
-        return it->second;
+        return it->second.texture;
     }
 
     LabMetalProvider* provider = [LabMetalProvider sharedInstance];
@@ -23,33 +34,78 @@ int TextureCache::GetEncodedTexture(std::shared_ptr<LabImageData_t> image) {
         return -1;
     }
 
+    auto upload = UploadableImage(image);
+    if (!upload) {
+        return -1;
+    }
+
+    int texture = CreateTexture(provider, upload);
+    if (texture >= 0) {
+        // the texture refers to the uploaded pixels, so the image must stay
+        // resident until the texture is released, as must a converted copy.
+        g_textureMap[image] = { texture, upload != image ? upload : nullptr };
+        Pin(image);
+    }
+    return texture;
+}
+
+void TextureCache::ReleaseEncodedTexture(std::shared_ptr<LabImageData_t> image) {
+    auto it = g_textureMap.find(image);
+    if (it == g_textureMap.end()) {
+        return;
+    }
+    LabRemoveTexture(it->second.texture);
+    g_textureMap.erase(it);
+    Unpin(image);
+}
+
+// the image itself if the provider has a matching texture format, and
+// otherwise a copy expanded to RGBA of the same type, or to float for
+// uint32 data, which has no normalized texture format
+static std::shared_ptr<LabImageData_t> UploadableImage(std::shared_ptr<LabImageData_t> image) {
+    int channels = image->channelCount;
+    switch (image->pixelType) {
+        case LAB_PIXEL_UINT8:
+        case LAB_PIXEL_HALF:
+            if (channels == 4) {
+                return image;
+            }
+            return ConvertImage(*image, image->pixelType, 4);
+
+        case LAB_PIXEL_FLOAT:
+            if (channels == 1 || channels == 4) {
+                return image;
+            }
+            return ConvertImage(*image, LAB_PIXEL_FLOAT, 4);
+
+        case LAB_PIXEL_UINT:
+            return ConvertImage(*image, LAB_PIXEL_FLOAT, channels == 1 ? 1 : 4);
+
+        default:
+            return nullptr;
+    }
+}
+
+static int CreateTexture(LabMetalProvider* provider, std::shared_ptr<LabImageData_t> image) {
     switch (image->pixelType) {
         case LAB_PIXEL_UINT8:
             if (image->channelCount == 4) {
-                int texture = [provider CreateRGBA8Texture:image->width height:image->height rgba_pixels:image->data];
-                g_textureMap[image] = texture;
-                return texture;
+                return [provider CreateRGBA8Texture:image->width height:image->height rgba_pixels:image->data];
             }
             return -1;
 
         case LAB_PIXEL_HALF:
             if (image->channelCount == 4) {
-                int texture = [provider CreateRGBAf16Texture:image->width height:image->height rgba_pixels:image->data];
-                g_textureMap[image] = texture;
-                return texture;
+                return [provider CreateRGBAf16Texture:image->width height:image->height rgba_pixels:image->data];
             }
             return -1;
 
         case LAB_PIXEL_FLOAT:
             if (image->channelCount == 1) {
-                int texture = [provider CreateYf32Texture:image->width height:image->height rgba_pixels:image->data];
-                g_textureMap[image] = texture;
-                return texture;
+                return [provider CreateYf32Texture:image->width height:image->height rgba_pixels:image->data];
             }
             else if (image->channelCount == 4) {
-                int texture = [provider CreateRGBAf32Texture:image->width height:image->height rgba_pixels:image->data];
-                g_textureMap[image] = texture;
-                return texture;
+                return [provider CreateRGBAf32Texture:image->width height:image->height rgba_pixels:image->data];
             }
             return -1;
 
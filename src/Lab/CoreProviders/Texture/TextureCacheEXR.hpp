@@ -0,0 +1,57 @@
+#ifndef Providers_Texture_TextureCacheEXR_hpp
+#define Providers_Texture_TextureCacheEXR_hpp
+
+#ifdef HAVE_OPENEXR
+
+#include "ImageData.h"
+#include "openexr-c.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace lab {
+
+// Positional reads, so that chunks of one file can be read and decoded on
+// several threads at once. bytesRead is kept for the benchmark.
+struct ExrSource {
+#ifdef _WIN32
+    FILE* f = nullptr;
+    std::mutex mutex;   // there is no pread; seeks and reads are serialized
+#else
+    int fd = -1;
+#endif
+    std::atomic<uint64_t> bytesRead{0};
+
+    bool Open(const char* path);
+    ~ExrSource();
+
+    int64_t Read(void* buffer, uint64_t size, uint64_t offset);
+    static int64_t ReadFunc(exr_const_context_t, void* userdata, void* buffer,
+                            uint64_t size, uint64_t offset, exr_stream_error_func_ptr_t);
+};
+
+// An EXR file whose header has been read. Levels, or regions of them, are
+// read and decoded on request, their chunks spread over the shared pool.
+class ExrFile {
+    ExrSource _source;
+    nanoexr_File_t _file = {};
+
+public:
+    ~ExrFile();
+
+    bool Open(const char* path);
+
+    int Levels() const { return _file.numMipLevels; }
+    uint64_t BytesRead() const { return _source.bytesRead; }
+
+    // decodes the region of level, reading only the chunks that overlap it
+    std::shared_ptr<LabImageData_t> Decode(int level, int x, int y, int width, int height);
+};
+
+} // lab
+
+#endif // HAVE_OPENEXR
+
+#endif // Providers_Texture_TextureCacheEXR_hpp
@@ -0,0 +1,215 @@
+
+// Portable float maps. A PFM is a short text header followed by rows of
+// 32 bit floats, bottom row first. The sign of the header's scale gives
+// the byte order of the floats: negative is little endian, and positive
+// big endian.
+
+#include "TextureCache.hpp"
+#include "Lab/LabThreadPool.hpp"
+#include "Lab/LabText.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define LAB_PFM_SSE2 1
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define LAB_PFM_NEON 1
+#endif
+
+namespace lab {
+
+namespace {
+
+struct PFMHeader {
+    int channels = 0;
+    int width = 0;
+    int height = 0;
+    bool bigEndian = false;
+    size_t dataOffset = 0;
+};
+
+bool IsSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// parses the header from the mapped bytes; stdio cannot be pointed at a
+// mapping, and the mapping is not nul terminated.
+bool ParsePFMHeader(const uint8_t* p, size_t size, PFMHeader& h) {
+    if (size < 3 || p[0] != 'P' || (p[1] != 'F' && p[1] != 'f'))
+        return false;
+    h.channels = p[1] == 'F' ? 3 : 1;
+    size_t pos = 2;
+
+    // width, height and scale, separated by any amount of white space
+    std::string tokens[3];
+    for (auto& token : tokens) {
+        while (pos < size && IsSpace(p[pos]))
+            ++pos;
+        while (pos < size && !IsSpace(p[pos]) && token.size() < 32)
+            token.push_back((char) p[pos++]);
+        if (token.empty() || pos >= size || !IsSpace(p[pos]))
+            return false;
+    }
+    ++pos;  // exactly one white space character precedes the pixels
+
+    char* end;
+    long w = strtol(tokens[0].c_str(), &end, 10);
+    if (*end || w <= 0 || w > INT32_MAX)
+        return false;
+    long hgt = strtol(tokens[1].c_str(), &end, 10);
+    if (*end || hgt <= 0 || hgt > INT32_MAX)
+        return false;
+    float scale = strtof(tokens[2].c_str(), &end);
+    if (*end || scale == 0 || !std::isfinite(scale))
+        return false;
+
+    h.width = (int) w;
+    h.height = (int) hgt;
+    h.bigEndian = !std::signbit(scale);
+    h.dataOffset = pos;
+    uint64_t bytes = uint64_t(h.width) * uint64_t(h.height) * h.channels * sizeof(float);
+    return bytes <= size - pos;
+}
+
+uint32_t ByteSwap(uint32_t w) {
+    return (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+}
+
+// copies words 32 bit words from src to dst, reversing the bytes of each
+void SwapCopy(uint8_t* dst, const uint8_t* src, size_t words) {
+    size_t i = 0;
+#if defined(LAB_PFM_SSE2)
+    for (; i + 4 <= words; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 4));
+        // swap the bytes of each 16 bit half, then the halves
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)),
+                                _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*) (dst + i * 4), v);
+    }
+#elif defined(LAB_PFM_NEON)
+    for (; i + 4 <= words; i += 4)
+        vst1q_u8(dst + i * 4, vrev32q_u8(vld1q_u8(src + i * 4)));
+#endif
+    for (; i < words; ++i) {
+        uint32_t w;
+        memcpy(&w, src + i * 4, 4);
+        w = ByteSwap(w);
+        memcpy(dst + i * 4, &w, 4);
+    }
+}
+
+// copies height rows of rowBytes, reversing their order, and byte swapping
+// them if swap is true. Rows are spread over the shared pool.
+void FlipRows(uint8_t* dst, const uint8_t* src, size_t rowBytes, int height, bool swap) {
+    size_t grain = std::max<size_t>(1, (size_t(1) << 18) / std::max<size_t>(1, rowBytes));
+    ThreadPool::Shared().ParallelFor(0, height, grain, [&](size_t b, size_t e) {
+        for (size_t row = b; row < e; ++row) {
+            const uint8_t* from = src + (height - 1 - row) * rowBytes;
+            if (swap)
+                SwapCopy(dst + row * rowBytes, from, rowBytes / 4);
+            else
+                memcpy(dst + row * rowBytes, from, rowBytes);
+        }
+    });
+}
+
+constexpr bool kBigEndianHost = std::endian::native == std::endian::big;
+
+} // anon
+
+//static
+std::shared_ptr<LabImageData_t> TextureCache::ReadPFM(const char* path, bool bottomUp) {
+    tsStrView_t view = tsMapFile(path);
+    if (!view.curr)
+        return nullptr;
+    const uint8_t* bytes = (const uint8_t*) view.curr;
+    PFMHeader h;
+    if (!ParsePFMHeader(bytes, view.sz, h)) {
+        tsUnmapFile(&view);
+        return nullptr;
+    }
+
+    LabImageData_t lid = {};
+    lid.dataSize = size_t(h.width) * h.height * h.channels * sizeof(float);
+    lid.pixelType = LAB_PIXEL_FLOAT;
+    lid.channelCount = h.channels;
+    lid.width = h.width;
+    lid.height = h.height;
+    lid.dataWindowMinY = 0;
+    lid.dataWindowMaxY = h.height - 1;
+
+    const bool swap = h.bigEndian != kBigEndianHost;
+    const uint8_t* pixels = bytes + h.dataOffset;
+    if (bottomUp && !swap && (uintptr_t) pixels % alignof(float) == 0) {
+        // hand out the mapping; it is unmapped with the last reference
+        lid.data = (uint8_t*) pixels;
+        return std::shared_ptr<LabImageData_t>(new LabImageData_t(lid),
+                                               [view](LabImageData_t* img) mutable {
+                                                   tsUnmapFile(&view);
+                                                   delete img;
+                                               });
+    }
+
+    lid.data = (uint8_t*) malloc(lid.dataSize);
+    if (!lid.data) {
+        tsUnmapFile(&view);
+        return nullptr;
+    }
+    const size_t rowBytes = size_t(h.width) * h.channels * sizeof(float);
+    if (bottomUp) {
+        if (swap)
+            SwapCopy(lid.data, pixels, lid.dataSize / 4);
+        else
+            memcpy(lid.data, pixels, lid.dataSize);
+    }
+    else
+        FlipRows(lid.data, pixels, rowBytes, h.height, swap);
+    tsUnmapFile(&view);
+    return AdoptImage(lid);
+}
+
+//static
+bool TextureCache::WritePFM(const char* path, const LabImageData_t& image, bool bigEndian) {
+    if (image.pixelType != LAB_PIXEL_FLOAT || (image.channelCount != 1 && image.channelCount != 3) ||
+        image.width <= 0 || image.height <= 0)
+        return false;
+
+    // the scale is padded so that the pixels are float aligned in the file,
+    // and so can be handed out directly from a mapping
+    std::string header = std::string(image.channelCount == 3 ? "PF" : "Pf") + "\n" +
+                         std::to_string(image.width) + " " + std::to_string(image.height) + "\n";
+    std::string scale = bigEndian ? "1.0" : "-1.0";
+    while ((header.size() + scale.size() + 1) % alignof(float))
+        scale += "0";
+    header += scale + "\n";
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(header.data(), 1, header.size(), f) == header.size();
+    const size_t rowBytes = size_t(image.width) * image.channelCount * sizeof(float);
+    std::vector<uint8_t> swapped(rowBytes);
+    const bool swap = bigEndian != kBigEndianHost;
+    for (int row = image.height - 1; ok && row >= 0; --row) {
+        const uint8_t* src = image.data + row * rowBytes;
+        if (swap) {
+            SwapCopy(swapped.data(), src, rowBytes / 4);
+            src = swapped.data();
+        }
+        ok = fwrite(src, 1, rowBytes, f) == rowBytes;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+} // lab
@@ -0,0 +1,938 @@
+// Tests and benchmarks of the texture cache, through its public interface.
+
+#include "TextureCacheTests.hpp"
+#include "TextureCache.hpp"
+#include "TextureCacheEXR.hpp"
+#include "ImageColor.hpp"
+#include "ImageStats.hpp"
+#include "MipChain.hpp"
+#include "PixelConvert.hpp"
+
+#ifdef HAVE_OPENEXR
+#include "openexr-c.h"
+#endif
+
+#include "stb_image_write.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lab {
+
+namespace {
+    typedef std::vector<std::shared_ptr<LabImageData_t>> ImageLevels;
+
+    constexpr bool kBigEndianHost = std::endian::native == std::endian::big;
+
+    // counts the failed checks of one test, and reports each
+    struct Checker {
+        const char* test;
+        int failures = 0;
+
+        explicit Checker(const char* test) : test(test) {}
+
+        void operator()(bool ok, const std::string& what) {
+            if (!ok) {
+                printf("  %s test failed: %s\n", test, what.c_str());
+                ++failures;
+            }
+        }
+    };
+
+    // random bits, with halves and floats kept finite, and uint values
+    // exactly representable as floats
+    std::shared_ptr<LabImageData_t> NoiseImage(int width, int height, int channels,
+                                               LabPixelType_t type, uint32_t& seed) {
+        auto img = TextureCache::AllocateImage(width, height, channels, type);
+        size_t count = img->dataSize / PixelComponentSize(type);
+        for (size_t i = 0; i < count; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t v = seed ^ (seed >> 15);
+            switch (type) {
+                case LAB_PIXEL_HALF:
+                    if ((v & 0x7c00) == 0x7c00)
+                        v &= ~0x4000u;
+                    ((uint16_t*) img->data)[i] = (uint16_t) v;
+                    break;
+                case LAB_PIXEL_FLOAT:
+                    if ((v & 0x7f800000) == 0x7f800000)
+                        v &= ~0x40000000u;
+                    ((uint32_t*) img->data)[i] = v;
+                    break;
+                case LAB_PIXEL_UINT:
+                    ((uint32_t*) img->data)[i] = v & 0xffffff;
+                    break;
+                default:
+                    img->data[i] = (uint8_t) v;
+                    break;
+            }
+        }
+        return img;
+    }
+
+    // a float RGBA image of one value
+    std::shared_ptr<LabImageData_t> FilledImage(int width, int height, float value) {
+        auto img = TextureCache::AllocateImage(width, height, 4, LAB_PIXEL_FLOAT);
+        for (size_t i = 0; i < img->dataSize / sizeof(float); ++i)
+            ((float*) img->data)[i] = value;
+        return img;
+    }
+
+    // the pixel type ExportCache writes image as, as ExportOptions describes
+    LabPixelType_t ExportedType(const LabImageData_t& image, LabPixelType_t requested) {
+        if (requested == LAB_PIXEL_HALF || requested == LAB_PIXEL_FLOAT)
+            return requested;
+        if (image.pixelType == LAB_PIXEL_HALF || image.pixelType == LAB_PIXEL_UINT8)
+            return LAB_PIXEL_HALF;
+        return LAB_PIXEL_FLOAT;
+    }
+}
+
+namespace {
+    // a directory of noisy gradients, so that decoding is neither trivial
+    // nor dominated by reading the file
+    std::string SynthesizePNGs(const char* name, int count) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        std::string dir = (fs::temp_directory_path(ec) / name).string();
+        fs::create_directories(dir, ec);
+        const int side = 1024;
+        std::vector<uint8_t> rgba(size_t(side) * side * 4);
+        uint32_t seed = 1;
+        for (int i = 0; i < count; ++i) {
+            for (int y = 0; y < side; ++y)
+                for (int x = 0; x < side; ++x) {
+                    seed = seed * 1664525u + 1013904223u;
+                    uint8_t* p = &rgba[(size_t(y) * side + x) * 4];
+                    p[0] = (uint8_t) (x + i);
+                    p[1] = (uint8_t) (y ^ i);
+                    p[2] = (uint8_t) (seed >> 24);
+                    p[3] = 255;
+                }
+            std::string path = dir + "/synthetic_" + std::to_string(i) + ".png";
+            if (!fs::exists(path, ec))
+                stbi_write_png(path.c_str(), side, side, 4, rgba.data(), side * 4);
+        }
+        return dir;
+    }
+
+    std::vector<std::string> ImagesIn(const std::string& dir) {
+        namespace fs = std::filesystem;
+        std::vector<std::string> paths;
+        std::error_code ec;
+        for (auto& entry : fs::directory_iterator(dir, ec)) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            static const char* known[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp",
+                                           ".gif", ".hdr", ".exr", ".pfm" };
+            for (const char* k : known)
+                if (ext == k) {
+                    paths.push_back(entry.path().string());
+                    break;
+                }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+}
+
+int BenchmarkAsyncDecode(const char* directory, int maxThreads) {
+    std::string dir = directory ? directory : "";
+    if (dir.empty())
+        dir = SynthesizePNGs("lab_decode_benchmark", 32);
+    std::vector<std::string> paths = ImagesIn(dir);
+    if (paths.empty()) {
+        printf("No images to decode in %s\n", dir.c_str());
+        return 1;
+    }
+
+    printf("Decoding %zu images from %s\n", paths.size(), dir.c_str());
+    double serialMs = 0;
+    int failures = 0;
+    for (int threads = 1; threads <= std::max(1, maxThreads); threads *= 2) {
+        TextureCache tc;
+        tc.SetMemoryBudget(0);
+        tc.SetDecodeThreads(threads);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<TextureCache::ReadHandle> handles;
+        for (auto& p : paths)
+            handles.push_back(tc.ReadAndCacheAsync(p.c_str()));
+        size_t bytes = 0;
+        for (auto& h : handles) {
+            auto img = h.Wait();
+            if (img)
+                bytes += img->dataSize;
+            else
+                ++failures;
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+            serialMs = ms;
+        printf("  %2d threads: %9.2f ms, %7.1f MB/s decoded, %.2fx\n",
+               threads, ms, bytes / (ms * 1e3), serialMs / ms);
+    }
+    return failures;
+}
+
+#ifdef HAVE_OPENEXR
+namespace {
+    // writes a ZIP compressed, tiled and mip mapped half RGBA file of noisy
+    // gradients, with levels that differ so that mismatched reads are caught
+    bool WriteTiledEXR(const char* path, int size, int tile) {
+        std::vector<std::shared_ptr<LabImageData_t>> chain;
+        std::vector<nanoexr_ImageData_t> levels;
+        uint32_t seed = 1;
+        for (int l = 0; (size >> l) > 0; ++l) {
+            int side = size >> l;
+            auto img = TextureCache::AllocateImage(side, side, 4, LAB_PIXEL_HALF);
+            if (!img)
+                return false;
+            uint16_t* p = (uint16_t*) img->data;
+            for (int y = 0; y < side; ++y)
+                for (int x = 0; x < side; ++x, p += 4) {
+                    seed = seed * 1664525u + 1013904223u;
+                    p[0] = (uint16_t) (0x3800 + ((x << l) & 0x3ff));
+                    p[1] = (uint16_t) (0x3800 + ((y << l) & 0x3ff));
+                    p[2] = (uint16_t) (0x3800 + ((seed >> 22) & 0x3ff));
+                    p[3] = 0x3c00;
+                }
+            nanoexr_ImageData_t level = {};
+            level.data = img->data;
+            level.dataSize = img->dataSize;
+            level.pixelType = EXR_PIXEL_HALF;
+            level.channelCount = 4;
+            level.width = side;
+            level.height = side;
+            levels.push_back(level);
+            chain.push_back(img);
+        }
+        return nanoexr_write_tiled_exr(path, nullptr, nullptr, levels.data(), (int) levels.size(),
+                                       tile, EXR_COMPRESSION_ZIP) == EXR_ERR_SUCCESS;
+    }
+
+    // the previous reader; a seek and a read through one FILE* per chunk
+    struct CountingFile {
+        FILE* f;
+        uint64_t bytesRead;
+    };
+
+    int64_t CountingFileRead(exr_const_context_t, void* userdata, void* buffer,
+                             uint64_t size, uint64_t offset, exr_stream_error_func_ptr_t) {
+        CountingFile* cf = (CountingFile*) userdata;
+        fseek(cf->f, offset, SEEK_SET);
+        int64_t n = (int64_t) fread(buffer, 1, size, cf->f);
+        cf->bytesRead += n;
+        return n;
+    }
+
+    bool SamePixels(const LabImageData_t& a, const uint8_t* b, size_t bSize) {
+        return a.dataSize == bSize && !memcmp(a.data, b, bSize);
+    }
+}
+#endif
+
+int BenchmarkEXRLevels([[maybe_unused]] const char* path) {
+#ifndef HAVE_OPENEXR
+    printf("EXR level benchmark skipped, OpenEXR is not available\n");
+    return 0;
+#else
+    namespace fs = std::filesystem;
+    using clock = std::chrono::steady_clock;
+    auto msSince = [](clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(clock::now() - t).count();
+    };
+    std::error_code ec;
+    std::string file = path ? path : "";
+    if (file.empty()) {
+        file = (fs::temp_directory_path(ec) / "lab_exr_levels_benchmark.exr").string();
+        if (!fs::exists(file, ec) && !WriteTiledEXR(file.c_str(), 4096, 64)) {
+            printf("Could not write %s\n", file.c_str());
+            return 1;
+        }
+    }
+    printf("Reading %s, %.1f MB\n", file.c_str(), fs::file_size(file, ec) / 1e6);
+
+    // every level, as ReadAndCache used to
+    auto start = clock::now();
+    CountingFile cf = { fopen(file.c_str(), "rb"), 0 };
+    if (!cf.f) {
+        printf("Could not open %s\n", file.c_str());
+        return 1;
+    }
+    nanoexr_Reader_t reader;
+    nanoexr_set_defaults(file.c_str(), &reader);
+    nanoexr_read_header(&reader, CountingFileRead, nullptr, &cf, 0);
+    std::vector<nanoexr_ImageData_t> eager;
+    double eagerFirstMs = 0;
+    for (int level = 0; level < reader.numMipLevels; ++level) {
+        nanoexr_ImageData_t img = {};
+        if (nanoexr_read_exr(file.c_str(), CountingFileRead, &cf, &img, nullptr,
+                             4, 0, level) != EXR_ERR_SUCCESS)
+            break;
+        eager.push_back(img);
+        if (level == 0)
+            eagerFirstMs = msSince(start);
+    }
+    double eagerMs = msSince(start);
+    fclose(cf.f);
+    nanoexr_free_storage(&reader);
+
+    int failures = 0;
+    auto report = [](const char* what, double firstMs, double totalMs, uint64_t bytes) {
+        printf("  %-28s %9.2f ms to first level, %9.2f ms total, %8.2f MB read\n",
+               what, firstMs, totalMs, bytes / 1e6);
+    };
+    report("eager, every level", eagerFirstMs, eagerMs, cf.bytesRead);
+
+    // the full resolution level only
+    {
+        start = clock::now();
+        ExrFile exr;
+        bool opened = exr.Open(file.c_str());
+        auto level0 = opened ? exr.Decode(0, 0, 0, INT_MAX, INT_MAX) : nullptr;
+        double ms = msSince(start);
+        report("lazy, level 0", ms, ms, exr.BytesRead());
+        if (!level0 || eager.empty() || !SamePixels(*level0, eager[0].data, eager[0].dataSize)) {
+            printf("  lazy level 0 differs from the eager read\n");
+            ++failures;
+        }
+    }
+
+    // a preview level, as a viewer showing the whole image would want
+    int preview = std::min(3, (int) eager.size() - 1);
+    if (preview > 0) {
+        start = clock::now();
+        ExrFile exr;
+        auto level = exr.Open(file.c_str()) ? exr.Decode(preview, 0, 0, INT_MAX, INT_MAX) : nullptr;
+        double ms = msSince(start);
+        std::string what = "lazy, level " + std::to_string(preview);
+        report(what.c_str(), ms, ms, exr.BytesRead());
+        if (!level || !SamePixels(*level, eager[preview].data, eager[preview].dataSize)) {
+            printf("  lazy level %d differs from the eager read\n", preview);
+            ++failures;
+        }
+    }
+
+    // a region of the full resolution level, as a zoomed in viewer would want
+    if (!eager.empty()) {
+        const int side = 256;
+        int x = std::max(0, eager[0].width / 2 - side / 2 - 17);
+        int y = std::max(0, eager[0].height / 2 - side / 2 - 9);
+        start = clock::now();
+        ExrFile exr;
+        auto region = exr.Open(file.c_str()) ? exr.Decode(0, x, y, side, side) : nullptr;
+        double ms = msSince(start);
+        report("lazy, 256x256 region", ms, ms, exr.BytesRead());
+        bool same = region != nullptr;
+        const size_t pixelSize = eager[0].dataSize / (size_t(eager[0].width) * eager[0].height);
+        for (int row = 0; same && row < region->height; ++row)
+            same = !memcmp(region->data + size_t(row) * region->width * pixelSize,
+                           eager[0].data + (size_t(y + row) * eager[0].width + x) * pixelSize,
+                           region->width * pixelSize);
+        if (!same) {
+            printf("  the region differs from the eager read\n");
+            ++failures;
+        }
+    }
+
+    for (auto& img : eager)
+        nanoexr_release_image_data(&img);
+    printf("EXR levels: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+#endif
+}
+
+int BenchmarkDiskCache(const char* directory) {
+    namespace fs = std::filesystem;
+    using clock = std::chrono::steady_clock;
+    std::error_code ec;
+    std::string dir = directory ? directory : "";
+    if (dir.empty()) {
+        dir = SynthesizePNGs("lab_disk_cache_benchmark", 16);
+#ifdef HAVE_OPENEXR
+        std::string exr = dir + "/synthetic_mips.exr";
+        if (!fs::exists(exr, ec) && !WriteTiledEXR(exr.c_str(), 2048, 64))
+            printf("Could not write %s\n", exr.c_str());
+#endif
+    }
+    std::vector<std::string> paths = ImagesIn(dir);
+    if (paths.empty()) {
+        printf("No images to read in %s\n", dir.c_str());
+        return 1;
+    }
+    std::string entries = (fs::temp_directory_path(ec) / "lab_disk_cache_benchmark_entries").string();
+
+    // reads every level of every image, and sums their words, so that a
+    // mapped level is paged in as a decoded one would have been written
+    struct Pass {
+        double ms = 0;
+        size_t bytes = 0;
+        uint64_t sum = 0;
+        std::vector<ImageLevels> images;
+    };
+    auto run = [&](bool disk) {
+        TextureCache tc;
+        tc.SetMemoryBudget(0);
+        if (disk)
+            tc.EnableDiskCache(entries.c_str());
+        Pass pass;
+        auto start = clock::now();
+        for (auto& path : paths) {
+            if (!tc.ReadAndCache(path.c_str()))
+                continue;
+            size_t count = tc.GetLevels(path.c_str()).size();
+            for (size_t l = 1; l < count; ++l)
+                tc.Get((path + "_" + std::to_string(l)).c_str());
+            ImageLevels levels = tc.GetLevels(path.c_str());
+            for (auto& level : levels) {
+                if (!level)
+                    continue;
+                const uint8_t* p = level->data;
+                for (size_t i = 0; i + 8 <= level->dataSize; i += 8) {
+                    uint64_t w;
+                    memcpy(&w, p + i, 8);
+                    pass.sum += w;
+                }
+                pass.bytes += level->dataSize;
+            }
+            pass.images.push_back(std::move(levels));
+        }
+        pass.ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        return pass;
+    };
+
+    printf("Reading %zu images from %s\n", paths.size(), dir.c_str());
+    Pass plain = run(false);
+    printf("  decoded, no disk cache: %9.2f ms, %7.1f MB\n", plain.ms, plain.bytes / 1e6);
+
+    {
+        TextureCache tc;
+        if (!tc.EnableDiskCache(entries.c_str())) {
+            printf("Could not create %s\n", entries.c_str());
+            return 1;
+        }
+        tc.ClearDiskCache();
+    }
+    Pass cold = run(true);
+    printf("  cold, decoded and written: %6.2f ms, %7.1f MB\n", cold.ms, cold.bytes / 1e6);
+    Pass warm = run(true);
+    printf("  warm, mapped:       %13.2f ms, %7.1f MB, %.1fx faster than decoding\n",
+           warm.ms, warm.bytes / 1e6, plain.ms / warm.ms);
+
+    int failures = 0;
+    if (warm.images.size() != plain.images.size() || warm.sum != plain.sum || cold.sum != plain.sum) {
+        printf("  FAILED: the cached pixels differ from the decoded pixels\n");
+        ++failures;
+    }
+    for (size_t i = 0; i < std::min(warm.images.size(), plain.images.size()); ++i) {
+        auto& a = warm.images[i];
+        auto& b = plain.images[i];
+        bool same = a.size() == b.size();
+        for (size_t l = 0; same && l < a.size(); ++l)
+            same = a[l] && b[l] && a[l]->dataSize == b[l]->dataSize &&
+                   a[l]->width == b[l]->width && a[l]->pixelType == b[l]->pixelType &&
+                   !memcmp(a[l]->data, b[l]->data, a[l]->dataSize);
+        if (!same) {
+            printf("  FAILED: %s differs when mapped from the disk cache\n", paths[i].c_str());
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+int TestCacheMemoryBudget() {
+    const int side = 1024;                      // 4MB per RGBA8 image
+    const size_t imageBytes = size_t(side) * side * 4;
+    const size_t budget = 16 * imageBytes;
+    const int count = 256;
+
+    TextureCache tc;
+    tc.SetMemoryBudget(budget);
+
+    Checker check("TextureCache budget");
+
+    std::vector<std::weak_ptr<LabImageData_t>> added;
+    std::shared_ptr<LabImageData_t> pinned[2];
+    size_t maxResident = 0;
+    for (int i = 0; i < count; ++i) {
+        auto img = TextureCache::AllocateImage(side, side, 4, LAB_PIXEL_UINT8);
+        memset(img->data, i & 0xff, img->dataSize);
+        std::string name = "synthetic_" + std::to_string(i);
+        tc.Add(name.c_str(), img);
+        if (i < 2) {
+            pinned[i] = img;
+            tc.Pin(img);
+        }
+        added.push_back(img);
+
+        // touch an early image so that recency, not insertion order, decides
+        if (i > 8)
+            tc.Get("synthetic_8");
+
+        maxResident = std::max(maxResident, tc.GetStats().bytesResident);
+    }
+    pinned[0].reset();  // the cache holds the only remaining references
+
+    TextureCache::Stats s = tc.GetStats();
+    check(maxResident <= budget, "residency exceeded the budget");
+    check(s.bytesPinned == 2 * imageBytes, "pinned bytes");
+    check(s.evictions == (uint64_t) count - 16, "eviction count");
+    check(tc.Get("synthetic_0") && tc.Get("synthetic_1"), "a pinned image was evicted");
+    check(tc.Get("synthetic_8") != nullptr, "a recently used image was evicted");
+    check(tc.Get("synthetic_9") == nullptr, "a stale image was retained");
+    check(tc.Get((std::string("synthetic_") + std::to_string(count - 1)).c_str()) != nullptr,
+          "the newest image was evicted");
+
+    // evicted pixels are released once nothing else refers to them
+    size_t live = 0;
+    for (auto& w : added)
+        live += !w.expired();
+    check(live == 16, "evicted images were not released");
+
+    // a single image larger than the budget stays resident until replaced
+    auto big = TextureCache::AllocateImage(side * 5, side * 5, 4, LAB_PIXEL_UINT8);
+    tc.Add("big", big);
+    check(tc.Get("big") != nullptr, "an oversized image was not retained");
+    check(tc.GetStats().bytesResident == big->dataSize + 2 * imageBytes,
+          "an oversized image did not displace the unpinned images");
+    tc.Add("small", TextureCache::AllocateImage(side, side, 4, LAB_PIXEL_UINT8));
+    check(tc.Get("big") == nullptr, "an oversized image was not evicted");
+
+    // unpinning makes an image evictable, shrinking the budget evicts it
+    tc.Unpin(pinned[1]);
+    tc.Unpin(tc.Get("synthetic_0"));
+    tc.SetMemoryBudget(imageBytes);
+    s = tc.GetStats();
+    check(s.bytesResident <= imageBytes && s.bytesPinned == 0, "unpinned images were not evicted");
+
+    printf("TextureCache budget: %zu MB budget, max resident %zu MB, "
+           "%llu hits, %llu misses, %llu evictions: %s\n",
+           budget >> 20, maxResident >> 20,
+           (unsigned long long) s.hits, (unsigned long long) s.misses,
+           (unsigned long long) s.evictions, check.failures ? "FAILED" : "ok");
+    return check.failures;
+}
+
+int TestCacheConcurrentAccess(int threadsPerRole, int milliseconds) {
+    const int names = 64;
+    const int levels = 4;
+    const int side = 64;
+    TextureCache tc;
+    size_t chainBytes = 0;
+    for (int l = 0; l < levels; ++l)
+        chainBytes += size_t(side >> l) * (side >> l) * 4;
+    const size_t budget = chainBytes * names / 4;
+    tc.SetMemoryBudget(budget);
+
+    std::atomic<uint64_t> generation{0};
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::atomic<uint64_t> reads{0}, writes{0}, erases{0}, pins{0};
+
+    // every level of a chain is stamped with the chain's generation
+    auto makeChain = [&](uint64_t gen) {
+        std::vector<std::shared_ptr<LabImageData_t>> chain;
+        for (int l = 0; l < levels; ++l) {
+            auto img = TextureCache::AllocateImage(side >> l, side >> l, 4, LAB_PIXEL_UINT8);
+            memset(img->data, (int) (gen & 0xff), img->dataSize);
+            memcpy(img->data, &gen, sizeof(gen));
+            chain.push_back(img);
+        }
+        return chain;
+    };
+    auto stampOf = [](const std::shared_ptr<LabImageData_t>& img) {
+        uint64_t gen;
+        memcpy(&gen, img->data, sizeof(gen));
+        return gen;
+    };
+    auto name = [](uint32_t& seed) {
+        seed = seed * 1664525u + 1013904223u;
+        return "hammer_" + std::to_string((seed >> 16) % names);
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsPerRole; ++t) {
+        threads.emplace_back([&, t]() {     // writer
+            uint32_t seed = 1 + t;
+            while (!stop.load()) {
+                tc.AddLevels(name(seed).c_str(), makeChain(++generation));
+                ++writes;
+            }
+        });
+        threads.emplace_back([&, t]() {     // reader
+            uint32_t seed = 101 + t;
+            while (!stop.load()) {
+                std::string n = name(seed);
+                auto chain = tc.GetLevels(n.c_str());
+                for (auto& img : chain) {
+                    uint64_t gen = stampOf(img);
+                    if (gen != stampOf(chain[0]) ||
+                        img->data[img->dataSize - 1] != (uint8_t) (gen & 0xff))
+                        ++torn;
+                }
+                auto level = tc.Get((n + "_2").c_str());
+                if (level && level->width != side >> 2)
+                    ++torn;
+                ++reads;
+            }
+        });
+        threads.emplace_back([&, t]() {     // eraser
+            uint32_t seed = 201 + t;
+            while (!stop.load()) {
+                tc.Erase(name(seed).c_str());
+                ++erases;
+                std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&, t]() {     // pinner
+            uint32_t seed = 301 + t;
+            while (!stop.load()) {
+                auto img = tc.Get(name(seed).c_str());
+                if (img) {
+                    tc.Pin(img);
+                    std::this_thread::yield();
+                    tc.Unpin(img);
+                    ++pins;
+                }
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+
+    Checker check("TextureCache concurrency");
+    check(torn.load() == 0, "a reader saw a torn mip chain");
+
+    TextureCache::Stats s = tc.GetStats();
+    check(tc.CountResidentBytes() == s.bytesResident, "resident bytes do not match the entries");
+    check(s.bytesPinned == 0, "pins leaked");
+    tc.SetMemoryBudget(budget);
+    check(tc.GetStats().bytesResident <= budget, "residency exceeds the budget");
+
+    printf("TextureCache concurrency: %d threads, %llu reads, %llu writes, "
+           "%llu erases, %llu pins, %llu evictions: %s\n",
+           threadsPerRole * 4,
+           (unsigned long long) reads.load(), (unsigned long long) writes.load(),
+           (unsigned long long) erases.load(), (unsigned long long) pins.load(),
+           (unsigned long long) s.evictions, check.failures ? "FAILED" : "ok");
+    return check.failures;
+}
+
+int TestExportCache() {
+#ifndef HAVE_OPENEXR
+    printf("Export test skipped, OpenEXR is not available\n");
+    return 0;
+#else
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string dir = (fs::temp_directory_path(ec) / "lab_export_test").string();
+    fs::remove_all(dir, ec);
+
+    uint32_t seed = 7;
+
+    // odd sizes leave partial chunks, the large image spans several
+    // batches of chunks, and the two half_rgba entries share a file name
+    TextureCache tc;
+    tc.Add("test/half_rgba", NoiseImage(257, 131, 4, LAB_PIXEL_HALF, seed));
+    tc.Add("other/half_rgba", NoiseImage(33, 17, 4, LAB_PIXEL_HALF, seed));
+    tc.Add("test/float_rgba", NoiseImage(300, 97, 4, LAB_PIXEL_FLOAT, seed));
+    tc.Add("test/uint8_rgba", NoiseImage(128, 64, 4, LAB_PIXEL_UINT8, seed));
+    tc.Add("test/float_gray", NoiseImage(199, 61, 1, LAB_PIXEL_FLOAT, seed));
+    tc.Add("test/uint_rgba", NoiseImage(64, 33, 4, LAB_PIXEL_UINT, seed));
+    tc.Add("test/large", NoiseImage(1024, 768, 4, LAB_PIXEL_HALF, seed));
+    tc.AddLevels("test/mips", { NoiseImage(96, 80, 4, LAB_PIXEL_HALF, seed),
+                                NoiseImage(48, 40, 4, LAB_PIXEL_HALF, seed),
+                                NoiseImage(24, 20, 4, LAB_PIXEL_HALF, seed) });
+    const size_t expectedFiles = 10;
+
+    static const char* compressionNames[] = { "none", "RLE", "ZIPS", "ZIP", "PIZ" };
+    int failures = 0;
+    auto run = [&](ExportCompression compression, LabPixelType_t type) {
+        ExportOptions options;
+        options.compression = compression;
+        options.pixelType = type;
+        std::string out = dir + "/" + compressionNames[(int) compression] + "_" +
+                          (type == LAB_PIXEL_HALF ? "half" : type == LAB_PIXEL_FLOAT ? "float" : "default");
+        auto files = tc.ExportCache(out.c_str(), options);
+        double ms = 0, slowest = 0;
+        size_t bytes = 0;
+        int mismatches = 0;
+        for (auto& f : files) {
+            ms += f.ms;
+            slowest = std::max(slowest, f.ms);
+            bytes += f.bytes;
+            auto original = tc.Get(f.name.c_str());
+            auto expected = original ? ConvertImage(*original, ExportedType(*original, type), 4) : nullptr;
+            auto read = f.ok ? TextureCache::ReadRegion(f.path.c_str(), 0, 0, 0, INT_MAX, INT_MAX) : nullptr;
+            if (!expected || !read || read->pixelType != expected->pixelType ||
+                read->width != expected->width || read->height != expected->height ||
+                read->dataSize != expected->dataSize ||
+                memcmp(read->data, expected->data, read->dataSize)) {
+                printf("  %s does not read back as written\n", f.path.c_str());
+                ++mismatches;
+            }
+        }
+        if (files.size() != expectedFiles) {
+            printf("  %zu files exported, expected %zu\n", files.size(), expectedFiles);
+            ++mismatches;
+        }
+        printf("  %-4s %-7s %2zu files, %8.2f MB, %8.2f ms total, %7.2f ms slowest: %s\n",
+               compressionNames[(int) compression],
+               type == LAB_PIXEL_HALF ? "half" : type == LAB_PIXEL_FLOAT ? "float" : "default",
+               files.size(), bytes / 1e6, ms, slowest, mismatches ? "FAILED" : "ok");
+        failures += mismatches;
+    };
+    for (int c = 0; c <= (int) ExportCompression::PIZ; ++c) {
+        run((ExportCompression) c, LAB_PIXEL_HALF);
+        run((ExportCompression) c, LAB_PIXEL_FLOAT);
+    }
+    run(ExportCompression::ZIPS, Lab_PIXEL_LAST_TYPE);
+
+    fs::remove_all(dir, ec);
+    printf("Export cache: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+#endif
+}
+
+int TestGenerateMips() {
+    Checker check("GenerateMips");
+    uint32_t seed = 11;
+
+    TextureCache tc;
+    tc.Add("test/photo.png", NoiseImage(300, 200, 4, LAB_PIXEL_UINT8, seed));
+    tc.Add("test/plate.pfm", NoiseImage(129, 65, 3, LAB_PIXEL_FLOAT, seed));
+    tc.Add("test/dot.png", NoiseImage(1, 1, 4, LAB_PIXEL_UINT8, seed));
+    tc.AddLevels("test/mips.exr", { NoiseImage(64, 64, 4, LAB_PIXEL_HALF, seed),
+                                    NoiseImage(32, 32, 4, LAB_PIXEL_HALF, seed) });
+    size_t before = tc.GetStats().bytesResident;
+    tc.GenerateAllMips(MipFilter::Lanczos);
+
+    auto photo = tc.GetLevels("test/photo.png");
+    auto plate = tc.GetLevels("test/plate.pfm");
+    check(photo.size() == 9, "levels of a 300x200 image");
+    check(plate.size() == 8, "levels of a 129x65 image");
+    check(tc.GetLevels("test/dot.png").size() == 1, "a 1x1 image has no levels");
+    check(tc.GetLevels("test/mips.exr").size() == 2, "existing levels are kept");
+    auto level3 = tc.Get("test/photo.png_3");
+    check(level3 && level3->width == 37 && level3->height == 25 &&
+          level3->pixelType == LAB_PIXEL_UINT8 && level3->channelCount == 4, "level found by name");
+
+    size_t added = 0;
+    for (size_t l = 1; l < photo.size(); ++l)
+        added += photo[l]->dataSize;
+    for (size_t l = 1; l < plate.size(); ++l)
+        added += plate[l]->dataSize;
+    check(tc.GetStats().bytesResident == before + added, "resident bytes include the levels");
+
+    check(tc.GenerateMips("test/photo.png"), "an entry with levels");
+    check(tc.GetLevels("test/photo.png").size() == 9, "levels are not generated twice");
+    check(!tc.GenerateMips("test/missing.png"), "a missing entry");
+
+    // levels made from a replaced image are not stored with its replacement
+    tc.Add("test/replaced.png", NoiseImage(16, 16, 4, LAB_PIXEL_UINT8, seed));
+    auto stale = NoiseImage(16, 16, 4, LAB_PIXEL_UINT8, seed);
+    check(!tc.AddMipLevels("test/replaced.png", stale, GenerateMipLevels(*stale, MipFilter::Box)),
+          "levels of a replaced image");
+    check(tc.GetLevels("test/replaced.png").size() == 1, "the replacement is unchanged");
+
+    printf("GenerateMips: %s\n", check.failures ? "FAILED" : "ok");
+    return check.failures;
+}
+
+int TestGetImageStats() {
+    Checker check("GetImageStats");
+
+    TextureCache tc;
+    check(!tc.GetImageStats(nullptr), "no image");
+    tc.Add("test/a.pfm", FilledImage(64, 32, 0.5f));
+    auto a = tc.Get("test/a.pfm");
+    auto stats = tc.GetImageStats(a, true);
+    check(stats && stats->pixels == 64 * 32 && stats->max[0] == 0.5f, "statistics of an image");
+    check(tc.GetImageStats(a) == stats && tc.GetImageStats(a, true) == stats,
+          "statistics are computed once");
+
+    // an image whose statistics are queued, and then waited on
+    auto b = FilledImage(64, 32, 2.f);
+    tc.GetImageStats(b);
+    auto waited = tc.GetImageStats(b, true);
+    check(waited && waited->min[3] == 2.f, "waiting on queued statistics");
+
+    tc.Add("test/a.pfm", FilledImage(64, 32, 4.f));
+    auto replaced = tc.GetImageStats(tc.Get("test/a.pfm"), true);
+    check(replaced && replaced != stats && replaced->mean[1] == 4.0, "a replaced image");
+
+    printf("GetImageStats: %s\n", check.failures ? "FAILED" : "ok");
+    return check.failures;
+}
+
+int TestPFM() {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::string dir = (fs::temp_directory_path(ec) / "lab_pfm_test").string();
+    fs::create_directories(dir, ec);
+
+    Checker check("PFM");
+
+    // odd sizes, so that the SIMD and scalar tails are both exercised
+    const int width = 37, height = 11;
+    for (int channels : { 1, 3 }) {
+        auto image = TextureCache::AllocateImage(width, height, channels, LAB_PIXEL_FLOAT);
+        float* px = (float*) image->data;
+        for (int i = 0; i < width * height * channels; ++i)
+            px[i] = (i % 7 == 0) ? -0.f : i * 0.37f - 100.f;
+
+        for (bool bigEndian : { false, true }) {
+            std::string name = std::to_string(channels) + " channel " +
+                               (bigEndian ? "big" : "little") + " endian";
+            std::string path = dir + "/" + std::to_string(channels) +
+                               (bigEndian ? "_big.pfm" : "_little.pfm");
+            check(TextureCache::WritePFM(path.c_str(), *image, bigEndian), "write " + name);
+
+            auto read = TextureCache::ReadPFM(path.c_str());
+            check(read && read->width == width && read->height == height &&
+                  read->channelCount == channels &&
+                  !memcmp(read->data, image->data, image->dataSize), "round trip " + name);
+
+            // bottom up, as stored; native files are returned from the mapping
+            auto raw = TextureCache::ReadPFM(path.c_str(), true);
+            bool flipped = raw != nullptr;
+            const size_t rowBytes = size_t(width) * channels * sizeof(float);
+            for (int row = 0; flipped && row < height; ++row)
+                flipped = !memcmp(raw->data + row * rowBytes,
+                                  image->data + (height - 1 - row) * rowBytes, rowBytes);
+            check(flipped, "bottom up read " + name);
+        }
+    }
+
+    // a header with unusual spacing, and a truncated file
+    {
+        std::string path = dir + "/spacing.pfm";
+        FILE* f = fopen(path.c_str(), "wb");
+        const char header[] = "Pf  2\t1\n\n-2.5\n";
+        float px[2] = { 1.5f, -3.f };
+        fwrite(header, 1, sizeof(header) - 1, f);
+        fwrite(px, 1, sizeof(px), f);
+        fclose(f);
+        auto read = TextureCache::ReadPFM(path.c_str());
+        if (kBigEndianHost)
+            check(read != nullptr, "header spacing");
+        else
+            check(read && read->width == 2 && read->height == 1 &&
+                  !memcmp(read->data, px, sizeof(px)), "header spacing");
+
+        fs::resize_file(path, sizeof(header) - 1 + sizeof(float), ec);
+        check(TextureCache::ReadPFM(path.c_str()) == nullptr, "truncated file is rejected");
+    }
+
+    printf("PFM round trips: %s\n", check.failures ? "FAILED" : "ok");
+    return check.failures;
+}
+
+namespace {
+    // the previous reader, for comparison: stdio, and no flip or swap
+    std::shared_ptr<LabImageData_t> ReadPFMStdio(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f)
+            return nullptr;
+        char magic[3] = {};
+        int w = 0, h = 0;
+        float scale = 0;
+        if (fscanf(f, "%2s\n", magic) != 1 || fscanf(f, "%d %d\n", &w, &h) != 2 ||
+            fscanf(f, "%f", &scale) != 1 || fgetc(f) == EOF) {
+            fclose(f);
+            return nullptr;
+        }
+        int channels = magic[1] == 'F' ? 3 : 1;
+        auto image = TextureCache::AllocateImage(w, h, channels, LAB_PIXEL_FLOAT);
+        size_t n = fread(image->data, 1, image->dataSize, f);
+        fclose(f);
+        return n == image->dataSize ? image : nullptr;
+    }
+}
+
+int BenchmarkPFM(int width, int height) {
+    namespace fs = std::filesystem;
+    using clock = std::chrono::steady_clock;
+    std::error_code ec;
+    std::string dir = (fs::temp_directory_path(ec) / "lab_pfm_test").string();
+    fs::create_directories(dir, ec);
+
+    auto image = TextureCache::AllocateImage(width, height, 3, LAB_PIXEL_FLOAT);
+    if (!image)
+        return 1;
+    float* px = (float*) image->data;
+    for (size_t i = 0; i < image->dataSize / sizeof(float); ++i)
+        px[i] = (float) (i % 4093) / 4093.f;
+    std::string native = dir + "/bench_native.pfm";
+    std::string foreign = dir + "/bench_foreign.pfm";
+    if (!TextureCache::WritePFM(native.c_str(), *image, kBigEndianHost) ||
+        !TextureCache::WritePFM(foreign.c_str(), *image, !kBigEndianHost)) {
+        printf("Could not write PFM files to %s\n", dir.c_str());
+        return 1;
+    }
+
+    printf("Reading a %d x %d RGB PFM, %.1f MB\n", width, height, image->dataSize / 1e6);
+    int failures = 0;
+    auto run = [&](const char* what, auto&& read) {
+        const int repeats = 5;
+        double best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            auto start = clock::now();
+            auto img = read();
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            best = std::min(best, ms);
+            if (!img)
+                ++failures;
+        }
+        printf("  %-36s %8.2f ms, %8.1f MB/s\n", what, best, image->dataSize / (best * 1e3));
+    };
+    run("stdio, no flip or swap", [&]() { return ReadPFMStdio(native.c_str()); });
+    run("mapped, flipped", [&]() { return TextureCache::ReadPFM(native.c_str()); });
+    run("mapped, flipped and byte swapped", [&]() { return TextureCache::ReadPFM(foreign.c_str()); });
+    run("mapped, bottom up, zero copy", [&]() { return TextureCache::ReadPFM(native.c_str(), true); });
+    return failures;
+}
+
+int RunTextureTests() {
+    int failures = 0;
+    failures += TestPixelConvert();
+    failures += TestMipChain();
+    failures += TestImageStats();
+    failures += TestImageColor();
+    failures += TestCacheMemoryBudget();
+    failures += TestCacheConcurrentAccess(2, 250);
+    failures += TestPFM();
+    failures += TestExportCache();
+    failures += TestGenerateMips();
+    failures += TestGetImageStats();
+    printf("Texture tests: %d failures\n", failures);
+    return failures;
+}
+
+int RunTextureBenchmarks() {
+    const int width = 2048, height = 2048;
+    int failures = 0;
+    failures += BenchmarkPixelConvert(width, height);
+    failures += BenchmarkMipChain(width, height);
+    failures += BenchmarkImageStats(width, height);
+    failures += BenchmarkImageColor(width, height);
+    failures += BenchmarkPFM(width, height);
+    failures += BenchmarkAsyncDecode(nullptr, (int) std::thread::hardware_concurrency());
+    failures += BenchmarkEXRLevels(nullptr);
+    failures += BenchmarkDiskCache(nullptr);
+    printf("Texture benchmarks: %d failures\n", failures);
+    return failures;
+}
+
+} // lab
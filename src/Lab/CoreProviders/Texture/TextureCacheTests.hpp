@@ -0,0 +1,65 @@
+#ifndef Providers_Texture_TextureCacheTests_hpp
+#define Providers_Texture_TextureCacheTests_hpp
+
+/*
+ Tests and benchmarks of the texture cache. Each returns the number of
+ failures, and prints a line of results. raven_headless --test runs the
+ tests, and --benchmark the tests and then the benchmarks.
+ */
+
+namespace lab {
+
+// loads many large synthetic images under a small budget, and verifies
+// that residency stays bounded and that pinned images survive.
+int TestCacheMemoryBudget();
+
+// readers, writers, erasers and pinners hammer one cache under a small
+// budget, checking that no reader sees a torn mip chain, and that the
+// memory accounting is consistent afterwards. Build with
+// -fsanitize=thread to check for races.
+int TestCacheConcurrentAccess(int threadsPerRole, int milliseconds);
+
+// writes and reads back 1 and 3 channel PFMs in both byte orders
+int TestPFM();
+
+// exports a cache of half, float, uint8 and single channel images, and a
+// mip chain, with every compression as half and as float, and checks
+// that every file reads back with the bits of the converted image.
+int TestExportCache();
+
+// generates the mips of a cache of single level images, and checks
+// that the levels are found by name and accounted as resident
+int TestGenerateMips();
+
+// checks that statistics are computed once per image, that waiting
+// runs or joins the pending computation, and that a replaced image
+// gets its own
+int TestGetImageStats();
+
+// decodes every image in directory, or in a synthesized directory if
+// directory is null, with one up to maxThreads decode threads.
+int BenchmarkAsyncDecode(const char* directory, int maxThreads);
+
+// compares reading every level of a tiled, mip mapped EXR with reading
+// only the level or region wanted, in time to the first level and in
+// bytes read. A 4K file is synthesized if path is null.
+int BenchmarkEXRLevels(const char* path);
+
+// compares the previous stdio reader with the mapped reader
+int BenchmarkPFM(int width, int height);
+
+// reads every image in directory, or in a synthesized directory if
+// directory is null, decoding with the disk cache cold and then mapping
+// with it warm, and checks that the warm pixels match the decoded ones.
+int BenchmarkDiskCache(const char* directory);
+
+// the cache's tests, and those of pixel conversion, mip chains, image
+// statistics and image color
+int RunTextureTests();
+
+// every texture benchmark, on synthesized images
+int RunTextureBenchmarks();
+
+} // lab
+
+#endif // Providers_Texture_TextureCacheTests_hpp
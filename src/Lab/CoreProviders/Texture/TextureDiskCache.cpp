@@ -0,0 +1,336 @@
+
+// The entry format is a header, a table of levels, the source path, and
+// then the pixels of each level, 64 byte aligned so that they may be used
+// in place from a mapping. Entries are only read by the machine that wrote
+// them, so fields are in native byte order, and a marker rejects the rest.
+
+#include "TextureDiskCache.hpp"
+#include "Lab/LabText.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+namespace lab {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = { 'L', 'a', 'b', 'T', 'e', 'x', 'C', '1' };
+const uint32_t kByteOrder = 0x01020304;
+const char* kExtension = ".labtex";
+constexpr size_t kAlignment = 64;
+constexpr uint32_t kMaxLevels = 32;
+
+struct DiskHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t levelCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+struct DiskLevel {
+    int32_t pixelType;
+    int32_t channelCount;
+    int32_t width, height;
+    int32_t dataWindowMinY, dataWindowMaxY;
+    uint64_t offset;
+    uint64_t size;
+};
+
+size_t ComponentSize(int32_t pixelType) {
+    static const size_t componentSize[] = { 4, 2, 4, 1 };
+    return componentSize[pixelType];
+}
+
+size_t AlignUp(size_t v) {
+    return (v + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+struct SourceId {
+    std::string path;
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+};
+
+// FNV-1a over the path, size and modification time
+bool IdentifySource(const char* path, SourceId& id) {
+    std::error_code ec;
+    id.path = path;
+    id.size = fs::file_size(id.path, ec);
+    if (ec)
+        return false;
+    auto time = fs::last_write_time(id.path, ec);
+    if (ec)
+        return false;
+    id.time = (int64_t) time.time_since_epoch().count();
+
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](const void* p, size_t n) {
+        auto b = (const uint8_t*) p;
+        for (size_t i = 0; i < n; ++i) {
+            h ^= b[i];
+            h *= 0x100000001b3ull;
+        }
+    };
+    mix(id.path.data(), id.path.size());
+    mix(&id.size, sizeof(id.size));
+    mix(&id.time, sizeof(id.time));
+    id.hash = h;
+    return true;
+}
+
+std::string EntryPath(const std::string& directory, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+    return (fs::path(directory) / (std::string(name) + kExtension)).string();
+}
+
+bool IsEntry(const fs::directory_entry& e) {
+    std::error_code ec;
+    return e.is_regular_file(ec) && e.path().extension() == kExtension;
+}
+
+} // anon
+
+TextureDiskCache::TextureDiskCache(const std::string& directory, size_t maxBytes)
+: _directory(directory), _maxBytes(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(_directory, ec);
+    for (auto& e : fs::directory_iterator(_directory, ec))
+        if (IsEntry(e))
+            _bytes += (size_t) e.file_size(ec);
+    if (_maxBytes && _bytes > _maxBytes)
+        Purge();
+}
+
+void TextureDiskCache::SetMaxBytes(size_t bytes) {
+    _maxBytes = bytes;
+    bool over;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        over = bytes && _bytes > bytes;
+    }
+    if (over)
+        Purge();
+}
+
+std::vector<std::shared_ptr<LabImageData_t>> TextureDiskCache::Load(const char* path) {
+    SourceId id;
+    if (!IdentifySource(path, id)) {
+        ++_misses;
+        return {};
+    }
+    std::string entry = EntryPath(_directory, id.hash);
+    tsStrView_t view = tsMapFile(entry.c_str());
+    if (!view.curr) {
+        ++_misses;
+        return {};
+    }
+    auto bytes = (const uint8_t*) view.curr;
+
+    // a stale, truncated or colliding entry is a miss, and is overwritten
+    // when the source is next decoded
+    auto reject = [&]() -> std::vector<std::shared_ptr<LabImageData_t>> {
+        tsUnmapFile(&view);
+        ++_misses;
+        return {};
+    };
+    DiskHeader h;
+    if (view.sz < sizeof(h))
+        return reject();
+    memcpy(&h, bytes, sizeof(h));
+    if (memcmp(h.magic, kMagic, sizeof(kMagic)) || h.byteOrder != kByteOrder ||
+        !h.levelCount || h.levelCount > kMaxLevels ||
+        h.sourceSize != id.size || h.sourceTime != id.time)
+        return reject();
+    size_t tableEnd = sizeof(h) + h.levelCount * sizeof(DiskLevel);
+    if (view.sz < tableEnd + h.pathLength || h.pathLength != id.path.size() ||
+        memcmp(bytes + tableEnd, id.path.data(), h.pathLength))
+        return reject();
+
+    std::vector<DiskLevel> table(h.levelCount);
+    memcpy(table.data(), bytes + sizeof(h), h.levelCount * sizeof(DiskLevel));
+    for (auto& l : table) {
+        if (l.pixelType < LAB_PIXEL_UINT || l.pixelType >= Lab_PIXEL_LAST_TYPE ||
+            l.channelCount < 1 || l.channelCount > 4 || l.width <= 0 || l.height <= 0 ||
+            l.size != ComponentSize(l.pixelType) * l.channelCount * uint64_t(l.width) * l.height ||
+            l.offset % kAlignment || l.offset > view.sz || l.size > view.sz - l.offset)
+            return reject();
+    }
+
+    // the levels share the mapping, which is unmapped with the last of them
+    auto mapping = std::shared_ptr<tsStrView_t>(new tsStrView_t(view), [](tsStrView_t* v) {
+        tsUnmapFile(v);
+        delete v;
+    });
+    std::vector<std::shared_ptr<LabImageData_t>> levels;
+    for (auto& l : table) {
+        LabImageData_t lid = {};
+        lid.data = (uint8_t*) bytes + l.offset;
+        lid.dataSize = (size_t) l.size;
+        lid.pixelType = (LabPixelType_t) l.pixelType;
+        lid.channelCount = l.channelCount;
+        lid.width = l.width;
+        lid.height = l.height;
+        lid.dataWindowMinY = l.dataWindowMinY;
+        lid.dataWindowMaxY = l.dataWindowMaxY;
+        levels.push_back(std::shared_ptr<LabImageData_t>(new LabImageData_t(lid),
+                                                         [mapping](LabImageData_t* img) {
+                                                             delete img;
+                                                         }));
+    }
+
+    // the modification time of an entry is its last use
+    std::error_code ec;
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+    ++_hits;
+    return levels;
+}
+
+bool TextureDiskCache::Store(const char* path,
+                             const std::vector<std::shared_ptr<LabImageData_t>>& levels) {
+    if (levels.empty() || levels.size() > kMaxLevels)
+        return false;
+    for (auto& l : levels)
+        if (!l || !l->data)
+            return false;
+    SourceId id;
+    if (!IdentifySource(path, id))
+        return false;
+
+    DiskHeader h = {};
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.byteOrder = kByteOrder;
+    h.levelCount = (uint32_t) levels.size();
+    h.sourceSize = id.size;
+    h.sourceTime = id.time;
+    h.pathLength = (uint32_t) id.path.size();
+
+    std::vector<DiskLevel> table;
+    size_t offset = AlignUp(sizeof(h) + levels.size() * sizeof(DiskLevel) + id.path.size());
+    for (auto& l : levels) {
+        DiskLevel d = {};
+        d.pixelType = l->pixelType;
+        d.channelCount = l->channelCount;
+        d.width = l->width;
+        d.height = l->height;
+        d.dataWindowMinY = l->dataWindowMinY;
+        d.dataWindowMaxY = l->dataWindowMaxY;
+        d.offset = offset;
+        d.size = l->dataSize;
+        table.push_back(d);
+        offset = AlignUp(offset + l->dataSize);
+    }
+    size_t fileSize = (size_t) (table.back().offset + table.back().size);
+
+    // a name unique to this thread, so that concurrent stores of the same
+    // source do not write into one file
+    static std::atomic<uint64_t> serial{0};
+    std::string entry = EntryPath(_directory, id.hash);
+    std::string temp = entry + "." +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+        std::to_string(++serial) + ".tmp";
+    FILE* f = fopen(temp.c_str(), "wb");
+    if (!f)
+        return false;
+    static const uint8_t zeros[kAlignment] = {};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(table.data(), sizeof(DiskLevel), table.size(), f) == table.size() &&
+              fwrite(id.path.data(), 1, id.path.size(), f) == id.path.size();
+    size_t written = sizeof(h) + table.size() * sizeof(DiskLevel) + id.path.size();
+    for (size_t i = 0; ok && i < levels.size(); ++i) {
+        size_t pad = (size_t) table[i].offset - written;
+        ok = fwrite(zeros, 1, pad, f) == pad &&
+             fwrite(levels[i]->data, 1, levels[i]->dataSize, f) == levels[i]->dataSize;
+        written += pad + levels[i]->dataSize;
+    }
+    ok = fclose(f) == 0 && ok;
+
+    std::error_code ec;
+    uint64_t replaced = ok ? fs::file_size(entry, ec) : 0;
+    if (ec)
+        replaced = 0;
+    if (ok) {
+        fs::rename(temp, entry, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    ++_writes;
+
+    bool over;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _bytes = _bytes + fileSize - std::min<size_t>(_bytes, (size_t) replaced);
+        over = _maxBytes && _bytes > _maxBytes;
+    }
+    if (over)
+        Purge();
+    return true;
+}
+
+void TextureDiskCache::Purge() {
+    struct Entry {
+        fs::file_time_type time;
+        size_t size;
+        fs::path path;
+    };
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<Entry> entries;
+    std::error_code ec;
+    size_t total = 0;
+    for (auto& e : fs::directory_iterator(_directory, ec)) {
+        if (!IsEntry(e))
+            continue;
+        Entry entry = { e.last_write_time(ec), (size_t) e.file_size(ec), e.path() };
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    size_t limit = _maxBytes;
+    for (auto& e : entries) {
+        if (total <= limit)
+            break;
+        // a mapped entry stays readable on POSIX; on Windows it cannot be
+        // removed while mapped, and is left for a later purge
+        if (fs::remove(e.path, ec))
+            total -= e.size;
+    }
+    _bytes = total;
+}
+
+void TextureDiskCache::Clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::error_code ec;
+    std::vector<fs::path> entries;
+    for (auto& e : fs::directory_iterator(_directory, ec))
+        if (IsEntry(e))
+            entries.push_back(e.path());
+    for (auto& p : entries)
+        fs::remove(p, ec);
+    _bytes = 0;
+}
+
+TextureDiskCache::Stats TextureDiskCache::GetStats() {
+    Stats s;
+    s.hits = _hits;
+    s.misses = _misses;
+    s.writes = _writes;
+    std::lock_guard<std::mutex> lock(_mutex);
+    s.bytes = _bytes;
+    return s;
+}
+
+} // lab
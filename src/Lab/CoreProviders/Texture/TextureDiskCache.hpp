@@ -0,0 +1,61 @@
+#ifndef Providers_Texture_TextureDiskCache_hpp
+#define Providers_Texture_TextureDiskCache_hpp
+
+#include "ImageData.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lab {
+
+// Decoded images kept on disk between sessions. An entry holds every level
+// of one source image, uncompressed, so that a load is a mapping of the
+// file, and pixels are paged in as they are used. Entries are named by a
+// hash of the source's path, size and modification time, so an edited
+// source misses rather than loading stale pixels. When the directory grows
+// past its limit, the least recently loaded entries are removed.
+//
+// Entries are written to a temporary name and renamed into place, so a
+// concurrent reader, or another process, sees a whole entry or none.
+class TextureDiskCache {
+    std::string _directory;
+    std::atomic<size_t> _maxBytes;
+    std::mutex _mutex;      // guards _bytes, and serializes purges
+    size_t _bytes = 0;
+    std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    std::atomic<uint64_t> _writes{0};
+
+    void Purge();
+
+public:
+    TextureDiskCache(const std::string& directory, size_t maxBytes);
+
+    const std::string& Directory() const { return _directory; }
+    void SetMaxBytes(size_t bytes);
+
+    // the levels of the image at path, mapped read only, or empty if there
+    // is no current entry for it
+    std::vector<std::shared_ptr<LabImageData_t>> Load(const char* path);
+
+    // writes every level of the image at path, none of which may be null
+    bool Store(const char* path, const std::vector<std::shared_ptr<LabImageData_t>>& levels);
+
+    // removes every entry
+    void Clear();
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t writes = 0;
+        size_t   bytes = 0;
+    };
+    Stats GetStats();
+};
+
+} // lab
+
+#endif // Providers_Texture_TextureDiskCache_hpp
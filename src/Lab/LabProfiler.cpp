@@ -0,0 +1,218 @@
+//
+//  LabProfiler.cpp
+//  LabExcelsior
+//
+
+#include "LabProfiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace lab {
+
+namespace {
+
+struct ProfileEvent {
+    const char* name;
+    const char* category;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// The fields of a slot are atomics, so that a reader may copy a slot its
+// thread is overwriting; the copy is then discarded, as below.
+struct ProfileSlot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<const char*> category{nullptr};
+    std::atomic<uint64_t> beginNs{0};
+    std::atomic<uint64_t> endNs{0};
+};
+
+// Written only by its own thread, as a sequence lock: claimed counts the
+// events whose slots have started to be written, head those that are
+// complete. A reader copies events below head, then discards those whose
+// slots were claimed again while it copied. Clear raises the floor below
+// which events are ignored, so that only the owning thread writes the
+// counters.
+struct ThreadBuffer {
+    static constexpr size_t kCapacity = 1 << 14;
+    ProfileSlot events[kCapacity];
+    std::atomic<uint64_t> claimed{0};
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> floor{0};
+    int tid = 0;
+};
+
+std::atomic<bool> gEnabled{false};
+std::mutex gBuffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> gBuffers;
+std::mutex gInternMutex;
+std::unordered_set<std::string> gInterned;
+const auto gEpoch = std::chrono::steady_clock::now();
+
+ThreadBuffer* LocalBuffer() {
+    // buffers are retained after their thread exits so that a trace can
+    // still be written; there are only as many as threads that profiled.
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(gBuffersMutex);
+        gBuffers.emplace_back(new ThreadBuffer());
+        buffer = gBuffers.back().get();
+        buffer->tid = (int) gBuffers.size();
+    }
+    return buffer;
+}
+
+struct Snapshot {
+    int tid;
+    std::vector<ProfileEvent> events;
+};
+
+std::vector<Snapshot> TakeSnapshot() {
+    std::vector<Snapshot> result;
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+    for (auto& b : gBuffers) {
+        uint64_t head = b->head.load(std::memory_order_acquire);
+        uint64_t first = std::max(b->floor.load(std::memory_order_relaxed),
+                                  head - std::min<uint64_t>(head, ThreadBuffer::kCapacity));
+        std::vector<ProfileEvent> events;
+        events.reserve(head - std::min(head, first));
+        for (uint64_t i = first; i < head; ++i) {
+            auto& slot = b->events[i % ThreadBuffer::kCapacity];
+            events.push_back({ slot.name.load(std::memory_order_acquire),
+                               slot.category.load(std::memory_order_acquire),
+                               slot.beginNs.load(std::memory_order_acquire),
+                               slot.endNs.load(std::memory_order_acquire) });
+        }
+
+        // a slot overwritten while it was copied was claimed first, and the
+        // acquire loads above make that claim visible
+        uint64_t claimed = b->claimed.load(std::memory_order_relaxed);
+        uint64_t valid = claimed - std::min<uint64_t>(claimed, ThreadBuffer::kCapacity);
+        Snapshot s;
+        s.tid = b->tid;
+        if (valid > first)
+            events.erase(events.begin(),
+                         events.begin() + (ptrdiff_t) std::min<uint64_t>(valid - first, events.size()));
+        s.events = std::move(events);
+        result.push_back(std::move(s));
+    }
+    return result;
+}
+
+void WriteJsonString(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; ++s) {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+} // anon
+
+void Profiler::SetEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::Enabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+const char* Profiler::Intern(const std::string& str) {
+    std::lock_guard<std::mutex> lock(gInternMutex);
+    auto i = gInterned.find(str);
+    if (i != gInterned.end())
+        return i->c_str();
+    if (gInterned.size() >= kMaxInterned)
+        return "(other)";
+    return gInterned.insert(str).first->c_str();
+}
+
+uint64_t Profiler::NowNs() {
+    // offset by one so that zero can mean "not recording"
+    return 1 + (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+void Profiler::Record(const char* name, const char* category,
+                      uint64_t beginNs, uint64_t endNs) {
+    ThreadBuffer* b = LocalBuffer();
+    uint64_t head = b->head.load(std::memory_order_relaxed);
+    b->claimed.store(head + 1, std::memory_order_relaxed);
+    auto& slot = b->events[head % ThreadBuffer::kCapacity];
+    slot.name.store(name, std::memory_order_release);
+    slot.category.store(category, std::memory_order_release);
+    slot.beginNs.store(beginNs, std::memory_order_release);
+    slot.endNs.store(endNs, std::memory_order_release);
+    b->head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<Profiler::Stats> Profiler::GetStats() {
+    std::map<std::pair<std::string, std::string>, std::vector<double>> samples;
+    for (auto& s : TakeSnapshot())
+        for (auto& e : s.events)
+            samples[{ e.category ? e.category : "", e.name ? e.name : "" }]
+                .push_back((e.endNs - e.beginNs) * 1e-6);
+
+    std::vector<Stats> result;
+    for (auto& i : samples) {
+        auto& d = i.second;
+        std::sort(d.begin(), d.end());
+        Stats st;
+        st.category = i.first.first;
+        st.name = i.first.second;
+        st.samples = (int) d.size();
+        st.minMs = d.front();
+        st.maxMs = d.back();
+        double total = 0;
+        for (double v : d)
+            total += v;
+        st.avgMs = total / d.size();
+        st.p99Ms = d[std::min(d.size() - 1, (size_t) (d.size() * 0.99))];
+        result.push_back(st);
+    }
+    return result;
+}
+
+bool Profiler::WriteChromeTrace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (auto& s : TakeSnapshot()) {
+        for (auto& e : s.events) {
+            fprintf(f, first ? "{\"name\":" : ",\n{\"name\":");
+            first = false;
+            WriteJsonString(f, e.name);
+            fprintf(f, ",\"cat\":");
+            WriteJsonString(f, e.category);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                    e.beginNs * 1e-3, (e.endNs - e.beginNs) * 1e-3, s.tid);
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(f) == 0;
+}
+
+void Profiler::Clear() {
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+    for (auto& b : gBuffers)
+        b->floor.store(b->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+} // lab
@@ -0,0 +1,93 @@
+//
+//  LabProfiler.hpp
+//  LabExcelsior
+//
+
+/*
+ A scoped profiler for the frame loop. Each scope records its begin and end
+ time into a ring buffer owned by the recording thread, so that recording
+ takes no locks. Statistics and Chrome trace output (chrome://tracing, or
+ ui.perfetto.dev) are computed on demand from whatever the ring buffers
+ currently hold.
+
+ Recording is off until enabled at runtime with Profiler::SetEnabled. When
+ LabCore is built without HAVE_LAB_PROFILER the LAB_PROFILE_SCOPE macro
+ compiles to nothing.
+
+ Names and categories must outlive the profiler, string literals and
+ activity names are fine; use Profiler::Intern for transient strings.
+ */
+
+#ifndef LabProfiler_hpp
+#define LabProfiler_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lab {
+
+class Profiler {
+public:
+    static void SetEnabled(bool enabled);
+    static bool Enabled();
+
+    // returns a pointer to a copy of str that remains valid for the life
+    // of the process. Once kMaxInterned strings are held, strings not yet
+    // interned are reported as "(other)", so intern names drawn from a
+    // small set, not free-form text.
+    static constexpr size_t kMaxInterned = 4096;
+    static const char* Intern(const std::string& str);
+
+    static uint64_t NowNs();
+    static void Record(const char* name, const char* category,
+                       uint64_t beginNs, uint64_t endNs);
+
+    struct Stats {
+        std::string name;
+        std::string category;
+        int    samples = 0;
+        double minMs = 0;
+        double avgMs = 0;
+        double p99Ms = 0;
+        double maxMs = 0;
+    };
+
+    // statistics over the samples currently held in the ring buffers,
+    // sorted by category, then name
+    static std::vector<Stats> GetStats();
+
+    // write the recorded scopes as Chrome trace event JSON
+    static bool WriteChromeTrace(const char* path);
+
+    // discard everything recorded so far
+    static void Clear();
+};
+
+class ProfileScope {
+    const char* _name;
+    const char* _category;
+    uint64_t _begin;
+public:
+    ProfileScope(const char* name, const char* category)
+    : _name(name), _category(category)
+    , _begin(Profiler::Enabled() ? Profiler::NowNs() : 0) {}
+    ~ProfileScope() {
+        if (_begin)
+            Profiler::Record(_name, _category, _begin, Profiler::NowNs());
+    }
+};
+
+} // lab
+
+#define LAB_PROFILE_CONCAT_(a, b) a##b
+#define LAB_PROFILE_CONCAT(a, b) LAB_PROFILE_CONCAT_(a, b)
+
+#ifdef HAVE_LAB_PROFILER
+#define LAB_PROFILE_SCOPE(name, category) \
+    lab::ProfileScope LAB_PROFILE_CONCAT(_labProfileScope, __LINE__)(name, category)
+#else
+#define LAB_PROFILE_SCOPE(name, category)
+#endif
+
+#endif /* LabProfiler_hpp */
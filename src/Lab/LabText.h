@@ -182,6 +182,61 @@ typedef struct tsParsedSexpr_t {
 EXTERNC tsParsedSexpr_t* tsParsedSexpr_New();
 EXTERNC tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance);
 
+// as tsStrViewParseSexpr, but cells are obtained from alloc, which must
+// return zeroed memory. Cells obtained this way are owned by the allocator.
+typedef tsParsedSexpr_t* (*tsParsedSexprAlloc_t)(void* ctx);
+EXTERNC tsStrView_t tsStrViewParseSexprAlloc(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance,
+                                             tsParsedSexprAlloc_t alloc, void* ctx);
+
+//-----------------------------------------------------------------------------
+// Flat sexpr scanner
+//
+// A high throughput alternative to tsStrViewParseSexpr. The input is
+// tokenized into a contiguous array of spans that refer back into the input
+// by offset, rather than into a list of allocated cells. Input is classified
+// 64 bytes at a time into whitespace, parens, quotes, and comment starts,
+// using AVX2 or SSE2 where available, and a scalar fallback otherwise.
+//
+// Tokens follow tsStrViewParseSexpr: lists, ; comments to end of line, "
+// and ' strings with backslash escapes, and atoms. An atom is reported as
+// an integer or float if the whole atom is numeric; use tsGetInt32 or
+// tsGetFloat on the span for the value. String spans exclude the quotes,
+// and escapes are left in place.
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    tsSexprToken_t kind;
+} tsSexprSpan_t;
+
+typedef struct {
+    tsSexprSpan_t* tokens;  // realloc'd as needed, release with tsSexprScanFree
+    size_t count;
+    size_t capacity;
+    int balance;            // opens not yet closed
+    size_t error;           // offset of input preceding the first list, or SIZE_MAX
+} tsSexprScan_t;
+
+// tokenize sz bytes of src, appending to scan. Inputs are limited to 4GB.
+// Returns the number of tokens appended.
+EXTERNC size_t tsScanSexpr(const char* src, size_t sz, tsSexprScan_t* scan);
+EXTERNC void tsSexprScanFree(tsSexprScan_t* scan);
+
+// 0 scalar, 1 SSE2, 2 AVX2. tsSexprScanForceLevel caps the level used, for
+// testing and benchmarking; pass -1 to restore the default.
+EXTERNC int tsSexprScanLevel(void);
+EXTERNC void tsSexprScanForceLevel(int level);
+
+// map a file read only. The view is empty if the file could not be mapped.
+EXTERNC tsStrView_t tsMapFile(const char* path);
+EXTERNC void tsUnmapFile(tsStrView_t* view);
+
+// generate about bytes of sexpr source, and compare the throughput of
+// tsStrViewParseSexpr with tsScanSexpr at each available level. Returns
+// non-zero if the scanners disagree.
+EXTERNC int tsSexprScanBenchmark(size_t bytes);
+
 
 
 //-----------------------------------------------------------------------------
@@ -1198,6 +1253,7 @@ char const* tsGetFloat(
 
         if (pCurr == test)
             return start;   // e without a number following it is malformed
+        pCurr = test;
 
         ret *= powf(10.0f, (float) intPart);
     }
@@ -1588,9 +1644,10 @@ tsParsedSexpr_t* tsParsedSexpr_New() {
     return result;
 }
 
-// recursive sexpr parser. returns the next tsStrView_t to parse, following the
+// sexpr parser. returns the next tsStrView_t to parse, following the
 // final matched closed paren beginning at the supplied input s.
-tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance) {
+tsStrView_t tsStrViewParseSexprAlloc(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance,
+                                     tsParsedSexprAlloc_t alloc, void* ctx) {
     if (!s || !s->sz || !s->curr || !currCell)
         return (tsStrView_t){ NULL, 0 };
 
@@ -1611,7 +1668,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
     }
 
     // the loop above searched for an opening paren. now we parse the sexpr
-    currCell->next = tsParsedSexpr_New();
+    currCell->next = alloc(ctx);
     currCell->next->token = tsSexprPushList;
     currCell = currCell->next;
     ++balance;
@@ -1632,7 +1689,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         if (*curr.curr == '"') {
             tsStrView_t str;
             curr = tsStrViewGetString(&curr, true, &str); // parase a string, dealing with escaped characters
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
+            tsParsedSexpr_t* cell = alloc(ctx);
             cell->token = tsSexprString;
             cell->str = str;
             currCell->next = cell;
@@ -1643,7 +1700,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         if (*curr.curr == '\'') {
             tsStrView_t str;
             curr = tsStrViewGetString2(&curr, '\'', true, &str); // parase a string, dealing with escaped characters
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
+            tsParsedSexpr_t* cell = alloc(ctx);
             cell->token = tsSexprString;
             cell->str = str;
             currCell->next = cell;
@@ -1655,7 +1712,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
             curr.curr += 1; // consume the discovered paren
             curr.sz -= 1;
             --balance;
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
+            tsParsedSexpr_t* cell = alloc(ctx);
             cell->token = tsSexprPopList;
             currCell->next = cell;
             currCell = cell;
@@ -1663,7 +1720,15 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         }
 
         if (*curr.curr == '(') {
-            curr = tsStrViewParseSexpr(&curr, currCell, balance);
+            // nested lists are opened in place rather than by recursion, so
+            // that long inputs can't exhaust the stack
+            curr.curr += 1; // consume the discovered paren
+            curr.sz -= 1;
+            ++balance;
+            tsParsedSexpr_t* cell = alloc(ctx);
+            cell->token = tsSexprPushList;
+            currCell->next = cell;
+            currCell = cell;
             continue;
         }
 
@@ -1686,7 +1751,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         float f;
         tsStrView_t test = tsStrViewGetFloat(&token, &f);
         if (test.curr != token.curr) {
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
+            tsParsedSexpr_t* cell = alloc(ctx);
             cell->token = tsSexprFloat;
             cell->f = f;
             currCell->next = cell;
@@ -1700,7 +1765,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         int32_t i;
         test = tsStrViewGetInt32(&token, &i);
         if (test.curr != token.curr) {
-            tsParsedSexpr_t* cell = tsParsedSexpr_New();
+            tsParsedSexpr_t* cell = alloc(ctx);
             cell->token = tsSexprInteger;
             cell->i = i;
             currCell->next = cell;
@@ -1712,7 +1777,7 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
         }
 
         // assume it is an atom
-        tsParsedSexpr_t* cell = tsParsedSexpr_New();
+        tsParsedSexpr_t* cell = alloc(ctx);
         cell->token = tsSexprAtom;
         cell->str = token;
         currCell->next = cell;
@@ -1722,6 +1787,520 @@ tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int b
     }
 }
 
+static tsParsedSexpr_t* tsParsedSexpr_Alloc(void* ctx) {
+    return tsParsedSexpr_New();
+}
+
+tsStrView_t tsStrViewParseSexpr(tsStrView_t* s, tsParsedSexpr_t* currCell, int balance) {
+    return tsStrViewParseSexprAlloc(s, currCell, balance, tsParsedSexpr_Alloc, NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+// Flat sexpr scanner
+//-----------------------------------------------------------------------------
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    #include <immintrin.h>
+    #define TS_SCAN_X86 1
+    #if defined(__GNUC__) || defined(__clang__)
+        #define TS_SCAN_AVX2_TARGET __attribute__((target("avx2")))
+        #define TS_SCAN_HAVE_AVX2 1
+    #elif defined(__AVX2__)
+        #define TS_SCAN_AVX2_TARGET
+        #define TS_SCAN_HAVE_AVX2 1
+    #endif
+#endif
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    static int tsCtz64(uint64_t v) { unsigned long i; _BitScanForward64(&i, v); return (int) i; }
+#else
+    static int tsCtz64(uint64_t v) { return __builtin_ctzll(v); }
+#endif
+
+// For each 64 byte block the classifiers produce one mask per kind of
+// search the scanner makes, one bit per byte.
+typedef enum {
+    tsFindNonWhiteSpace,  // the start of the next token
+    tsFindDelimiter,      // the end of an atom: whitespace, parens, or ;
+    tsFindDoubleQuoteEnd, // closing " or an escape
+    tsFindSingleQuoteEnd, // closing ' or an escape
+    tsFindEndOfLine,      // the end of a comment
+    tsFindCount
+} tsScanFind_t;
+
+typedef void (*tsScanClassify_t)(const unsigned char* p, uint64_t* m);
+
+static void tsScanClassifyScalar(const unsigned char* p, uint64_t* m) {
+    uint64_t ws = 0, delim = 0, dq = 0, sq = 0, eol = 0;
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = 1ull << i;
+        switch (p[i]) {
+            case ' ': case '\t':  ws |= bit; break;
+            case '\n': case '\r': ws |= bit; eol |= bit; break;
+            case '(': case ')': case ';': delim |= bit; break;
+            case '"':  dq |= bit; break;
+            case '\'': sq |= bit; break;
+            case '\\': dq |= bit; sq |= bit; break;
+        }
+    }
+    m[tsFindNonWhiteSpace] = ~ws;
+    m[tsFindDelimiter] = ws | delim;
+    m[tsFindDoubleQuoteEnd] = dq;
+    m[tsFindSingleQuoteEnd] = sq;
+    m[tsFindEndOfLine] = eol;
+}
+
+#ifdef TS_SCAN_X86
+static void tsScanClassifySSE2(const unsigned char* p, uint64_t* m) {
+    uint64_t ws = 0, delim = 0, dq = 0, sq = 0, eol = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + i * 16));
+        #define TS_EQ(ch) _mm_cmpeq_epi8(v, _mm_set1_epi8(ch))
+        #define TS_BITS(x) ((uint64_t) (uint16_t) _mm_movemask_epi8(x) << (i * 16))
+        __m128i e = _mm_or_si128(TS_EQ('\n'), TS_EQ('\r'));
+        __m128i w = _mm_or_si128(_mm_or_si128(TS_EQ(' '), TS_EQ('\t')), e);
+        __m128i d = _mm_or_si128(_mm_or_si128(TS_EQ('('), TS_EQ(')')), TS_EQ(';'));
+        __m128i b = TS_EQ('\\');
+        ws    |= TS_BITS(w);
+        delim |= TS_BITS(d);
+        eol   |= TS_BITS(e);
+        dq    |= TS_BITS(_mm_or_si128(TS_EQ('"'), b));
+        sq    |= TS_BITS(_mm_or_si128(TS_EQ('\''), b));
+        #undef TS_BITS
+        #undef TS_EQ
+    }
+    m[tsFindNonWhiteSpace] = ~ws;
+    m[tsFindDelimiter] = ws | delim;
+    m[tsFindDoubleQuoteEnd] = dq;
+    m[tsFindSingleQuoteEnd] = sq;
+    m[tsFindEndOfLine] = eol;
+}
+#endif
+
+#ifdef TS_SCAN_HAVE_AVX2
+TS_SCAN_AVX2_TARGET
+static void tsScanClassifyAVX2(const unsigned char* p, uint64_t* m) {
+    uint64_t ws = 0, delim = 0, dq = 0, sq = 0, eol = 0;
+    for (int i = 0; i < 2; ++i) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + i * 32));
+        #define TS_EQ(ch) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(ch))
+        #define TS_BITS(x) ((uint64_t) (uint32_t) _mm256_movemask_epi8(x) << (i * 32))
+        __m256i e = _mm256_or_si256(TS_EQ('\n'), TS_EQ('\r'));
+        __m256i w = _mm256_or_si256(_mm256_or_si256(TS_EQ(' '), TS_EQ('\t')), e);
+        __m256i d = _mm256_or_si256(_mm256_or_si256(TS_EQ('('), TS_EQ(')')), TS_EQ(';'));
+        __m256i b = TS_EQ('\\');
+        ws    |= TS_BITS(w);
+        delim |= TS_BITS(d);
+        eol   |= TS_BITS(e);
+        dq    |= TS_BITS(_mm256_or_si256(TS_EQ('"'), b));
+        sq    |= TS_BITS(_mm256_or_si256(TS_EQ('\''), b));
+        #undef TS_BITS
+        #undef TS_EQ
+    }
+    m[tsFindNonWhiteSpace] = ~ws;
+    m[tsFindDelimiter] = ws | delim;
+    m[tsFindDoubleQuoteEnd] = dq;
+    m[tsFindSingleQuoteEnd] = sq;
+    m[tsFindEndOfLine] = eol;
+}
+#endif
+
+static int tsSexprScanForced = -1;
+
+int tsSexprScanLevel(void) {
+    int level = 0;
+#ifdef TS_SCAN_X86
+    level = 1; // SSE2 is part of the x86-64 baseline
+#endif
+#if defined(TS_SCAN_HAVE_AVX2)
+    #if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_cpu_supports("avx2"))
+            level = 2;
+    #else
+        level = 2;
+    #endif
+#endif
+    if (tsSexprScanForced >= 0 && tsSexprScanForced < level)
+        level = tsSexprScanForced;
+    return level;
+}
+
+void tsSexprScanForceLevel(int level) {
+    tsSexprScanForced = level;
+}
+
+// The scanner keeps the classification of one block at a time; finding
+// the next byte of interest is a mask, a shift and a count of trailing
+// zeros until the cursor leaves the block.
+typedef struct {
+    const unsigned char* src;
+    size_t sz;
+    size_t block; // offset of the classified block, or SIZE_MAX
+    uint64_t m[tsFindCount];
+    tsScanClassify_t classify;
+} tsScanState_t;
+
+static size_t tsScanFindSlow(tsScanState_t* s, size_t from, tsScanFind_t find) {
+    while (from < s->sz) {
+        size_t block = from & ~(size_t) 63;
+        if (block != s->block) {
+            s->block = block;
+            if (block + 64 <= s->sz)
+                s->classify(s->src + block, s->m);
+            else {
+                // pad the tail with spaces, which terminate atoms and are
+                // skipped as whitespace; positions past the end are
+                // clamped below.
+                unsigned char tail[64];
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, s->src + block, s->sz - block);
+                s->classify(tail, s->m);
+            }
+        }
+        uint64_t bits = s->m[find] & (~0ull << (from - block));
+        if (bits) {
+            size_t found = block + tsCtz64(bits);
+            return found < s->sz ? found : s->sz;
+        }
+        from = block + 64;
+    }
+    return s->sz;
+}
+
+static inline size_t tsScanFind(tsScanState_t* s, size_t from, tsScanFind_t find) {
+    // most tokens are short, and end within the block they started in
+    size_t block = from & ~(size_t) 63;
+    if (block == s->block) {
+        uint64_t bits = s->m[find] & (~0ull << (from - block));
+        if (bits) {
+            size_t found = block + tsCtz64(bits);
+            return found < s->sz ? found : s->sz;
+        }
+    }
+    return tsScanFindSlow(s, from, find);
+}
+
+static tsSexprToken_t tsScanAtomKind(const unsigned char* p, size_t sz) {
+    // [+-]?digits is an integer, [+-]?digits.digits*([eE][+-]?digits)? a float
+    size_t i = 0;
+    if (i < sz && (p[i] == '+' || p[i] == '-'))
+        ++i;
+    size_t digits = i;
+    while (i < sz && p[i] >= '0' && p[i] <= '9')
+        ++i;
+    if (i == digits)
+        return tsSexprAtom;
+    if (i == sz)
+        return tsSexprInteger;
+    if (p[i] != '.')
+        return tsSexprAtom;
+    ++i;
+    while (i < sz && p[i] >= '0' && p[i] <= '9')
+        ++i;
+    if (i < sz && (p[i] == 'e' || p[i] == 'E')) {
+        ++i;
+        if (i < sz && (p[i] == '+' || p[i] == '-'))
+            ++i;
+        size_t exponent = i;
+        while (i < sz && p[i] >= '0' && p[i] <= '9')
+            ++i;
+        if (i == exponent)
+            return tsSexprAtom;
+    }
+    return i == sz ? tsSexprFloat : tsSexprAtom;
+}
+
+static void tsScanPush(tsSexprScan_t* scan, size_t offset, size_t length, tsSexprToken_t kind) {
+    if (scan->count == scan->capacity) {
+        size_t grow = scan->capacity ? scan->capacity * 2 : 1024;
+        tsSexprSpan_t* tokens = (tsSexprSpan_t*) realloc(scan->tokens, grow * sizeof(tsSexprSpan_t));
+        Assert(tokens);
+        scan->tokens = tokens;
+        scan->capacity = grow;
+    }
+    tsSexprSpan_t* t = &scan->tokens[scan->count++];
+    t->offset = (uint32_t) offset;
+    t->length = (uint32_t) length;
+    t->kind = kind;
+}
+
+size_t tsScanSexpr(const char* src, size_t sz, tsSexprScan_t* scan) {
+    if (!scan)
+        return 0;
+    size_t first = scan->count;
+    if (first == 0) {
+        scan->balance = 0;
+        scan->error = SIZE_MAX;
+    }
+    if (!src || !sz || sz > UINT32_MAX)
+        return 0;
+
+    tsScanState_t s;
+    s.src = (const unsigned char*) src;
+    s.sz = sz;
+    s.block = SIZE_MAX;
+    s.classify = tsScanClassifyScalar;
+    switch (tsSexprScanLevel()) {
+#ifdef TS_SCAN_HAVE_AVX2
+        case 2: s.classify = tsScanClassifyAVX2; break;
+#endif
+#ifdef TS_SCAN_X86
+        case 1: s.classify = tsScanClassifySSE2; break;
+#endif
+        default: break;
+    }
+
+    bool started = false;
+    size_t pos = 0;
+    while (true) {
+        pos = tsScanFind(&s, pos, tsFindNonWhiteSpace);
+        if (pos >= sz)
+            break;
+        char c = src[pos];
+        if (c == ';') {
+            pos = tsScanFind(&s, pos, tsFindEndOfLine); // Lisp comment
+            continue;
+        }
+        if (!started) {
+            // as with tsStrViewParseSexpr, only comments may precede the
+            // first list
+            if (c != '(') {
+                scan->error = pos;
+                break;
+            }
+            started = true;
+        }
+        switch (c) {
+            case '(':
+                tsScanPush(scan, pos, 1, tsSexprPushList);
+                ++scan->balance;
+                ++pos;
+                break;
+            case ')':
+                tsScanPush(scan, pos, 1, tsSexprPopList);
+                --scan->balance;
+                ++pos;
+                break;
+            case '"':
+            case '\'': {
+                tsScanFind_t find = c == '"' ? tsFindDoubleQuoteEnd : tsFindSingleQuoteEnd;
+                size_t begin = pos + 1;
+                size_t end = begin;
+                while (true) {
+                    end = tsScanFind(&s, end, find);
+                    if (end < sz && src[end] == '\\')
+                        end += 2; // not handling multicharacter escapes
+                    else
+                        break;
+                }
+                if (end > sz)
+                    end = sz;
+                tsScanPush(scan, begin, end - begin, tsSexprString);
+                pos = end < sz ? end + 1 : sz;
+                break;
+            }
+            default: {
+                size_t end = tsScanFind(&s, pos, tsFindDelimiter);
+                tsScanPush(scan, pos, end - pos,
+                           tsScanAtomKind(s.src + pos, end - pos));
+                pos = end;
+                break;
+            }
+        }
+    }
+    return scan->count - first;
+}
+
+void tsSexprScanFree(tsSexprScan_t* scan) {
+    if (!scan)
+        return;
+    free(scan->tokens);
+    scan->tokens = NULL;
+    scan->count = 0;
+    scan->capacity = 0;
+}
+
+tsStrView_t tsMapFile(const char* path) {
+    tsStrView_t result = { NULL, 0 };
+    if (!path)
+        return result;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return result;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (data) {
+                result.curr = (const char*) data;
+                result.sz = (size_t) size.QuadPart;
+            }
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return result;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+            result.curr = (const char*) data;
+            result.sz = (size_t) st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    return result;
+}
+
+void tsUnmapFile(tsStrView_t* view) {
+    if (!view || !view->curr)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(view->curr);
+#else
+    munmap((void*) view->curr, view->sz);
+#endif
+    view->curr = NULL;
+    view->sz = 0;
+}
+
+static double tsScanSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int tsSexprScanBenchmark(size_t bytes) {
+    // a Landru like mix of lists, atoms, numbers, strings and comments
+    static const char* snippet =
+        "(machine pingpong ; a comment\n"
+        "    (state ping (io.print \"ping! \\\"quoted\\\"\") (set x 0.5)\n"
+        "        (on time.after 0.25 (goto pong)))\n"
+        "    (state pong (io.print 'pong!') (set y -42) (set z 1.5e3)\n"
+        "        (on time.after 0.25 (goto ping)))\n"
+        "    (state main (goto ping)))\n";
+    size_t snippetSz = strlen(snippet);
+    size_t copies = bytes / snippetSz + 1;
+    size_t sz = copies * snippetSz;
+    char* src = (char*) malloc(sz + 1);
+    for (size_t i = 0; i < copies; ++i)
+        memcpy(src + i * snippetSz, snippet, snippetSz);
+    src[sz] = 0;
+    double mb = sz / (1024.0 * 1024.0);
+    int runs = 5;
+
+    // the linked cell parser, including releasing the cells
+    double best = 1e9;
+    size_t cells = 0;
+    for (int run = 0; run < runs; ++run) {
+        double t = tsScanSeconds();
+        tsParsedSexpr_t* head = tsParsedSexpr_New();
+        tsStrView_t view = { src, sz };
+        tsStrViewParseSexpr(&view, head, 0);
+        cells = 0;
+        tsParsedSexpr_t* curr = head->next; // skip the empty head cell
+        free(head);
+        while (curr) {
+            tsParsedSexpr_t* next = curr->next;
+            free(curr);
+            ++cells;
+            curr = next;
+        }
+        t = tsScanSeconds() - t;
+        if (t < best)
+            best = t;
+    }
+    printf("sexpr: %.1f MB of source\n", mb);
+    printf("  tsStrViewParseSexpr  %8.1f MB/s  %zu cells\n", mb / best, cells);
+
+    int result = 0;
+    tsSexprScan_t reference = { 0 };
+    static const char* names[] = { "scalar", "SSE2", "AVX2" };
+    int top = tsSexprScanLevel();
+    for (int level = 0; level <= top; ++level) {
+        tsSexprScanForceLevel(level);
+        best = 1e9;
+        tsSexprScan_t scan = { 0 };
+        for (int run = 0; run < runs; ++run) {
+            scan.count = 0;
+            double t = tsScanSeconds();
+            tsScanSexpr(src, sz, &scan);
+            t = tsScanSeconds() - t;
+            if (t < best)
+                best = t;
+        }
+        printf("  tsScanSexpr %-8s  %8.1f MB/s  %zu tokens\n", names[level], mb / best, scan.count);
+
+        if (level == 0) {
+            // the scalar scan should agree with the cell parser token for token
+            reference = scan;
+            tsParsedSexpr_t* head = tsParsedSexpr_New();
+            tsStrView_t view = { src, sz };
+            tsStrViewParseSexpr(&view, head, 0);
+            tsParsedSexpr_t* curr = head->next;
+            free(head);
+            for (size_t i = 0; curr; ++i) {
+                const tsSexprSpan_t* t = i < scan.count ? &scan.tokens[i] : NULL;
+                bool same = t && t->kind == curr->token;
+                if (same && (curr->token == tsSexprAtom || curr->token == tsSexprString))
+                    same = curr->str.curr == src + t->offset && curr->str.sz == t->length;
+                if (!same && !result) {
+                    printf("  token %zu differs from the cell parser\n", i);
+                    result = 1;
+                }
+                tsParsedSexpr_t* next = curr->next;
+                free(curr);
+                curr = next;
+            }
+            if (scan.count != cells) {
+                printf("  token count differs from the cell parser\n");
+                result = 1;
+            }
+        }
+        else {
+            if (scan.count != reference.count ||
+                memcmp(scan.tokens, reference.tokens, scan.count * sizeof(tsSexprSpan_t))) {
+                printf("  %s tokens differ from scalar\n", names[level]);
+                result = 1;
+            }
+            tsSexprScanFree(&scan);
+        }
+    }
+    tsSexprScanForceLevel(-1);
+    tsSexprScanFree(&reference);
+    free(src);
+    return result;
+}
+
 
 #ifdef __cplusplus
 namespace lab { namespace Text {
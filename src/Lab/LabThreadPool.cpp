@@ -0,0 +1,100 @@
+//
+//  LabThreadPool.cpp
+//  LabExcelsior
+//
+
+#include "LabThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace lab {
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0)
+        threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threads; ++i)
+        _threads.emplace_back([this]() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cv.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+                    if (_jobs.empty())
+                        return; // stopping, and drained
+                    job = std::move(_jobs.front());
+                    _jobs.pop_front();
+                }
+                job();
+            }
+        });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& t : _threads)
+        t.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _cv.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& fn) {
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(1, grain);
+    const size_t chunks = (end - begin + grain - 1) / grain;
+    if (chunks == 1) {
+        fn(begin, end);
+        return;
+    }
+
+    // helpers may start after the loop has finished, so the state they
+    // share with the caller is reference counted.
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    auto work = [state, begin, end, grain, chunks, &fn]() {
+        size_t c;
+        while ((c = state->next++) < chunks) {
+            size_t b = begin + c * grain;
+            fn(b, std::min(end, b + grain));
+            if (++state->done == chunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cv.notify_all();
+            }
+        }
+    };
+
+    // fn is only referenced by helpers that claim a chunk, and every chunk
+    // completes before this function returns.
+    size_t helpers = std::min(chunks - 1, _threads.size());
+    for (size_t i = 0; i < helpers; ++i)
+        Enqueue(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]() { return state->done.load() == chunks; });
+}
+
+//static
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+} // lab
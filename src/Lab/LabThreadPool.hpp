@@ -0,0 +1,66 @@
+//
+//  LabThreadPool.hpp
+//  LabExcelsior
+//
+
+/*
+ A plain fixed size thread pool. Jobs are run in submission order by
+ whichever worker is free. ParallelFor splits a range into chunks, and the
+ calling thread works on chunks alongside the pool, so it is safe to call
+ ParallelFor from within a job.
+ */
+
+#ifndef LabThreadPool_hpp
+#define LabThreadPool_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab {
+
+class ThreadPool {
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _jobs;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stopping = false;
+
+public:
+    // zero threads means one per hardware thread
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int Size() const { return (int) _threads.size(); }
+
+    void Enqueue(std::function<void()> job);
+
+    template <typename F>
+    auto Submit(F&& f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // calls fn(chunkBegin, chunkEnd) over [begin, end) in chunks of grain,
+    // returning when every chunk has completed.
+    void ParallelFor(size_t begin, size_t end, size_t grain,
+                     const std::function<void(size_t, size_t)>& fn);
+
+    // a pool shared by LabCore and the core providers
+    static ThreadPool& Shared();
+};
+
+} // lab
+
+#endif /* LabThreadPool_hpp */
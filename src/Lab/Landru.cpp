@@ -1,4 +1,5 @@
 
+#include "Landru.hpp"
 #include "LabText.h"
 #include <stdio.h>
 
@@ -219,10 +220,13 @@ Functions work as is familiar from Lisp.
  */
 
 
-#include <map>
-using std::map;
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <new>
 #include <string>
 using std::string;
+#include <type_traits>
 #include <vector>
 using std::vector;
 
@@ -262,6 +266,235 @@ char const* pingpongSrc = R"(
 struct Landru;
 struct MachineExemplar;
 struct MachineInstance;
+//----------------------------------------------------------------------
+// Arena
+//
+// Everything that lives as long as a script, its parse, its exemplars,
+// and the text of its symbols, is bump allocated from a per-script arena,
+// and released in one shot when the script is destroyed. Objects placed
+// in the arena must be trivially destructible.
+
+static constexpr uint32_t kLandruNil = 0xffffffff;
+
+typedef struct LandruArena {
+    static constexpr size_t kBlockSize = 64 * 1024;
+    vector<char*> blocks;
+    char* curr = NULL;
+    size_t remaining = 0;
+    size_t bytes = 0; // total allocated, for diagnostics
+
+    LandruArena() = default;
+    LandruArena(const LandruArena&) = delete;
+    LandruArena& operator=(const LandruArena&) = delete;
+    ~LandruArena() { Reset(); }
+
+    void* Alloc(size_t size, size_t align) {
+        size_t pad = (align - ((uintptr_t) curr & (align - 1))) & (align - 1);
+        if (!curr || pad + size > remaining) {
+            size_t blockSize = std::max(kBlockSize, size + align);
+            blocks.push_back((char*) malloc(blockSize));
+            curr = blocks.back();
+            remaining = blockSize;
+            pad = (align - ((uintptr_t) curr & (align - 1))) & (align - 1);
+        }
+        char* result = curr + pad;
+        curr += pad + size;
+        remaining -= pad + size;
+        bytes += size;
+        memset(result, 0, size);
+        return result;
+    }
+
+    template <typename T>
+    T* New(size_t count = 1) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are never destructed");
+        T* result = (T*) Alloc(sizeof(T) * count, alignof(T));
+        for (size_t i = 0; i < count; ++i)
+            new (result + i) T();
+        return result;
+    }
+
+    void Reset() {
+        for (char* b : blocks)
+            free(b);
+        blocks.clear();
+        curr = NULL;
+        remaining = 0;
+        bytes = 0;
+    }
+} LandruArena;
+
+// A growable array in the arena. Growth abandons the old storage, which
+// the arena reclaims when the script is released.
+template <typename T>
+struct LandruArray {
+    T* data;
+    uint32_t count;
+    uint32_t capacity;
+
+    void push_back(LandruArena& arena, const T& v) {
+        if (count == capacity) {
+            uint32_t grow = capacity ? capacity * 2 : 2;
+            T* d = arena.New<T>(grow);
+            for (uint32_t i = 0; i < count; ++i)
+                d[i] = data[i];
+            data = d;
+            capacity = grow;
+        }
+        data[count++] = v;
+    }
+    uint32_t size() const { return count; }
+    T* begin() const { return data; }
+    T* end() const { return data + count; }
+    T& operator[](uint32_t i) const { return data[i]; }
+};
+
+// An open addressed table from symbol id to value, with linear probing,
+// resized to stay at most half full.
+template <typename V>
+struct LandruSymbolMap {
+    struct Slot {
+        uint32_t key;
+        V value;
+    };
+    Slot* slots;
+    uint32_t count;
+    uint32_t capacity; // a power of two, or zero
+
+    static uint32_t hash(uint32_t key) { return key * 0x9e3779b1u; }
+
+    V find(uint32_t key) const {
+        if (!capacity)
+            return V();
+        for (uint32_t i = hash(key) & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+            if (slots[i].key == key)
+                return slots[i].value;
+            if (slots[i].key == kLandruNil)
+                return V();
+        }
+    }
+
+    void insert(LandruArena& arena, uint32_t key, V value) {
+        if ((count + 1) * 2 > capacity) {
+            uint32_t grow = capacity ? capacity * 2 : 8;
+            Slot* old = slots;
+            uint32_t oldCapacity = capacity;
+            slots = arena.New<Slot>(grow);
+            for (uint32_t i = 0; i < grow; ++i)
+                slots[i].key = kLandruNil;
+            capacity = grow;
+            count = 0;
+            for (uint32_t i = 0; i < oldCapacity; ++i)
+                if (old[i].key != kLandruNil)
+                    insert(arena, old[i].key, old[i].value);
+        }
+        uint32_t i = hash(key) & (capacity - 1);
+        while (slots[i].key != kLandruNil && slots[i].key != key)
+            i = (i + 1) & (capacity - 1);
+        if (slots[i].key == kLandruNil)
+            ++count;
+        slots[i] = { key, value };
+    }
+
+    template <typename F>
+    void for_each(F&& f) const {
+        for (uint32_t i = 0; i < capacity; ++i)
+            if (slots[i].key != kLandruNil)
+                f(slots[i].key, slots[i].value);
+    }
+};
+
+//----------------------------------------------------------------------
+// Symbols
+//
+// Every name in a script, atoms, machine and state names, and library
+// function names, is interned to a dense integer id. Comparisons during
+// compilation and lookups at runtime are on ids. The keywords are
+// interned first, so their ids are constants.
+
+typedef enum : uint32_t {
+    symRequire, symMachine, symState, symOn, symGoto, symLaunch, symSet,
+    symDefun, symDefum, symMain, symTop, symTimeAfter,
+    symKeywordCount
+} LandruKeyword;
+
+static const char* landruKeywords[symKeywordCount] = {
+    "require", "machine", "state", "on", "goto", "launch", "set",
+    "defun", "defum", "main", "top", "time.after",
+};
+
+typedef struct LandruSymbols {
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;
+    };
+    vector<Slot> slots;        // open addressed, power of two sized
+    vector<tsStrView_t> names; // by id, the text lives in the arena
+
+    static uint32_t hash(tsStrView_t s) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < s.sz; ++i)
+            h = (h ^ (uint8_t) s.curr[i]) * 16777619u;
+        return h;
+    }
+
+    uint32_t find(tsStrView_t s) const {
+        if (slots.empty())
+            return kLandruNil;
+        uint32_t h = hash(s);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.id == kLandruNil)
+                return kLandruNil;
+            if (slot.hash == h && names[slot.id].sz == s.sz &&
+                !memcmp(names[slot.id].curr, s.curr, s.sz))
+                return slot.id;
+        }
+    }
+
+    uint32_t find(const char* s) const {
+        return find(tsStrView_t{ s, strlen(s) });
+    }
+
+    uint32_t intern(LandruArena& arena, tsStrView_t s) {
+        uint32_t id = find(s);
+        if (id != kLandruNil)
+            return id;
+        if ((names.size() + 1) * 2 > slots.size()) {
+            vector<Slot> old;
+            old.swap(slots);
+            slots.assign(old.size() ? old.size() * 2 : 256, Slot{ 0, kLandruNil });
+            for (const Slot& slot : old)
+                if (slot.id != kLandruNil)
+                    place(slot);
+        }
+        char* text = arena.New<char>(s.sz + 1);
+        memcpy(text, s.curr, s.sz);
+        id = (uint32_t) names.size();
+        names.push_back({ text, s.sz });
+        place({ hash(s), id });
+        return id;
+    }
+
+    uint32_t intern(LandruArena& arena, const char* s) {
+        return intern(arena, tsStrView_t{ s, strlen(s) });
+    }
+
+    void place(Slot slot) {
+        size_t mask = slots.size() - 1;
+        size_t i = slot.hash & mask;
+        while (slots[i].id != kLandruNil)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+
+    tsStrView_t name(uint32_t id) const {
+        return id < names.size() ? names[id] : tsStrView_t{ "", 0 };
+    }
+} LandruSymbols;
+
 //----------------------------------------------------------------------
 
 // function pointer for library functions whose signature is
@@ -282,6 +515,7 @@ typedef struct {
     tsParsedSexpr_t* arg; // for launch, goto, args for call
     LandruLibFunc func;   // for call function
     tsStrView_t name;     // for debugging purposes
+    uint32_t symbol;      // the interned name
     MachineExemplar* me;  // for when the operation needs to recurse
 } MachineInstruction;
 
@@ -295,39 +529,100 @@ typedef enum {
     mtList,
 } MachineType;
 
+// exemplars are allocated from the script's arena; their tables are keyed
+// by symbol id.
 typedef struct MachineExemplar {
-    string name;
+    uint32_t name;
     MachineType isState;
     MachineExemplar* parent;
     tsParsedSexpr_t* arg;
-    vector<MachineInstruction> instructions;
-    map<string, MachineExemplar*> machines;
-    map<string, MachineExemplar*> functions;
-    vector<MachineExemplar*> ons;
+    LandruArray<MachineInstruction> instructions;
+    LandruSymbolMap<MachineExemplar*> machines;
+    LandruSymbolMap<MachineExemplar*> functions;
+    LandruArray<MachineExemplar*> ons;
+    uint32_t linked; // index of the linked machine or state
 } MachineExemplar;
 
 //----------------------------------------------------------------------
 // A machine instance contains the local runtime scope for a machine.
-// THe local scope context contains the machine exemplar, the local variables, 
-// and the callbacks and functions defined in the machine.
-// The lcoal context also contains all the states that can be dispatched
-// from the current context.
+// THe local scope context contains the local variables; the functions
+// and states that can be dispatched from the current context are found
+// through the machine exemplar.
 // The instance contains not only the local runtime scope, but also all the
 // child scopes that have been launched from this scope.
 
 typedef struct {
     tsParsedSexpr_t* arguments;
-    map<string, tsParsedSexpr_t*> vars;
-    map<string, tsParsedSexpr_t*> callbacks;
-    map<string, tsParsedSexpr_t*> functions;
-    map<string, tsParsedSexpr_t*> states;
+    vector<tsParsedSexpr_t*> vars; // by variable slot, grown on first set
 } MachineLocalContext;
 
 typedef struct MachineInstance {
     MachineExemplar* me;
     vector<MachineLocalContext> localStates;
+
+    // runtime bookkeeping, owned by the scheduler
+    MachineInstance* parent;
+    uint32_t machine;    // index into LandruProgram::machines
+    uint32_t nextState;  // pending goto, or kLandruNil
+    uint32_t generation; // advances on every state change, stales timers
+    uint32_t armed;      // timers armed by the current state
+    bool live;
 } MachineInstance;
 
+//----------------------------------------------------------------------
+// Bytecode
+//
+// Exemplars are flattened into a single code array when a script is
+// loaded. The root, every machine body, every state, and every on handler
+// is a block of LandruCode terminated by opYield. Operands index the
+// program's tables, so an instruction is eight bytes.
+
+typedef enum : uint8_t {
+    opYield,  // end of block
+    opCall,   // a: library function, b: argument
+    opSet,    // a: variable slot, b: argument
+    opLaunch, // a: machine
+    opGoto,   // a: state, ends the block
+    opAfter,  // a: delay, b: pc of the handler block
+} LandruOp;
+
+typedef struct {
+    uint32_t op : 8;
+    uint32_t a  : 24;
+    uint32_t b;
+} LandruCode;
+
+static_assert(sizeof(LandruCode) == 8, "LandruCode should pack into eight bytes");
+
+typedef struct {
+    MachineExemplar* me;
+    uint32_t body;      // pc of the machine level instructions
+    uint32_t mainState; // state entered on launch, or kLandruNil
+} LandruMachine;
+
+typedef struct {
+    vector<LandruCode> code;
+    vector<LandruLibFunc> funcs;
+    vector<tsParsedSexpr_t*> args;
+    vector<uint32_t> variables;    // symbol of each variable slot
+    vector<uint32_t> variableSlot; // by symbol, or kLandruNil
+    vector<double> delays;
+    vector<LandruMachine> machines;
+    vector<uint32_t> states; // pc of each state's block
+    uint32_t root = 0;       // pc of the top level block
+} LandruProgram;
+
+// a one shot timer armed by an on time.after. The generation is the
+// instance's at the time of arming; if the instance has changed state
+// since, the timer is stale and is discarded when it comes due.
+typedef struct {
+    double due;
+    uint64_t seq;
+    MachineInstance* inst;
+    uint32_t generation;
+    uint32_t block;
+} LandruTimer;
+
 //----------------------------------------------------------------------
 // The Landru context contains the all of the library functions
 // imported by the program. It contains the root machine instance
@@ -340,13 +635,37 @@ typedef struct MachineInstance {
 typedef struct {
     MachineExemplar* me; // machine to launch
     MachineInstance* parent; // the scope to launch the machine into
+    uint32_t machine; // index into LandruProgram::machines
 } PendingLaunch;
 
 typedef struct Landru {
     MachineInstance root;
-    vector<string> req;
-    map<string, LandruLibFunc> libraryFunctions;
+    LandruArena arena;
+    LandruSymbols symbols;
+    vector<uint32_t> req;
+    vector<LandruLibFunc> libraryFunctions; // by symbol
     vector<PendingLaunch> launch;
+
+    // the script, its parse, and its compiled form
+    tsStrView_t source = {};
+    tsParsedSexpr_t* parsed = NULL;
+    tsParsedSexpr_t open = {tsSexprPushList, };
+    tsParsedSexpr_t close = {tsSexprPopList, };
+    MachineExemplar* exemplar = NULL;
+    LandruProgram program;
+
+    // scheduler state. The pool is a deque so that instances never move;
+    // timers and pending launches hold on to them by pointer.
+    std::deque<MachineInstance> pool;
+    vector<MachineInstance*> freeList;
+    vector<MachineInstance*> ready;   // instances with a pending goto
+    vector<MachineInstance*> running; // the ready list being serviced
+    vector<LandruTimer> timers;       // min heap on due time
+    size_t launchHead = 0;  // launches before this index have been serviced
+    size_t launchBatch = 0; // launches serviced per update, zero for all
+    uint64_t timerSeq = 0;
+    double now = 0;
+    LandruStats stats = {};
 } Landru;
 
 //----------------------------------------------------------------------
@@ -356,6 +675,7 @@ tsParsedSexpr_t* compileMachine(
     Landru* l, 
     MachineType mt, 
     MachineExemplar** exemplar);
+tsParsedSexpr_t* findClosingParen(tsParsedSexpr_t* openParen);
 
 //----------------------------------------------------------------------
 
@@ -385,12 +705,10 @@ void dump_parsed(tsParsedSexpr_t* curr) {
 
     while (curr) {
         switch (curr->token) {
-        case tsSexprAtom: {
-            std::string s = std::string(curr->str.curr, curr->str.sz);
-            printf("%s ", s.c_str());
+        case tsSexprAtom:
+            printf("%.*s ", (int) curr->str.sz, curr->str.curr);
             marker = markerAtom;
             break;
-        }
         case tsSexprPushList:
             printf("\n"); print_spaces(indent); printf("(");
             indent += 3;
@@ -411,25 +729,29 @@ void dump_parsed(tsParsedSexpr_t* curr) {
             printf(" %f ", curr->f);
             marker = markerAtom;
             break;
-        case tsSexprString: {
-            std::string s = std::string(curr->str.curr, curr->str.sz);
-            printf(" \"%s\" ", s.c_str());
+        case tsSexprString:
+            printf(" \"%.*s\" ", (int) curr->str.sz, curr->str.curr);
             marker = markerAtom;
             break;
         }
-        }
         curr = curr->next;
     } // while
     printf("\n");
 }
 
 
-void dumpExemplar(MachineExemplar* me, int indent = 0) {
+void printSymbol(Landru* l, uint32_t symbol) {
+    tsStrView_t name = l->symbols.name(symbol);
+    printf("%.*s", (int) name.sz, name.curr);
+}
+
+void dumpExemplar(Landru* l, MachineExemplar* me, int indent = 0) {
     if (!me)
         return;
 
     print_spaces(indent);
-    printf("MachineExemplar: %s", me->name.c_str());
+    printf("MachineExemplar: ");
+    printSymbol(l, me->name);
     switch (me->isState) {
         case mtRoot:     printf("  type: root\n"); break;
         case mtMachine:  printf("  type: machine\n"); break;
@@ -450,36 +772,47 @@ void dumpExemplar(MachineExemplar* me, int indent = 0) {
         }
         printf("  [%.*s]\n", (int) instr.name.sz, instr.name.curr);
     }
-    for (auto& on : me->ons) {
+    for (auto on : me->ons) {
         print_spaces(indent);
-        printf("  on: %s\n", on->name.c_str());
-        dumpExemplar(on, indent + 2);
+        printf("  on: ");
+        printSymbol(l, on->name);
+        printf("\n");
+        dumpExemplar(l, on, indent + 2);
     }
-    for (auto& func : me->functions) {
+    me->functions.for_each([&](uint32_t name, MachineExemplar* func) {
         print_spaces(indent);
-        printf("  function: %s\n", func.second->name.c_str());
-        dumpExemplar(func.second, indent + 2);
-    }
-    for (auto& machine : me->machines) {
-        dumpExemplar(machine.second, indent + 2);
-    }
+        printf("  function: ");
+        printSymbol(l, name);
+        printf("\n");
+        dumpExemplar(l, func, indent + 2);
+    });
+    me->machines.for_each([&](uint32_t, MachineExemplar* machine) {
+        dumpExemplar(l, machine, indent + 2);
+    });
 }
 
-void dumpMachineInstance(MachineInstance* inst) {
-    if (!inst)
+void dumpMachineInstance(Landru* l, MachineInstance* inst) {
+    if (!inst || !inst->me)
         return;
     
-    printf("MachineInstance: %s\n", inst->me->name.c_str());
-    printf("  states:\n");
-    for (auto i = inst->localStates.back().states.begin(); i != inst->localStates.back().states.end(); ++i) {
-        printf("    %s\n", i->first.c_str());
-    }
+    printf("MachineInstance: ");
+    printSymbol(l, inst->me->name);
+    printf("\n  states:\n");
+    inst->me->machines.for_each([&](uint32_t name, MachineExemplar* state) {
+        if (state->isState == mtState) {
+            printf("    ");
+            printSymbol(l, name);
+            printf("\n");
+        }
+    });
 }
 
 void dumpLandru(Landru* l) {
     printf("require:\n");
-    for (auto& s : l->req) {
-        printf("  %s\n", s.c_str());
+    for (auto s : l->req) {
+        printf("  ");
+        printSymbol(l, s);
+        printf("\n");
     }
 }
 
@@ -524,7 +857,68 @@ void dumpParsedExpr(const char* prefix, tsParsedSexpr_t* curr) {
 // lib io
 //
 
+void registerLibraryFunction(Landru* l, const char* name, LandruLibFunc f) {
+    uint32_t symbol = l->symbols.intern(l->arena, name);
+    if (symbol >= l->libraryFunctions.size())
+        l->libraryFunctions.resize(symbol + 1, NULL);
+    l->libraryFunctions[symbol] = f;
+}
+
+tsParsedSexpr_t* findVariable(Landru* l, MachineInstance* inst, tsStrView_t name) {
+    uint32_t symbol = l->symbols.find(name);
+    if (symbol >= l->program.variableSlot.size())
+        return NULL;
+    uint32_t slot = l->program.variableSlot[symbol];
+    if (slot == kLandruNil)
+        return NULL;
+    for (MachineInstance* scope : { inst, &l->root }) {
+        for (auto it = scope->localStates.rbegin(); it != scope->localStates.rend(); ++it) {
+            if (slot < it->vars.size() && it->vars[slot])
+                return it->vars[slot];
+        }
+    }
+    return NULL;
+}
+
+void io_print_value(Landru* l, tsParsedSexpr_t* curr, MachineInstance* inst) {
+    switch (curr->token) {
+        case tsSexprAtom: {
+            // atoms name variables; unknown atoms print as themselves
+            tsParsedSexpr_t* value = findVariable(l, inst, curr->str);
+            if (value && value->token != tsSexprAtom)
+                io_print_value(l, value, inst);
+            else
+                printf("%.*s", (int) curr->str.sz, curr->str.curr);
+            break;
+        }
+        case tsSexprString:
+            printf("%.*s", (int) curr->str.sz, curr->str.curr);
+            break;
+        case tsSexprInteger:
+            printf("%lld", (long long) curr->i);
+            break;
+        case tsSexprFloat:
+            printf("%f", curr->f);
+            break;
+        case tsSexprPushList:
+        case tsSexprPopList:
+            break;
+    }
+}
+
+void io_print(Landru* l, tsParsedSexpr_t* arg, MachineInstance* inst) {
+    if (arg && arg->token == tsSexprPushList) {
+        tsParsedSexpr_t* end = findClosingParen(arg);
+        for (tsParsedSexpr_t* curr = arg->next; curr && curr != end; curr = curr->next)
+            io_print_value(l, curr, inst);
+    }
+    else if (arg)
+        io_print_value(l, arg, inst);
+    printf("\n");
+}
+
 void io_register(Landru* l) {
+    registerLibraryFunction(l, "io.print", io_print);
 }
 
 void registerLibrary(Landru* l, const char* name) {
@@ -532,7 +926,7 @@ void registerLibrary(Landru* l, const char* name) {
         io_register(l);
     }
     else if (strcmp(name, "time") == 0) {
-        //
+        // time.after is serviced by the scheduler's timer heap
     }
     else if (strcmp(name, "test") == 0) {
         //
@@ -543,48 +937,33 @@ void registerLibrary(Landru* l, const char* name) {
 
 //----------------------------------------------------------------------
 
-bool atomIsKeyword(const tsParsedSexpr_t* curr) {
+bool atomIsKeyword(Landru* l, const tsParsedSexpr_t* curr) {
     if (!curr || curr->token != tsSexprAtom)
         return false;
 
-    static const char* keywords[] = {"require", "machine", "state", "on", "goto", "launch"};
-    static const int numKeywords = sizeof(keywords) / sizeof(keywords[0]);
-    for (int i = 0; i < numKeywords; ++i) {
-        if (sizeof(keywords[i]) != curr->str.sz)
-            continue;
-        if (strncmp(curr->str.curr, keywords[i], curr->str.sz) == 0)
-            return true;
-    }
-    return false;
+    // keywords are interned ahead of everything else
+    return l->symbols.find(curr->str) <= symDefum;
 }
 
 void landru_add_require(Landru* l, tsParsedSexpr_t* curr) {
     if (!curr || curr->token != tsSexprAtom || !curr->str.sz)
         return;
 
-    l->req.push_back(std::string(curr->str.curr, curr->str.sz));
+    l->req.push_back(l->symbols.intern(l->arena, curr->str));
 }
 
-LandruLibFunc findLibraryFunction(Landru* l, const char* name) {    // search root
-    auto f = l->libraryFunctions.find(name);
-    if (f != l->libraryFunctions.end())
-        return f->second;
+LandruLibFunc findLibraryFunction(Landru* l, uint32_t symbol) {    // search root
+    if (symbol < l->libraryFunctions.size())
+        return l->libraryFunctions[symbol];
     return NULL;
 }
 
-tsParsedSexpr_t* findFunction(Landru* l, MachineInstance* inst, const char* name) {
-    // search local states
-    for (auto it = inst->localStates.rbegin(); it != inst->localStates.rend(); ++it) {
-        auto& ctx = *it;
-        auto f = ctx.functions.find(name);
-        if (f != ctx.functions.end()) {
-            return f->second;
-        }
-    }
-    // search root
-    auto f = l->root.localStates[0].functions.find(name);
-    if (f != l->root.localStates[0].functions.end()) {
-        return f->second;
+MachineExemplar* findFunction(Landru* l, MachineExemplar* me, uint32_t symbol) {
+    // search enclosing scopes, out to the root
+    for (; me; me = me->parent) {
+        MachineExemplar* f = me->functions.find(symbol);
+        if (f)
+            return f;
     }
     return NULL;
 }
@@ -654,31 +1033,36 @@ void signalCallbackSet(MachineInstance* inst) {
         throw std::runtime_error("no current state");
 }
 
-void diagnoseStateNotFound(MachineInstance* inst, string stateName) {
-    printf("state not found: %s\n", stateName.c_str());
-    printf("available states:\n");
-    for (auto& c : inst->localStates) {
-        for (auto& s : c.states) {
-            printf("  %s\n", s.first.c_str());
-        }
+void diagnoseStateNotFound(Landru* l, MachineExemplar* me, uint32_t stateName) {
+    printf("state not found: ");
+    printSymbol(l, stateName);
+    printf("\navailable states:\n");
+    for (; me; me = me->parent) {
+        me->machines.for_each([&](uint32_t name, MachineExemplar* state) {
+            if (state->isState == mtState) {
+                printf("  ");
+                printSymbol(l, name);
+                printf("\n");
+            }
+        });
     }
 }
 
-tsParsedSexpr_t* compileLaunch(tsParsedSexpr_t* curr, MachineExemplar* me) {
+tsParsedSexpr_t* compileLaunch(tsParsedSexpr_t* curr, Landru* l, MachineExemplar* me) {
     // peek at next to get the name of the machine to launch
     tsParsedSexpr_t* name = curr->next;
     if (name && name->token == tsSexprAtom) {
-        std::string nameStr = std::string(name->str.curr, name->str.sz);
-        
+
         // the next should be a close paren
         tsParsedSexpr_t* body = name->next;
         if (!body || body->token != tsSexprPopList)
             diagnoseAndThrow(curr, "expected end of list");
         
-        MachineInstruction instr;
+        MachineInstruction instr = {};
         instr.op = moLaunchMachine;
         instr.name = name->str;
-        me->instructions.push_back(instr);
+        instr.symbol = l->symbols.intern(l->arena, name->str);
+        me->instructions.push_back(l->arena, instr);
         return body; // return closing paren
     }
     else {
@@ -686,21 +1070,21 @@ tsParsedSexpr_t* compileLaunch(tsParsedSexpr_t* curr, MachineExemplar* me) {
     }
 }
 
-tsParsedSexpr_t* compileGoto(tsParsedSexpr_t* curr, MachineExemplar* me) {
+tsParsedSexpr_t* compileGoto(tsParsedSexpr_t* curr, Landru* l, MachineExemplar* me) {
     // peek at next to get the name of the state to launch
     tsParsedSexpr_t* name = curr->next;
     if (name && name->token == tsSexprAtom) {
-        std::string nameStr = std::string(name->str.curr, name->str.sz);
-        
+
         // the next should be a close paren
         tsParsedSexpr_t* body = name->next;
         if (!body || body->token != tsSexprPopList)
             diagnoseAndThrow(curr, "expected end of list");
         
-        MachineInstruction instr;
+        MachineInstruction instr = {};
         instr.op = moGotoState;
         instr.name = name->str;
-        me->instructions.push_back(instr);
+        instr.symbol = l->symbols.intern(l->arena, name->str);
+        me->instructions.push_back(l->arena, instr);
         return body; // return closing paren
     }
     else {
@@ -712,8 +1096,6 @@ tsParsedSexpr_t* compileSet(tsParsedSexpr_t* curr, Landru* l, MachineExemplar* m
     // peek at next to get the name of variable to set
     tsParsedSexpr_t* name = curr->next;
     if (name && name->token == tsSexprAtom) {
-        std::string nameStr = std::string(name->str.curr, name->str.sz);
-        
         // the next token should either be a constant or a list
         tsParsedSexpr_t* body = name->next;
         switch (body->token) {
@@ -728,12 +1110,13 @@ tsParsedSexpr_t* compileSet(tsParsedSexpr_t* curr, Landru* l, MachineExemplar* m
                 if (!monad)
                     throw std::runtime_error("expected monad");
 
-                MachineInstruction instr;
+                MachineInstruction instr = {};
                 instr.op = moSetVariable;
                 instr.name = name->str;
-                me->instructions.push_back(instr);
+                instr.symbol = l->symbols.intern(l->arena, name->str);
                 instr.arg = NULL;
                 instr.me = monad;
+                me->instructions.push_back(l->arena, instr);
                 return body->next;
             }
             break;
@@ -741,12 +1124,13 @@ tsParsedSexpr_t* compileSet(tsParsedSexpr_t* curr, Landru* l, MachineExemplar* m
             case tsSexprString:
             case tsSexprFloat:
             case tsSexprInteger: {
-                MachineInstruction instr;
+                MachineInstruction instr = {};
                 instr.op = moSetVariable;
                 instr.name = name->str;
-                me->instructions.push_back(instr);
+                instr.symbol = l->symbols.intern(l->arena, name->str);
                 instr.me = NULL;
                 instr.arg = body;
+                me->instructions.push_back(l->arena, instr);
                 return body->next;
             }
             break;
@@ -787,12 +1171,12 @@ tsParsedSexpr_t* compileFunctionCall(tsParsedSexpr_t* curr, Landru* l, MachineEx
     curr = curr->next;
     expectConstantOrList(curr);
 
-    MachineInstruction instr;
+    MachineInstruction instr = {};
     instr.op = moFunctionCall;
     instr.name = name->str;
-    me->instructions.push_back(instr);
+    instr.symbol = l->symbols.intern(l->arena, name->str);
     instr.me = NULL;
-    instr.arg = NULL;
+    instr.arg = curr; // a constant, or the open paren of the argument list
     MachineExemplar* monad = NULL;
     if (curr->token == tsSexprPushList) {
         curr = compileMachine(curr, l, mtList, &monad);
@@ -801,11 +1185,11 @@ tsParsedSexpr_t* compileFunctionCall(tsParsedSexpr_t* curr, Landru* l, MachineEx
         instr.me = monad;
     }
     else {
-        instr.arg = curr;
         curr = curr->next; // consume value
         if (!curr || curr->token != tsSexprPopList)
             diagnoseAndThrow(curr, "expected closing paren");
     }
+    me->instructions.push_back(l->arena, instr);
     return curr;
 }
 
@@ -815,8 +1199,10 @@ tsParsedSexpr_t* compileRequire(tsParsedSexpr_t* curr, Landru* l) {
     // peek at next to get the name of the required library
     tsParsedSexpr_t* name = curr->next;
     if (name && name->token == tsSexprAtom) {
-        std::string nameStr = std::string(name->str.curr, name->str.sz);
-        registerLibrary(l, nameStr.c_str());
+        // interned names are nul terminated
+        uint32_t symbol = l->symbols.intern(l->arena, name->str);
+        registerLibrary(l, l->symbols.name(symbol).curr);
+        l->req.push_back(symbol);
         name = name->next; // consume the name
         if (!name || name->token != tsSexprPopList)
             diagnoseAndThrow(curr, "expected paren at end of scope");
@@ -842,10 +1228,11 @@ tsParsedSexpr_t* compileMachine(
         diagnoseAndThrow(curr, "unexpected end of program\n");
     
     // the top level machine is implicit and unnamed.
-    std::string name = "top";
+    uint32_t name = symTop;
     // create new substate
-    MachineExemplar* me = new MachineExemplar();
+    MachineExemplar* me = l->arena.New<MachineExemplar>();
     me->isState = mt;
+    me->linked = kLandruNil;
     *exemplar = me;
 
     if (mt == mtList) {
@@ -856,26 +1243,26 @@ tsParsedSexpr_t* compileMachine(
         // machine, state, defun, and defum expect to be followed by a name
         if (curr->token != tsSexprAtom)
             diagnoseAndThrow(curr, "expected machine atom");
-        std::string token = std::string(curr->str.curr, curr->str.sz);
+        uint32_t token = l->symbols.intern(l->arena, curr->str);
         switch (mt) {
             case mtMachine:
-                if (token != "machine")
+                if (token != symMachine)
                     diagnoseAndThrow(curr, "expected machine atom");
                 break;
             case mtState:
-                if (token != "state")
+                if (token != symState)
                     diagnoseAndThrow(curr, "expected state atom");
                 break;
             case mtFunction:
-                if (token != "defun")
+                if (token != symDefun)
                     diagnoseAndThrow(curr, "expected defun atom");
                 break;
             case mtMonad:
-                if (token != "defum")
+                if (token != symDefum)
                     diagnoseAndThrow(curr, "expected defum atom");
                 break;
             case mtOn:
-                if (token != "on")
+                if (token != symOn)
                     diagnoseAndThrow(curr, "expected defum atom");
                 break;
             case mtRoot:
@@ -887,7 +1274,7 @@ tsParsedSexpr_t* compileMachine(
         curr = curr->next;
         if (!curr || curr->token != tsSexprAtom)
             diagnoseAndThrow(curr, "expected state name");
-        name = std::string(curr->str.curr, curr->str.sz);
+        name = l->symbols.intern(l->arena, curr->str);
         curr = curr->next;
     }
     me->name = name;
@@ -946,8 +1333,8 @@ tsParsedSexpr_t* compileMachine(
                 continue;
 
             case tsSexprAtom: {
-                std::string s = std::string(curr->str.curr, curr->str.sz);
-                if (s == "machine") {
+                uint32_t s = l->symbols.intern(l->arena, curr->str);
+                if (s == symMachine) {
                     // parse a local machine
                     MachineExemplar* sub_me = NULL;
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
@@ -958,12 +1345,12 @@ tsParsedSexpr_t* compileMachine(
                         // and make it available to the local scope
                         sub_me->parent = me;
                         sub_me->isState = mtMachine;
-                        me->machines[sub_me->name] = sub_me;
+                        me->machines.insert(l->arena, sub_me->name, sub_me);
                     }
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "state") {
+                else if (s == symState) {
                     // parse a local state; the only difference between a state and
                     // a machine is that machines are launched into the same
                     // scope as the launching machine, and states are launched
@@ -980,12 +1367,12 @@ tsParsedSexpr_t* compileMachine(
                         // and make it available to the local scope
                         sub_me->parent = me;
                         sub_me->isState = mtState;
-                        me->machines[sub_me->name] = sub_me;
+                        me->machines.insert(l->arena, sub_me->name, sub_me);
                     }
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "on") {
+                else if (s == symOn) {
                     MachineExemplar* sub_me = NULL;
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
                     curr = compileMachine(openParen, l, mtOn, &sub_me);
@@ -995,12 +1382,12 @@ tsParsedSexpr_t* compileMachine(
                         // and make it available to the local scope
                         sub_me->parent = me;
                         sub_me->isState = mtState;
-                        me->ons.emplace_back(sub_me);
+                        me->ons.push_back(l->arena, sub_me);
                     }
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "require") {
+                else if (s == symRequire) {
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
                     curr = compileRequire(curr, l);
                     if (verify != curr)
@@ -1008,7 +1395,7 @@ tsParsedSexpr_t* compileMachine(
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "defun") {
+                else if (s == symDefun) {
                     // a function is just like a state, except invoking it
                     // does not terminate the present state or launch a new one.
                     // a function is a pure function, and does not have access to
@@ -1022,12 +1409,12 @@ tsParsedSexpr_t* compileMachine(
                         // and make it available to the local scope
                         sub_me->parent = me;
                         sub_me->isState = mtFunction;
-                        me->functions[sub_me->name] = sub_me;
+                        me->functions.insert(l->arena, sub_me->name, sub_me);
                     }
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "defum") {
+                else if (s == symDefum) {
                     // a monadic function is just like a function, except that
                     // it may have side effects.
                     MachineExemplar* sub_me = NULL;
@@ -1039,12 +1426,12 @@ tsParsedSexpr_t* compileMachine(
                         // and make it available to the local scope
                         sub_me->parent = me;
                         sub_me->isState = mtMonad;
-                        me->functions[sub_me->name] = sub_me;
+                        me->functions.insert(l->arena, sub_me->name, sub_me);
                     }
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "launch") {
+                else if (s == symLaunch) {
                     // compile a launch operation
                     // note that at the moment a launch occurs into the local scope
                     // and not a higher scope. The next iteration of the compiler
@@ -1058,21 +1445,21 @@ tsParsedSexpr_t* compileMachine(
                     // and a player machine might launch bubble machines into the
                     // playfield scope. That's probably the best idea.
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
-                    curr = compileLaunch(curr, me);
+                    curr = compileLaunch(curr, l, me);
                     if (verify != curr)
                         diagnoseAndThrow(curr, "launch not properly closed");
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "goto") {
+                else if (s == symGoto) {
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
-                    curr = compileGoto(curr, me);
+                    curr = compileGoto(curr, l, me);
                     if (verify != curr)
                         diagnoseAndThrow(curr, "goto not properly closed");
                     curr = curr->next;
                     --level;
                 }
-                else if (s == "set") {
+                else if (s == symSet) {
                     tsParsedSexpr_t* verify = findClosingParen(openParen);
                     curr = compileSet(curr, l, me);
                     if (verify != curr)
@@ -1103,54 +1490,430 @@ tsParsedSexpr_t* compileMachine(
 }
 
 
-bool LandruRun(const char* src, bool dump_exemplar) {
-    tsParsedSexpr_t* parsed = tsParsedSexpr_New();
-    parsed->token = tsSexprAtom;
-    tsStrView_t str = (tsStrView_t){src, strlen(src)};
+//----------------------------------------------------------------------
+// Linking flattens the exemplar tree into a LandruProgram. Names are
+// resolved here, once, rather than every time an instruction runs.
 
-    /*tsStrView_t end_of_str =*/ tsStrViewParseSexpr(&str, parsed, 0);
-    dump_parsed(parsed);
+typedef struct {
+    vector<MachineExemplar*> machines;
+    vector<MachineExemplar*> states;
+} LandruLinkTables;
+
+void indexExemplars(MachineExemplar* me, LandruLinkTables& t) {
+    me->machines.for_each([&](uint32_t, MachineExemplar* sub) {
+        if (sub->isState == mtMachine) {
+            sub->linked = (uint32_t) t.machines.size();
+            t.machines.push_back(sub);
+        }
+        else if (sub->isState == mtState) {
+            sub->linked = (uint32_t) t.states.size();
+            t.states.push_back(sub);
+        }
+        indexExemplars(sub, t);
+    });
+    for (auto on : me->ons)
+        indexExemplars(on, t);
+}
 
-    Landru l;
-    l.root.me = NULL;
-    l.root.localStates.push_back({});
-    MachineExemplar* me = NULL;
+// find the nearest enclosing machine or state of the given name
+MachineExemplar* resolveExemplar(MachineExemplar* me, uint32_t name, MachineType mt) {
+    for (; me; me = me->parent) {
+        MachineExemplar* found = me->machines.find(name);
+        if (found && found->isState == mt)
+            return found;
+    }
+    return NULL;
+}
 
-    // @TODO get rid of the empty token in the parser itself
-    if (parsed->token == tsSexprAtom && parsed->str.sz == 0)
-        parsed = parsed->next;
+uint32_t checkOperand(size_t i) {
+    if (i >= (1 << 24))
+        throw std::runtime_error("script exceeds bytecode operand range");
+    return (uint32_t) i;
+}
 
-    // empty file is valid
-    if (!parsed)
-        return true;
-    
-    tsParsedSexpr_t open = {tsSexprPushList, };
-    tsParsedSexpr_t close = {tsSexprPopList, };
+uint32_t emitBlock(Landru* l, MachineExemplar* me, LandruLinkTables& t) {
+    LandruProgram& p = l->program;
+    uint32_t start = (uint32_t) p.code.size();
+    for (auto& instr : me->instructions) {
+        switch (instr.op) {
+            case moFunctionCall: {
+                LandruLibFunc f = findLibraryFunction(l, instr.symbol);
+                if (!f) {
+                    printf("unknown function: %.*s\n", (int) instr.name.sz, instr.name.curr);
+                    break;
+                }
+                auto fi = std::find(p.funcs.begin(), p.funcs.end(), f);
+                if (fi == p.funcs.end())
+                    fi = p.funcs.insert(p.funcs.end(), f);
+                p.args.push_back(instr.arg);
+                p.code.push_back({ opCall,
+                    checkOperand(fi - p.funcs.begin()),
+                    (uint32_t) p.args.size() - 1 });
+                break;
+            }
+            case moSetVariable: {
+                if (instr.symbol >= p.variableSlot.size())
+                    p.variableSlot.resize(l->symbols.names.size(), kLandruNil);
+                uint32_t& slot = p.variableSlot[instr.symbol];
+                if (slot == kLandruNil) {
+                    slot = (uint32_t) p.variables.size();
+                    p.variables.push_back(instr.symbol);
+                }
+                p.args.push_back(instr.arg);
+                p.code.push_back({ opSet, checkOperand(slot),
+                    (uint32_t) p.args.size() - 1 });
+                break;
+            }
+            case moLaunchMachine: {
+                MachineExemplar* target = resolveExemplar(me, instr.symbol, mtMachine);
+                if (!target) {
+                    printf("machine not found: %.*s\n", (int) instr.name.sz, instr.name.curr);
+                    break;
+                }
+                p.code.push_back({ opLaunch, checkOperand(target->linked), 0 });
+                break;
+            }
+            case moGotoState: {
+                MachineExemplar* target = resolveExemplar(me, instr.symbol, mtState);
+                if (!target) {
+                    diagnoseStateNotFound(l, me, instr.symbol);
+                    break;
+                }
+                p.code.push_back({ opGoto, checkOperand(target->linked), 0 });
+                break;
+            }
+            case moOn:
+                break;
+        }
+    }
 
-    open.next = parsed;
-    tsParsedSexpr_t* last = parsed;
-    while (last) {
-        if (!last->next) {
-            last->next = &close;
-            break;
+    // arm the on conditions. The handlers are emitted after this block is
+    // terminated, so that each block remains contiguous.
+    vector<std::pair<uint32_t, MachineExemplar*>> handlers;
+    for (auto on : me->ons) {
+        if (on->name != symTimeAfter) {
+            printf("unsupported condition: ");
+            printSymbol(l, on->name);
+            printf("\n");
+            continue;
         }
-        last = last->next;
+        double delay = 0;
+        if (on->arg && on->arg->token == tsSexprFloat)
+            delay = on->arg->f;
+        else if (on->arg && on->arg->token == tsSexprInteger)
+            delay = (double) on->arg->i;
+        else
+            throw std::runtime_error("time.after expects a number of seconds");
+        p.delays.push_back(delay);
+        handlers.push_back({ (uint32_t) p.code.size(), on });
+        p.code.push_back({ opAfter, checkOperand(p.delays.size() - 1), kLandruNil });
     }
+    p.code.push_back({ opYield, 0, 0 });
+
+    for (auto& h : handlers)
+        p.code[h.first].b = emitBlock(l, h.second, t);
+    return start;
+}
 
-    tsParsedSexpr_t* verifyClose = findClosingParen(&open);
-    if (verifyClose != &close) {
-        diagnoseAndThrow(verifyClose, "unmatched open paren");
+void linkProgram(Landru* l) {
+    LandruLinkTables t;
+    indexExemplars(l->exemplar, t);
+
+    LandruProgram& p = l->program;
+    p.root = emitBlock(l, l->exemplar, t);
+    p.states.resize(t.states.size());
+    for (size_t i = 0; i < t.states.size(); ++i)
+        p.states[i] = emitBlock(l, t.states[i], t);
+    for (auto me : t.machines) {
+        LandruMachine m;
+        m.me = me;
+        m.body = emitBlock(l, me, t);
+        m.mainState = kLandruNil;
+        MachineExemplar* main = me->machines.find(symMain);
+        if (main && main->isState == mtState)
+            m.mainState = main->linked;
+        p.machines.push_back(m);
     }
+}
 
-    tsParsedSexpr_t* curr = compileMachine(&open, &l, mtRoot, &me);
-    if (curr != verifyClose) {
-        diagnoseAndThrow(curr, "found tokens beyond end of script");
+//----------------------------------------------------------------------
+// Scheduler
+//
+// Machines are cooperative. A block runs to its end, or until a goto,
+// without interruption. A goto yields; the state change happens when the
+// scheduler next services the ready list. Launches are queued, and are
+// serviced in batches at the start of an update.
+
+void scheduleGoto(Landru* l, MachineInstance* inst, uint32_t state) {
+    if (inst == &l->root)
+        return; // the top level has no states
+    if (inst->nextState == kLandruNil)
+        l->ready.push_back(inst);
+    inst->nextState = state;
+}
+
+void executeBlock(Landru* l, MachineInstance* inst, uint32_t pc) {
+    const LandruProgram& p = l->program;
+    const LandruCode* code = p.code.data();
+    while (true) {
+        const LandruCode c = code[pc++];
+        switch (c.op) {
+            case opYield:
+                return;
+            case opCall:
+                p.funcs[c.a](l, p.args[c.b], inst);
+                break;
+            case opSet: {
+                vector<tsParsedSexpr_t*>& vars = inst->localStates.back().vars;
+                if (vars.size() <= c.a)
+                    vars.resize(p.variables.size(), NULL);
+                vars[c.a] = p.args[c.b];
+                break;
+            }
+            case opLaunch:
+                l->launch.push_back({ p.machines[c.a].me, inst, c.a });
+                break;
+            case opGoto:
+                scheduleGoto(l, inst, c.a);
+                return;
+            case opAfter: {
+                LandruTimer timer = { l->now + p.delays[c.a], l->timerSeq++,
+                                      inst, inst->generation, c.b };
+                l->timers.push_back(timer);
+                std::push_heap(l->timers.begin(), l->timers.end(),
+                    [](const LandruTimer& a, const LandruTimer& b) {
+                        return a.due > b.due || (a.due == b.due && a.seq > b.seq); });
+                ++inst->armed;
+                break;
+            }
+        }
+    }
+}
+
+MachineInstance* acquireInstance(Landru* l) {
+    MachineInstance* inst;
+    if (l->freeList.size()) {
+        inst = l->freeList.back();
+        l->freeList.pop_back();
+    }
+    else {
+        l->pool.push_back(MachineInstance{});
+        inst = &l->pool.back();
+        inst->generation = 0;
+    }
+    inst->live = true;
+    inst->nextState = kLandruNil;
+    inst->armed = 0;
+    ++l->stats.live;
+    ++l->stats.launched;
+    return inst;
+}
+
+void retireIfIdle(Landru* l, MachineInstance* inst) {
+    if (inst == &l->root || !inst->live)
+        return;
+    if (inst->nextState != kLandruNil || inst->armed)
+        return;
+    inst->live = false;
+    ++inst->generation; // stale anything still referring to this slot
+    inst->localStates.clear();
+    l->freeList.push_back(inst);
+    --l->stats.live;
+    ++l->stats.retired;
+}
+
+void serviceLaunches(Landru* l) {
+    size_t count = l->launch.size() - l->launchHead;
+    if (l->launchBatch && count > l->launchBatch)
+        count = l->launchBatch;
+
+    // instances launched here may launch in turn; those land beyond
+    // end, and are serviced on a later update.
+    size_t end = l->launchHead + count;
+    l->freeList.reserve(l->freeList.size() + count);
+    for (size_t i = l->launchHead; i < end; ++i) {
+        PendingLaunch pending = l->launch[i];
+        const LandruMachine& m = l->program.machines[pending.machine];
+        MachineInstance* inst = acquireInstance(l);
+        inst->me = pending.me;
+        inst->parent = pending.parent;
+        inst->machine = pending.machine;
+        signalStateEnter(inst); // the machine scope
+        executeBlock(l, inst, m.body);
+        if (inst->nextState == kLandruNil && m.mainState != kLandruNil)
+            scheduleGoto(l, inst, m.mainState);
+        retireIfIdle(l, inst);
+    }
+    l->launchHead = end;
+    if (l->launchHead == l->launch.size()) {
+        l->launch.clear();
+        l->launchHead = 0;
+    }
+}
+
+void serviceTimers(Landru* l) {
+    auto later = [](const LandruTimer& a, const LandruTimer& b) {
+        return a.due > b.due || (a.due == b.due && a.seq > b.seq); };
+    while (l->timers.size() && l->timers.front().due <= l->now) {
+        std::pop_heap(l->timers.begin(), l->timers.end(), later);
+        LandruTimer timer = l->timers.back();
+        l->timers.pop_back();
+        MachineInstance* inst = timer.inst;
+        if (inst->generation != timer.generation) {
+            ++l->stats.timersStale;
+            continue;
+        }
+        --inst->armed;
+        ++l->stats.timersFired;
+        executeBlock(l, inst, timer.block);
+        retireIfIdle(l, inst);
     }
+}
+
+void serviceGotos(Landru* l) {
+    // gotos issued while servicing this list are deferred to the next
+    // update, so a machine that loops on goto can't starve the others.
+    std::swap(l->ready, l->running);
+    for (MachineInstance* inst : l->running) {
+        uint32_t state = inst->nextState;
+        inst->nextState = kLandruNil;
+        if (inst->localStates.size() > 1)
+            signalStateExit(inst);
+        ++inst->generation;
+        inst->armed = 0;
+        signalStateEnter(inst);
+        ++l->stats.transitions;
+        executeBlock(l, inst, l->program.states[state]);
+        retireIfIdle(l, inst);
+    }
+    l->running.clear();
+}
 
-    if (dump_exemplar) {
-        dumpExemplar(me);
+Landru* LandruCreate(const char* src, bool dump_exemplar) {
+    Landru* l = new Landru();
+    l->root.me = NULL;
+    l->root.parent = NULL;
+    l->root.machine = kLandruNil;
+    l->root.nextState = kLandruNil;
+    l->root.generation = 0;
+    l->root.armed = 0;
+    l->root.live = true;
+    l->root.localStates.push_back({});
+
+    // intern the keywords first, so that their ids match LandruKeyword
+    for (uint32_t i = 0; i < symKeywordCount; ++i)
+        l->symbols.intern(l->arena, landruKeywords[i]);
+
+    // the parse refers into the source, so the instance keeps a copy
+    size_t sz = src ? strlen(src) : 0;
+    char* source = l->arena.New<char>(sz + 1);
+    if (sz)
+        memcpy(source, src, sz);
+    l->source = { source, sz };
+
+    try {
+        auto alloc = [](void* arena) -> tsParsedSexpr_t* {
+            return static_cast<LandruArena*>(arena)->New<tsParsedSexpr_t>();
+        };
+        l->parsed = alloc(&l->arena);
+        l->parsed->token = tsSexprAtom;
+        tsStrView_t str = l->source;
+        /*tsStrView_t end_of_str =*/ tsStrViewParseSexprAlloc(&str, l->parsed, 0, alloc, &l->arena);
+        if (dump_exemplar)
+            dump_parsed(l->parsed);
+
+        // @TODO get rid of the empty token in the parser itself
+        tsParsedSexpr_t* parsed = l->parsed;
+        if (parsed->token == tsSexprAtom && parsed->str.sz == 0)
+            parsed = parsed->next;
+
+        // empty file is valid
+        if (!parsed)
+            return l;
+
+        l->open.next = parsed;
+        tsParsedSexpr_t* last = parsed;
+        while (last) {
+            if (!last->next) {
+                last->next = &l->close;
+                break;
+            }
+            last = last->next;
+        }
+
+        tsParsedSexpr_t* verifyClose = findClosingParen(&l->open);
+        if (verifyClose != &l->close) {
+            diagnoseAndThrow(verifyClose, "unmatched open paren");
+        }
+
+        tsParsedSexpr_t* curr = compileMachine(&l->open, l, mtRoot, &l->exemplar);
+        if (curr != verifyClose) {
+            diagnoseAndThrow(curr, "found tokens beyond end of script");
+        }
+
+        if (dump_exemplar) {
+            dumpExemplar(l, l->exemplar);
+        }
+
+        linkProgram(l);
+        executeBlock(l, &l->root, l->program.root);
     }
-    return false;
+    catch (...) {
+        LandruDestroy(l);
+        throw;
+    }
+    return l;
+}
+
+Landru* LandruCreate(const char* src) {
+    return LandruCreate(src, false);
+}
+
+void LandruDestroy(Landru* l) {
+    // the parse and exemplars go with the arena
+    delete l;
+}
+
+bool LandruUpdate(Landru* l, double dt) {
+    if (!l)
+        return false;
+    l->now += dt;
+    serviceLaunches(l);
+    serviceTimers(l);
+    serviceGotos(l);
+    return l->stats.live > 0 || l->launch.size() > l->launchHead;
+}
+
+bool LandruLaunch(Landru* l, const char* machine, int count) {
+    if (!l || !l->exemplar || !machine)
+        return false;
+    uint32_t symbol = l->symbols.find(machine);
+    MachineExemplar* me = symbol == kLandruNil ? NULL : l->exemplar->machines.find(symbol);
+    if (!me || me->isState != mtMachine)
+        return false;
+    l->launch.reserve(l->launch.size() + count);
+    for (int n = 0; n < count; ++n)
+        l->launch.push_back({ me, &l->root, me->linked });
+    return true;
+}
+
+void LandruSetLaunchBatch(Landru* l, size_t batch) {
+    if (l)
+        l->launchBatch = batch;
+}
+
+LandruStats LandruGetStats(const Landru* l) {
+    return l ? l->stats : LandruStats{};
+}
+
+bool LandruRun(const char* src, bool dump_exemplar) {
+    Landru* l = LandruCreate(src, dump_exemplar);
+    const double dt = 1.0 / 60.0;
+    bool running = true;
+    for (int tick = 0; running && tick < 600; ++tick)
+        running = LandruUpdate(l, dt);
+    LandruDestroy(l);
+    return !running;
 }
 
 bool LandruRun(const char* src) {
@@ -1161,6 +1924,135 @@ bool LandruRunPrintExemplar(const char* src) {
     return LandruRun(src, true);
 }
 
+char const* pingpongBenchSrc = R"(
+
+(require time)
+
+(machine pingpong
+    (state ping
+        (on time.after 0.1
+            (goto pong)
+        )
+    )
+    (state pong
+        (on time.after 0.1
+            (goto ping)
+        )
+    )
+    (state main
+        (goto ping)
+    )
+)
+
+)";
+
+int LandruBenchmark(int machines) {
+    using clock = std::chrono::steady_clock;
+    Landru* l = LandruCreate(pingpongBenchSrc);
+    LandruLaunch(l, "pingpong", machines);
+
+    // spread the launches over ten ticks so that the timers are staggered
+    LandruSetLaunchBatch(l, std::max(1, machines / 10));
+
+    const int ticks = 600;
+    const double dt = 1.0 / 60.0;
+    double totalMs = 0, maxMs = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        auto start = clock::now();
+        LandruUpdate(l, dt);
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        totalMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    LandruStats stats = LandruGetStats(l);
+    printf("landru: %d pingpong machines, %d ticks\n", machines, ticks);
+    printf("  %.3f ms per tick average, %.3f ms worst\n", totalMs / ticks, maxMs);
+    printf("  %llu transitions, %llu timers fired, %.2f M transitions/s\n",
+           (unsigned long long) stats.transitions,
+           (unsigned long long) stats.timersFired,
+           stats.transitions / (totalMs * 1e3));
+    size_t pool = l->pool.size();
+    LandruDestroy(l);
+
+    // every machine should still be live. Each waits a tenth of a second
+    // per state, rounded up to whole ticks, and its goto takes effect on
+    // the following tick, so expect well over fifty transitions apiece.
+    bool ok = stats.live == (size_t) machines && pool == (size_t) machines &&
+              stats.transitions >= (uint64_t) machines * 50;
+    if (!ok)
+        printf("landru: benchmark machines did not run as expected\n");
+    return ok ? 0 : 1;
+}
+
+// generate a script of machines machines, each with a few states, and
+// time parsing, compiling and linking it
+int LandruBenchmarkCompile(int machines) {
+    using clock = std::chrono::steady_clock;
+    string src = "(require io)\n(require time)\n";
+    char buff[512];
+    for (int i = 0; i < machines; ++i) {
+        snprintf(buff, sizeof(buff),
+            "(machine m%d\n"
+            "    (set count %d)\n"
+            "    (state main (io.print \"m%d\") (goto a%d))\n"
+            "    (state a%d (set x 1.5) (on time.after 0.5 (goto b%d)))\n"
+            "    (state b%d (set y %d) (on time.after 0.25 (goto a%d)))\n"
+            ")\n", i, i, i, i, i, i, i, i, i);
+        src += buff;
+    }
+    src += "(launch m0)\n";
+
+    const int runs = 5;
+    double parseMallocMs = 1e9, parseArenaMs = 1e9, compileMs = 1e9;
+    size_t arenaBytes = 0, symbols = 0, code = 0;
+    for (int run = 0; run < runs; ++run) {
+        // parse alone, one heap allocation per cell
+        auto start = clock::now();
+        tsParsedSexpr_t* parsed = tsParsedSexpr_New();
+        tsStrView_t str = { src.c_str(), src.size() };
+        tsStrViewParseSexpr(&str, parsed, 0);
+        while (parsed) {
+            tsParsedSexpr_t* next = parsed->next;
+            free(parsed);
+            parsed = next;
+        }
+        parseMallocMs = std::min(parseMallocMs,
+            std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+        // parse alone, cells from an arena
+        start = clock::now();
+        {
+            LandruArena arena;
+            auto alloc = [](void* arena) -> tsParsedSexpr_t* {
+                return static_cast<LandruArena*>(arena)->New<tsParsedSexpr_t>();
+            };
+            str = { src.c_str(), src.size() };
+            tsStrViewParseSexprAlloc(&str, alloc(&arena), 0, alloc, &arena);
+        }
+        parseArenaMs = std::min(parseArenaMs,
+            std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+        // parse, compile, link, and release
+        start = clock::now();
+        Landru* l = LandruCreate(src.c_str());
+        arenaBytes = l->arena.bytes;
+        symbols = l->symbols.names.size();
+        code = l->program.code.size();
+        LandruDestroy(l);
+        compileMs = std::min(compileMs,
+            std::chrono::duration<double, std::milli>(clock::now() - start).count());
+    }
+
+    double mb = src.size() / (1024.0 * 1024.0);
+    printf("landru: compile %d machines, %.2f MB of source\n", machines, mb);
+    printf("  parse, heap cells   %8.3f ms\n", parseMallocMs);
+    printf("  parse, arena cells  %8.3f ms\n", parseArenaMs);
+    printf("  parse+compile+link  %8.3f ms, %.1f MB/s\n", compileMs, mb / (compileMs * 1e-3));
+    printf("  %zu symbols, %zu instructions, %.1f KB arena\n",
+           symbols, code, arenaBytes / 1024.0);
+    return code > 0 ? 0 : 1;
+}
 
 int landru_tests() {
     printf("test empty program\n");
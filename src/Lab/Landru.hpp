@@ -9,7 +9,51 @@
 #ifndef included_landru_hpp
 #define included_landru_hpp
 
+#include <cstddef>
+#include <cstdint>
+
+// Compile and run a script to completion on a simulated clock. Scripts
+// that are still running after ten simulated seconds are stopped.
+// Returns true if every machine retired.
 bool LandruRun(const char* src);
 bool LandruRunPrintExemplar(const char* src);
 
+// A Landru instance runs a compiled script a tick at a time, so that the
+// machines it launches can be advanced once per frame. Compilation errors
+// are thrown as std::runtime_error.
+
+struct Landru;
+
+typedef struct {
+    size_t   live;        // machines currently running
+    uint64_t launched;
+    uint64_t retired;
+    uint64_t transitions; // state changes
+    uint64_t timersFired;
+    uint64_t timersStale; // timers whose state exited before they came due
+} LandruStats;
+
+Landru* LandruCreate(const char* src);
+void LandruDestroy(Landru*);
+
+// advance the clock by dt seconds, service due timers, pending launches
+// and gotos. Returns true while any machine is live or any launch pending.
+bool LandruUpdate(Landru*, double dt);
+
+// queue count launches of a top level machine; returns false if the
+// script does not define it
+bool LandruLaunch(Landru*, const char* machine, int count);
+
+// limit the number of pending launches serviced per update, zero for all
+void LandruSetLaunchBatch(Landru*, size_t batch);
+
+LandruStats LandruGetStats(const Landru*);
+
+// launch machines pingpong machines and run them for ten simulated seconds
+// at sixty ticks per second
+int LandruBenchmark(int machines);
+
+// generate a script defining machines machines, and time its compilation
+int LandruBenchmarkCompile(int machines);
+
 #endif /* included_landru_hpp */
@@ -7,8 +7,23 @@
 //
 
 #include "StudioCore.hpp"
+#include "concurrentqueue.hpp"
+#include "LabDirectories.h"
+#include "LabProfiler.hpp"
+#include "LabThreadPool.hpp"
 
+#ifndef HAVE_NO_USD
+#include <pxr/usd/sdf/changeBlock.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <thread>
 #include <zmq.hpp>
@@ -18,71 +33,152 @@ namespace lab
 using namespace std;
 
 
-// static
-int JournalNode::count = 0;
+namespace {
 
-// recursively delete all the nodes after this one
-// making this node the end of the journal
-void JournalNode::Truncate(JournalNode* node) {
-    if (!node)
-        return;
-    if (node->next) {
-        Truncate(node->next);
-        delete node->next;
-        node->next = nullptr;
+// assignment doesn't return a string's storage, so swap it away
+void ReleaseTransaction(Transaction& t) {
+    std::string().swap(t.message);
+    t.exec = nullptr;
+    t.undo = nullptr;
+#ifndef HAVE_NO_USD
+    t.prim = pxr::UsdPrim();
+    t.token = pxr::TfToken();
+#endif
+}
+
+} // anon
+
+Journal::Journal() {
+    _curr = Allocate();
+    JournalNode* root = Node(_curr);
+    root->transaction.undo = [](){
+        throw std::runtime_error("Cannot undo journal root"); };
+    root->transaction.message = "Session start";
+    _bytes += Footprint(*root);
+}
+
+Journal::~Journal() {
+    if (_spill) {
+        fclose(_spill);
+        std::remove(_spillPath.c_str());
+    }
+}
+
+JournalIndex Journal::Allocate() {
+    JournalIndex index;
+    if (_free.size()) {
+        index = _free.back();
+        _free.pop_back();
     }
-    if (node->sibling) {
-        Truncate(node->sibling);
-        delete node->sibling;
-        node->sibling = nullptr;
+    else {
+        index = (JournalIndex) (_slabs.size() * kSlabSize);
+        _slabs.emplace_back(new JournalNode[kSlabSize]);
+        // push the rest of the new slab in reverse so that indices are
+        // handed out in ascending order
+        for (size_t i = kSlabSize - 1; i > 0; --i)
+            _free.push_back(index + (JournalIndex) i);
     }
+    ++_live;
+    return index;
 }
 
-void Journal::CountHelper(JournalNode* node, int& total) {
-    // recurse the next list, and the sibling lists to count the nodes
-    if (node->next)
-        CountHelper(node->next, total);
-    if (node->sibling)
-        CountHelper(node->sibling, total);
-    ++total;
+JournalNode* Journal::Node(JournalIndex node) const {
+    if (node == kJournalNil)
+        return nullptr;
+    return &_slabs[node / kSlabSize][node % kSlabSize];
 }
 
-Journal::Journal() : _curr(&root) {
-    root.transaction.undo = [](){
-        throw std::runtime_error("Cannot undo journal root"); };
-    root.transaction.message = "Session start";
+size_t Journal::Footprint(const JournalNode& node) const {
+    return sizeof(JournalNode) + node.transaction.message.capacity();
+}
+
+void Journal::FreeSubtree(JournalIndex node) {
+    std::vector<JournalIndex> stack;
+    if (node != kJournalNil)
+        stack.push_back(node);
+    while (stack.size()) {
+        JournalIndex i = stack.back();
+        stack.pop_back();
+        JournalNode* n = Node(i);
+        if (n->next != kJournalNil)
+            stack.push_back(n->next);
+        if (n->sibling != kJournalNil)
+            stack.push_back(n->sibling);
+        _bytes -= Footprint(*n);
+        _reloaded.erase(i);
+        ReleaseTransaction(n->transaction);
+        *n = JournalNode();
+        _free.push_back(i);
+        --_live;
+    }
+}
+
+void Journal::Truncate(JournalIndex node) {
+    JournalNode* n = Node(node);
+    if (!n)
+        return;
+    FreeSubtree(n->next);
+    FreeSubtree(n->sibling);
+    n->next = kJournalNil;
+    n->sibling = kJournalNil;
 }
 
 bool Journal::Validate() {
-    int total = 0;
-    CountHelper(&root, total);
-    return total == JournalNode::count;
+    size_t total = 0;
+    std::vector<JournalIndex> stack = { Root() };
+    while (stack.size()) {
+        JournalIndex i = stack.back();
+        stack.pop_back();
+        JournalNode* n = Node(i);
+        ++total;
+        if (total > _live)
+            return false;   // a cycle
+        if (n->next != kJournalNil) {
+            if (Node(n->next)->parent != i)
+                return false;
+            stack.push_back(n->next);
+        }
+        if (n->sibling != kJournalNil) {
+            if (Node(n->sibling)->parent != n->parent)
+                return false;
+            stack.push_back(n->sibling);
+        }
+    }
+    return total == _live;
 }
 
 // append a transaction to the journal. If the journal is not at the end,
 // the journal is truncated and the new transaction is appended
 void Journal::Append(Transaction&& t) {
+    JournalNode* curr = Node(_curr);
+
     // if _curr->next is not null, we are not at the end of the journal
-    if (_curr->next) {
-        JournalNode::Truncate(_curr->next);
-        delete _curr->next;
+    if (curr->next != kJournalNil) {
+        FreeSubtree(curr->next);
+        curr->next = kJournalNil;
     }
-    
+
 #ifndef HAVE_NO_USD
-    if (!t.token.IsEmpty() && (t.prim == _curr->transaction.prim && t.token == _curr->transaction.token)) {
+    if (!t.token.IsEmpty() && (t.prim == curr->transaction.prim && t.token == curr->transaction.token)) {
         // if the transaction's prim & token match, overwrite the current
         // journal node. This is so that things like interactively dragging a manipulator
         // accumulate only a single node.
-        _curr->transaction = std::move(t);
+        _bytes -= Footprint(*curr);
+        curr->transaction = std::move(t);
+        _bytes += Footprint(*curr);
     }
-    else 
+    else
 #endif
     {
-        _curr->next = new JournalNode();
-        _curr->next->parent = _curr;
-        _curr->next->transaction = std::move(t);
-        _curr = _curr->next;
+        JournalIndex next = Allocate();
+        JournalNode* n = Node(next);
+        n->parent = _curr;
+        n->transaction = std::move(t);
+        _bytes += Footprint(*n);
+        curr->next = next;
+        _curr = next;
     }
+    Compact();
 }
 
 // fork the journal, creating a new branch. The current node becomes the
@@ -93,48 +189,291 @@ void Journal::Append(Transaction&& t) {
 void Journal::Fork(Transaction&& t) {
     // if the current node has a sibling, follow the siblings until we
     // find the last one, and set that to _curr.
-    while (_curr->sibling)
-        _curr = _curr->sibling;
-    _curr->sibling = new JournalNode();
-    _curr->sibling->parent = _curr->parent;
-    _curr->sibling->transaction = std::move(t);
-    _curr = _curr->sibling;
+    while (Node(_curr)->sibling != kJournalNil)
+        _curr = Node(_curr)->sibling;
+    JournalIndex fork = Allocate();
+    JournalNode* n = Node(fork);
+    n->parent = Node(_curr)->parent;
+    n->transaction = std::move(t);
+    _bytes += Footprint(*n);
+    Node(_curr)->sibling = fork;
+    _curr = fork;
+    Compact();
 }
 
-// removes node from the journal but does not delete it
-void Journal::Remove(JournalNode* node) {
-    if (!node)
+// unlinks node from the journal, and deletes it and its history
+void Journal::Remove(JournalIndex node) {
+    JournalNode* n = Node(node);
+    if (!n || node == Root())
         return;
 
-    JournalNode::Truncate(node);
+    // the node is either the parent's next, or in the sibling chain that
+    // starts at the parent's next.
+    JournalNode* parent = Node(n->parent);
+    if (parent->next == node) {
+        parent->next = n->sibling;
+    }
+    else {
+        JournalNode* prev = Node(parent->next);
+        while (prev && prev->sibling != node)
+            prev = Node(prev->sibling);
+        if (!prev)
+            return; // not linked into the journal
+        prev->sibling = n->sibling;
+    }
 
-    // if node is in the sibling list of the parent, remove it
-    if (node->parent) {
-        JournalNode* prev = nullptr;
-        JournalNode* curr = node->parent->sibling;
-        while (curr) {
-            if (curr == node) {
-                if (prev)
-                    prev->sibling = curr->sibling;
-                else
-                    node->parent->sibling = curr->sibling;
-                break;
-            }
-            prev = curr;
-            curr = curr->sibling;
+    // if the current node is being removed, move to the parent
+    for (JournalIndex i = _curr; i != kJournalNil; i = Node(i)->parent)
+        if (i == node) {
+            _curr = n->parent;
+            break;
         }
+
+    n->sibling = kJournalNil;
+    FreeSubtree(node);
+}
+
+std::string Journal::Message(JournalIndex node) {
+    JournalNode* n = Node(node);
+    if (!n->IsSpilled())
+        return n->transaction.message;
+
+    auto i = _reloaded.find(node);
+    if (i != _reloaded.end())
+        return i->second;
+
+    // keep the reloaded messages bounded
+    if (_reloaded.size() >= 1024)
+        _reloaded.clear();
+
+    std::string& message = _reloaded[node];
+    std::string text(n->spillLength, '\0');
+    if (fseek(_spill, (long) n->spillOffset, SEEK_SET) != 0 ||
+        fread(text.data(), 1, n->spillLength, _spill) != n->spillLength) {
+        text = "<journal spill unavailable>\n";
     }
+    fseek(_spill, 0, SEEK_END);
 
-    // if node is next of the parent, remove it
-    if (node->parent && node->parent->next == node)
-        node->parent->next = nullptr;
+    // messages are stored newline terminated
+    size_t first = text.find('\n');
+    if (n->spillCount <= 1 || first == std::string::npos) {
+        message = text.substr(0, first);
+    }
+    else {
+        size_t last = text.rfind('\n', text.size() - 2);
+        message = text.substr(0, first) + " ... " +
+                  text.substr(last + 1, text.size() - last - 2) +
+                  " (" + std::to_string(n->spillCount) + " transactions)";
+    }
+    return message;
+}
 
-    // if node is the current node, move to the parent
-    if (_curr == node)
-        _curr = node->parent;
+bool Journal::IsUndoable(JournalIndex node) const {
+    JournalNode* n = Node(node);
+    return n && !n->IsSpilled() && n->transaction.undo;
 }
 
+void Journal::SetMemoryBudget(size_t bytes) {
+    _budget = bytes;
+    Compact();
+}
 
+void Journal::Spill(JournalIndex node) {
+    JournalNode* n = Node(node);
+    if (n->IsSpilled())
+        return;
+
+    if (!_spill) {
+        const char* temp = lab_temp_directory_path();
+        _spillPath = std::string(temp ? temp : ".") + "/LabJournal-" +
+                     std::to_string((uintptr_t) this) + ".spill";
+        _spill = fopen(_spillPath.c_str(), "w+b");
+        if (!_spill) {
+            std::cerr << "Could not create journal spill file " << _spillPath << std::endl;
+            return;
+        }
+    }
+
+    std::string message = n->transaction.message;
+    std::replace(message.begin(), message.end(), '\n', ' ');
+    message += '\n';
+    fseek(_spill, 0, SEEK_END);
+    long offset = ftell(_spill);
+    if (offset < 0 || fwrite(message.data(), 1, message.size(), _spill) != message.size())
+        return;
+
+    _bytes -= Footprint(*n);
+    n->spillOffset = offset;
+    n->spillLength = (uint32_t) message.size();
+    n->spillCount = 1;
+    ReleaseTransaction(n->transaction);
+    _bytes += Footprint(*n);
+}
+
+// fold a spilled node into its parent, if the parent is also spilled, the
+// node is the parent's only child, and their messages are contiguous.
+void Journal::Merge(JournalIndex node) {
+    JournalNode* n = Node(node);
+    JournalNode* parent = Node(n->parent);
+    if (!n->IsSpilled() || !parent || n->parent == Root() || !parent->IsSpilled())
+        return;
+    if (parent->next != node || n->sibling != kJournalNil)
+        return;
+    if (parent->spillOffset + parent->spillLength != n->spillOffset)
+        return;
+
+    parent->spillLength += n->spillLength;
+    parent->spillCount += n->spillCount;
+    parent->next = n->next;
+    for (JournalIndex c = n->next; c != kJournalNil; c = Node(c)->sibling)
+        Node(c)->parent = n->parent;
+    _reloaded.erase(n->parent);
+
+    n->next = kJournalNil;
+    FreeSubtree(node);
+}
+
+// spill history, oldest first, along the path from the root to the current
+// node, as well as any branches forking from that path, until the journal
+// fits within its budget. The root and the current node are never spilled.
+// Spilled runs without forks are merged, so a long linear history compacts
+// to a single node.
+void Journal::Compact() {
+    if (!_budget || _bytes <= _budget)
+        return;
+
+    // history is spilled oldest first, so the path only needs to be walked
+    // back as far as the most recently spilled node.
+    std::vector<JournalIndex> path;
+    for (JournalIndex i = _curr; i != Root() && !Node(i)->IsSpilled(); i = Node(i)->parent)
+        path.push_back(i);
+    std::reverse(path.begin(), path.end());
+
+    std::vector<JournalIndex> stack;
+    for (size_t p = 0; p + 1 < path.size() && _bytes > _budget; ++p) {
+        JournalIndex onPath = path[p];
+        Spill(onPath);
+        JournalIndex parent = Node(onPath)->parent;
+
+        // spill the branches that forked from the path at this node
+        for (JournalIndex s = Node(parent)->next; s != kJournalNil; s = Node(s)->sibling) {
+            if (s == onPath)
+                continue;
+            Spill(s);
+            if (Node(s)->next != kJournalNil)
+                stack.push_back(Node(s)->next);
+            while (stack.size()) {
+                JournalIndex i = stack.back();
+                stack.pop_back();
+                Spill(i);
+                if (Node(i)->next != kJournalNil)
+                    stack.push_back(Node(i)->next);
+                if (Node(i)->sibling != kJournalNil)
+                    stack.push_back(Node(i)->sibling);
+            }
+        }
+
+        Merge(onPath);
+    }
+}
+
+
+
+namespace {
+
+// Transactions are pushed by any number of producer threads onto a lock free
+// queue, and executed in bulk by a single consumer, once per frame.
+class TransactionQueue {
+public:
+    struct Pending {
+        Transaction transaction;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    moodycamel::ConcurrentQueue<Pending> queue;
+    std::vector<Pending> batch;
+    std::atomic<uint64_t> enqueued{0};
+    uint64_t executed = 0;
+    uint64_t batches = 0;
+    size_t lastBatchSize = 0;
+    size_t batchLimit = 0;
+    double lastLatencyMs = 0;
+    double maxLatencyMs = 0;
+    double totalLatencyMs = 0;
+    bool changeBlocks = false;
+    bool echo = true;
+
+    static constexpr size_t kBulkSize = 256;
+
+    TransactionQueue() : batch(kBulkSize) {}
+
+    void Enqueue(Transaction&& t) {
+        queue.enqueue(Pending{std::move(t), std::chrono::steady_clock::now()});
+        ++enqueued;
+    }
+
+    // execute pending transactions, appending them to the journal. Returns
+    // the number of transactions executed.
+    size_t Service(Journal& journal) {
+        // only those pending now, so that transactions enqueued by a
+        // producer or by the batch itself cannot hold the frame
+        size_t count = 0;
+        size_t limit = queue.size_approx();
+        if (batchLimit)
+            limit = std::min(limit, batchLimit);
+        if (!limit)
+            return 0;
+
+#ifndef HAVE_NO_USD
+        std::optional<pxr::SdfChangeBlock> block;
+        if (changeBlocks)
+            block.emplace();
+#endif
+        while (count < limit) {
+            size_t n = queue.try_dequeue_bulk(batch.begin(),
+                                              std::min(kBulkSize, limit - count));
+            if (!n)
+                break;
+
+            if (!count) {
+                auto now = std::chrono::steady_clock::now();
+                lastLatencyMs = std::chrono::duration<double, std::milli>(
+                                        now - batch[0].enqueued).count();
+            }
+            for (size_t i = 0; i < n; ++i) {
+                Transaction& transaction = batch[i].transaction;
+                if (!transaction.exec)
+                    continue;
+                if (echo)
+                    std::cout << "> " << transaction.message << std::endl;
+                {
+                    // messages are free-form, so only their first word is
+                    // interned, as the kind of transaction
+                    LAB_PROFILE_SCOPE(Profiler::Enabled() ?
+                            Profiler::Intern(transaction.message.substr(
+                                    0, transaction.message.find(' '))) : nullptr,
+                            "Transaction");
+                    transaction.exec();
+                }
+                auto done = std::chrono::steady_clock::now();
+                double ms = std::chrono::duration<double, std::milli>(
+                                        done - batch[i].enqueued).count();
+                totalLatencyMs += ms;
+                maxLatencyMs = std::max(maxLatencyMs, ms);
+                ++executed;
+                journal.Append(std::move(transaction));
+            }
+            count += n;
+        }
+        if (count) {
+            ++batches;
+            lastBatchSize = count;
+        }
+        return count;
+    }
+};
+
+} // anon
 
 struct Orchestrator::data {
     Studio* current_studio = nullptr;
@@ -156,61 +495,19 @@ struct Orchestrator::data {
     std::vector<Activity*> mainmenu_activities;
 
     Journal journal;
-
-    struct Transactor {
-        zmq::context_t context;
-        zmq::socket_t pull_socket;
-        zmq::socket_t push_socket;
-        std::thread processing_thread;
-        Transactor()
-            : context(1) // one thread, because low frequency and in process.
-            , pull_socket(context, ZMQ_PULL)
-            , push_socket(context, ZMQ_PUSH) {
-                pull_socket.bind("inproc://transactions");
-                push_socket.connect("inproc://transactions");
-            }
-    } transactor;
-
-    data() {
-        transactor.processing_thread = std::thread([this]() {
-            while (true) {
-                zmq::message_t message;
-
-                if (transactor.pull_socket.recv(message, zmq::recv_flags::none)) {
-
-                    // Placement delete and copy to local scope
-                    Transaction* work = static_cast<Transaction*>(message.data());
-                    Transaction transaction = std::move(*work);
-                    work->~Transaction();
-
-                    // Handle special termination logic if needed
-                    if (transaction.message == "STOP") {
-                        break;
-                    }
-
-                    // Process transaction
-                    if (transaction.exec) {
-                        std::cout << "> " << transaction.message << std::endl;
-                        transaction.exec();
-                        journal.Append(std::move(transaction));
-                    }
-                }
-                else  {
-                    // there was an issue. @TODO handle or report it.
-                }
-            }
-        });
-    }
-
-    ~data() {
-        zmq::socket_t stop_socket(transactor.context, ZMQ_PUSH);
-        stop_socket.connect("inproc://transactions");
-        Transaction stop_transaction("STOP", []() {});
-        zmq::message_t message(sizeof(Transaction));
-        new (message.data()) Transaction(std::move(stop_transaction)); // Placement new
-        stop_socket.send(message, zmq::send_flags::none);
-        transactor.processing_thread.join(); // Wait for the thread to exit
-    }
+    TransactionQueue transactions;
+
+    // concurrent updates, in activity name order unless reordered by
+    // declared predecessors, with edges from each update to the updates
+    // that must wait for it.
+    struct UpdateGraph {
+        std::vector<Activity*> nodes;
+        std::vector<std::vector<int>> successors;
+        std::vector<int> predecessors;
+        std::vector<Activity*> serial;
+    } updateGraph;
+    std::unique_ptr<ThreadPool> updatePool;
+    int updateThreads = 0;
 
     void SetActivities() {
         ui_activities.clear();
@@ -230,6 +527,8 @@ struct Orchestrator::data {
                 if (a->activity.Menu) mainmenu_activities.push_back(a);
             }
         }
+        BuildUpdateGraph();
+
         static bool noisy = true;
         if (noisy) {
             std::cout << "Active Activities: \n";
@@ -239,6 +538,164 @@ struct Orchestrator::data {
             }
         }
     }
+
+    void BuildUpdateGraph() {
+        UpdateGraph& g = updateGraph;
+        g = UpdateGraph();
+
+        // the concurrent updates all complete before the serial updates
+        // run, so one that must follow a serial update is made serial, as
+        // are those that must follow it in turn
+        std::set<std::string> serialNames;
+        for (auto a : update_activities)
+            if (!a->update.concurrent)
+                serialNames.insert(a->Name());
+        for (bool demoted = true; demoted;) {
+            demoted = false;
+            for (auto a : update_activities) {
+                if (serialNames.count(a->Name()))
+                    continue;
+                for (auto& name : a->update.after)
+                    if (serialNames.count(name)) {
+                        std::cerr << "Activity " << a->Name() << " updates after the serial activity "
+                                  << name << ", so it updates serially" << std::endl;
+                        serialNames.insert(a->Name());
+                        demoted = true;
+                        break;
+                    }
+            }
+        }
+        std::vector<Activity*> concurrent;
+        std::vector<Activity*> serial;
+        for (auto a : update_activities)
+            (serialNames.count(a->Name()) ? serial : concurrent).push_back(a);
+
+        // the serial updates run in name order, save that each follows
+        // those it names in after
+        while (serial.size()) {
+            auto next = std::find_if(serial.begin(), serial.end(), [&](Activity* a) {
+                for (auto& name : a->update.after)
+                    for (auto b : serial)
+                        if (b != a && b->Name() == name)
+                            return false;
+                return true;
+            });
+            if (next == serial.end()) {
+                std::cerr << "Serial activity update dependencies form a cycle, ignoring them" << std::endl;
+                g.serial.insert(g.serial.end(), serial.begin(), serial.end());
+                break;
+            }
+            g.serial.push_back(*next);
+            serial.erase(next);
+        }
+
+        // order the concurrent updates by their declared predecessors,
+        // breaking ties by name so that the order is deterministic
+        const size_t n = concurrent.size();
+        std::map<std::string, size_t> index;
+        for (size_t i = 0; i < n; ++i)
+            index[concurrent[i]->Name()] = i;
+        std::vector<std::vector<size_t>> after(n);
+        std::vector<int> waiting(n, 0);
+        for (size_t i = 0; i < n; ++i)
+            for (auto& name : concurrent[i]->update.after) {
+                auto p = index.find(name);
+                if (p != index.end()) {
+                    after[p->second].push_back(i);
+                    ++waiting[i];
+                }
+            }
+        std::set<size_t> ready;
+        for (size_t i = 0; i < n; ++i)
+            if (!waiting[i])
+                ready.insert(i);
+        while (ready.size()) {
+            size_t i = *ready.begin();
+            ready.erase(ready.begin());
+            g.nodes.push_back(concurrent[i]);
+            for (size_t s : after[i])
+                if (--waiting[s] == 0)
+                    ready.insert(s);
+        }
+        if (g.nodes.size() != n) {
+            std::cerr << "Activity update dependencies form a cycle, updating serially" << std::endl;
+            g.nodes.clear();
+            g.serial = update_activities;
+            return;
+        }
+
+        // an update depends on every earlier update that it must follow
+        // by declaration, or with which it shares a written resource
+        auto intersects = [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+            for (auto& x : a)
+                if (std::find(b.begin(), b.end(), x) != b.end())
+                    return true;
+            return false;
+        };
+        g.successors.resize(n);
+        g.predecessors.assign(n, 0);
+        for (size_t j = 0; j < n; ++j) {
+            auto& uj = g.nodes[j]->update;
+            for (size_t i = 0; i < j; ++i) {
+                auto& ui = g.nodes[i]->update;
+                bool edge = std::find(uj.after.begin(), uj.after.end(), g.nodes[i]->Name()) != uj.after.end()
+                         || intersects(ui.writes, uj.writes)
+                         || intersects(ui.writes, uj.reads)
+                         || intersects(ui.reads, uj.writes);
+                if (edge) {
+                    g.successors[i].push_back((int) j);
+                    ++g.predecessors[j];
+                }
+            }
+        }
+
+        if (n > 1 && updateThreads != 1 && !updatePool)
+            updatePool.reset(new ThreadPool(updateThreads));
+    }
+
+    void RunUpdates(float dt) {
+        UpdateGraph& g = updateGraph;
+        const int n = (int) g.nodes.size();
+        auto update = [dt](Activity* a) {
+            LAB_PROFILE_SCOPE(a->activity.name, "Update");
+            a->activity.Update(a, dt);
+        };
+
+        if (n < 2 || !updatePool) {
+            for (auto a : g.nodes)
+                update(a);
+        }
+        else {
+            std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[n]);
+            for (int i = 0; i < n; ++i)
+                pending[i] = g.predecessors[i];
+            int remaining = n;
+            std::mutex mutex;
+            std::condition_variable cv;
+            ThreadPool& pool = *updatePool;
+
+            std::function<void(int)> run = [&](int i) {
+                update(g.nodes[i]);
+                for (int s : g.successors[i])
+                    if (--pending[s] == 0)
+                        pool.Enqueue([&run, s]() { run(s); });
+                // the count is only read under the lock, so the waiting
+                // thread can't return while this job still holds it
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--remaining == 0)
+                    cv.notify_all();
+            };
+            for (int i = 0; i < n; ++i)
+                if (!g.predecessors[i])
+                    pool.Enqueue([&run, i]() { run(i); });
+
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return remaining == 0; });
+        }
+
+        for (auto a : g.serial)
+            update(a);
+    }
 };
 
 namespace {
@@ -273,9 +730,104 @@ Studio* Orchestrator::CurrentStudio() const {
 }
 
 void Orchestrator::EnqueueTransaction(Transaction&& work) {
-    zmq::message_t message(sizeof(Transaction));
-    new (message.data()) Transaction(std::move(work)); // Placement new
-    _self->transactor.push_socket.send(message, zmq::send_flags::none);
+    _self->transactions.Enqueue(std::move(work));
+}
+
+Orchestrator::TransactionStats Orchestrator::GetTransactionStats() const {
+    auto& q = _self->transactions;
+    TransactionStats stats;
+    stats.queueDepth = q.queue.size_approx();
+    stats.lastBatchSize = q.lastBatchSize;
+    stats.enqueued = q.enqueued.load();
+    stats.executed = q.executed;
+    stats.batches = q.batches;
+    stats.lastLatencyMs = q.lastLatencyMs;
+    stats.maxLatencyMs = q.maxLatencyMs;
+    stats.meanLatencyMs = q.executed ? q.totalLatencyMs / q.executed : 0;
+    return stats;
+}
+
+void Orchestrator::SetTransactionBatchLimit(size_t limit) {
+    _self->transactions.batchLimit = limit;
+}
+
+void Orchestrator::SetTransactionChangeBlocks(bool enable) {
+    _self->transactions.changeBlocks = enable;
+}
+
+//static
+int Orchestrator::BenchmarkTransactions(int count) {
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count(); };
+
+    // the transactor this queue replaced; a Transaction is placement new'd
+    // into each message, and executed by a thread pulling messages one at
+    // a time.
+    double zmqTotalMs = 0, zmqLatencyMs = 0;
+    {
+        Journal journal;
+        zmq::context_t context(1);
+        zmq::socket_t pull_socket(context, ZMQ_PULL);
+        zmq::socket_t push_socket(context, ZMQ_PUSH);
+        pull_socket.bind("inproc://transaction_benchmark");
+        push_socket.connect("inproc://transaction_benchmark");
+
+        double latency = 0;
+        auto start = clock::now();
+        std::thread consumer([&]() {
+            for (int i = 0; i < count; ++i) {
+                zmq::message_t message;
+                if (!pull_socket.recv(message, zmq::recv_flags::none))
+                    break;
+                Transaction* work = static_cast<Transaction*>(message.data());
+                Transaction transaction = std::move(*work);
+                work->~Transaction();
+                transaction.exec();
+                journal.Append(std::move(transaction));
+            }
+        });
+        for (int i = 0; i < count; ++i) {
+            auto t0 = clock::now();
+            zmq::message_t message(sizeof(Transaction));
+            new (message.data()) Transaction("bench", [t0, &latency, &ms]() {
+                latency += ms(clock::now() - t0); });
+            push_socket.send(message, zmq::send_flags::none);
+        }
+        consumer.join();
+        zmqTotalMs = ms(clock::now() - start);
+        zmqLatencyMs = latency / count;
+    }
+
+    // the transaction queue, a producer thread enqueues, while the calling
+    // thread services the queue as if it were the frame loop.
+    double queueTotalMs = 0, queueLatencyMs = 0;
+    uint64_t queueBatches = 0;
+    {
+        Journal journal;
+        TransactionQueue transactions;
+        transactions.echo = false;
+        auto start = clock::now();
+        std::thread producer([&]() {
+            for (int i = 0; i < count; ++i)
+                transactions.Enqueue(Transaction("bench", [](){}));
+        });
+        while (transactions.executed < (uint64_t) count)
+            if (!transactions.Service(journal))
+                std::this_thread::yield();
+        producer.join();
+        queueTotalMs = ms(clock::now() - start);
+        queueLatencyMs = transactions.totalLatencyMs / count;
+        queueBatches = transactions.batches;
+    }
+
+    printf("Transactions: %d\n", count);
+    printf("  zmq inproc: %9.3f ms total, %10.0f tx/s, mean latency %8.4f ms\n",
+           zmqTotalMs, count / (zmqTotalMs * 1e-3), zmqLatencyMs);
+    printf("  queue:      %9.3f ms total, %10.0f tx/s, mean latency %8.4f ms, %llu batches\n",
+           queueTotalMs, count / (queueTotalMs * 1e-3), queueLatencyMs,
+           (unsigned long long) queueBatches);
+    return 0;
 }
 
 void Orchestrator::ServiceTransactionsAndActivities(float dt) {
@@ -304,8 +856,168 @@ void Orchestrator::ServiceTransactionsAndActivities(float dt) {
         _set_activities();
     }
 
-    for (auto i : _self->update_activities)
-        i->activity.Update(i, dt);
+    _self->transactions.Service(_self->journal);
+
+    _self->RunUpdates(dt);
+}
+
+void Orchestrator::SetUpdateThreads(int threads) {
+    _self->updateThreads = threads;
+    _self->updatePool.reset();
+    _self->BuildUpdateGraph();
+}
+
+namespace {
+
+// an activity whose update folds the values of the resources it reads into
+// the resources it writes, in an order sensitive way, after spinning for a
+// while to simulate work.
+class ResourceActivity : public Activity {
+    std::string _name;
+public:
+    std::map<std::string, uint64_t>& resources;
+    int spinMicroseconds = 0;
+
+    ResourceActivity(const char* name, std::map<std::string, uint64_t>& r)
+    : Activity(name), _name(name), resources(r) {
+        activity.Update = [](void* instance, float) {
+            static_cast<ResourceActivity*>(instance)->Update();
+        };
+    }
+    const std::string Name() const override { return _name; }
+
+    void Update() {
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(spinMicroseconds);
+        while (std::chrono::steady_clock::now() < until) {}
+        uint64_t h = std::hash<std::string>()(_name);
+        for (auto& r : update.reads)
+            h = h * 31 + resources.at(r);
+        for (auto& w : update.writes)
+            resources.at(w) = resources.at(w) * 1099511628211ull + h;
+    }
+};
+
+// builds an orchestrator of ResourceActivities, runs frames, and returns the
+// final resource values. The canonical orchestrator is preserved.
+std::map<std::string, uint64_t> RunResourceActivities(
+        int count, int frames, int threads, bool concurrent, int spin,
+        double* msPerFrame)
+{
+    Orchestrator* canonical = Orchestrator::Canonical();
+    std::map<std::string, uint64_t> resources;
+    const int resourceCount = std::max(1, count / 4);
+    for (int r = 0; r < resourceCount; ++r)
+        resources["r" + std::to_string(r)] = r;
+
+    std::vector<std::string> names;
+    for (int i = 0; i < count; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "UpdateTest%04d", i);
+        names.push_back(name);
+    }
+    std::vector<std::string> predecessor(count);
+    for (int i = 4; i < count; i += 5) {
+        int j = (i + 3) % count;
+        if (j % 5 != 4)
+            predecessor[i] = names[j];
+    }
+    {
+        Orchestrator mm;
+        mm.SetUpdateThreads(threads);
+        for (int i = 0; i < count; ++i) {
+            const char* name = names[i].c_str();
+            mm.RegisterActivity(name, [&, name, i]() {
+                auto a = std::make_shared<ResourceActivity>(name, resources);
+                a->spinMicroseconds = spin;
+                a->update.concurrent = concurrent;
+                // most activities are independent, some share resources,
+                // and some have an explicit predecessor
+                a->update.reads = { "r" + std::to_string(i % resourceCount) };
+                if (i % 3 == 0)
+                    a->update.writes = { "r" + std::to_string((i / 3) % resourceCount) };
+                if (predecessor[i].size())
+                    a->update.after = { predecessor[i] };
+                return a;
+            });
+            mm.ActivateActivity(name);
+        }
+        mm.ServiceTransactionsAndActivities(0); // activates the activities
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; ++f)
+            mm.ServiceTransactionsAndActivities(1.f / 60.f);
+        if (msPerFrame)
+            *msPerFrame = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start).count() / frames;
+    }
+    gCanonical = canonical;
+    return resources;
+}
+
+} // anon
+
+//static
+int Orchestrator::TestConcurrentUpdates() {
+    const int count = 64, frames = 16;
+    auto reference = RunResourceActivities(count, frames, 1, false, 0, nullptr);
+    int failures = 0;
+    int maxThreads = (int) std::max(4u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+        for (int run = 0; run < 4; ++run)
+            if (RunResourceActivities(count, frames, threads, true, 0, nullptr) != reference) {
+                std::cerr << "Concurrent updates diverged from serial on "
+                          << threads << " threads" << std::endl;
+                ++failures;
+            }
+
+    // a concurrent update following a serial one updates after it. A is
+    // named first, so in name order it would update first.
+    auto followSerial = [](bool concurrent, bool after) {
+        Orchestrator* canonical = Orchestrator::Canonical();
+        std::map<std::string, uint64_t> resources = { { "r", 1 } };
+        {
+            Orchestrator mm;
+            mm.SetUpdateThreads(2);
+            mm.RegisterActivity("UpdateTestA", [&, concurrent, after]() {
+                auto a = std::make_shared<ResourceActivity>("UpdateTestA", resources);
+                a->update.concurrent = concurrent;
+                a->update.writes = { "r" };
+                if (after)
+                    a->update.after = { "UpdateTestB" };
+                return a;
+            });
+            mm.RegisterActivity("UpdateTestB", [&]() {
+                auto b = std::make_shared<ResourceActivity>("UpdateTestB", resources);
+                b->update.writes = { "r" };
+                return b;
+            });
+            mm.ActivateActivity("UpdateTestA");
+            mm.ActivateActivity("UpdateTestB");
+            mm.ServiceTransactionsAndActivities(0);
+        }
+        gCanonical = canonical;
+        return resources["r"];
+    };
+    if (followSerial(true, true) != followSerial(false, true) ||
+        followSerial(false, true) == followSerial(false, false)) {
+        std::cerr << "A concurrent update did not follow the serial update it names" << std::endl;
+        ++failures;
+    }
+    printf("Concurrent update determinism: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+//static
+int Orchestrator::BenchmarkUpdates(int activities, int frames, int maxThreads) {
+    double serialMs = 0;
+    RunResourceActivities(activities, frames, 1, false, 100, &serialMs);
+    printf("Activity updates: %d activities, 100us each\n", activities);
+    printf("  serial:     %8.3f ms/frame\n", serialMs);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        double ms = 0;
+        RunResourceActivities(activities, frames, threads, true, 100, &ms);
+        printf("  %2d threads: %8.3f ms/frame, %.2fx\n", threads, ms, serialMs / ms);
+    }
+    return 0;
 }
 
 std::shared_ptr<Studio> Orchestrator::FindStudio(const std::string & m)
@@ -437,8 +1149,10 @@ void Orchestrator::_deactivate_studio(const std::string& name)
 
 void Orchestrator::RunActivityUIs(const LabViewInteraction& vi) {
     for (auto i : _self->ui_activities)
-        if (i->activity.active && i->activity.RunUI)
+        if (i->activity.active && i->activity.RunUI) {
+            LAB_PROFILE_SCOPE(i->activity.name, "RunUI");
             i->activity.RunUI(i, &vi);
+        }
 }
 
 void Orchestrator::RunViewportHovering(const LabViewInteraction& vi) {
@@ -447,6 +1161,7 @@ void Orchestrator::RunViewportHovering(const LabViewInteraction& vi) {
 
     for (auto i : _self->hovering_activities)
         if (i->activity.active && i->activity.ViewportHoverBid) {
+            LAB_PROFILE_SCOPE(i->activity.name, "ViewportHoverBid");
             int bid = i->activity.ViewportHoverBid(i, &vi);
             if (bid > highest_bidder) {
                 dragger = i;
@@ -455,6 +1170,7 @@ void Orchestrator::RunViewportHovering(const LabViewInteraction& vi) {
         }
 
     if (dragger) {
+        LAB_PROFILE_SCOPE(dragger->activity.name, "ViewportHovering");
         dragger->activity.ViewportHovering(dragger, &vi);
     }
 }
@@ -479,14 +1195,18 @@ void Orchestrator::RunViewportDragging(const LabViewInteraction& vi) {
 
 void Orchestrator::RunActivityRendering(const LabViewInteraction& vi) {
     for (auto i : _self->rendering_activities)
-        if (i->activity.active && i->activity.Render)
+        if (i->activity.active && i->activity.Render) {
+            LAB_PROFILE_SCOPE(i->activity.name, "Render");
             i->activity.Render(i, &vi);
+        }
 }
 
 void Orchestrator::RunMainMenu() {
     for (auto i : _self->mainmenu_activities)
-        if (i->activity.active && i->activity.Menu)
+        if (i->activity.active && i->activity.Menu) {
+            LAB_PROFILE_SCOPE(i->activity.name, "Menu");
             i->activity.Menu(i);
+        }
 }
 
 const std::map< std::string, std::shared_ptr<Activity> > Orchestrator::Activities() const {
@@ -39,9 +39,13 @@ Orchestrator
 #include <stddef.h>
 
 #ifdef __cplusplus
+#include <cstdint>
+#include <cstdio>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #ifndef HAVE_NO_USD
 #include <pxr/usd/usd/prim.h>
@@ -147,40 +151,60 @@ struct Transaction {
     Transaction& operator=(const Transaction&) = delete;
 };
 
+// Journal nodes are allocated from slabs owned by the Journal, and refer to
+// one another by index rather than by pointer. kJournalNil ends a chain.
+typedef uint32_t JournalIndex;
+constexpr JournalIndex kJournalNil = 0xffffffff;
+
 struct JournalNode {
     Transaction transaction;
-    JournalNode* next;
-    JournalNode* sibling;   // for forking history
-    JournalNode* parent;    // for undoing history
-
-    // for debugging, the total extant node count is
-    // tracked. The application can call validate() to
-    // ensure that the number of nodes equals the count.
-    // if it differs, there's a bug in the journal.
-    static int count;
-
-    // recursively delete all the nodes after this one
-    // making this node the end of the journal
-    static void Truncate(JournalNode* node);
-    
-    JournalNode() : next(nullptr), sibling(nullptr) {
-        ++count;
-    }
-    ~JournalNode() {
-        Truncate(this);
-        --count;
-    }
+    JournalIndex next = kJournalNil;
+    JournalIndex sibling = kJournalNil;   // for forking history
+    JournalIndex parent = kJournalNil;    // for undoing history
+
+    // When the journal exceeds its memory budget, the oldest history is
+    // spilled; the transaction's closures are released, and its message is
+    // moved to the journal's spill file, from where it is reloaded on demand.
+    // Linear runs of spilled nodes are compacted into a single node, so
+    // spillCount may be greater than one. Only the message is kept, so a
+    // spilled transaction can no longer be undone or redone; the budget
+    // therefore caps the depth of undo.
+    int64_t spillOffset = -1;
+    uint32_t spillLength = 0;
+    uint32_t spillCount = 0;
+    bool IsSpilled() const { return spillOffset >= 0; }
 };
 
 class Journal {
-    JournalNode* _curr;
-
-    static void CountHelper(JournalNode* node, int& total);
+    static constexpr size_t kSlabSize = 256;
+    std::vector<std::unique_ptr<JournalNode[]>> _slabs;
+    std::vector<JournalIndex> _free;
+    std::map<JournalIndex, std::string> _reloaded;
+    JournalIndex _curr = kJournalNil;
+    size_t _live = 0;
+    size_t _bytes = 0;
+    size_t _budget = 0;
+    FILE* _spill = nullptr;
+    std::string _spillPath;
+
+    JournalIndex Allocate();
+
+    // free node, and every node reachable from it via next and sibling
+    void FreeSubtree(JournalIndex node);
+    size_t Footprint(const JournalNode&) const;
+    void Spill(JournalIndex node);
+    void Merge(JournalIndex node);
+    void Compact();
 
 public:
     Journal();
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // verifies that every allocated node is reachable from the root
     bool Validate();
-    
+
     // append a transaction to the journal. If the journal is not at the end,
     // the journal is truncated and the new transaction is appended
     void Append(Transaction&& t);
@@ -191,11 +215,34 @@ public:
     // current node's sibling, in order that there may be many forks from
     // the same node.
     void Fork(Transaction&& t);
-    
-    // removes node from the journal but does not delete it
-    void Remove(JournalNode* node);
-    
-    JournalNode root;
+
+    // delete all the nodes after this one, making it the end of the journal
+    void Truncate(JournalIndex node);
+
+    // unlinks node from the journal, and deletes it and its history
+    void Remove(JournalIndex node);
+
+    JournalIndex Root() const { return 0; }
+    JournalIndex Current() const { return _curr; }
+
+    // returns nullptr for kJournalNil
+    JournalNode* Node(JournalIndex node) const;
+
+    // the node's message, reloaded from the spill file if necessary. A
+    // compacted run reports its first and last messages. Returned by value,
+    // as fetching other messages may evict reloaded ones, and compaction
+    // may release the node's transaction.
+    std::string Message(JournalIndex node);
+
+    // spilled nodes have released their undo closure
+    bool IsUndoable(JournalIndex node) const;
+
+    // approximate bytes held in memory by transactions; zero means unlimited.
+    // History beyond the budget is spilled, and can no longer be undone.
+    void SetMemoryBudget(size_t bytes);
+    size_t MemoryBudget() const { return _budget; }
+    size_t MemoryUsage() const { return _bytes; }
+    size_t NodeCount() const { return _live; }
 };
 
 
@@ -223,6 +270,23 @@ public:
     bool UIVisible() const { return activity.uiVisible; }
 
     LabActivity activity;
+
+    // An activity opts into running its Update concurrently with other
+    // activities by declaring the resources its Update reads and writes,
+    // and the activities whose Update must precede its own. Updates that
+    // share a written resource run in activity name order, as they would
+    // serially. Activities that don't opt in update on the main thread,
+    // after the concurrent updates have completed, in name order save that
+    // each follows the activities named in its after. A concurrent
+    // activity that names a serial activity in after can't run ahead of
+    // it, so it updates serially instead, as do those that follow it.
+    struct UpdateDeclaration {
+        bool concurrent = false;
+        std::vector<std::string> reads;
+        std::vector<std::string> writes;
+        std::vector<std::string> after;
+    };
+    UpdateDeclaration update;
 };
 
 /* A Studio configures the workspace and activates and
@@ -372,9 +436,48 @@ public:
     void RunActivityRendering(const LabViewInteraction&);
     void RunMainMenu();
         
+    // Transactions may be enqueued from any thread. They are executed in
+    // batches on the thread calling ServiceTransactionsAndActivities, which
+    // is therefore the only thread that appends to the Journal.
     void EnqueueTransaction(Transaction&&);
     void ServiceTransactionsAndActivities(float dt);
 
+    struct TransactionStats {
+        size_t   queueDepth = 0;        // approximate, pending transactions
+        size_t   lastBatchSize = 0;
+        uint64_t enqueued = 0;
+        uint64_t executed = 0;
+        uint64_t batches = 0;
+        double   lastLatencyMs = 0;     // enqueue to exec, oldest in last batch
+        double   maxLatencyMs = 0;
+        double   meanLatencyMs = 0;
+    };
+    TransactionStats GetTransactionStats() const;
+
+    // the maximum number of transactions executed per service call. Zero,
+    // the default, executes those pending when the call begins; those
+    // enqueued meanwhile, including by the transactions themselves, wait
+    // for the next frame.
+    void SetTransactionBatchLimit(size_t);
+
+    // when enabled, each batch executes within a single SdfChangeBlock so
+    // that USD change notification is sent once per batch.
+    void SetTransactionChangeBlocks(bool);
+
+    // measures enqueue to exec latency and throughput of the transaction
+    // queue, versus a zmq inproc push/pull transactor.
+    static int BenchmarkTransactions(int count);
+
+    // the number of threads running concurrent activity updates; zero means
+    // one per hardware thread, one runs them all on the main thread.
+    void SetUpdateThreads(int threads);
+
+    // verifies that concurrent updates produce the same results as serial
+    // updates, and reports update frame times from one thread up to
+    // maxThreads.
+    static int TestConcurrentUpdates();
+    static int BenchmarkUpdates(int activities, int frames, int maxThreads);
+
     Journal& GetJournal() const;
 };
 
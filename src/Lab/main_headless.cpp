@@ -0,0 +1,411 @@
+// main_headless.cpp
+//
+// Runs the Orchestrator without a window or GPU, so that provider and
+// activity work can be measured on build machines.
+//
+//   raven_headless [options]
+//     --studio NAME     activate the named studio before the first frame
+//     --frames N        number of simulated frames (default 600)
+//     --dt SECONDS      simulated frame time (default 1/60)
+//     --script PATH     transactions to enqueue on particular frames
+//     --ui              also run the UI each frame against a null ImGui
+//                       backend; nothing is rendered
+//     --threads N       number of threads for concurrent activity updates
+//     --csv PATH        write per-frame times in milliseconds
+//     --trace PATH      enable the profiler and write a Chrome trace
+//     --max-p99 MS      exit with status 2 if the p99 frame time exceeds MS
+//     --list            print the registered studios, activities and
+//                       providers, and exit; with --test or --benchmark,
+//                       print the suites that would run
+//     --test            run the test suites, and exit with status 3 if
+//                       any fail
+//     --benchmark       run the test suites and then the benchmarks,
+//                       likewise
+//     --only NAME       run only the suites whose name contains NAME
+//
+// A script has one command per line, prefixed by the frame on which it
+// is enqueued as a transaction. # starts a comment.
+//
+//   0   studio Texture
+//   10  activate Console
+//   20  deactivate Console
+//   30  noop 1000          enqueue 1000 empty transactions
+
+#include "App.h"
+#include "CSP.hpp"
+#include "Landru.hpp"
+#include "LabText.h"
+#include "StudioCore.hpp"
+#include "LabProfiler.hpp"
+#include "RegisterAllActivities.h"
+#include "Lab/CoreProviders/Color/ColorProvider.hpp"
+#include "Lab/CoreProviders/Color/nanocolorLUT.h"
+#include "Lab/CoreProviders/Color/nanocolorSpectral.h"
+#include "Lab/CoreProviders/Color/nanocolorUtils.h"
+#include "Lab/CoreProviders/Texture/TextureCacheTests.hpp"
+
+#include "imgui.h"
+#include "implot.h"
+#include "implot3d.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using lab::Orchestrator;
+using lab::Profiler;
+using lab::Transaction;
+
+namespace {
+
+struct ScriptCommand {
+    int frame = 0;
+    std::string verb;
+    std::string arg;
+};
+
+bool LoadScript(const char* path, std::vector<ScriptCommand>& script) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        auto hash = line.find('#');
+        if (hash != std::string::npos)
+            line.resize(hash);
+        std::istringstream ls(line);
+        ScriptCommand c;
+        if (!(ls >> c.frame))
+            continue; // blank line
+        if (!(ls >> c.verb)) {
+            std::cerr << path << ":" << lineNumber << ": missing command" << std::endl;
+            return false;
+        }
+        ls >> c.arg;
+        if (c.verb != "studio" && c.verb != "activate" &&
+            c.verb != "deactivate" && c.verb != "noop") {
+            std::cerr << path << ":" << lineNumber << ": unknown command "
+                      << c.verb << std::endl;
+            return false;
+        }
+        script.push_back(c);
+    }
+    std::stable_sort(script.begin(), script.end(),
+                     [](const ScriptCommand& a, const ScriptCommand& b) {
+                         return a.frame < b.frame; });
+    return true;
+}
+
+void EnqueueCommand(Orchestrator& mm, const ScriptCommand& c) {
+    std::string arg = c.arg;
+    if (c.verb == "studio") {
+        mm.EnqueueTransaction(Transaction("Activate studio " + arg,
+                                          [&mm, arg]() { mm.ActivateStudio(arg); }));
+    }
+    else if (c.verb == "activate") {
+        mm.EnqueueTransaction(Transaction("Activate " + arg,
+                                          [&mm, arg]() { mm.ActivateActivity(arg); }));
+    }
+    else if (c.verb == "deactivate") {
+        mm.EnqueueTransaction(Transaction("Deactivate " + arg,
+                                          [&mm, arg]() { mm.DeactivateActivity(arg); }));
+    }
+    else if (c.verb == "noop") {
+        int count = std::max(1, atoi(arg.c_str()));
+        for (int i = 0; i < count; ++i)
+            mm.EnqueueTransaction(Transaction("noop", []() {}));
+    }
+}
+
+// a null backend: a display size, a built font atlas, and no renderer.
+// ImGui::Render still builds draw lists, so UI cost is measured, but
+// nothing is submitted anywhere.
+void CreateNullImGui(bool ui) {
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImPlot::CreateContext();
+    ImPlot3D::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(1280, 768);
+    io.DisplayFramebufferScale = ImVec2(1, 1);
+    if (ui)
+        io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    unsigned char* pixels;
+    int w, h;
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &w, &h);
+}
+
+void DestroyNullImGui() {
+    ImPlot3D::DestroyContext();
+    ImPlot::DestroyContext();
+    ImGui::DestroyContext();
+}
+
+void PrintRegistry(Orchestrator& mm) {
+    std::cout << "Studios:" << std::endl;
+    for (auto& n : mm.StudioNames())
+        std::cout << "    " << n << std::endl;
+    std::cout << "Activities:" << std::endl;
+    for (auto& n : mm.ActivityNames())
+        std::cout << "    " << n << std::endl;
+    std::cout << "Providers:" << std::endl;
+    for (auto& n : mm.ProviderNames())
+        std::cout << "    " << n << std::endl;
+}
+
+// a test or benchmark suite; each returns its number of failures
+struct Suite {
+    const char* name;
+    bool benchmark;
+    std::function<int()> run;
+};
+
+// the engine's tests and benchmarks, with a single worker and with several
+int RunCSP(bool benchmark) {
+    int failures = 0;
+    for (int workers : { 1, 4 }) {
+        lab::CSP_Engine engine;
+        engine.set_worker_count(workers);
+        failures += benchmark ? engine.benchmark(200000) : engine.test();
+    }
+    return failures;
+}
+
+// nanocolor's transforms, LUTs and spectral functions, and the conversion
+// of cached images into the rendering color space
+int RunColor(bool benchmark) {
+    if (!benchmark)
+        return NcTestTransformColors() + NcTestTransforms() + NcTestLUTs() + NcTestSpectral() +
+               lab::ColorProvider::TestConvertCachedLevels();
+    const size_t count = size_t(1) << 20;
+    return NcBenchmarkTransformColors(count) + NcBenchmarkTransforms(count / 4) +
+           NcBenchmarkLUTs(count) + NcBenchmarkSpectral(count / 4);
+}
+
+const std::vector<Suite>& Suites() {
+    static const std::vector<Suite> suites = {
+        { "color",          false, []() { return RunColor(false); } },
+        { "csp",            false, []() { return RunCSP(false); } },
+        { "texture",        false, []() { return lab::RunTextureTests(); } },
+        { "updates",        false, []() { return Orchestrator::TestConcurrentUpdates(); } },
+        { "transactions",   true,  []() { return Orchestrator::BenchmarkTransactions(100000); } },
+        { "color",          true,  []() { return RunColor(true); } },
+        { "csp",            true,  []() { return RunCSP(true); } },
+        { "landru",         true,  []() { return LandruBenchmark(10000); } },
+        { "landru-compile", true,  []() { return LandruBenchmarkCompile(1000); } },
+        { "sexpr",          true,  []() { return tsSexprScanBenchmark(size_t(16) << 20); } },
+        { "texture",        true,  []() { return lab::RunTextureBenchmarks(); } },
+        { "updates",        true,  []() {
+            int threads = (int) std::max(4u, std::thread::hardware_concurrency());
+            return Orchestrator::BenchmarkUpdates(64, 60, threads); } },
+    };
+    return suites;
+}
+
+// runs the tests, then if benchmark the benchmarks, of the suites whose
+// name contains only, and returns the number of failures
+int RunSuites(bool benchmark, const std::string& only, bool list) {
+    int failures = 0;
+    for (auto& suite : Suites()) {
+        if (suite.benchmark && !benchmark)
+            continue;
+        if (!only.empty() && !strstr(suite.name, only.c_str()))
+            continue;
+        if (list) {
+            printf("%-10s %s\n", suite.benchmark ? "benchmark" : "test", suite.name);
+            continue;
+        }
+        int f = suite.run();
+        if (f)
+            printf("%s %s: %d failures\n", suite.name, suite.benchmark ? "benchmark" : "test", f);
+        failures += f;
+    }
+    if (!list)
+        printf("%d failures\n", failures);
+    return failures;
+}
+
+int Usage(const char* exe) {
+    std::cerr << "usage: " << exe << " [--studio NAME] [--frames N] [--dt SECONDS]"
+                 " [--script PATH] [--ui] [--threads N] [--csv PATH]"
+                 " [--trace PATH] [--max-p99 MS] [--list] [--test]"
+                 " [--benchmark] [--only NAME]" << std::endl;
+    return 1;
+}
+
+} // anon
+
+int main(int argc, char** argv) {
+    std::string studio;
+    std::string scriptPath;
+    std::string csvPath;
+    std::string tracePath;
+    std::string only;
+    int frames = 600;
+    int threads = -1;
+    float dt = 1.f / 60.f;
+    double maxP99 = 0;
+    bool ui = false;
+    bool list = false;
+    bool test = false;
+    bool benchmark = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        bool more = i + 1 < argc;
+        if (!strcmp(a, "--studio") && more)         studio = argv[++i];
+        else if (!strcmp(a, "--frames") && more)    frames = atoi(argv[++i]);
+        else if (!strcmp(a, "--dt") && more)        dt = (float) atof(argv[++i]);
+        else if (!strcmp(a, "--script") && more)    scriptPath = argv[++i];
+        else if (!strcmp(a, "--threads") && more)   threads = atoi(argv[++i]);
+        else if (!strcmp(a, "--csv") && more)       csvPath = argv[++i];
+        else if (!strcmp(a, "--trace") && more)     tracePath = argv[++i];
+        else if (!strcmp(a, "--max-p99") && more)   maxP99 = atof(argv[++i]);
+        else if (!strcmp(a, "--only") && more)      only = argv[++i];
+        else if (!strcmp(a, "--ui"))                ui = true;
+        else if (!strcmp(a, "--list"))              list = true;
+        else if (!strcmp(a, "--test"))              test = true;
+        else if (!strcmp(a, "--benchmark"))         benchmark = true;
+        else
+            return Usage(argv[0]);
+    }
+    if (frames < 1 || dt < 0)
+        return Usage(argv[0]);
+
+    // the tests need neither the studios nor ImGui
+    if (test || benchmark)
+        return RunSuites(benchmark, only, list) ? 3 : 0;
+
+    std::vector<ScriptCommand> script;
+    if (!scriptPath.empty() && !LoadScript(scriptPath.c_str(), script)) {
+        std::cerr << "Could not load script " << scriptPath << std::endl;
+        return 1;
+    }
+
+    CreateNullImGui(ui);
+
+    App* app = gApp();
+    Orchestrator& mm = *lab::gOrchestrator();
+    RegisterAllActivities(mm);
+
+    if (list) {
+        PrintRegistry(mm);
+        DestroyNullImGui();
+        return 0;
+    }
+
+    if (!studio.empty()) {
+        if (!mm.FindStudio(studio)) {
+            std::cerr << "Unknown studio " << studio << std::endl;
+            PrintRegistry(mm);
+            DestroyNullImGui();
+            return 1;
+        }
+        mm.ActivateStudio(studio);
+    }
+    if (threads >= 0)
+        mm.SetUpdateThreads(threads);
+    if (!tracePath.empty())
+        Profiler::SetEnabled(true);
+
+    using clock = std::chrono::steady_clock;
+
+    // studio activation is reported separately from the frame times
+    auto t0 = clock::now();
+    mm.ServiceTransactionsAndActivities(0);
+    double activationMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    size_t next = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        while (next < script.size() && script[next].frame <= frame)
+            EnqueueCommand(mm, script[next++]);
+
+        auto start = clock::now();
+        if (ui) {
+            // the app services transactions and activities from its Gui
+            ImGui::GetIO().DeltaTime = dt > 0 ? dt : 1.f / 60.f;
+            ImGui::NewFrame();
+            app->Gui();
+            ImGui::Render();
+        }
+        else {
+            mm.ServiceTransactionsAndActivities(dt);
+        }
+        frameMs.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+
+        if (!app->IsRunning())
+            break;
+    }
+
+    auto tx = mm.GetTransactionStats();
+
+    if (!csvPath.empty()) {
+        FILE* f = fopen(csvPath.c_str(), "w");
+        if (f) {
+            fprintf(f, "frame,ms\n");
+            for (size_t i = 0; i < frameMs.size(); ++i)
+                fprintf(f, "%zu,%.4f\n", i, frameMs[i]);
+            fclose(f);
+        }
+        else
+            std::cerr << "Could not write " << csvPath << std::endl;
+    }
+    if (!tracePath.empty()) {
+        if (Profiler::WriteChromeTrace(tracePath.c_str()))
+            std::cout << "Wrote profile trace to " << tracePath << std::endl;
+        else
+            std::cerr << "Could not write profile trace to " << tracePath << std::endl;
+    }
+
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double v : sorted)
+        total += v;
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, (size_t) (sorted.size() * p))];
+    };
+    double p99 = percentile(0.99);
+
+    printf("studio %s, %zu frames, dt %.4f s%s\n",
+           studio.empty() ? "(none)" : studio.c_str(), frameMs.size(), dt,
+           ui ? ", with UI" : "");
+    printf("activation %.3f ms\n", activationMs);
+    printf("frame ms: min %.3f  avg %.3f  p50 %.3f  p99 %.3f  max %.3f  total %.1f\n",
+           sorted.front(), total / sorted.size(), percentile(0.5), p99,
+           sorted.back(), total);
+    printf("transactions: %llu executed in %llu batches, max latency %.3f ms\n",
+           (unsigned long long) tx.executed, (unsigned long long) tx.batches,
+           tx.maxLatencyMs);
+
+    if (Profiler::Enabled()) {
+        printf("%-16s %-32s %8s %9s %9s %9s %9s\n",
+               "category", "name", "samples", "min", "avg", "p99", "max");
+        for (auto& s : Profiler::GetStats())
+            printf("%-16s %-32s %8d %9.3f %9.3f %9.3f %9.3f\n",
+                   s.category.c_str(), s.name.c_str(), s.samples,
+                   s.minMs, s.avgMs, s.p99Ms, s.maxMs);
+    }
+
+    DestroyNullImGui();
+
+    if (maxP99 > 0 && p99 > maxP99) {
+        printf("p99 frame time %.3f ms exceeds the budget of %.3f ms\n", p99, maxP99);
+        return 2;
+    }
+    return 0;
+}